@@ -0,0 +1,137 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "analysis_worker.hpp"
+#include "commandbuffer.hpp"
+#include "queue.hpp"
+
+using namespace std;
+
+namespace MPD
+{
+void SubmitSnapshot::clear()
+{
+	indexData.clear();
+	indexOffsets.clear();
+	indexWriteGenerations.clear();
+	indirectData.clear();
+	indirectOffsets.clear();
+	viewUsages.clear();
+	viewUsageCounts.clear();
+	nextIndexScan = 0;
+	nextIndirectDraw = 0;
+	nextDescriptorSet = 0;
+	nextViewUsage = 0;
+}
+
+void AnalysisJob::clear()
+{
+	queue = nullptr;
+	commandBuffers.clear();
+	references.clear();
+	snapshot.clear();
+}
+
+AnalysisWorker::AnalysisWorker(size_t queueDepth)
+    : jobs(new AnalysisJob[queueDepth ? queueDepth : 1])
+    , capacity(queueDepth ? queueDepth : 1)
+{
+	thread = std::thread(&AnalysisWorker::run, this);
+}
+
+AnalysisWorker::~AnalysisWorker()
+{
+	{
+		lock_guard<mutex> holder{ sleepLock };
+		stopping = true;
+	}
+	sleepCond.notify_one();
+
+	// The worker finishes all queued jobs before it exits.
+	thread.join();
+}
+
+AnalysisJob &AnalysisWorker::beginJob(Queue &queue)
+{
+	uint64_t index = head.load(memory_order_relaxed);
+	while (index - tail.load(memory_order_acquire) >= capacity)
+		this_thread::yield();
+
+	auto &job = jobs[index % capacity];
+	job.clear();
+	job.queue = &queue;
+	return job;
+}
+
+void AnalysisWorker::endJob()
+{
+	head.store(head.load(memory_order_relaxed) + 1, memory_order_seq_cst);
+
+	// Only take the lock if the worker might be waiting for us.
+	if (sleeping.load(memory_order_seq_cst))
+	{
+		lock_guard<mutex> holder{ sleepLock };
+		sleepCond.notify_one();
+	}
+}
+
+void AnalysisWorker::drain()
+{
+	uint64_t index = head.load(memory_order_relaxed);
+	while (tail.load(memory_order_acquire) != index)
+		this_thread::yield();
+}
+
+void AnalysisWorker::execute(AnalysisJob &job)
+{
+	for (auto *commandBuffer : job.commandBuffers)
+		commandBuffer->replayDeferredCommands(*job.queue, &job.snapshot);
+
+	for (auto *commandBuffer : job.references)
+		commandBuffer->releaseAnalysisReference();
+}
+
+void AnalysisWorker::run()
+{
+	for (;;)
+	{
+		uint64_t index = tail.load(memory_order_relaxed);
+
+		if (head.load(memory_order_acquire) == index)
+		{
+			sleeping.store(true, memory_order_seq_cst);
+			if (head.load(memory_order_seq_cst) == index)
+			{
+				unique_lock<mutex> holder{ sleepLock };
+				sleepCond.wait(holder, [&] { return stopping || head.load(memory_order_acquire) != index; });
+				if (head.load(memory_order_acquire) == index)
+				{
+					sleeping.store(false, memory_order_relaxed);
+					return;
+				}
+			}
+			sleeping.store(false, memory_order_relaxed);
+		}
+
+		execute(jobs[index % capacity]);
+		tail.store(index + 1, memory_order_release);
+	}
+}
+}
@@ -0,0 +1,126 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "image.hpp"
+#include "perfdoc.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MPD
+{
+class CommandBuffer;
+class ImageView;
+class Queue;
+
+/// State captured at vkQueueSubmit which the application is free to modify once the submit returns.
+/// Entries are stored in the order the deferred commands are replayed.
+struct SubmitSnapshot
+{
+	static const size_t NOT_MAPPED = ~size_t(0);
+
+	// Copy of the indices for every deferred index buffer scan,
+	// or NOT_MAPPED if the indices cannot be read or have already been scanned.
+	std::vector<uint8_t> indexData;
+	std::vector<size_t> indexOffsets;
+	// Write generation of the index buffer memory when the indices were copied.
+	std::vector<uint64_t> indexWriteGenerations;
+
+	// Copy of the arguments of every deferred indirect drawcall, or NOT_MAPPED if they cannot be read.
+	std::vector<uint8_t> indirectData;
+	std::vector<size_t> indirectOffsets;
+
+	// Image views referenced by every deferred descriptor set usage.
+	std::vector<std::pair<ImageView *, Image::Usage>> viewUsages;
+	std::vector<uint32_t> viewUsageCounts;
+
+	// Replay cursors.
+	size_t nextIndexScan = 0;
+	size_t nextIndirectDraw = 0;
+	size_t nextDescriptorSet = 0;
+	size_t nextViewUsage = 0;
+
+	void clear();
+};
+
+/// A vkQueueSubmit waiting to be analyzed.
+struct AnalysisJob
+{
+	Queue *queue = nullptr;
+
+	// Primary command buffers in submission order.
+	std::vector<CommandBuffer *> commandBuffers;
+
+	// Every command buffer the job reads from, including secondaries. These cannot be reset until the job is done.
+	std::vector<CommandBuffer *> references;
+
+	SubmitSnapshot snapshot;
+
+	void clear();
+};
+
+/// Runs the checks deferred to vkQueueSubmit on a dedicated thread.
+///
+/// Jobs live in a bounded ring which is filled in place, so steady state submission does not allocate.
+/// There is a single worker, so findings are reported in submission order, per queue and across queues.
+/// If the ring is full, the submitting thread waits for the worker to catch up.
+class AnalysisWorker
+{
+public:
+	explicit AnalysisWorker(size_t queueDepth);
+	~AnalysisWorker();
+
+	AnalysisWorker(const AnalysisWorker &) = delete;
+	void operator=(const AnalysisWorker &) = delete;
+
+	/// Returns an empty job to fill in. Must be followed by endJob().
+	/// beginJob(), endJob() and drain() must be externally synchronized.
+	AnalysisJob &beginJob(Queue &queue);
+	void endJob();
+
+	/// Waits until all queued jobs have been analyzed.
+	/// Used before the application destroys or modifies objects which queued jobs may still read.
+	void drain();
+
+private:
+	std::unique_ptr<AnalysisJob[]> jobs;
+	size_t capacity;
+
+	// head is only written by the submitting thread, tail is only written by the worker once a job is done.
+	std::atomic<uint64_t> head{ 0 };
+	std::atomic<uint64_t> tail{ 0 };
+
+	// Only used to put the worker to sleep when there is nothing to do.
+	std::mutex sleepLock;
+	std::condition_variable sleepCond;
+	std::atomic<bool> sleeping{ false };
+	bool stopping = false;
+
+	std::thread thread;
+
+	void run();
+	void execute(AnalysisJob &job);
+};
+}
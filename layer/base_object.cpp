@@ -36,15 +36,12 @@ Instance *BaseObject::getInstance() const
 static void dispatchLog(Logger &logger, VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT type,
                         uint64_t objHandle, int32_t messageCode, const char *fmt, va_list args)
 {
-	char buffer[1024 * 10];
-	vsnprintf(buffer, sizeof(buffer), fmt, args);
-
 	LoggerMessageInfo inf;
 	inf.flags = flags;
 	inf.objectType = type;
 	inf.object = objHandle;
 	inf.messageCode = messageCode;
-	logger.write(inf, buffer);
+	logger.writeFormatted(inf, fmt, args);
 }
 
 void BaseObject::log(VkDebugReportFlagsEXT flags, int32_t messageCode, const char *fmt, ...)
@@ -48,6 +48,11 @@ public:
 		return baseDevice;
 	}
 
+	uint64_t getHandle() const
+	{
+		return objHandle;
+	}
+
 	/// Get universaly unique identifier. It's unique for all objects.
 	uint64_t getUuid() const
 	{
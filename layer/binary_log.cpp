@@ -0,0 +1,326 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "binary_log.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <string.h>
+
+#ifdef MPD_BINARY_LOG_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace MPD
+{
+static uint32_t getThreadIndex()
+{
+	static atomic<uint32_t> nextIndex{ 0 };
+	static thread_local uint32_t index = nextIndex.fetch_add(1, memory_order_relaxed);
+	return index;
+}
+
+static size_t alignRecordSize(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+BinaryLog::~BinaryLog()
+{
+#ifdef MPD_BINARY_LOG_MMAP
+	if (chunk)
+		munmap(chunk, CHUNK_SIZE);
+	if (fd >= 0)
+	{
+		// Drop the unwritten part of the last chunk. If this fails, the decoder stops at the zeroes anyway.
+		int res = ftruncate(fd, off_t(chunkBase + chunkOffset));
+		MPD_UNUSED(res);
+		close(fd);
+	}
+#else
+	if (file)
+		fclose(file);
+#endif
+}
+
+bool BinaryLog::init(const char *path)
+{
+	start = chrono::steady_clock::now();
+
+#ifdef MPD_BINARY_LOG_MMAP
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	if (!mapChunk(0))
+	{
+		close(fd);
+		fd = -1;
+		return false;
+	}
+#else
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+#endif
+
+	BinaryLogFileHeader header = {};
+	memcpy(header.magic, BINARY_LOG_MAGIC, sizeof(header.magic));
+	header.version = BINARY_LOG_VERSION;
+	header.headerSize = sizeof(header);
+	header.startTimeNs =
+	    uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count());
+	append(&header, sizeof(header));
+	return true;
+}
+
+#ifdef MPD_BINARY_LOG_MMAP
+bool BinaryLog::mapChunk(uint64_t base)
+{
+	if (ftruncate(fd, off_t(base + CHUNK_SIZE)) != 0)
+		return false;
+
+	void *mapping = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, off_t(base));
+	if (mapping == MAP_FAILED)
+		return false;
+
+	chunk = static_cast<uint8_t *>(mapping);
+	chunkBase = base;
+	chunkOffset = 0;
+	return true;
+}
+#endif
+
+void BinaryLog::append(const void *data, size_t size)
+{
+	MPD_ASSERT(size % 8 == 0);
+
+#ifdef MPD_BINARY_LOG_MMAP
+	if (!chunk)
+		return;
+
+	if (chunkOffset + size > CHUNK_SIZE)
+	{
+		// Records never straddle chunks, pad out the rest of this one.
+		size_t remaining = CHUNK_SIZE - chunkOffset;
+		if (remaining)
+		{
+			BinaryLogRecordHeader padding = { BINARY_LOG_RECORD_PADDING, uint32_t(remaining) };
+			memcpy(chunk + chunkOffset, &padding, sizeof(padding));
+		}
+
+		munmap(chunk, CHUNK_SIZE);
+		chunk = nullptr;
+		if (!mapChunk(chunkBase + CHUNK_SIZE))
+			return;
+	}
+
+	memcpy(chunk + chunkOffset, data, size);
+	chunkOffset += size;
+#else
+	if (file)
+		fwrite(data, size, 1, file);
+#endif
+}
+
+const BinaryLog::Format &BinaryLog::getFormat(const char *fmt)
+{
+	auto itr = formats.find(fmt);
+	if (itr != end(formats))
+		return itr->second;
+
+	Format format;
+	format.id = uint32_t(formats.size());
+
+	const char *cursor = fmt;
+	BinaryLogConversion conversion;
+	while (nextBinaryLogConversion(cursor, conversion))
+	{
+		if (conversion.widthArg)
+			format.args.push_back(BinaryLogArg::INT);
+		if (conversion.precisionArg)
+			format.args.push_back(BinaryLogArg::INT);
+		if (conversion.arg != BinaryLogArg::NONE)
+			format.args.push_back(conversion.arg);
+	}
+
+	uint32_t length = uint32_t(strlen(fmt));
+	size_t size = alignRecordSize(sizeof(BinaryLogFormatRecord) + length + 1);
+	vector<uint8_t> buffer(size);
+
+	BinaryLogFormatRecord record;
+	record.header.type = BINARY_LOG_RECORD_FORMAT;
+	record.header.size = uint32_t(size);
+	record.formatId = format.id;
+	record.length = length;
+	memcpy(buffer.data(), &record, sizeof(record));
+	memcpy(buffer.data() + sizeof(record), fmt, length);
+	append(buffer.data(), size);
+
+	return formats.insert(make_pair(fmt, move(format))).first->second;
+}
+
+void BinaryLog::write(const LoggerMessageInfo &inf, const char *fmt, va_list args)
+{
+	auto timestamp = chrono::steady_clock::now() - start;
+
+	uint8_t buffer[sizeof(BinaryLogMessageRecord) + MAX_ARG_SIZE];
+	uint8_t *argData = buffer + sizeof(BinaryLogMessageRecord);
+	size_t argSize = 0;
+
+	lock_guard<mutex> holder{ lock };
+	const auto &format = getFormat(fmt);
+
+	for (auto arg : format.args)
+	{
+		uint64_t value = 0;
+		switch (arg)
+		{
+		case BinaryLogArg::NONE:
+			continue;
+
+		case BinaryLogArg::INT:
+			value = uint64_t(int64_t(va_arg(args, int)));
+			break;
+
+		case BinaryLogArg::UNSIGNED_INT:
+			value = va_arg(args, unsigned);
+			break;
+
+		case BinaryLogArg::LONG:
+			value = uint64_t(int64_t(va_arg(args, long)));
+			break;
+
+		case BinaryLogArg::UNSIGNED_LONG:
+			value = va_arg(args, unsigned long);
+			break;
+
+		case BinaryLogArg::LONG_LONG:
+			value = uint64_t(va_arg(args, long long));
+			break;
+
+		case BinaryLogArg::UNSIGNED_LONG_LONG:
+			value = va_arg(args, unsigned long long);
+			break;
+
+		case BinaryLogArg::SIZE:
+			value = va_arg(args, size_t);
+			break;
+
+		case BinaryLogArg::DOUBLE:
+		{
+			double d = va_arg(args, double);
+			memcpy(&value, &d, sizeof(d));
+			break;
+		}
+
+		case BinaryLogArg::LONG_DOUBLE:
+		{
+			double d = double(va_arg(args, long double));
+			memcpy(&value, &d, sizeof(d));
+			break;
+		}
+
+		case BinaryLogArg::POINTER:
+			value = uint64_t(reinterpret_cast<uintptr_t>(va_arg(args, void *)));
+			break;
+
+		case BinaryLogArg::STRING:
+		{
+			const char *str = va_arg(args, const char *);
+			if (!str)
+				str = "(null)";
+
+			if (argSize + sizeof(uint32_t) > MAX_ARG_SIZE)
+				break;
+			uint32_t length = uint32_t(std::min(strlen(str), MAX_ARG_SIZE - argSize - sizeof(uint32_t)));
+			memcpy(argData + argSize, &length, sizeof(length));
+			memcpy(argData + argSize + sizeof(length), str, length);
+			argSize += sizeof(length) + length;
+			continue;
+		}
+		}
+
+		if (argSize + sizeof(value) > MAX_ARG_SIZE)
+			break;
+		memcpy(argData + argSize, &value, sizeof(value));
+		argSize += sizeof(value);
+	}
+
+	size_t size = alignRecordSize(sizeof(BinaryLogMessageRecord) + argSize);
+	memset(argData + argSize, 0, size - sizeof(BinaryLogMessageRecord) - argSize);
+
+	BinaryLogMessageRecord record;
+	record.header.type = BINARY_LOG_RECORD_MESSAGE;
+	record.header.size = uint32_t(size);
+	record.timestampNs = uint64_t(chrono::duration_cast<chrono::nanoseconds>(timestamp).count());
+	record.object = inf.object;
+	record.frame = frame.load(memory_order_relaxed);
+	record.threadIndex = getThreadIndex();
+	record.messageCode = inf.messageCode;
+	record.objectType = uint32_t(inf.objectType);
+	record.flags = inf.flags;
+	record.formatId = format.id;
+	record.argSize = uint32_t(argSize);
+	memcpy(buffer, &record, sizeof(record));
+
+	append(buffer, size);
+}
+
+void BinaryLog::writeFrame(uint64_t frameTimeNs, const uint64_t *counters, uint32_t counterCount)
+{
+	auto timestamp = chrono::steady_clock::now() - start;
+
+	static const uint32_t MAX_COUNTERS = 32;
+	counterCount = std::min(counterCount, MAX_COUNTERS);
+
+	uint8_t buffer[sizeof(BinaryLogFrameRecord) + MAX_COUNTERS * sizeof(uint64_t)];
+	size_t size = sizeof(BinaryLogFrameRecord) + counterCount * sizeof(uint64_t);
+
+	BinaryLogFrameRecord record;
+	record.header.type = BINARY_LOG_RECORD_FRAME;
+	record.header.size = uint32_t(size);
+	record.frame = frame.load(memory_order_relaxed);
+	record.timestampNs = uint64_t(chrono::duration_cast<chrono::nanoseconds>(timestamp).count());
+	record.frameTimeNs = frameTimeNs;
+	record.counterCount = counterCount;
+	record.reserved = 0;
+	memcpy(buffer, &record, sizeof(record));
+	memcpy(buffer + sizeof(record), counters, counterCount * sizeof(uint64_t));
+
+	lock_guard<mutex> holder{ lock };
+	append(buffer, size);
+}
+
+static void writeVariadic(BinaryLog &log, const LoggerMessageInfo &inf, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	log.write(inf, fmt, args);
+	va_end(args);
+}
+
+void BinaryLog::writeText(const LoggerMessageInfo &inf, const char *msg)
+{
+	writeVariadic(*this, inf, "%s", msg);
+}
+}
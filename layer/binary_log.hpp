@@ -0,0 +1,104 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "binary_log_format.hpp"
+#include "perfdoc.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <mutex>
+#include <stdio.h>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__) || defined(ANDROID)
+#define MPD_BINARY_LOG_MMAP 1
+#endif
+
+namespace MPD
+{
+struct LoggerMessageInfo;
+
+/// Writes messages as binary records (see binary_log_format.hpp) instead of formatting them.
+///
+/// Recording a message copies its argument values into the log, the format string is written once.
+/// Where mmap is available, the file is mapped in chunks and records are copied straight into the mapping,
+/// so the log survives a crash up to the last message. Elsewhere, records are written with stdio.
+/// Thread-safe.
+class BinaryLog
+{
+public:
+	BinaryLog() = default;
+	~BinaryLog();
+
+	BinaryLog(const BinaryLog &) = delete;
+	void operator=(const BinaryLog &) = delete;
+
+	bool init(const char *path);
+
+	/// Records a message, the va_list is consumed.
+	void write(const LoggerMessageInfo &inf, const char *fmt, va_list args);
+
+	/// Records a message which has already been formatted.
+	void writeText(const LoggerMessageInfo &inf, const char *msg);
+
+	/// Records the counters of the frame which is ending, see FrameStats.
+	void writeFrame(uint64_t frameTimeNs, const uint64_t *counters, uint32_t counterCount);
+
+	/// Called at every vkQueuePresentKHR.
+	void nextFrame()
+	{
+		frame.fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+	// Arguments which do not fit are dropped, long strings are truncated.
+	static const size_t MAX_ARG_SIZE = 4096;
+	static const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+	struct Format
+	{
+		uint32_t id;
+		std::vector<BinaryLogArg> args;
+	};
+
+	std::mutex lock;
+	std::unordered_map<const char *, Format> formats;
+	std::atomic<uint64_t> frame{ 0 };
+	std::chrono::steady_clock::time_point start;
+
+#ifdef MPD_BINARY_LOG_MMAP
+	int fd = -1;
+	uint8_t *chunk = nullptr;
+	size_t chunkOffset = 0;
+	// Offset of the chunk in the file.
+	uint64_t chunkBase = 0;
+
+	bool mapChunk(uint64_t base);
+#else
+	FILE *file = nullptr;
+#endif
+
+	const Format &getFormat(const char *fmt);
+	void append(const void *data, size_t size);
+	void writeRecord(const LoggerMessageInfo &inf, const Format &format, const uint8_t *args, size_t argSize);
+};
+}
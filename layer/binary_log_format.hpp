@@ -0,0 +1,265 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+
+// Layout of the binary log written when loggingBinary is set, shared with the perfdoc-log-decode tool.
+// Everything is stored in the byte order of the machine which wrote the log.
+//
+// The file starts with a BinaryLogFileHeader, followed by records. Every record starts with a
+// BinaryLogRecordHeader and is padded to a multiple of 8 bytes. A record of type BINARY_LOG_RECORD_END (zero),
+// e.g. the unwritten tail of a log which was not closed, ends the log.
+//
+// Messages are not formatted. Each format string is written once as a BINARY_LOG_RECORD_FORMAT, and messages
+// refer to it by id, followed by the raw values of their arguments in order:
+// 8 bytes for numbers and pointers, and a uint32_t length followed by the characters for strings.
+namespace MPD
+{
+static const char BINARY_LOG_MAGIC[8] = { 'P', 'V', 'R', 'P', 'D', 'L', 'O', 'G' };
+static const uint32_t BINARY_LOG_VERSION = 1;
+
+enum BinaryLogRecordType
+{
+	BINARY_LOG_RECORD_END = 0,
+	BINARY_LOG_RECORD_FORMAT = 1,
+	BINARY_LOG_RECORD_MESSAGE = 2,
+	BINARY_LOG_RECORD_PADDING = 3,
+	BINARY_LOG_RECORD_FRAME = 4
+};
+
+struct BinaryLogFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	// Wall clock time the log was opened, in nanoseconds since the UNIX epoch.
+	uint64_t startTimeNs;
+};
+
+struct BinaryLogRecordHeader
+{
+	uint32_t type;
+	// Including the header and padding.
+	uint32_t size;
+};
+
+struct BinaryLogFormatRecord
+{
+	BinaryLogRecordHeader header;
+	uint32_t formatId;
+	// The format string follows, length characters and a terminating zero.
+	uint32_t length;
+};
+
+struct BinaryLogMessageRecord
+{
+	BinaryLogRecordHeader header;
+	// Time since the log was opened.
+	uint64_t timestampNs;
+	uint64_t object;
+	// Number of vkQueuePresentKHR calls before the message.
+	uint64_t frame;
+	// Small integer identifying the logging thread, in order of first use.
+	uint32_t threadIndex;
+	int32_t messageCode;
+	uint32_t objectType;
+	uint32_t flags;
+	uint32_t formatId;
+	// The arguments follow.
+	uint32_t argSize;
+};
+
+// Written at every vkQueuePresentKHR when frameStatsEnable is set.
+struct BinaryLogFrameRecord
+{
+	BinaryLogRecordHeader header;
+	// Index of the frame which ended, as in BinaryLogMessageRecord.
+	uint64_t frame;
+	uint64_t timestampNs;
+	// Time since the previous present.
+	uint64_t frameTimeNs;
+	// counterCount uint64_t counters follow, named by BINARY_LOG_FRAME_COUNTERS.
+	uint32_t counterCount;
+	uint32_t reserved;
+};
+
+static const char *const BINARY_LOG_FRAME_COUNTERS[] = {
+	"draws", "dispatches", "render_passes", "submits", "barriers", "descriptor_updates", "pipeline_binds",
+	"layer_cpu_time_ns"
+};
+
+static_assert(sizeof(BinaryLogFileHeader) == 24, "Unexpected padding in BinaryLogFileHeader");
+static_assert(sizeof(BinaryLogFormatRecord) == 16, "Unexpected padding in BinaryLogFormatRecord");
+static_assert(sizeof(BinaryLogMessageRecord) == 56, "Unexpected padding in BinaryLogMessageRecord");
+static_assert(sizeof(BinaryLogFrameRecord) == 40, "Unexpected padding in BinaryLogFrameRecord");
+
+/// How a printf conversion reads its argument.
+enum class BinaryLogArg
+{
+	// %% and conversions which read nothing.
+	NONE,
+	INT,
+	UNSIGNED_INT,
+	LONG,
+	UNSIGNED_LONG,
+	LONG_LONG,
+	UNSIGNED_LONG_LONG,
+	SIZE,
+	DOUBLE,
+	LONG_DOUBLE,
+	STRING,
+	POINTER
+};
+
+struct BinaryLogConversion
+{
+	// The conversion specification, from '%' to the conversion character inclusive.
+	const char *begin;
+	const char *end;
+	// '*' field width and precision, each read as an int before the argument.
+	bool widthArg;
+	bool precisionArg;
+	BinaryLogArg arg;
+};
+
+/// Finds the next conversion at or after cursor, and moves the cursor past it.
+/// Returns false at the end of the format string, or at a conversion the log does not support (e.g. %n).
+inline bool nextBinaryLogConversion(const char *&cursor, BinaryLogConversion &conversion)
+{
+	const char *c = cursor;
+	while (*c && *c != '%')
+		c++;
+	if (!*c)
+		return false;
+
+	conversion.begin = c++;
+	conversion.widthArg = false;
+	conversion.precisionArg = false;
+
+	while (*c == '-' || *c == '+' || *c == ' ' || *c == '#' || *c == '0')
+		c++;
+
+	if (*c == '*')
+	{
+		conversion.widthArg = true;
+		c++;
+	}
+	else
+	{
+		while (*c >= '0' && *c <= '9')
+			c++;
+	}
+
+	if (*c == '.')
+	{
+		c++;
+		if (*c == '*')
+		{
+			conversion.precisionArg = true;
+			c++;
+		}
+		else
+		{
+			while (*c >= '0' && *c <= '9')
+				c++;
+		}
+	}
+
+	// Length modifiers, hh and h are promoted to int anyway.
+	int longs = 0;
+	bool size = false;
+	bool longDouble = false;
+	for (;; c++)
+	{
+		if (*c == 'h')
+			continue;
+		else if (*c == 'l')
+			longs++;
+		else if (*c == 'j' || *c == 't')
+			longs = 2;
+		else if (*c == 'z')
+			size = true;
+		else if (*c == 'L')
+			longDouble = true;
+		else
+			break;
+	}
+
+	bool isSigned = true;
+	switch (*c)
+	{
+	case '%':
+		conversion.arg = BinaryLogArg::NONE;
+		break;
+
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		isSigned = false;
+		// Fallthrough
+	case 'd':
+	case 'i':
+		if (size)
+			conversion.arg = BinaryLogArg::SIZE;
+		else if (longs >= 2)
+			conversion.arg = isSigned ? BinaryLogArg::LONG_LONG : BinaryLogArg::UNSIGNED_LONG_LONG;
+		else if (longs == 1)
+			conversion.arg = isSigned ? BinaryLogArg::LONG : BinaryLogArg::UNSIGNED_LONG;
+		else
+			conversion.arg = isSigned ? BinaryLogArg::INT : BinaryLogArg::UNSIGNED_INT;
+		break;
+
+	case 'c':
+		conversion.arg = BinaryLogArg::INT;
+		break;
+
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		conversion.arg = longDouble ? BinaryLogArg::LONG_DOUBLE : BinaryLogArg::DOUBLE;
+		break;
+
+	case 's':
+		// Wide strings are not supported.
+		if (longs)
+			return false;
+		conversion.arg = BinaryLogArg::STRING;
+		break;
+
+	case 'p':
+		conversion.arg = BinaryLogArg::POINTER;
+		break;
+
+	default:
+		return false;
+	}
+
+	conversion.end = ++c;
+	cursor = c;
+	return true;
+}
+}
@@ -33,8 +33,9 @@ VkResult Buffer::init(VkBuffer buffer_, const VkBufferCreateInfo &createInfo_)
 	baseDevice->getTable()->GetBufferMemoryRequirements(baseDevice->getDevice(), buffer, &memoryRequirements);
 
 	// we need to be able to map indexbuffer back to host memory
-	// so modify memory requirements such that host_visible is always used
-	if (createInfo.usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+	// so modify memory requirements such that host_visible is always used,
+	// unless indices are copied back on the GPU instead
+	if ((createInfo.usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) && !getDevice()->getIndexReadback())
 	{
 		const VkPhysicalDeviceMemoryProperties &memoryProperties = getDevice()->getMemoryProperties();
 		memoryRequirements.memoryTypeBits = INDEXBUFFER_MEMORY_PROPERTIES;
@@ -58,10 +59,14 @@ VkResult Buffer::bindMemory(DeviceMemory *memory_, VkDeviceSize offset)
 	memory = memory_;
 	memoryOffset = offset;
 
-	auto memorySize = memory->getAllocateInfo().allocationSize;
-
 	const auto &cfg = this->getDevice()->getConfig();
 
+	// Index buffers are scanned from the mapping, so find out when the application rewrites them.
+	if (cfg.indexBufferWriteTrackingEnable && (createInfo.usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+		memory->enableWriteTracking();
+
+	auto memorySize = memory->getAllocateInfo().allocationSize;
+
 	// If we're consuming an entire memory block here, it better be a very large allocation.
 	if (
 	cfg.msgSmallDedicatedAllocation &&
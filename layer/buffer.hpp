@@ -43,6 +43,11 @@ public:
 	VkResult init(VkBuffer buffer_, const VkBufferCreateInfo &createInfo);
 	VkResult bindMemory(DeviceMemory *memory, VkDeviceSize offset);
 
+	VkBuffer getBuffer() const
+	{
+		return buffer;
+	}
+
 	const VkMemoryRequirements &getMemoryRequirements() const
 	{
 		return memoryRequirements;
@@ -53,6 +58,16 @@ public:
 		return memory;
 	}
 
+	DeviceMemory *getDeviceMemory()
+	{
+		return memory;
+	}
+
+	const VkBufferCreateInfo &getCreateInfo() const
+	{
+		return createInfo;
+	}
+
 	uint32_t getMemoryOffset() const
 	{
 		return memoryOffset;
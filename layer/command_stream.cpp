@@ -0,0 +1,96 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "command_stream.hpp"
+
+using namespace std;
+
+namespace MPD
+{
+CommandStreamBlock *CommandStreamArena::allocateBlock()
+{
+	if (freeBlocks.empty())
+	{
+		blocks.emplace_back(new CommandStreamBlock);
+		freeBlocks.push_back(blocks.back().get());
+	}
+
+	auto *block = freeBlocks.back();
+	freeBlocks.pop_back();
+	block->next = nullptr;
+	block->used = 0;
+	return block;
+}
+
+void CommandStreamArena::releaseBlocks(CommandStreamBlock *head)
+{
+	while (head)
+	{
+		auto *next = head->next;
+		freeBlocks.push_back(head);
+		head = next;
+	}
+}
+
+CommandStream::~CommandStream()
+{
+	if (arena)
+		arena->releaseBlocks(head);
+}
+
+void CommandStream::setArena(CommandStreamArena *arena_)
+{
+	if (arena)
+		arena->releaseBlocks(head);
+
+	arena = arena_;
+	head = nullptr;
+	tail = nullptr;
+}
+
+void CommandStream::clear()
+{
+	for (auto *block = head; block; block = block->next)
+		block->used = 0;
+	tail = head;
+}
+
+void *CommandStream::allocate(size_t size)
+{
+	MPD_ASSERT(arena);
+
+	if (!tail)
+	{
+		head = arena->allocateBlock();
+		tail = head;
+	}
+	else if (tail->used + size > CommandStreamBlock::SIZE)
+	{
+		// Reuse blocks from an earlier recording before asking the arena for more.
+		if (!tail->next)
+			tail->next = arena->allocateBlock();
+		tail = tail->next;
+		MPD_ASSERT(tail->used == 0);
+	}
+
+	void *mem = tail->data + tail->used;
+	tail->used += size;
+	return mem;
+}
+}
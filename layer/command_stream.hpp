@@ -0,0 +1,244 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#include "image.hpp"
+#include "index_scan.hpp"
+#include "perfdoc.hpp"
+#include "queue_tracker.hpp"
+#include "tile_bandwidth.hpp"
+
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+namespace MPD
+{
+
+class Buffer;
+class CommandBuffer;
+class DescriptorSet;
+class ImageView;
+
+/// Work which is recorded into a command buffer, but which can only be evaluated once we know which queue
+/// the command buffer is submitted to (or when it is submitted at all).
+enum class DeferredCommandType : uint32_t
+{
+	ImageUsage,
+	ImageRangeUsage,
+	ImageViewUsage,
+	DescriptorSetUsage,
+	ExecuteCommands,
+	ScanIndices,
+	DrawIndirect,
+	DepthPrePassCheck,
+	RenderPassBandwidth,
+	ImageBandwidth
+};
+
+/// Every record in a CommandStream starts with this header.
+/// Records are plain data, they are never constructed or destructed, only copied into the stream.
+struct DeferredCommand
+{
+	DeferredCommandType type;
+	uint32_t size;
+};
+
+struct DeferredImageUsage : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::ImageUsage;
+	Image *image;
+	VkImageSubresourceLayers layers;
+	Image::Usage usage;
+};
+
+struct DeferredImageRangeUsage : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::ImageRangeUsage;
+	Image *image;
+	VkImageSubresourceRange range;
+	Image::Usage usage;
+};
+
+struct DeferredImageViewUsage : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::ImageViewUsage;
+	ImageView *view;
+	Image::Usage usage;
+};
+
+struct DeferredDescriptorSetUsage : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::DescriptorSetUsage;
+	DescriptorSet *set;
+};
+
+struct DeferredExecuteCommands : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::ExecuteCommands;
+	CommandBuffer *commandBuffer;
+};
+
+struct DeferredScanIndices : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::ScanIndices;
+	IndexScanKey key;
+};
+
+/// An indirect drawcall, whose arguments are read at submit and expanded into one event per draw.
+struct DeferredDrawIndirect : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::DrawIndirect;
+	Buffer *buffer;
+	VkDeviceSize offset;
+	uint32_t drawCount;
+	uint32_t stride;
+	bool indexed;
+	// Index buffer state at the drawcall, firstIndex and indexCount come from the arguments.
+	IndexScanKey indexState;
+	// State of the bound pipeline, for the depth pre-pass heuristic.
+	bool depthOnly;
+	bool depthEqualTest;
+};
+
+/// End of a render pass which had indirect drawcalls, with the depth pre-pass counts of its direct drawcalls.
+/// The counts of the indirect drawcalls replayed since the previous check are added before reporting.
+struct DeferredDepthPrePassCheck : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::DepthPrePassCheck;
+	uint32_t numDrawCallsDepthOnly;
+	uint32_t numDrawCallsDepthEqual;
+};
+
+/// Tile memory traffic of a render pass instance, estimated when it was recorded.
+struct DeferredRenderPassBandwidth : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::RenderPassBandwidth;
+	uint64_t renderPass;
+	uint64_t framebuffer;
+	TileTraffic traffic;
+};
+
+/// Tile memory traffic of one attachment of a render pass instance.
+struct DeferredImageBandwidth : DeferredCommand
+{
+	static const DeferredCommandType TYPE = DeferredCommandType::ImageBandwidth;
+	uint64_t image;
+	TileTraffic traffic;
+};
+
+/// Fixed size chunk of memory which deferred commands are written into.
+struct CommandStreamBlock
+{
+	enum
+	{
+		SIZE = 16 * 1024
+	};
+
+	CommandStreamBlock *next = nullptr;
+	size_t used = 0;
+	alignas(8) uint8_t data[SIZE];
+};
+
+/// Hands out CommandStreamBlocks to the command buffers of one VkCommandPool.
+/// Blocks are recycled when command buffers are freed and only released when the pool is destroyed.
+/// Like the VkCommandPool itself, this is externally synchronized.
+class CommandStreamArena
+{
+public:
+	CommandStreamArena() = default;
+	CommandStreamArena(const CommandStreamArena &) = delete;
+	void operator=(const CommandStreamArena &) = delete;
+
+	CommandStreamBlock *allocateBlock();
+
+	/// Returns a chain of blocks linked through CommandStreamBlock::next.
+	void releaseBlocks(CommandStreamBlock *head);
+
+private:
+	std::vector<std::unique_ptr<CommandStreamBlock>> blocks;
+	std::vector<CommandStreamBlock *> freeBlocks;
+};
+
+/// A typed stream of deferred commands recorded into a command buffer.
+/// Appending only copies a small record into arena memory, and replaying walks contiguous memory.
+/// Blocks are kept across resets so re-recording a command buffer does not need to touch the arena.
+class CommandStream
+{
+public:
+	CommandStream() = default;
+	~CommandStream();
+
+	CommandStream(const CommandStream &) = delete;
+	void operator=(const CommandStream &) = delete;
+
+	void setArena(CommandStreamArena *arena);
+
+	/// Appends a zero-initialized record of type T and returns it so the caller can fill it in.
+	template <typename T>
+	T *append()
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Deferred commands must be plain data.");
+		static_assert(sizeof(T) <= CommandStreamBlock::SIZE, "Deferred command too large.");
+
+		const size_t size = (sizeof(T) + 7) & ~size_t(7);
+		void *mem = allocate(size);
+		T *cmd = new (mem) T();
+		cmd->type = T::TYPE;
+		cmd->size = uint32_t(size);
+		return cmd;
+	}
+
+	/// Forgets all recorded commands, but keeps the memory.
+	void clear();
+
+	bool empty() const
+	{
+		return !head || head->used == 0;
+	}
+
+	template <typename Func>
+	void forEach(const Func &func) const
+	{
+		for (const CommandStreamBlock *block = head; block; block = block->next)
+		{
+			size_t offset = 0;
+			while (offset < block->used)
+			{
+				auto *cmd = reinterpret_cast<const DeferredCommand *>(block->data + offset);
+				func(*cmd);
+				offset += cmd->size;
+			}
+
+			if (block == tail)
+				break;
+		}
+	}
+
+private:
+	CommandStreamArena *arena = nullptr;
+	CommandStreamBlock *head = nullptr;
+	CommandStreamBlock *tail = nullptr;
+
+	void *allocate(size_t size);
+};
+}
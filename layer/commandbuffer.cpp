@@ -20,6 +20,7 @@
 
 #include "commandbuffer.hpp"
 #include "buffer.hpp"
+#include "commandpool.hpp"
 #include "device.hpp"
 #include "device_memory.hpp"
 #include "message_codes.hpp"
@@ -27,16 +28,20 @@
 #include "render_pass.hpp"
 
 #include "descriptor_set.hpp"
+#include "event.hpp"
 #include "format.hpp"
 #include "framebuffer.hpp"
+#include "index_readback.hpp"
+#include "index_scan.hpp"
 #include "pipeline_layout.hpp"
+#include "reorder_advisor.hpp"
+#include "tile_bandwidth.hpp"
 #include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <thread>
 #include <vector>
 
-#ifdef _MSC_VER
-#include <intrin.h>
-#endif
-
 using namespace std;
 
 namespace MPD
@@ -54,17 +59,25 @@ VkResult CommandBuffer::init(VkCommandBuffer commandBuffer_, CommandPool *comman
 {
 	commandBuffer = commandBuffer_;
 	commandPool = commandPool_;
+	deferredCommands.setArena(&commandPool->getCommandStreamArena());
 	reset();
 	return VK_SUCCESS;
 }
 
 void CommandBuffer::reset()
 {
+	// With asynchronous analysis, the worker might still be reading our deferred commands.
+	while (pendingAnalysis.load(memory_order_acquire))
+		this_thread::yield();
+
 	indexBuffer = nullptr;
 	indexOffset = 0;
 	executedCommandBuffers.clear();
-	deferredFunctions.clear();
+	writtenMemory.clear();
+	deferredCommands.clear();
+	trackerSummary.clear();
 	smallIndexedDrawcallCount = 0;
+	reportedIndirectSmallDrawcalls = false;
 	currentRenderPass = nullptr;
 	currentSubpassIndex = 0;
 
@@ -95,7 +108,7 @@ void CommandBuffer::enqueueComputeDescriptorSetUsage()
 		auto *set = computeDescriptorSets[i].set;
 		if (set)
 		{
-			enqueueDeferredFunction([set](Queue &) { set->signalUsage(); });
+			enqueueDescriptorSetUsage(set);
 		}
 		computeDescriptorSets[i].dirty = false;
 	}
@@ -114,7 +127,7 @@ void CommandBuffer::enqueueGraphicsDescriptorSetUsage()
 		auto *set = graphicsDescriptorSets[i].set;
 		if (set)
 		{
-			enqueueDeferredFunction([set](Queue &) { set->signalUsage(); });
+			enqueueDescriptorSetUsage(set);
 		}
 		graphicsDescriptorSets[i].dirty = false;
 	}
@@ -141,23 +154,485 @@ void CommandBuffer::bindIndexBuffer(Buffer *buffer, VkDeviceSize offset, VkIndex
 	this->indexType = indexType;
 }
 
-void CommandBuffer::enqueueDeferredFunction(std::function<void(Queue &)> Function)
+void CommandBuffer::enqueuePushWork(QueueTracker::Stage stage)
+{
+	trackerSummary.pushWork(stage);
+}
+
+void CommandBuffer::enqueuePipelineBarrier(QueueTracker::StageFlags srcStages, QueueTracker::StageFlags dstStages)
+{
+	trackerSummary.pipelineBarrier(srcStages, dstStages);
+}
+
+void CommandBuffer::enqueueSignalEvent(Event *event, QueueTracker::StageFlags srcStages)
+{
+	trackerSummary.signalEvent(event, srcStages);
+}
+
+void CommandBuffer::enqueueWaitEvent(Event *event, QueueTracker::StageFlags dstStages)
+{
+	trackerSummary.waitEvent(event, dstStages);
+}
+
+void CommandBuffer::enqueueResetEvent(Event *event)
+{
+	trackerSummary.resetEvent(event);
+}
+
+void CommandBuffer::enqueueImageUsage(Image *image, const VkImageSubresourceLayers &layers, Image::Usage usage)
+{
+	auto *cmd = deferredCommands.append<DeferredImageUsage>();
+	cmd->image = image;
+	cmd->layers = layers;
+	cmd->usage = usage;
+}
+
+void CommandBuffer::enqueueImageUsage(Image *image, const VkImageSubresourceRange &range, Image::Usage usage)
+{
+	auto *cmd = deferredCommands.append<DeferredImageRangeUsage>();
+	cmd->image = image;
+	cmd->range = range;
+	cmd->usage = usage;
+}
+
+void CommandBuffer::enqueueBufferWrite(Buffer *buffer)
+{
+	// Indices are only scanned from memory we keep mapped, or copy back on the GPU.
+	DeviceMemory *memory = buffer->getDeviceMemory();
+	if (!memory || (!memory->getMappedMemory() && !baseDevice->getIndexReadback()))
+		return;
+
+	// Uploads tend to target the same buffer many times in a row.
+	if (writtenMemory.empty() || writtenMemory.back() != memory)
+		writtenMemory.push_back(memory);
+}
+
+void CommandBuffer::signalBufferWrites()
+{
+	for (auto *memory : writtenMemory)
+		memory->signalWrite();
+}
+
+void CommandBuffer::enqueueImageViewUsage(ImageView *view, Image::Usage usage)
+{
+	auto *cmd = deferredCommands.append<DeferredImageViewUsage>();
+	cmd->view = view;
+	cmd->usage = usage;
+}
+
+void CommandBuffer::enqueueDescriptorSetUsage(DescriptorSet *set)
+{
+	deferredCommands.append<DeferredDescriptorSetUsage>()->set = set;
+}
+
+void CommandBuffer::end()
+{
+	trackerSummary.compile();
+}
+
+void CommandBuffer::replayDeferredCommands(Queue &queue, SubmitSnapshot *snapshot)
+{
+	replayCommandStream(snapshot);
+
+	// Secondary command buffers were folded into our summary when they were executed.
+	queue.getQueueTracker().apply(trackerSummary);
+}
+
+void CommandBuffer::snapshotDeferredCommands(AnalysisJob &job)
+{
+	job.commandBuffers.push_back(this);
+	snapshotCommandStream(job);
+}
+
+// VkDrawIndirectCommand and VkDrawIndexedIndirectCommand both start with the vertex or index count,
+// followed by the instance count.
+static uint32_t getIndirectRecordSize(const DeferredDrawIndirect &draw)
+{
+	return draw.indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand);
+}
+
+static uint32_t readIndirectWord(const uint8_t *record, uint32_t word)
+{
+	uint32_t value;
+	memcpy(&value, record + word * sizeof(uint32_t), sizeof(value));
+	return value;
+}
+
+// Number of draws whose arguments lie within the buffer.
+static uint32_t getIndirectDrawCount(const DeferredDrawIndirect &draw)
+{
+	VkDeviceSize bufferSize = draw.buffer->getCreateInfo().size;
+	VkDeviceSize recordSize = getIndirectRecordSize(draw);
+	if (draw.offset + recordSize > bufferSize)
+		return 0;
+	if (draw.stride == 0)
+		return draw.drawCount;
+	VkDeviceSize maxDraws = (bufferSize - draw.offset - recordSize) / draw.stride + 1;
+	return uint32_t(std::min<VkDeviceSize>(draw.drawCount, maxDraws));
+}
+
+static size_t getIndirectDataSize(const DeferredDrawIndirect &draw, uint32_t drawCount)
+{
+	return size_t(drawCount - 1) * draw.stride + getIndirectRecordSize(draw);
+}
+
+// Returns the mapped arguments, or nullptr if they are not host visible.
+static const uint8_t *getIndirectData(const DeferredDrawIndirect &draw)
+{
+	const DeviceMemory *memory = draw.buffer->getDeviceMemory();
+	if (!memory || !memory->getMappedMemory())
+		return nullptr;
+	return static_cast<const uint8_t *>(memory->getMappedMemory()) + draw.buffer->getMemoryOffset() + draw.offset;
+}
+
+// Calls func with the key of every draw of an indexed indirect drawcall which needs its indices scanned.
+template <typename Func>
+static void forEachIndirectIndexScan(const Device &device, const DeferredDrawIndirect &draw, const uint8_t *args,
+                                     uint32_t drawCount, const Func &func)
+{
+	const auto &cfg = device.getConfig();
+	if (!draw.indexed || !cfg.indexBufferScanningEnable)
+		return;
+
+	// Arguments may be stale or not written yet, so don't trust them to stay within the index buffer.
+	const auto &state = draw.indexState;
+	uint32_t stride = state.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	VkDeviceSize bufferSize = state.buffer->getCreateInfo().size;
+	uint64_t maxIndices = state.indexOffset < bufferSize ? (bufferSize - state.indexOffset) / stride : 0;
+
+	for (uint32_t i = 0; i < drawCount; i++)
+	{
+		const uint8_t *record = args + size_t(i) * draw.stride;
+		uint32_t indexCount = readIndirectWord(record, 0);
+		uint32_t instanceCount = readIndirectWord(record, 1);
+		uint32_t firstIndex = readIndirectWord(record, 2);
+
+		// GPU culling usually sets the instance count of invisible draws to 0.
+		if (!instanceCount || indexCount < cfg.indexBufferScanMinIndexCount ||
+		    uint64_t(firstIndex) + indexCount > maxIndices)
+			continue;
+
+		IndexScanKey key = state;
+		key.firstIndex = firstIndex;
+		key.indexCount = indexCount;
+		func(key);
+	}
+}
+
+void CommandBuffer::countIndirectDraws(const Device &device, const DeferredDrawIndirect &draw, const uint8_t *args,
+                                       uint32_t drawCount, IndirectDrawCounts &counts)
+{
+	const auto &cfg = device.getConfig();
+	uint64_t smallLimit = draw.indexed ? cfg.smallIndexedDrawcallIndices : 0;
+	uint64_t depthPrePassMin = draw.indexed ? cfg.depthPrePassMinIndices : cfg.depthPrePassMinVertices;
+
+	// GPU-driven renderers issue thousands of draws at once. Decode a batch of records first,
+	// so the counting loop runs over packed values without branches and can be vectorized.
+	static const uint32_t BATCH_SIZE = 64;
+	uint64_t totals[BATCH_SIZE];
+
+	uint32_t smallDraws = 0;
+	uint32_t depthPrePassDraws = 0;
+	for (uint32_t base = 0; base < drawCount; base += BATCH_SIZE)
+	{
+		uint32_t count = std::min(BATCH_SIZE, drawCount - base);
+		const uint8_t *records = args + size_t(base) * draw.stride;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint8_t *record = records + size_t(i) * draw.stride;
+			totals[i] = uint64_t(readIndirectWord(record, 0)) * readIndirectWord(record, 1);
+		}
+
+		// Draws culled on the GPU have no vertices, and are not counted at all.
+		for (uint32_t i = 0; i < count; i++)
+		{
+			smallDraws += uint32_t(totals[i] != 0) & uint32_t(totals[i] <= smallLimit);
+			depthPrePassDraws += uint32_t(totals[i] != 0) & uint32_t(totals[i] >= depthPrePassMin);
+		}
+	}
+
+	if (draw.indexed)
+		counts.smallIndexedDrawcalls += smallDraws;
+	if (draw.depthOnly)
+		counts.drawCallsDepthOnly += depthPrePassDraws;
+	if (draw.depthEqualTest)
+		counts.drawCallsDepthEqual += depthPrePassDraws;
+}
+
+void CommandBuffer::snapshotCommandStream(AnalysisJob &job)
+{
+	pendingAnalysis.fetch_add(1, memory_order_relaxed);
+	job.references.push_back(this);
+
+	auto &snapshot = job.snapshot;
+
+	deferredCommands.forEach([&](const DeferredCommand &cmd) {
+		switch (cmd.type)
+		{
+		case DeferredCommandType::DescriptorSetUsage:
+		{
+			size_t count = snapshot.viewUsages.size();
+			static_cast<const DeferredDescriptorSetUsage &>(cmd).set->getImageUsages(snapshot.viewUsages);
+			snapshot.viewUsageCounts.push_back(uint32_t(snapshot.viewUsages.size() - count));
+			break;
+		}
+
+		case DeferredCommandType::ExecuteCommands:
+			static_cast<const DeferredExecuteCommands &>(cmd).commandBuffer->snapshotCommandStream(job);
+			break;
+
+		case DeferredCommandType::ScanIndices:
+			snapshotIndexScan(snapshot, static_cast<const DeferredScanIndices &>(cmd).key);
+			break;
+
+		case DeferredCommandType::DrawIndirect:
+		{
+			auto &draw = static_cast<const DeferredDrawIndirect &>(cmd);
+			uint32_t drawCount = getIndirectDrawCount(draw);
+			auto *args = getIndirectData(draw);
+			bool readback = drawCount && enqueueIndirectReadback(draw, drawCount);
+			if (!args || !drawCount)
+			{
+				snapshot.indirectOffsets.push_back(SubmitSnapshot::NOT_MAPPED);
+				break;
+			}
+
+			size_t offset = snapshot.indirectData.size();
+			snapshot.indirectOffsets.push_back(offset);
+			snapshot.indirectData.insert(snapshot.indirectData.end(), args, args + getIndirectDataSize(draw, drawCount));
+
+			// Decide what to scan from the copy, so replay finds the same draws even if the arguments change.
+			if (!readback)
+			{
+				forEachIndirectIndexScan(*baseDevice, draw, snapshot.indirectData.data() + offset, drawCount,
+				                         [&](const IndexScanKey &key) { snapshotIndexScan(snapshot, key); });
+			}
+			break;
+		}
+
+		default:
+			break;
+		}
+	});
+}
+
+void CommandBuffer::snapshotIndexScan(SubmitSnapshot &snapshot, const IndexScanKey &key)
+{
+	uint64_t writeGeneration;
+	auto *indexData = getIndexData(key, writeGeneration);
+
+	// Don't bother copying indices which have already been scanned, or which won't be scanned this time.
+	auto *cache = baseDevice->getIndexScanCache();
+	auto *scheduler = baseDevice->getIndexScanScheduler();
+	if (!indexData)
+	{
+		enqueueIndexReadback(*baseDevice, key, writeGeneration);
+		snapshot.indexOffsets.push_back(SubmitSnapshot::NOT_MAPPED);
+	}
+	else if (!(cache && cache->find(key, writeGeneration)) && !(scheduler && !scheduler->admit(key)))
+	{
+		size_t stride = key.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		size_t size = key.indexCount * stride;
+		snapshot.indexOffsets.push_back(snapshot.indexData.size());
+		snapshot.indexData.insert(snapshot.indexData.end(), indexData, indexData + size);
+		writeGeneration = validateIndexRead(key, writeGeneration);
+	}
+	else
+		snapshot.indexOffsets.push_back(SubmitSnapshot::NOT_MAPPED);
+	snapshot.indexWriteGenerations.push_back(writeGeneration);
+}
+
+void CommandBuffer::releaseAnalysisReference()
+{
+	pendingAnalysis.fetch_sub(1, memory_order_release);
+}
+
+void CommandBuffer::replayCommandStream(SubmitSnapshot *snapshot)
+{
+	IndirectDrawCounts indirectCounts;
+
+	deferredCommands.forEach([&](const DeferredCommand &cmd) {
+		switch (cmd.type)
+		{
+		case DeferredCommandType::ImageUsage:
+		{
+			auto &usage = static_cast<const DeferredImageUsage &>(cmd);
+			usage.image->signalUsage(usage.layers, usage.usage);
+			break;
+		}
+
+		case DeferredCommandType::ImageRangeUsage:
+		{
+			auto &usage = static_cast<const DeferredImageRangeUsage &>(cmd);
+			usage.image->signalUsage(usage.range, usage.usage);
+			break;
+		}
+
+		case DeferredCommandType::ImageViewUsage:
+		{
+			auto &usage = static_cast<const DeferredImageViewUsage &>(cmd);
+			usage.view->signalUsage(usage.usage);
+			break;
+		}
+
+		case DeferredCommandType::DescriptorSetUsage:
+			if (snapshot)
+			{
+				uint32_t count = snapshot->viewUsageCounts[snapshot->nextDescriptorSet++];
+				for (uint32_t i = 0; i < count; i++)
+				{
+					auto &usage = snapshot->viewUsages[snapshot->nextViewUsage++];
+					usage.first->signalUsage(usage.second);
+				}
+			}
+			else
+				static_cast<const DeferredDescriptorSetUsage &>(cmd).set->signalUsage();
+			break;
+
+		case DeferredCommandType::ExecuteCommands:
+			static_cast<const DeferredExecuteCommands &>(cmd).commandBuffer->replayCommandStream(snapshot);
+			break;
+
+		case DeferredCommandType::ScanIndices:
+			replayIndexScan(snapshot, static_cast<const DeferredScanIndices &>(cmd).key);
+			break;
+
+		case DeferredCommandType::DrawIndirect:
+			replayDrawIndirect(snapshot, static_cast<const DeferredDrawIndirect &>(cmd), indirectCounts);
+			break;
+
+		case DeferredCommandType::DepthPrePassCheck:
+		{
+			auto &check = static_cast<const DeferredDepthPrePassCheck &>(cmd);
+			DepthPrePassHeuristic::checkDrawCallCounts(*this,
+			                                           check.numDrawCallsDepthOnly + indirectCounts.drawCallsDepthOnly,
+			                                           check.numDrawCallsDepthEqual + indirectCounts.drawCallsDepthEqual);
+			indirectCounts.drawCallsDepthOnly = 0;
+			indirectCounts.drawCallsDepthEqual = 0;
+			break;
+		}
+
+		case DeferredCommandType::RenderPassBandwidth:
+		{
+			auto &pass = static_cast<const DeferredRenderPassBandwidth &>(cmd);
+			baseDevice->getTileBandwidthEstimator()->addRenderPass(pass.renderPass, pass.framebuffer, pass.traffic);
+			break;
+		}
+
+		case DeferredCommandType::ImageBandwidth:
+		{
+			auto &image = static_cast<const DeferredImageBandwidth &>(cmd);
+			baseDevice->getTileBandwidthEstimator()->addImage(image.image, image.traffic);
+			break;
+		}
+		}
+	});
+
+	reportIndirectDrawCounts(indirectCounts);
+}
+
+void CommandBuffer::replayIndexScan(SubmitSnapshot *snapshot, const IndexScanKey &key)
+{
+	const uint8_t *indexData = nullptr;
+	uint64_t writeGeneration;
+	if (snapshot)
+	{
+		size_t offset = snapshot->indexOffsets[snapshot->nextIndexScan];
+		if (offset != SubmitSnapshot::NOT_MAPPED)
+			indexData = snapshot->indexData.data() + offset;
+		writeGeneration = snapshot->indexWriteGenerations[snapshot->nextIndexScan];
+		snapshot->nextIndexScan++;
+	}
+	else
+	{
+		indexData = getIndexData(key, writeGeneration);
+		if (!indexData)
+			enqueueIndexReadback(*baseDevice, key, writeGeneration);
+	}
+
+	scanIndices(*baseDevice, vertexCache, key, indexData, writeGeneration, snapshot == nullptr);
+}
+
+void CommandBuffer::replayDrawIndirect(SubmitSnapshot *snapshot, const DeferredDrawIndirect &draw,
+                                       IndirectDrawCounts &counts)
+{
+	uint32_t drawCount = getIndirectDrawCount(draw);
+	const uint8_t *args = nullptr;
+	bool readback = false;
+	if (snapshot)
+	{
+		size_t offset = snapshot->indirectOffsets[snapshot->nextIndirectDraw++];
+		if (offset != SubmitSnapshot::NOT_MAPPED)
+			args = snapshot->indirectData.data() + offset;
+		readback = baseDevice->getIndexReadback() != nullptr;
+	}
+	else
+	{
+		args = getIndirectData(draw);
+		readback = drawCount && enqueueIndirectReadback(draw, drawCount);
+	}
+
+	// Draws are only counted from arguments the host can read, the GPU might not even have written them yet.
+	if (!args || !drawCount)
+		return;
+
+	countIndirectDraws(*baseDevice, draw, args, drawCount, counts);
+
+	// Copied back arguments are scanned once the GPU is done with them.
+	if (!readback)
+	{
+		forEachIndirectIndexScan(*baseDevice, draw, args, drawCount,
+		                         [&](const IndexScanKey &key) { replayIndexScan(snapshot, key); });
+	}
+}
+
+bool CommandBuffer::enqueueIndirectReadback(const DeferredDrawIndirect &draw, uint32_t drawCount)
+{
+	auto *readback = baseDevice->getIndexReadback();
+	if (!readback || !draw.indexed || !baseDevice->getConfig().indexBufferScanningEnable)
+		return false;
+
+	// If the staging ring is full, the indices are not scanned this time, just like direct draws.
+	readback->enqueueIndirect(draw, drawCount, getIndirectDataSize(draw, drawCount));
+	return true;
+}
+
+void CommandBuffer::scanIndirectIndices(Device &device, VertexCache &vertexCache, const DeferredDrawIndirect &draw,
+                                        const uint8_t *args, uint32_t drawCount)
 {
-	deferredFunctions.push_back(std::move(Function));
+	forEachIndirectIndexScan(device, draw, args, drawCount, [&](const IndexScanKey &key) {
+		uint64_t writeGeneration;
+		auto *indexData = getIndexData(key, writeGeneration);
+		if (indexData)
+			scanIndices(device, vertexCache, key, indexData, writeGeneration, true);
+		else
+			enqueueIndexReadback(device, key, writeGeneration);
+	});
 }
 
-void CommandBuffer::callDeferredFunctions(Queue &queue)
+void CommandBuffer::reportIndirectDrawCounts(const IndirectDrawCounts &counts)
 {
-	for (auto func : deferredFunctions)
+	// Same as in drawIndexed(), with the indirect draws on top of the direct ones.
+	const auto &cfg = baseDevice->getConfig();
+	if (cfg.msgManySmallIndexedDrawcalls && !reportedIndirectSmallDrawcalls &&
+	    smallIndexedDrawcallCount < cfg.maxSmallIndexedDrawcalls &&
+	    uint64_t(smallIndexedDrawcallCount) + counts.smallIndexedDrawcalls >= cfg.maxSmallIndexedDrawcalls)
 	{
-		func(queue);
+		reportedIndirectSmallDrawcalls = true;
+		log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS,
+		    "The command buffer contains many small indexed drawcalls "
+		    "(at least %u drawcalls with less than %u indices each). This may cause pipeline bubbles. "
+		    "You can try batching drawcalls or instancing when applicable.",
+		    cfg.maxSmallIndexedDrawcalls, cfg.smallIndexedDrawcallIndices);
 	}
-	deferredFunctions.clear();
 }
 
 void CommandBuffer::executeCommandBuffer(CommandBuffer *commandBuffer)
 {
-	enqueueDeferredFunction([commandBuffer](Queue &queue) { commandBuffer->callDeferredFunctions(queue); });
+	deferredCommands.append<DeferredExecuteCommands>()->commandBuffer = commandBuffer;
+	trackerSummary.append(commandBuffer->trackerSummary);
+	auto &secondaryWrites = commandBuffer->writtenMemory;
+	writtenMemory.insert(writtenMemory.end(), secondaryWrites.begin(), secondaryWrites.end());
 }
 
 void CommandBuffer::bindPipeline(VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
@@ -255,7 +730,7 @@ void CommandBuffer::enqueueRenderPassLoadOps(VkRenderPass renderPass, VkFramebuf
 		}
 
 		ImageView *view = baseDevice->get<ImageView>(fbInfo.pAttachments[att]);
-		enqueueDeferredFunction([view, usage](Queue &) { view->signalUsage(usage); });
+		enqueueImageViewUsage(view, usage);
 	}
 }
 void CommandBuffer::enqueueRenderPassStoreOps(VkRenderPass renderPass, VkFramebuffer framebuffer)
@@ -291,7 +766,33 @@ void CommandBuffer::enqueueRenderPassStoreOps(VkRenderPass renderPass, VkFramebu
 
 		ImageView *view = baseDevice->get<ImageView>(fbInfo.pAttachments[att]);
 		MPD_ASSERT(view);
-		enqueueDeferredFunction([view, usage](Queue &) { view->signalUsage(usage); });
+		enqueueImageViewUsage(view, usage);
+	}
+}
+
+void CommandBuffer::enqueueRenderPassBandwidth(const VkRenderPassBeginInfo &beginInfo)
+{
+	if (!baseDevice->getTileBandwidthEstimator())
+		return;
+
+	auto *rp = baseDevice->get<RenderPass>(beginInfo.renderPass);
+	auto *fb = baseDevice->get<Framebuffer>(beginInfo.framebuffer);
+	MPD_ASSERT(rp);
+	MPD_ASSERT(fb);
+
+	attachmentTraffic.clear();
+	auto traffic = TileBandwidthEstimator::estimateRenderPass(*baseDevice, beginInfo, attachmentTraffic);
+
+	auto *pass = deferredCommands.append<DeferredRenderPassBandwidth>();
+	pass->renderPass = rp->getHandle();
+	pass->framebuffer = fb->getHandle();
+	pass->traffic = traffic;
+
+	for (auto &attachment : attachmentTraffic)
+	{
+		auto *image = deferredCommands.append<DeferredImageBandwidth>();
+		image->image = attachment.first;
+		image->traffic = attachment.second;
 	}
 }
 
@@ -306,6 +807,7 @@ void CommandBuffer::beginRenderPass(const VkRenderPassBeginInfo *pRenderPassBegi
 	enqueueRenderPassLoadOps(pRenderPassBegin->renderPass, pRenderPassBegin->framebuffer);
 	// Don't need to wait for CmdEndRenderPass.
 	enqueueRenderPassStoreOps(pRenderPassBegin->renderPass, pRenderPassBegin->framebuffer);
+	enqueueRenderPassBandwidth(*pRenderPassBegin);
 
 	currentRenderPass = baseDevice->get<RenderPass>(pRenderPassBegin->renderPass);
 	currentSubpassIndex = 0;
@@ -332,13 +834,10 @@ void CommandBuffer::beginRenderPass(const VkRenderPassBeginInfo *pRenderPassBegi
 		}
 	}
 
-	enqueueDeferredFunction([=](Queue &queue) {
-		auto &tracker = queue.getQueueTracker();
-		tracker.pipelineBarrier(src, dst);
-		tracker.pushWork(QueueTracker::STAGE_GEOMETRY);
-		tracker.pipelineBarrier(QueueTracker::STAGE_GEOMETRY_BIT, QueueTracker::STAGE_FRAGMENT_BIT);
-		tracker.pushWork(QueueTracker::STAGE_FRAGMENT);
-	});
+	enqueuePipelineBarrier(src, dst);
+	enqueuePushWork(QueueTracker::STAGE_GEOMETRY);
+	enqueuePipelineBarrier(QueueTracker::STAGE_GEOMETRY_BIT, QueueTracker::STAGE_FRAGMENT_BIT);
+	enqueuePushWork(QueueTracker::STAGE_FRAGMENT);
 
 	setFramebuffer(pRenderPassBegin->framebuffer);
 }
@@ -370,47 +869,57 @@ void CommandBuffer::endRenderPass()
 		}
 	}
 
-	enqueueDeferredFunction([=](Queue &queue) {
-		auto &tracker = queue.getQueueTracker();
-		tracker.pipelineBarrier(src, dst);
-	});
+	enqueuePipelineBarrier(src, dst);
 
 	currentRenderPass = nullptr;
 	currentSubpassIndex = 0;
 }
 
-void CommandBuffer::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+void CommandBuffer::drawIndirect(Buffer *buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride,
+                                 bool indexed)
 {
+	const auto &cfg = baseDevice->getConfig();
+	if (!cfg.indirectDrawAnalysisEnable || drawCount == 0)
+		return;
+
+	MPD_ASSERT(buffer != nullptr);
+	MPD_ASSERT(pipeline != nullptr);
+	MPD_ASSERT(!indexed || indexBuffer != nullptr);
+
 	for (auto &it : heuristics)
-		it->cmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		it->cmdDrawIndirect(commandBuffer, indexed);
+
+	auto *draw = deferredCommands.append<DeferredDrawIndirect>();
+	draw->buffer = buffer;
+	draw->offset = offset;
+	draw->drawCount = drawCount;
+	draw->stride = stride;
+	draw->indexed = indexed;
+
+	const auto &pipelineInfo = pipeline->getGraphicsCreateInfo();
+	draw->indexState = IndexScanKey();
+	if (indexed)
+	{
+		draw->indexState.buffer = indexBuffer;
+		draw->indexState.indexOffset = indexOffset;
+		draw->indexState.indexType = indexType;
+		draw->indexState.topology = pipelineInfo.pInputAssemblyState->topology;
+		draw->indexState.primitiveRestart = pipelineInfo.pInputAssemblyState->primitiveRestartEnable;
+	}
+	DepthPrePassHeuristic::classifyPipeline(pipelineInfo, draw->depthOnly, draw->depthEqualTest);
 }
 
-bool CommandBuffer::testCache(uint32_t value, uint32_t iteration, CacheEntry *cacheEntries, uint32_t cacheSize)
+void CommandBuffer::enqueueDepthPrePassCheck(uint32_t numDrawCallsDepthOnly, uint32_t numDrawCallsDepthEqual)
 {
-	uint32_t lru = 0;
-	for (uint32_t i = 0; i < std::min(iteration, cacheSize); i++)
-	{
-		if (cacheEntries[i].value == value)
-		{
-			cacheEntries[i].age = iteration;
-			return true;
-		}
-		else if (cacheEntries[i].age < cacheEntries[lru].age)
-			lru = i;
-	}
+	auto *check = deferredCommands.append<DeferredDepthPrePassCheck>();
+	check->numDrawCallsDepthOnly = numDrawCallsDepthOnly;
+	check->numDrawCallsDepthEqual = numDrawCallsDepthEqual;
+}
 
-	if (iteration < cacheSize)
-	{
-		cacheEntries[iteration].value = value;
-		cacheEntries[iteration].age = iteration;
-	}
-	else
-	{
-		MPD_ASSERT(lru < cacheSize);
-		cacheEntries[lru].value = value;
-		cacheEntries[lru].age = iteration;
-	}
-	return false;
+void CommandBuffer::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	for (auto &it : heuristics)
+		it->cmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
 }
 
 void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
@@ -442,106 +951,169 @@ void CommandBuffer::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uin
 
 	if (cfg.indexBufferScanningEnable)
 	{
-		bool primitiveRestart = pipeline->getGraphicsCreateInfo().pInputAssemblyState->primitiveRestartEnable;
+		IndexScanKey key;
+		key.buffer = indexBuffer;
+		key.indexOffset = indexOffset;
+		key.firstIndex = firstIndex;
+		key.indexCount = indexCount;
+		key.indexType = indexType;
+		key.topology = pipeline->getGraphicsCreateInfo().pInputAssemblyState->topology;
+		key.primitiveRestart = pipeline->getGraphicsCreateInfo().pInputAssemblyState->primitiveRestartEnable;
+
 		if (cfg.indexBufferScanningInPlace)
-			scanIndices(indexBuffer, indexOffset, indexType, indexCount, firstIndex, primitiveRestart);
-		else
 		{
-			// Capture a copy of these members.
-			auto indexBufferCopy = indexBuffer;
-			auto indexOffsetCopy = indexOffset;
-			auto indexTypeCopy = indexType;
-			enqueueDeferredFunction([=](Queue &) {
-				this->scanIndices(indexBufferCopy, indexOffsetCopy, indexTypeCopy, indexCount, firstIndex,
-				                  primitiveRestart);
-			});
+			uint64_t writeGeneration;
+			auto *indexData = getIndexData(key, writeGeneration);
+			scanIndices(*baseDevice, vertexCache, key, indexData, writeGeneration, true);
 		}
+		else
+			deferredCommands.append<DeferredScanIndices>()->key = key;
 	}
 }
 
-void CommandBuffer::scanIndices(Buffer *buffer, VkDeviceSize indexOffset, VkIndexType indexType, uint32_t indexCount,
-                                uint32_t firstIndex, bool primitiveRestart)
+const uint8_t *CommandBuffer::getIndexData(const IndexScanKey &key, uint64_t &writeGeneration)
 {
-	MPD_ASSERT(buffer != nullptr);
+	MPD_ASSERT(key.buffer != nullptr);
 
-	const DeviceMemory *deviceMemory = buffer->getDeviceMemory();
+	const DeviceMemory *deviceMemory = key.buffer->getDeviceMemory();
 	MPD_ASSERT(deviceMemory);
 
-	const auto &cfg = this->getDevice()->getConfig();
+	VkDeviceSize offset, size;
+	getIndexRange(key, offset, size);
+	writeGeneration = deviceMemory->getWriteGeneration(offset, size, key.buffer->getMemoryOffset(),
+	                                                   key.buffer->getCreateInfo().size);
 
 	const void *indexData = deviceMemory->getMappedMemory();
-	if (indexData)
-	{
-		uint32_t scanStride = (indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+	if (!indexData)
+		return nullptr;
 
-		const uint8_t *scanBegin =
-		    static_cast<const uint8_t *>(indexData) + buffer->getMemoryOffset() + indexOffset + scanStride * firstIndex;
-		const uint8_t *scanEnd = scanBegin + indexCount * scanStride;
+	return static_cast<const uint8_t *>(indexData) + offset;
+}
 
-		uint32_t minValue = ~0u;
-		uint32_t maxValue = 0u;
+void CommandBuffer::getIndexRange(const IndexScanKey &key, VkDeviceSize &offset, VkDeviceSize &size)
+{
+	uint32_t scanStride = (key.indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+	offset = key.buffer->getMemoryOffset() + key.indexOffset + VkDeviceSize(scanStride) * key.firstIndex;
+	size = VkDeviceSize(scanStride) * key.indexCount;
+}
 
-		cacheEntries.resize(baseDevice->getConfig().indexBufferVertexPostTransformCache);
+uint64_t CommandBuffer::validateIndexRead(const IndexScanKey &key, uint64_t writeGeneration)
+{
+	VkDeviceSize offset, size;
+	getIndexRange(key, offset, size);
+	if (key.buffer->getDeviceMemory()->isReadConsistent(offset, size, key.buffer->getMemoryOffset(),
+	                                                    key.buffer->getCreateInfo().size))
+		return writeGeneration;
+	else
+		return IndexScanCache::UNKNOWN_GENERATION;
+}
 
-		uint32_t iteration = 0;
-		uint32_t vertexShadeCount = 0;
+void CommandBuffer::enqueueIndexReadback(Device &device, const IndexScanKey &key, uint64_t writeGeneration)
+{
+	auto *readback = device.getIndexReadback();
+	if (!readback)
+		return;
 
-		uint32_t primitiveRestartValue;
-		if (indexType == VK_INDEX_TYPE_UINT16)
-			primitiveRestartValue = 0xFFFF;
-		else
-			primitiveRestartValue = 0xFFFFFFFF;
+	auto *cache = device.getIndexScanCache();
+	if (cache && cache->find(key, writeGeneration))
+		return;
 
-		// get min/max range
-		const uint8_t *scanPtr = scanBegin;
-		while (scanPtr != scanEnd)
-		{
-			uint32_t scanValue;
+	auto *scheduler = device.getIndexScanScheduler();
+	if (scheduler && !scheduler->admit(key))
+		return;
 
-			if (indexType == VK_INDEX_TYPE_UINT16)
-				scanValue = *(uint16_t *)scanPtr;
-			else
-				scanValue = *(uint32_t *)scanPtr;
+	// If the staging ring is full, the draw is simply tried again at its next submission.
+	readback->enqueue(key, writeGeneration);
+}
 
-			if (!primitiveRestart || scanValue != primitiveRestartValue)
-			{
-				minValue = std::min(minValue, scanValue);
-				maxValue = std::max(maxValue, scanValue);
-				if (!testCache(scanValue, iteration++, cacheEntries.data(), cacheEntries.size()))
-					vertexShadeCount++;
-			}
-			scanPtr += scanStride;
-		}
+void CommandBuffer::rememberIndexScan(Device &device, const IndexScanKey &key, const IndexScanResult &result,
+                                      uint64_t writeGeneration, bool liveData)
+{
+	auto *cache = device.getIndexScanCache();
+	if (!cache)
+		return;
 
-		if (maxValue < minValue)
-		{
-			// all indices are primitive restarts so early exit
-			return;
-		}
+	// Indices read from the mapping might have been rewritten while we were scanning them.
+	if (liveData)
+		writeGeneration = validateIndexRead(key, writeGeneration);
+	cache->insert(key, writeGeneration, result);
+}
+
+void CommandBuffer::scanIndices(Device &device, VertexCache &vertexCache, const IndexScanKey &key,
+                                const uint8_t *indexData, uint64_t writeGeneration, bool liveData)
+{
+	MPD_ASSERT(key.buffer != nullptr);
+
+	if (!indexData)
+		return;
+
+	auto *reorderAdvisor = device.getReorderAdvisor();
+	if (reorderAdvisor)
+		reorderAdvisor->countDraw(key);
 
-		// We already know that this is going to be sparse.
-		// To potentially avoid an explosion in memory, just exit early.
-		if (cfg.msgIndexBufferSparse &&
-		maxValue - minValue >= indexCount)
+	// Static meshes are drawn with the same indices every frame, they only need to be looked at once.
+	auto *cache = device.getIndexScanCache();
+	if (cache && cache->find(key, writeGeneration))
+		return;
+
+	// Snapshots were only taken of admitted draws.
+	auto *scheduler = device.getIndexScanScheduler();
+	if (scheduler && liveData && !scheduler->admit(key))
+		return;
+
+	// Time the scan for the budget, reporting is not included.
+	auto scanStart = scheduler ? chrono::steady_clock::now() : chrono::steady_clock::time_point();
+	auto chargeScanTime = [&]() {
+		if (scheduler)
 		{
-			buffer->log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_SPARSE,
-			            "Indexbuffer data used by drawcall is fragmented. Number of indices (%u) is smaller than range "
-			            "of index buffer data (%u).\n",
-			            indexCount, maxValue - minValue + 1);
-			return;
+			auto elapsed = chrono::steady_clock::now() - scanStart;
+			scheduler->chargeTime(uint64_t(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()));
 		}
+	};
 
-		std::vector<uint64_t> buckets;
-		buckets.resize(((maxValue - minValue + 1) + 63) / 64);
-		memset(buckets.data(), 0, sizeof(uint64_t) * buckets.size());
+	const auto &cfg = device.getConfig();
+	Buffer *buffer = key.buffer;
+	VkIndexType indexType = key.indexType;
+	uint32_t indexCount = key.indexCount;
+	bool primitiveRestart = key.primitiveRestart;
 
-#define FRAGMENT_SIZE 16
-		char fragmentation[FRAGMENT_SIZE + 1];
-		memset(fragmentation, ' ', sizeof(fragmentation));
-		fragmentation[FRAGMENT_SIZE] = '\0';
+	uint32_t scanStride = (indexType == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
 
-		scanPtr = scanBegin;
-		while (scanPtr != scanEnd)
+	uint32_t primitiveRestartValue;
+	if (indexType == VK_INDEX_TYPE_UINT16)
+		primitiveRestartValue = 0xFFFF;
+	else
+		primitiveRestartValue = 0xFFFFFFFF;
+
+	// Start from an empty post-transform cache, so the result only depends on the indices and can be cached.
+	vertexCache.reset(cfg.indexBufferVertexPostTransformCache, cfg.indexBufferVertexPostTransformCacheFIFO ?
+	                                                               VertexCache::Policy::FIFO :
+	                                                               VertexCache::Policy::LRU);
+	uint32_t vertexShadeCount = 0;
+
+	// Indices are read once, in chunks small enough to stay in L1 between the vectorized min/max
+	// and the per-index pass which models the cache and collects unique vertices.
+	static const uint32_t SCAN_CHUNK_INDICES = 1024;
+	IndexBitmap &vertices = IndexBitmap::get();
+	uint32_t minValue = ~0u;
+	uint32_t maxValue = 0;
+
+	for (uint32_t chunkStart = 0; chunkStart < indexCount; chunkStart += SCAN_CHUNK_INDICES)
+	{
+		uint32_t chunkCount = std::min(SCAN_CHUNK_INDICES, indexCount - chunkStart);
+		const uint8_t *scanBegin = indexData + size_t(chunkStart) * scanStride;
+		const uint8_t *scanEnd = scanBegin + size_t(chunkCount) * scanStride;
+
+		IndexBounds bounds = scanIndexBounds(scanBegin, indexType, chunkCount, primitiveRestart);
+		if (bounds.maxValue < bounds.minValue)
+			continue;
+
+		if (maxValue < minValue)
+			vertices.reset(bounds.minValue);
+		minValue = std::min(minValue, bounds.minValue);
+		maxValue = std::max(maxValue, bounds.maxValue);
+
+		for (const uint8_t *scanPtr = scanBegin; scanPtr != scanEnd; scanPtr += scanStride)
 		{
 			uint32_t scanValue;
 
@@ -552,47 +1124,87 @@ void CommandBuffer::scanIndices(Buffer *buffer, VkDeviceSize indexOffset, VkInde
 
 			if (!primitiveRestart || scanValue != primitiveRestartValue)
 			{
-				uint32_t index = (scanValue - minValue) / 64;
-				uint64_t bit = 1ull << (uint64_t)((scanValue - minValue) & 63);
-
-				uint32_t frag_index = ((scanValue - minValue) * FRAGMENT_SIZE) / (maxValue - minValue + 1);
-				fragmentation[frag_index] = '#';
-
-				buckets[index] |= bit;
+				if (!vertexCache.access(scanValue))
+					vertexShadeCount++;
+				vertices.set(scanValue);
 			}
-			scanPtr += scanStride;
 		}
+	}
 
-		uint32_t verticesReferenced = 0;
-		for (auto it : buckets)
-		{
-#ifdef _MSC_VER
-			verticesReferenced += (uint32_t)__popcnt(it & 0xffffffffu);
-			verticesReferenced += (uint32_t)__popcnt(it >> 32);
-#else
-			verticesReferenced += (uint32_t)__builtin_popcountll(it);
-#endif
-		}
+	IndexScanResult result = {};
+	result.minValue = minValue;
+	result.maxValue = maxValue;
 
-		float utilization = float(verticesReferenced) / float(maxValue - minValue + 1);
-		if (cfg.msgIndexBufferSparse &&
-		utilization < baseDevice->getConfig().indexBufferUtilizationThreshold)
-		{
-			buffer->log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_SPARSE,
-			            "Indexbuffer data used by drawcall is fragmented: [%s]", fragmentation);
-		}
+	if (maxValue < minValue)
+	{
+		// all indices are primitive restarts
+		chargeScanTime();
+		rememberIndexScan(device, key, result, writeGeneration, liveData);
+		return;
+	}
 
-		float cacheHitRate = float(verticesReferenced) / float(vertexShadeCount);
-		if (
-		cfg.msgIndexBufferCacheThrashing &&
-		cacheHitRate <= baseDevice->getConfig().indexBufferCacheHitThreshold)
+	// Indices scattered over a huge range can't all be kept track of, fall back to an upper bound.
+	float range = float(maxValue - minValue) + 1.0f;
+	if (vertices.overflowed())
+		result.utilization = std::min(float(indexCount) / range, 1.0f);
+	else
+	{
+		uint32_t verticesReferenced = vertices.count();
+		result.utilization = float(verticesReferenced) / range;
+		result.cacheHitRate = float(verticesReferenced) / float(vertexShadeCount);
+	}
+	chargeScanTime();
+
+	// The hit rate needs the number of distinct vertices, which is not known once the bitmap overflowed.
+	// Such scans are neither remembered nor checked for cache thrashing.
+	bool hitRateKnown = !vertices.overflowed();
+	if (hitRateKnown)
+		rememberIndexScan(device, key, result, writeGeneration, liveData);
+
+	if (reorderAdvisor && hitRateKnown)
+		reorderAdvisor->analyze(key, indexData, writeGeneration);
+
+	if (cfg.msgIndexBufferSparse && maxValue - minValue >= indexCount)
+	{
+		buffer->log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_SPARSE,
+		            "Indexbuffer data used by drawcall is fragmented. Number of indices (%u) is smaller than range "
+		            "of index buffer data (%u).\n",
+		            indexCount, maxValue - minValue + 1);
+		return;
+	}
+
+	if (cfg.msgIndexBufferSparse &&
+	result.utilization < device.getConfig().indexBufferUtilizationThreshold)
+	{
+#define FRAGMENT_SIZE 16
+		char fragmentation[FRAGMENT_SIZE + 1];
+		memset(fragmentation, ' ', sizeof(fragmentation));
+		fragmentation[FRAGMENT_SIZE] = '\0';
+
+		// An index lands in fragment ((index - minValue) * FRAGMENT_SIZE) / range, so fragment j covers the bits
+		// [ceil(j * range / FRAGMENT_SIZE), ceil((j + 1) * range / FRAGMENT_SIZE)).
+		uint64_t range = uint64_t(maxValue - minValue) + 1;
+		for (uint64_t j = 0; j < FRAGMENT_SIZE; j++)
 		{
-			buffer->log(
-			    VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING,
-			    "Indexbuffer data causes thrashing of post-transform vertex cache.\n"
-			    "Percentage of unique vertices to number of vertices theoretically shaded is estimated to %.02f%%.",
-			    cacheHitRate * 100.0f);
+			uint64_t begin = (j * range + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
+			uint64_t end = ((j + 1) * range + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
+			if (vertices.anySet(minValue + begin, minValue + end))
+				fragmentation[j] = '#';
 		}
+#undef FRAGMENT_SIZE
+
+		buffer->log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_SPARSE,
+		            "Indexbuffer data used by drawcall is fragmented: [%s]", fragmentation);
+	}
+
+	if (cfg.msgIndexBufferCacheThrashing && hitRateKnown &&
+	    result.cacheHitRate <= device.getConfig().indexBufferCacheHitThreshold)
+	{
+		buffer->log(
+		    VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING,
+		    "Indexbuffer data causes thrashing of post-transform vertex cache.\n"
+		    "Percentage of unique vertices to number of vertices theoretically shaded is estimated to %.02f%%.",
+		    result.cacheHitRate * 100.0f);
 	}
 }
 
@@ -631,18 +1243,14 @@ void CommandBuffer::pipelineBarrier(VkPipelineStageFlags srcStageMask, VkPipelin
 	if (currentRenderPass)
 		return;
 
-	enqueueDeferredFunction([=](Queue &queue) {
-		auto &tracker = queue.getQueueTracker();
+	auto src = srcStageMask;
+	auto dst = dstStageMask;
 
-		auto src = srcStageMask;
-		auto dst = dstStageMask;
+	if (dst & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+		dst |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	if (src & VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+		src |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 
-		if (dst & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
-			dst |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-		if (src & VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
-			src |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-
-		tracker.pipelineBarrier(vkStagesToTracker(src), vkStagesToTracker(dst));
-	});
+	enqueuePipelineBarrier(vkStagesToTracker(src), vkStagesToTracker(dst));
 }
 }
@@ -19,14 +19,17 @@
  */
 
 #pragma once
+#include "analysis_worker.hpp"
 #include "base_object.hpp"
+#include "command_stream.hpp"
 #include "dispatch_helper.hpp"
 #include "heuristic.hpp"
 #include "perfdoc.hpp"
 #include "pipeline.hpp"
 #include "queue_tracker.hpp"
+#include "vertex_cache.hpp"
 
-#include <functional>
+#include <atomic>
 #include <vector>
 
 namespace MPD
@@ -34,9 +37,11 @@ namespace MPD
 
 class CommandPool;
 class Buffer;
+class DeviceMemory;
 class Queue;
 class RenderPass;
 class DescriptorSet;
+class Event;
 class PipelineLayout;
 
 class CommandBuffer : public BaseObject
@@ -59,8 +64,34 @@ public:
 		return commandPool;
 	}
 
-	void enqueueDeferredFunction(std::function<void(Queue &)> Function);
-	void callDeferredFunctions(Queue &queue);
+	void enqueuePushWork(QueueTracker::Stage stage);
+	void enqueuePipelineBarrier(QueueTracker::StageFlags srcStages, QueueTracker::StageFlags dstStages);
+	void enqueueSignalEvent(Event *event, QueueTracker::StageFlags srcStages);
+	void enqueueWaitEvent(Event *event, QueueTracker::StageFlags dstStages);
+	void enqueueResetEvent(Event *event);
+	void enqueueImageUsage(Image *image, const VkImageSubresourceLayers &layers, Image::Usage usage);
+	void enqueueImageUsage(Image *image, const VkImageSubresourceRange &range, Image::Usage usage);
+
+	/// Records a transfer into the buffer. The memory is marked as written once the command buffer is submitted.
+	void enqueueBufferWrite(Buffer *buffer);
+
+	/// Called at vkQueueSubmit after the analysis of the submission, so cached index scans of buffers written by
+	/// this command buffer are not reused next time.
+	void signalBufferWrites();
+
+	/// Evaluates everything which was deferred until submission, in recording order.
+	/// The recorded commands are kept, so command buffers which are submitted many times (or secondary command
+	/// buffers executed many times) are analyzed on every submission. They are only discarded by reset().
+	/// If a snapshot is given, index data and descriptor sets are read from it instead of the live objects.
+	void replayDeferredCommands(Queue &queue, SubmitSnapshot *snapshot = nullptr);
+
+	/// Captures what replayDeferredCommands() needs from state the application can modify after vkQueueSubmit,
+	/// and keeps this command buffer (and the secondaries it executes) from being reset until the job is done.
+	void snapshotDeferredCommands(AnalysisJob &job);
+	void releaseAnalysisReference();
+
+	/// Called at vkEndCommandBuffer, prepares the recorded QueueTracker commands for submission.
+	void end();
 
 	void bindIndexBuffer(Buffer *buffer, VkDeviceSize offset, VkIndexType indexType);
 	void executeCommandBuffer(CommandBuffer *commandBuffer);
@@ -78,6 +109,12 @@ public:
 	void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
 	                 uint32_t firstInstance);
 
+	/// The arguments are read at submit, see DeferredDrawIndirect.
+	void drawIndirect(Buffer *buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride, bool indexed);
+
+	/// Called by DepthPrePassHeuristic at the end of a render pass which had indirect drawcalls.
+	void enqueueDepthPrePassCheck(uint32_t numDrawCallsDepthOnly, uint32_t numDrawCallsDepthEqual);
+
 	void pipelineBarrier(VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
 	                     VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount,
 	                     const VkMemoryBarrier *pMemoryBarriers, uint32_t bufferMemoryBarrierCount,
@@ -118,15 +155,80 @@ public:
 		return currentSubpassIndex;
 	}
 
+	/// The capture epoch of the device when recording began, see Device::getCaptureEpoch().
+	/// Only command buffers recorded in the current epoch are tracked and analyzed.
+	uint32_t getCaptureEpoch() const
+	{
+		return captureEpoch;
+	}
+
+	void setCaptureEpoch(uint32_t epoch)
+	{
+		captureEpoch = epoch;
+	}
+
+	/// Checks the indices of a drawcall and reports what it finds.
+	/// liveData is set if indexData points to the mapping rather than a copy.
+	static void scanIndices(Device &device, VertexCache &vertexCache, const IndexScanKey &key,
+	                        const uint8_t *indexData, uint64_t writeGeneration, bool liveData);
+
+	/// Scans the indices of every draw of an indexed indirect drawcall, from arguments copied back by IndexReadback.
+	/// Indices which are not host visible are copied back in turn.
+	static void scanIndirectIndices(Device &device, VertexCache &vertexCache, const DeferredDrawIndirect &draw,
+	                                const uint8_t *args, uint32_t drawCount);
+
 private:
-	void scanIndices(Buffer *buffer, VkDeviceSize indexOffset, VkIndexType indexType, uint32_t indexCount,
-	                 uint32_t firstIndex, bool primitiveRestart);
+	struct IndirectDrawCounts
+	{
+		uint32_t smallIndexedDrawcalls = 0;
+		uint32_t drawCallsDepthOnly = 0;
+		uint32_t drawCallsDepthEqual = 0;
+	};
+
+	void replayCommandStream(SubmitSnapshot *snapshot);
+	void snapshotCommandStream(AnalysisJob &job);
+
+	void snapshotIndexScan(SubmitSnapshot &snapshot, const IndexScanKey &key);
+	void replayIndexScan(SubmitSnapshot *snapshot, const IndexScanKey &key);
+
+	void replayDrawIndirect(SubmitSnapshot *snapshot, const DeferredDrawIndirect &draw, IndirectDrawCounts &counts);
+	static void countIndirectDraws(const Device &device, const DeferredDrawIndirect &draw, const uint8_t *args,
+	                               uint32_t drawCount, IndirectDrawCounts &counts);
+	void reportIndirectDrawCounts(const IndirectDrawCounts &counts);
+
+	/// Returns the mapped indices, or nullptr if they are not host visible.
+	/// The write generation is read first, so it can only be older than the returned data.
+	static const uint8_t *getIndexData(const IndexScanKey &key, uint64_t &writeGeneration);
+	static void getIndexRange(const IndexScanKey &key, VkDeviceSize &offset, VkDeviceSize &size);
+
+	/// Call once the indices have been read, returns the write generation they can be cached with.
+	static uint64_t validateIndexRead(const IndexScanKey &key, uint64_t writeGeneration);
+
+	static void rememberIndexScan(Device &device, const IndexScanKey &key, const IndexScanResult &result,
+	                              uint64_t writeGeneration, bool liveData);
+
+	/// Queues a GPU copy of indices which are not host visible, to be scanned once it completes.
+	static void enqueueIndexReadback(Device &device, const IndexScanKey &key, uint64_t writeGeneration);
+
+	/// Queues a GPU copy of the arguments of an indexed indirect drawcall, if they are copied back rather than read
+	/// at submit. Returns true if so.
+	bool enqueueIndirectReadback(const DeferredDrawIndirect &draw, uint32_t drawCount);
 
 	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
 	CommandPool *commandPool;
 
 	std::vector<CommandBuffer *> executedCommandBuffers;
-	std::vector<std::function<void(Queue &)>> deferredFunctions;
+	CommandStream deferredCommands;
+
+	// QueueTracker commands are kept apart from the other deferred work,
+	// so they can be applied as a precompiled summary at submit.
+	QueueTrackerSummary trackerSummary;
+
+	// Memory written by transfer commands, including those of executed secondary command buffers.
+	std::vector<DeviceMemory *> writtenMemory;
+
+	// Number of queued analysis jobs which still read from this command buffer.
+	std::atomic<uint32_t> pendingAnalysis{ 0 };
 
 	VkFramebuffer lastFB;
 
@@ -136,23 +238,25 @@ private:
 	Pipeline *pipeline;
 
 	uint32_t smallIndexedDrawcallCount = 0;
+	bool reportedIndirectSmallDrawcalls = false;
 
 	std::vector<std::unique_ptr<Heuristic>> heuristics;
 	const RenderPass *currentRenderPass;
 	uint32_t currentSubpassIndex = 0;
 	bool secondary = false;
+	uint32_t captureEpoch = 0;
 
-	struct CacheEntry
-	{
-		uint32_t value;
-		uint32_t age;
-	};
-
-	std::vector<CacheEntry> cacheEntries;
-	static bool testCache(uint32_t value, uint32_t iteration, CacheEntry *cacheEntries, uint32_t cacheSize);
+	// Post-transform cache model for index buffer scanning, reset for every scan.
+	VertexCache vertexCache;
 
+	void enqueueImageViewUsage(ImageView *view, Image::Usage usage);
+	void enqueueDescriptorSetUsage(DescriptorSet *set);
 	void enqueueRenderPassLoadOps(VkRenderPass renderPass, VkFramebuffer framebuffer);
 	void enqueueRenderPassStoreOps(VkRenderPass renderPass, VkFramebuffer framebuffer);
+	void enqueueRenderPassBandwidth(const VkRenderPassBeginInfo &beginInfo);
+
+	// Scratch space for enqueueRenderPassBandwidth.
+	std::vector<std::pair<uint64_t, TileTraffic>> attachmentTraffic;
 
 	struct DescriptorSetInfo
 	{
@@ -20,6 +20,7 @@
 
 #pragma once
 #include "base_object.hpp"
+#include "command_stream.hpp"
 #include "dispatch_helper.hpp"
 #include "perfdoc.hpp"
 
@@ -59,8 +60,14 @@ public:
 		return commandBuffers;
 	}
 
+	CommandStreamArena &getCommandStreamArena()
+	{
+		return commandStreamArena;
+	}
+
 private:
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	std::unordered_set<CommandBuffer *> commandBuffers;
+	CommandStreamArena commandStreamArena;
 };
 }
@@ -144,6 +144,60 @@ public:
 	MPD_DEFINE_CFG_OPTIONU(indexBufferVertexPostTransformCache, 32,
 	                       "Size of post-transform cache used for estimating index buffer cache hit-rate");
 
+	MPD_DEFINE_CFG_OPTIONB(indexBufferScanCacheEnable, true,
+	                       "Remember index buffer scans until the memory is written to, so each mesh is only scanned "
+	                       "and reported once");
+
+	MPD_DEFINE_CFG_OPTIONU(indexBufferScanCacheSize, 4096,
+	                       "Maximum number of index buffer scans to remember, for the scan cache, the scan budgets and "
+	                       "the reorder advisor each");
+
+	MPD_DEFINE_CFG_OPTIONU(indexBufferScanBudgetBytes, 0,
+	                       "Maximum number of bytes of index data to scan per frame, 0 for no limit. "
+	                       "Draws which are not scanned in one frame are scanned in a later one");
+
+	MPD_DEFINE_CFG_OPTIONU(indexBufferScanBudgetMicroseconds, 0,
+	                       "Maximum CPU time in microseconds to spend scanning index data per frame, 0 for no limit");
+
+	MPD_DEFINE_CFG_OPTIONB(indexBufferScanBudgetPerSubmit, false,
+	                       "Apply the index buffer scan budgets to each vkQueueSubmit rather than to each frame");
+
+	MPD_DEFINE_CFG_OPTIONB(indexBufferWriteTrackingEnable, false,
+	                       "Linux only. Write-protect host memory backing index buffers to see which pages the "
+	                       "application writes, so cached index buffer scans are redone exactly when needed. Only "
+	                       "pages which lie entirely within an index buffer are protected. While a page is protected, "
+	                       "the kernel cannot write to it: read(), recv() or fread() straight into mapped index memory "
+	                       "fail with EFAULT instead of faulting, which can break the application silently. The layer "
+	                       "also installs a process wide SIGSEGV handler, which can conflict with the handlers of the "
+	                       "application or of a crash reporter. Only enable it for applications which fill index "
+	                       "buffers with plain CPU stores");
+
+	MPD_DEFINE_CFG_OPTIONB(indexBufferVertexPostTransformCacheFIFO, false,
+	                       "Model the post-transform cache with FIFO replacement instead of LRU");
+
+	MPD_DEFINE_CFG_OPTIONB(indexBufferShadowReadback, false,
+	                       "Leave index buffers in the memory type the application picks, and copy the indices of "
+	                       "drawcalls to host visible memory on the GPU to scan them. If the staging buffer can't be "
+	                       "created, a warning is logged and index buffers are placed in host visible memory");
+
+	MPD_DEFINE_CFG_OPTIONU(indexBufferShadowReadbackSize, 16777216,
+	                       "Size in bytes of the staging buffer used by indexBufferShadowReadback");
+
+	MPD_DEFINE_CFG_OPTIONB(indexBufferReorderAdvisorEnable, false,
+	                       "Reorder the indices of scanned triangle lists on a background thread, and report how many "
+	                       "vertex shader invocations a cache-optimized order would save");
+
+	MPD_DEFINE_CFG_OPTIONF(indexBufferReorderAdvisorMinSavings, 0.1,
+	                       "Only report drawcalls whose reordered indices would save at least this fraction of their "
+	                       "vertex shader invocations");
+
+	MPD_DEFINE_CFG_OPTIONU(indexBufferReorderAdvisorReportFrames, 300,
+	                       "Number of frames between rankings of the drawcalls which would save the most vertex shader "
+	                       "invocations per frame, 0 to disable the ranking");
+
+	MPD_DEFINE_CFG_OPTIONU(indexBufferReorderAdvisorReportCount, 10,
+	                       "Number of drawcalls listed in each ranking of indexBufferReorderAdvisorReportFrames");
+
 	MPD_DEFINE_CFG_OPTIONU(maxInstancedVertexBuffers, 1,
 	                       "Maximum number of instanced vertex buffers which should be used");
 
@@ -160,7 +214,8 @@ public:
 	MPD_DEFINE_CFG_OPTIONB(
 	    indexBufferScanningEnable, true,
 	    "If enabled, scans the index buffer for every draw call in an attempt to find inefficiencies. "
-	    "This is fairly expensive, so it should be disabled once index buffers have been validated.");
+	    "This is fairly expensive, so it should be disabled once index buffers have been validated, "
+	    "or limited with indexBufferScanBudgetBytes or indexBufferScanBudgetMicroseconds.");
 
 	MPD_DEFINE_CFG_OPTIONB(
 	    indexBufferScanningInPlace, false,
@@ -170,6 +225,75 @@ public:
 	    "but scanning indices here will only work if the index buffer is actually valid when calling this function. "
 	    "If not enabled, indices will be scanned on vkQueueSubmit.");
 
+	MPD_DEFINE_CFG_OPTIONB(
+	    indirectDrawAnalysisEnable, true,
+	    "If enabled, the arguments of indirect drawcalls are read on vkQueueSubmit if they are host visible, "
+	    "and every draw is analyzed like a direct drawcall. "
+	    "Arguments written by the GPU are only seen with indexBufferShadowReadback, which copies them back after "
+	    "the submission and scans the indices of their draws. The drawcall counts are always taken at submit.");
+
+	MPD_DEFINE_CFG_OPTIONB(
+	    asyncAnalysisEnable, false,
+	    "If enabled, the checks which are deferred to vkQueueSubmit run on a dedicated thread. "
+	    "vkQueueSubmit only snapshots the state the checks need, including index data, and returns. "
+	    "Findings are reported from the analysis thread, in submission order.");
+
+	MPD_DEFINE_CFG_OPTIONU(asyncAnalysisQueueDepth, 64,
+	                       "Number of submissions which can wait for asynchronous analysis before vkQueueSubmit blocks");
+
+	MPD_DEFINE_CFG_OPTIONB(dispatchPassThroughEnable, true,
+	                       "If enabled, entry points which none of the enabled checks need are not intercepted, so "
+	                       "they cost nothing. With every msg option for command buffers off, command buffer recording "
+	                       "and vkQueueSubmit go straight to the driver");
+
+	MPD_DEFINE_CFG_OPTIONB(frameBoundaryPerSubmit, false,
+	                       "If enabled, every vkQueueSubmit ends a frame as vkQueuePresentKHR does, for applications "
+	                       "which never present, such as offscreen renderers and compute workloads");
+
+	MPD_DEFINE_CFG_OPTIONB(frameStatsEnable, false,
+	                       "If enabled, draws, dispatches, render passes, submits, barriers, descriptor updates, "
+	                       "pipeline binds and the CPU time spent in the layer are counted for every frame. Frames end "
+	                       "at vkQueuePresentKHR. With loggingBinary, the counters of every frame are written to the log");
+
+	MPD_DEFINE_CFG_OPTIONU(frameStatsLogInterval, 60,
+	                       "Report the counters of frameStatsEnable every this many frames, 0 to only write them to "
+	                       "the binary log");
+
+	MPD_DEFINE_CFG_OPTIONB(tileBandwidthEstimatorEnable, false,
+	                       "Estimate the bytes the load and store ops of every render pass move between the tile "
+	                       "buffer and memory, and add them up per render pass, frame and image");
+
+	MPD_DEFINE_CFG_OPTIONU(tileBandwidthBudgetBytes, 0,
+	                       "Warn about frames whose render passes move more than this many bytes between the tile "
+	                       "buffer and memory, 0 for no budget");
+
+	MPD_DEFINE_CFG_OPTIONU(tileBandwidthReportFrames, 300,
+	                       "Number of frames between rankings of the render passes and images which cost the most "
+	                       "tile memory traffic, 0 to disable the ranking");
+
+	MPD_DEFINE_CFG_OPTIONU(tileBandwidthReportCount, 10,
+	                       "Number of render passes and images listed in each ranking of tileBandwidthReportFrames");
+
+	MPD_DEFINE_CFG_OPTIONB(captureWindowEnable, false,
+	                       "If enabled, the layer only analyzes the frames of a capture window, given by "
+	                       "captureWindowFirstFrame and captureWindowFrameCount or by captureTriggerFile. Outside the "
+	                       "window, command buffers and submissions go to the driver after a single check. Objects are "
+	                       "still tracked. Command buffers recorded before the window opens are not analyzed");
+
+	MPD_DEFINE_CFG_OPTIONU(captureWindowFirstFrame, 0,
+	                       "First frame of the capture window, counting the frames since the device was created");
+
+	MPD_DEFINE_CFG_OPTIONU(captureWindowFrameCount, 0,
+	                       "Number of frames in the capture window, 0 to only capture while captureTriggerFile exists");
+
+	MPD_DEFINE_CFG_OPTION_STRING(captureTriggerFile, "",
+	                             "If set, frames are also captured while this file exists. It is checked at the end of "
+	                             "a frame, at most once every captureTriggerPollMilliseconds");
+
+	MPD_DEFINE_CFG_OPTIONU(captureTriggerPollMilliseconds, 500,
+	                       "Minimum time between two checks for captureTriggerFile, 0 to check at the end of every "
+	                       "frame");
+
 	MPD_DEFINE_CFG_OPTION_STRING(loggingFilename, "",
 	                             "This setting specifies where to log output from the layer.\n"
 	                             "# The setting does not impact VK_EXT_debug_report which will always be supported.\n"
@@ -178,6 +302,45 @@ public:
 	                             "#  stderr\n"
 	                             "#  logcat (Android only)\n"
 	                             "#  debug_output (OutputDebugString, Windows only).");
+
+	MPD_DEFINE_CFG_OPTIONB(loggingBinary, false,
+	                       "If enabled, loggingFilename is written as binary records which are only formatted when the "
+	                       "log is decoded with perfdoc-log-decode. Does not apply to the special values");
+
+	MPD_DEFINE_CFG_OPTIONB(loggingAsyncEnable, false,
+	                       "If enabled, messages are handed to a dedicated thread which calls the debug callbacks and "
+	                       "writes to loggingFilename, so the application thread does not wait for them. Callbacks are "
+	                       "then called from that thread, so they cannot be used to backtrace the Vulkan call.");
+
+	MPD_DEFINE_CFG_OPTIONU(loggingAsyncQueueSize, 1024,
+	                       "Number of messages which can wait for the logging thread of loggingAsyncEnable");
+
+	MPD_DEFINE_CFG_OPTIONB(loggingAsyncBlockWhenFull, false,
+	                       "Wait for the logging thread when its queue is full instead of dropping the message. "
+	                       "The number of dropped messages is reported once there is room again. Messages logged "
+	                       "by a debug callback which calls back into the layer are still dropped, the logging "
+	                       "thread would wait for itself");
+
+	MPD_DEFINE_CFG_OPTIONB(messageFilterEnable, false,
+	                       "If enabled, repeated messages are counted instead of being formatted and reported. "
+	                       "A message is repeated if it has the same message code, object and origin in the layer");
+
+	MPD_DEFINE_CFG_OPTIONU(messageFilterRepeatLimit, 10,
+	                       "Number of times a repeated message is reported before it is only counted, 0 for no limit");
+
+	MPD_DEFINE_CFG_OPTIONF(messageFilterRatePerSecond, 0.0,
+	                       "Maximum number of messages per second with the same message code, 0 for no limit");
+
+	MPD_DEFINE_CFG_OPTIONU(messageFilterBurst, 100,
+	                       "Number of messages with the same message code which can be reported at once before "
+	                       "messageFilterRatePerSecond applies");
+
+	MPD_DEFINE_CFG_OPTIONU(messageFilterSummarySeconds, 10,
+	                       "Number of seconds between summaries of the messages which were suppressed, 0 to only "
+	                       "summarize them when the instance is destroyed");
+
+	MPD_DEFINE_CFG_OPTIONU(messageFilterTableSize, 65536,
+	                       "Maximum number of distinct messages to count, the counts start over once it is reached");
 								 
 	MPD_DEFINE_CFG_OPTIONB(msgCommandBufferReset, true, "Toggle MESSAGE_CODE_COMMAND_BUFFER_RESET");
 	MPD_DEFINE_CFG_OPTIONB(msgCommandBufferSimultaneousUse, true,
@@ -274,6 +437,11 @@ public:
 	MPD_DEFINE_CFG_OPTIONB(msgInefficientDepthStencilOps, true, "Toggle MESSAGE_CODE_INEFFICIENT_DEPTH_STENCIL_OPS");
 	
 	MPD_DEFINE_CFG_OPTIONB(msgQueryBundleTooSmall, true, "Toggle MESSAGE_CODE_QUERY_BUNDLE_TOO_SMALL");
+	MPD_DEFINE_CFG_OPTIONB(msgIndexBufferReorderAdvice, true, "Toggle MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE");
+	MPD_DEFINE_CFG_OPTIONB(msgFrameStatistics, true, "Toggle MESSAGE_CODE_FRAME_STATISTICS");
+	MPD_DEFINE_CFG_OPTIONB(msgTileBandwidthBudget, true, "Toggle MESSAGE_CODE_TILE_BANDWIDTH_BUDGET");
+	MPD_DEFINE_CFG_OPTIONB(msgTileBandwidthRanking, true, "Toggle MESSAGE_CODE_TILE_BANDWIDTH_RANKING");
+	MPD_DEFINE_CFG_OPTIONB(msgCaptureWindow, true, "Toggle MESSAGE_CODE_CAPTURE_WINDOW");
 	
 	bool tryToLoadFromFile(const std::string &fname);
 
@@ -112,6 +112,35 @@ void DescriptorSet::signalUsage()
 	}
 }
 
+void DescriptorSet::getImageUsages(std::vector<std::pair<ImageView *, Image::Usage>> &usages) const
+{
+	for (auto &binding : layout->getSampledImageBindings())
+	{
+		auto itr = bindings.find(binding);
+		if (itr == end(bindings))
+			continue;
+
+		for (auto *view : itr->second.views)
+		{
+			if (view)
+				usages.emplace_back(view, Image::Usage::ResourceRead);
+		}
+	}
+
+	for (auto &binding : layout->getStorageImageBindings())
+	{
+		auto itr = bindings.find(binding);
+		if (itr == end(bindings))
+			continue;
+
+		for (auto *view : itr->second.views)
+		{
+			if (view)
+				usages.emplace_back(view, Image::Usage::ResourceWrite);
+		}
+	}
+}
+
 DescriptorSet::~DescriptorSet()
 {
 	if (pool)
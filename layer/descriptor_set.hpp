@@ -20,8 +20,10 @@
 
 #pragma once
 #include "base_object.hpp"
+#include "image.hpp"
 #include <atomic>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace MPD
@@ -60,6 +62,9 @@ public:
 
 	void signalUsage();
 
+	/// Appends the image views signalUsage() would signal, so they can be signalled later.
+	void getImageUsages(std::vector<std::pair<ImageView *, Image::Usage>> &usages) const;
+
 	static void writeDescriptors(Device *device, const VkWriteDescriptorSet &write);
 	static void copyDescriptors(Device *device, const VkCopyDescriptorSet &copy);
 
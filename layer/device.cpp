@@ -28,16 +28,21 @@
 #include "device_memory.hpp"
 #include "dispatch_helper.hpp"
 #include "event.hpp"
+#include "frame_stats.hpp"
 #include "framebuffer.hpp"
 #include "image.hpp"
+#include "index_readback.hpp"
 #include "instance.hpp"
 #include "pipeline.hpp"
 #include "pipeline_layout.hpp"
 #include "queue.hpp"
 #include "render_pass.hpp"
+#include "reorder_advisor.hpp"
 #include "sampler.hpp"
 #include "shader_module.hpp"
 #include "swapchain.hpp"
+#include "tile_bandwidth.hpp"
+#include <stdio.h>
 
 namespace MPD
 {
@@ -48,6 +53,9 @@ Device::Device(Instance *inst, uint64_t objHandle_)
 
 Device::~Device()
 {
+	// Finish queued analysis while every object it can reference is still alive.
+	analysisWorker.reset();
+	reorderAdvisor.reset();
 }
 
 void Device::setQueue(uint32_t family, uint32_t index, VkQueue queue)
@@ -69,6 +77,36 @@ VkQueue Device::getQueue(uint32_t family, uint32_t index) const
 	return queueFamilies[family][index];
 }
 
+// Which entry points the enabled checks and trackers need. A check which is added to an entry point must be added here.
+static uint32_t computeInterceptMask(const Config &cfg)
+{
+	if (!cfg.dispatchPassThroughEnable)
+		return Device::INTERCEPT_ALL;
+
+	uint32_t mask = Device::INTERCEPT_OBJECTS_BIT;
+
+	bool indexScanning = cfg.indexBufferScanningEnable && (cfg.msgIndexBufferSparse ||
+	                                                       cfg.msgIndexBufferCacheThrashing ||
+	                                                       cfg.indexBufferReorderAdvisorEnable);
+
+	bool commandBuffers =
+	    indexScanning || cfg.frameStatsEnable || cfg.tileBandwidthEstimatorEnable || cfg.frameBoundaryPerSubmit ||
+	    cfg.msgCommandBufferSimultaneousUse || cfg.msgManySmallIndexedDrawcalls || cfg.msgNonIndexedDrawCall ||
+	    cfg.msgWorkgroupSizeDivisor || cfg.msgResolveImage || cfg.msgNoFBCDC || cfg.msgPotentialSubpass ||
+	    cfg.msgQueryBundleTooSmall || cfg.msgPartialClear || cfg.msgPipelineBubble || cfg.msgDepthPrePass ||
+	    cfg.msgTileReadback || cfg.msgClearAttachmentsAfterLoad || cfg.msgClearAttachmentsNoDrawCall ||
+	    cfg.msgRedundantRenderpassStore || cfg.msgRedundantImageClear || cfg.msgInefficientClear;
+
+	if (commandBuffers)
+		mask |= Device::INTERCEPT_COMMAND_BUFFERS_BIT;
+
+	// Descriptor sets are tracked for the image usage of the command buffers which bind them.
+	if (commandBuffers || cfg.msgNonMipmappedTextureUsed || cfg.msgUncompressedTextureUsed)
+		mask |= Device::INTERCEPT_DESCRIPTOR_UPDATES_BIT;
+
+	return mask;
+}
+
 VkResult Device::init(VkPhysicalDevice gpu_, VkDevice device_, const VkLayerInstanceDispatchTable *pInstanceTable_,
                       VkLayerDispatchTable *pTable_)
 {
@@ -80,59 +118,141 @@ VkResult Device::init(VkPhysicalDevice gpu_, VkDevice device_, const VkLayerInst
 	getInstanceTable()->GetPhysicalDeviceMemoryProperties(gpu, &memoryProperties);
 	getInstanceTable()->GetPhysicalDeviceProperties(gpu, &properties);
 
+	const auto &cfg = getConfig();
+	interceptMask = computeInterceptMask(cfg);
+	if (cfg.asyncAnalysisEnable)
+		analysisWorker.reset(new AnalysisWorker(size_t(cfg.asyncAnalysisQueueDepth)));
+	if (cfg.indexBufferScanCacheEnable)
+		indexScanCache.reset(new IndexScanCache(size_t(cfg.indexBufferScanCacheSize)));
+	if (cfg.indexBufferScanBudgetBytes || cfg.indexBufferScanBudgetMicroseconds)
+	{
+		indexScanScheduler.reset(new IndexScanScheduler(cfg.indexBufferScanBudgetBytes,
+		                                                uint64_t(cfg.indexBufferScanBudgetMicroseconds) * 1000,
+		                                                size_t(cfg.indexBufferScanCacheSize)));
+	}
+	if (cfg.frameStatsEnable)
+		frameStats.reset(new FrameStats(*this));
+	if (cfg.tileBandwidthEstimatorEnable)
+		tileBandwidthEstimator.reset(new TileBandwidthEstimator(*this));
+	if (cfg.indexBufferReorderAdvisorEnable)
+		reorderAdvisor.reset(new ReorderAdvisor(*this, size_t(cfg.indexBufferScanCacheSize)));
+	if (cfg.indexBufferShadowReadback)
+	{
+		// Without a staging buffer, index buffers are forced into host visible memory, as if it was disabled.
+		indexReadback.reset(new IndexReadback(*this, cfg.indexBufferShadowReadbackSize));
+		auto res = indexReadback->init();
+		if (res != VK_SUCCESS)
+		{
+			indexReadback.reset();
+			log(VK_DEBUG_REPORT_WARNING_BIT_EXT, 0,
+			    "Failed to create the staging buffer of indexBufferShadowReadback (VkResult %d), index buffers are "
+			    "placed in host visible memory instead.",
+			    int(res));
+		}
+	}
+	if (cfg.captureWindowEnable)
+	{
+		captureEpoch.store(0, std::memory_order_relaxed);
+		if (isCaptureFrame(0))
+			openCaptureWindow();
+	}
+
 	return VK_SUCCESS;
 }
 
-void Device::freeDescriptorSets(DescriptorPool *pool)
+bool Device::isCaptureFrame(uint64_t frame)
 {
-	MPD_ASSERT(pool);
-	auto &map = static_cast<std::unordered_map<VkDescriptorSet, std::unique_ptr<DescriptorSet>> &>(maps);
+	const auto &cfg = getConfig();
+	if (frame >= cfg.captureWindowFirstFrame && frame - cfg.captureWindowFirstFrame < cfg.captureWindowFrameCount)
+		return true;
 
-	while (1)
-	{
-		auto it = map.begin();
-		const auto end = map.end();
-		while (it != end)
-		{
-			if (it->second->getPool() == pool)
-			{
-				it = map.erase(it);
-				break;
-			}
+	return pollTriggerFile();
+}
 
-			++it;
-		}
+bool Device::pollTriggerFile()
+{
+	const auto &cfg = getConfig();
+	if (cfg.captureTriggerFile.empty())
+		return false;
 
-		if (it == end)
-			break;
+	// Opening a file every frame is not free, only look again once the interval is over.
+	auto now = std::chrono::steady_clock::now();
+	auto interval = std::chrono::milliseconds(cfg.captureTriggerPollMilliseconds);
+	if (lastTriggerPoll != std::chrono::steady_clock::time_point() && now - lastTriggerPoll < interval)
+		return triggerFileFound;
+
+	lastTriggerPoll = now;
+	FILE *file = fopen(cfg.captureTriggerFile.c_str(), "rb");
+	triggerFileFound = file != nullptr;
+	if (file)
+		fclose(file);
+	return triggerFileFound;
+}
+
+void Device::openCaptureWindow()
+{
+	// Nothing was tracked while the window was closed, so what is known about images and index buffers from
+	// before could be stale. Forget it rather than report findings against it.
+	waitForAnalysis();
+	static_cast<ObjectRegistry<VkImage, Image> &>(maps).forEach([](Image &image) { image.resetLastUsage(); });
+	if (indexScanCache)
+		indexScanCache->clear();
+	if (frameStats)
+		frameStats->restart();
+
+	// Skip 0, which means the window is closed.
+	if (++lastCaptureEpoch == 0)
+		lastCaptureEpoch = 1;
+	captureEpoch.store(lastCaptureEpoch, std::memory_order_release);
+
+	if (getConfig().msgCaptureWindow)
+	{
+		log(VK_DEBUG_REPORT_INFORMATION_BIT_EXT, MESSAGE_CODE_CAPTURE_WINDOW, "Capture window opened at frame %llu.",
+		    static_cast<unsigned long long>(captureFrame));
 	}
 }
 
-void Device::freeCommandBuffers(CommandPool *pool)
+void Device::nextCaptureFrame()
 {
-	MPD_ASSERT(pool);
-	auto &map = static_cast<std::unordered_map<VkCommandBuffer, std::unique_ptr<CommandBuffer>> &>(maps);
+	if (!getConfig().captureWindowEnable)
+		return;
+
+	captureFrame++;
+	bool capture = isCaptureFrame(captureFrame);
+	bool open = captureEpoch.load(std::memory_order_relaxed) != 0;
 
-	while (1)
+	if (capture && !open)
+		openCaptureWindow();
+	else if (!capture && open)
 	{
-		auto it = map.begin();
-		const auto end = map.end();
-		while (it != end)
+		captureEpoch.store(0, std::memory_order_release);
+		if (getConfig().msgCaptureWindow)
 		{
-			if (it->second->getCommandPool() == pool)
-			{
-				it = map.erase(it);
-				break;
-			}
-
-			++it;
+			log(VK_DEBUG_REPORT_INFORMATION_BIT_EXT, MESSAGE_CODE_CAPTURE_WINDOW,
+			    "Capture window closed at frame %llu.", static_cast<unsigned long long>(captureFrame));
 		}
-
-		if (it == end)
-			break;
 	}
 }
 
+void Device::releaseIndexReadback()
+{
+	indexReadback.reset();
+}
+
+void Device::freeDescriptorSets(DescriptorPool *pool)
+{
+	MPD_ASSERT(pool);
+	static_cast<ObjectRegistry<VkDescriptorSet, DescriptorSet> &>(maps).eraseIf(
+	    [pool](const DescriptorSet &set) { return set.getPool() == pool; });
+}
+
+void Device::freeCommandBuffers(CommandPool *pool)
+{
+	MPD_ASSERT(pool);
+	static_cast<ObjectRegistry<VkCommandBuffer, CommandBuffer> &>(maps).eraseIf(
+	    [pool](const CommandBuffer &cmd) { return cmd.getCommandPool() == pool; });
+}
+
 const Config &Device::getConfig() const
 {
 	return baseInstance->getConfig();
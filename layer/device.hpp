@@ -19,8 +19,13 @@
  */
 
 #pragma once
+#include "analysis_worker.hpp"
 #include "base_object.hpp"
 #include "config.hpp"
+#include "index_scan.hpp"
+#include "object_registry.hpp"
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -46,8 +51,12 @@ class SwapchainKHR;
 class Queue;
 class Event;
 class PipelineLayout;
+class IndexReadback;
+class ReorderAdvisor;
+class FrameStats;
+class TileBandwidthEstimator;
 
-#define MPD_OBJECT_MAP(ourType) std::unordered_map<Vk##ourType, std::unique_ptr<ourType>>
+#define MPD_OBJECT_MAP(ourType) ObjectRegistry<Vk##ourType, ourType>
 
 class ObjectMaps : public MPD_OBJECT_MAP(CommandBuffer),
                    public MPD_OBJECT_MAP(CommandPool),
@@ -116,29 +125,14 @@ public:
 	template <typename T>
 	T *alloc(typename T::VulkanType handle)
 	{
-		using VkType = typename T::VulkanType;
-		using MapType = std::unordered_map<VkType, std::unique_ptr<T>>;
-		auto &map = static_cast<MapType &>(maps);
-
-		MPD_ASSERT(map.find(handle) == map.end());
 		// Reinterpret cast while changing integer size doesn't work on MSVC.
-		T *n = new T(this, (uint64_t)handle);
-		map[handle] = std::unique_ptr<T>(n);
-		return n;
+		return static_cast<ObjectRegistry<typename T::VulkanType, T> &>(maps).emplace(handle, this, (uint64_t)handle);
 	}
 
 	template <class T>
-	T *get(typename T::VulkanType handle)
+	T *get(typename T::VulkanType handle) const
 	{
-		using VkType = typename T::VulkanType;
-		using MapType = std::unordered_map<VkType, std::unique_ptr<T>>;
-		auto &map = static_cast<MapType &>(maps);
-
-		auto it = map.find(handle);
-		if (it != map.end())
-			return it->second.get();
-		else
-			return nullptr;
+		return static_cast<const ObjectRegistry<typename T::VulkanType, T> &>(maps).find(handle);
 	}
 
 	template <class T>
@@ -147,13 +141,7 @@ public:
 		if (handle == VK_NULL_HANDLE)
 			return;
 
-		using VkType = typename T::VulkanType;
-		using MapType = std::unordered_map<VkType, std::unique_ptr<T>>;
-		auto &map = static_cast<MapType &>(maps);
-
-		auto it = map.find(handle);
-		MPD_ASSERT(it != map.end());
-		map.erase(it);
+		static_cast<ObjectRegistry<typename T::VulkanType, T> &>(maps).erase(handle);
 	}
 
 	void freeDescriptorSets(DescriptorPool *pool);
@@ -161,6 +149,88 @@ public:
 
 	const Config &getConfig() const;
 
+	/// Non-null if asyncAnalysisEnable is set.
+	AnalysisWorker *getAnalysisWorker()
+	{
+		return analysisWorker.get();
+	}
+
+	/// Waits for queued asynchronous analysis, which might still read objects the application is about to
+	/// destroy or modify.
+	void waitForAnalysis()
+	{
+		if (analysisWorker)
+			analysisWorker->drain();
+	}
+
+	/// Non-null if indexBufferScanCacheEnable is set.
+	IndexScanCache *getIndexScanCache()
+	{
+		return indexScanCache.get();
+	}
+
+	/// Non-null if an index buffer scan budget is set.
+	IndexScanScheduler *getIndexScanScheduler()
+	{
+		return indexScanScheduler.get();
+	}
+
+	/// Non-null if indexBufferShadowReadback is set and the staging buffer could be created.
+	IndexReadback *getIndexReadback()
+	{
+		return indexReadback.get();
+	}
+
+	/// Non-null if indexBufferReorderAdvisorEnable is set.
+	ReorderAdvisor *getReorderAdvisor()
+	{
+		return reorderAdvisor.get();
+	}
+
+	/// Non-null if frameStatsEnable is set.
+	FrameStats *getFrameStats()
+	{
+		return frameStats.get();
+	}
+
+	/// Non-null if tileBandwidthEstimatorEnable is set.
+	TileBandwidthEstimator *getTileBandwidthEstimator()
+	{
+		return tileBandwidthEstimator.get();
+	}
+
+	/// Groups of entry points which vkGetDeviceProcAddr returns the layer's own functions for.
+	/// The others go straight to the next layer.
+	enum InterceptBits
+	{
+		// Entry points which create and destroy objects, or which the checks of those objects need.
+		INTERCEPT_OBJECTS_BIT = 1 << 0,
+		// Command buffer recording and submission.
+		INTERCEPT_COMMAND_BUFFERS_BIT = 1 << 1,
+		// vkUpdateDescriptorSets.
+		INTERCEPT_DESCRIPTOR_UPDATES_BIT = 1 << 2,
+		INTERCEPT_ALL = 0x7
+	};
+
+	/// Worked out from the config when the device is created, see dispatchPassThroughEnable.
+	uint32_t getInterceptMask() const
+	{
+		return interceptMask;
+	}
+
+	/// Non-zero while the capture window of captureWindowEnable is open, and always without captureWindowEnable.
+	/// It changes every time the window opens, so command buffers recorded before then can be told apart.
+	uint32_t getCaptureEpoch() const
+	{
+		return captureEpoch.load(std::memory_order_acquire);
+	}
+
+	/// Opens or closes the capture window for the next frame, called at vkQueuePresentKHR.
+	void nextCaptureFrame();
+
+	/// Waits for the GPU and frees the readback objects, must be called before the VkDevice is destroyed.
+	void releaseIndexReadback();
+
 private:
 	VkPhysicalDevice gpu = VK_NULL_HANDLE;
 	VkDevice device = VK_NULL_HANDLE;
@@ -172,5 +242,24 @@ private:
 	VkPhysicalDeviceProperties properties;
 
 	std::vector<std::vector<VkQueue>> queueFamilies;
+	std::unique_ptr<IndexScanCache> indexScanCache;
+	std::unique_ptr<IndexScanScheduler> indexScanScheduler;
+	std::unique_ptr<IndexReadback> indexReadback;
+	std::unique_ptr<ReorderAdvisor> reorderAdvisor;
+	std::unique_ptr<FrameStats> frameStats;
+	std::unique_ptr<TileBandwidthEstimator> tileBandwidthEstimator;
+	uint32_t interceptMask = INTERCEPT_ALL;
+
+	std::atomic<uint32_t> captureEpoch{ 1 };
+	uint32_t lastCaptureEpoch = 1;
+	uint64_t captureFrame = 0;
+	std::chrono::steady_clock::time_point lastTriggerPoll;
+	bool triggerFileFound = false;
+	bool isCaptureFrame(uint64_t frame);
+	bool pollTriggerFile();
+	void openCaptureWindow();
+
+	// Declared after the object maps, so it is destroyed before any object a job could reference.
+	std::unique_ptr<AnalysisWorker> analysisWorker;
 };
 }
@@ -56,4 +56,13 @@ VkResult DeviceMemory::init(VkDeviceMemory memory_, const VkMemoryAllocateInfo &
 	}
 	return VK_SUCCESS;
 }
+
+void DeviceMemory::enableWriteTracking()
+{
+	if (writeTrackerOwner || !mappedMemory)
+		return;
+
+	writeTrackerOwner = PageWriteTracker::create(mappedMemory, size_t(allocInfo.allocationSize));
+	writeTracker.store(writeTrackerOwner.get(), std::memory_order_release);
+}
 }
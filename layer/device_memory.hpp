@@ -21,7 +21,10 @@
 #pragma once
 #include "base_object.hpp"
 #include "dispatch_helper.hpp"
+#include "page_write_tracker.hpp"
 #include "perfdoc.hpp"
+#include <atomic>
+#include <memory>
 
 namespace MPD
 {
@@ -48,9 +51,66 @@ public:
 		return mappedMemory;
 	}
 
+	/// Changes whenever the contents of the range may have changed, so results derived from them can be validated.
+	/// The range belongs to a resource bound at [boundOffset, boundOffset + boundSize).
+	/// Without write tracking, any write to the memory changes it.
+	/// Must be called before reading the range, see isReadConsistent().
+	uint64_t getWriteGeneration(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize boundOffset,
+	                            VkDeviceSize boundSize) const
+	{
+		uint64_t generation = writeGeneration.load(std::memory_order_acquire);
+		if (auto *tracker = getWriteTracker(offset, size, boundOffset, boundSize))
+			generation += tracker->arm(size_t(offset), size_t(size));
+		else
+			generation += hostWriteGeneration.load(std::memory_order_acquire);
+		return generation;
+	}
+
+	/// Returns false if the application may have written to the range while it was read, after
+	/// getWriteGeneration(). Only known with write tracking, otherwise always true.
+	bool isReadConsistent(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize boundOffset,
+	                      VkDeviceSize boundSize) const
+	{
+		auto *tracker = getWriteTracker(offset, size, boundOffset, boundSize);
+		return !tracker || tracker->isArmed(size_t(offset), size_t(size));
+	}
+
+	/// A write we cannot see, for example a transfer on the GPU.
+	void signalWrite()
+	{
+		writeGeneration.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	/// The application may write to the mapping.
+	/// Ranges which are write tracked ignore it, the tracker sees the writes themselves.
+	void signalHostWrite()
+	{
+		hostWriteGeneration.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	/// Starts tracking which pages of the mapping the application writes to, if supported.
+	void enableWriteTracking();
+
 private:
 	void *mappedMemory;
 	VkDeviceMemory memory = VK_NULL_HANDLE;
 	VkMemoryAllocateInfo allocInfo;
+	std::atomic<uint64_t> writeGeneration{ 0 };
+	std::atomic<uint64_t> hostWriteGeneration{ 0 };
+
+	// Can be enabled while other threads read the memory.
+	std::unique_ptr<PageWriteTracker> writeTrackerOwner;
+	std::atomic<PageWriteTracker *> writeTracker{ nullptr };
+
+	// Returns the tracker if it sees every write to the range. Pages which extend beyond the resource the range
+	// belongs to may hold other data, and the application might write to them in ways which can't be protected.
+	PageWriteTracker *getWriteTracker(VkDeviceSize offset, VkDeviceSize size, VkDeviceSize boundOffset,
+	                                  VkDeviceSize boundSize) const
+	{
+		auto *tracker = writeTracker.load(std::memory_order_acquire);
+		if (tracker && tracker->canTrack(size_t(offset), size_t(size), size_t(boundOffset), size_t(boundSize)))
+			return tracker;
+		return nullptr;
+	}
 };
 }
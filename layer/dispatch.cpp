@@ -39,15 +39,20 @@
 #include "descriptor_set_layout.hpp"
 #include "device_memory.hpp"
 #include "event.hpp"
+#include "frame_stats.hpp"
 #include "framebuffer.hpp"
 #include "image.hpp"
+#include "index_readback.hpp"
 #include "pipeline.hpp"
 #include "pipeline_layout.hpp"
+#include "proc_table.hpp"
 #include "queue.hpp"
 #include "render_pass.hpp"
+#include "reorder_advisor.hpp"
 #include "sampler.hpp"
 #include "shader_module.hpp"
 #include "swapchain.hpp"
+#include "tile_bandwidth.hpp"
 
 #include "format.hpp"
 
@@ -57,17 +62,34 @@ namespace MPD
 {
 
 // Global data structures to remap VkInstance and VkDevice to internal data structures.
+// Entry points which create, destroy or mutate shared layer state take globalLock.
+// Command recording only touches the command buffer (externally synchronized by the application) and
+// immutable objects. Devices and objects are looked up lock-free, so vkCmd* entry points do not take any lock.
 static mutex globalLock;
 static InstanceTable instanceDispatch;
 static DeviceTable deviceDispatch;
 static unordered_map<void *, unique_ptr<Instance>> instanceData;
 static unordered_map<void *, unique_ptr<Device>> deviceData;
+static DispatchKeyTable<Device> deviceLookup;
+
+// Returns the command buffer if its recording is analyzed, or nullptr if the command should go straight to the driver.
+// Outside the capture window of captureWindowEnable, this is one atomic load.
+static CommandBuffer *getCapturedCommandBuffer(Device *layer, VkCommandBuffer commandBuffer)
+{
+	uint32_t epoch = layer->getCaptureEpoch();
+	if (!epoch)
+		return nullptr;
+
+	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
+	MPD_ASSERT(cmdBuffer);
+	return cmdBuffer->getCaptureEpoch() == epoch ? cmdBuffer : nullptr;
+}
 
 static VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(VkDevice device, uint32_t familyIndex, uint32_t index, VkQueue *pQueue)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 	*pQueue = layer->getQueue(familyIndex, index);
 }
 
@@ -94,7 +116,12 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const V
 	if (res != VK_SUCCESS)
 		return res;
 
-	auto *device = createLayerData(getDispatchKey(*pDevice), deviceData, layer, reinterpret_cast<uintptr_t>(pDevice));
+	Device *device;
+	{
+		lock_guard<mutex> holder{ globalLock };
+		device = createLayerData(getDispatchKey(*pDevice), deviceData, layer, reinterpret_cast<uintptr_t>(pDevice));
+		deviceLookup.insert(getDispatchKey(*pDevice), device);
+	}
 
 	res =
 	    device->init(gpu, *pDevice, layer->getTable(), initDeviceTable(*pDevice, fpGetDeviceProcAddr, deviceDispatch));
@@ -104,6 +131,8 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const V
 		auto fpDestroyDevice = reinterpret_cast<PFN_vkDestroyDevice>(fpGetDeviceProcAddr(*pDevice, "vkDestroyDevice"));
 		if (fpDestroyDevice)
 			fpDestroyDevice(*pDevice, pAllocator);
+		lock_guard<mutex> holder{ globalLock };
+		deviceLookup.remove(key);
 		destroyLayerData(key, deviceData);
 		return res;
 	}
@@ -119,14 +148,17 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice gpu, const V
 
 			auto *pQueue = device->alloc<Queue>(queue);
 			MPD_ASSERT(pQueue);
-			res = pQueue->init(queue);
+			res = pQueue->init(queue, family);
 			if (res != VK_SUCCESS)
 			{
 				void *key = getDispatchKey(*pDevice);
+				device->releaseIndexReadback();
 				auto fpDestroyDevice =
 				    reinterpret_cast<PFN_vkDestroyDevice>(fpGetDeviceProcAddr(*pDevice, "vkDestroyDevice"));
 				if (fpDestroyDevice)
 					fpDestroyDevice(*pDevice, pAllocator);
+				lock_guard<mutex> holder{ globalLock };
+				deviceLookup.remove(key);
 				destroyLayerData(key, deviceData);
 				return res;
 			}
@@ -184,10 +216,18 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo
 
 static VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(instance);
-	auto *layer = getLayerData(key, instanceData);
+	Instance *layer;
+	{
+		lock_guard<mutex> holder{ globalLock };
+		layer = getLayerData(key, instanceData);
+	}
+
+	// Deliver queued messages while the callbacks and the log file are still around.
+	// Callbacks may call back into the layer, so this must not hold the global lock.
+	layer->getLogger().flush();
+
+	lock_guard<mutex> holder{ globalLock };
 	layer->getTable()->DestroyInstance(instance, pAllocator);
 	destroyLayerData(key, instanceData);
 }
@@ -199,7 +239,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateCommandPool(VkDevice device, const V
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	VkResult result = layer->getTable()->CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
 	if (result == VK_SUCCESS)
@@ -233,7 +273,8 @@ static VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(VkDevice device, VkCommandP
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 	layer->getTable()->DestroyCommandPool(device, commandPool, pAllocator);
 
 	// destroyCommandPool will also destroy any commandbuffers allocated to this pool
@@ -247,7 +288,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device,
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 	VkResult result = layer->getTable()->AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
 	if (result == VK_SUCCESS)
 	{
@@ -281,7 +322,8 @@ static VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandP
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 	layer->getTable()->FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
 
 	for (uint32_t i = 0; i < commandBufferCount; i++)
@@ -294,13 +336,17 @@ static VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandP
 static VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(VkCommandBuffer commandBuffer,
                                                          const VkCommandBufferBeginInfo *pBeginInfo)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	// Command buffers which are begun outside the capture window are neither tracked nor analyzed.
+	uint32_t epoch = layer->getCaptureEpoch();
+	if (!epoch)
+		return layer->getTable()->BeginCommandBuffer(commandBuffer, pBeginInfo);
 
 	CommandBuffer *pCommandBuffer = layer->get<CommandBuffer>(commandBuffer);
 	pCommandBuffer->reset();
+	pCommandBuffer->setCaptureEpoch(epoch);
 
 	if (pBeginInfo->flags & VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT)
 	{
@@ -319,12 +365,58 @@ static VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(VkCommandBuffer command
 	return layer->getTable()->BeginCommandBuffer(commandBuffer, pBeginInfo);
 }
 
+static VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	void *key = getDispatchKey(commandBuffer);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	CommandBuffer *pCommandBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (pCommandBuffer)
+		pCommandBuffer->end();
+
+	return layer->getTable()->EndCommandBuffer(commandBuffer);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL ResetCommandBuffer(VkCommandBuffer commandBuffer,
+                                                         VkCommandBufferResetFlags flags)
+{
+	void *key = getDispatchKey(commandBuffer);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	// Outside the capture window, nothing is recorded which would need to be discarded.
+	// Command buffers recorded in an earlier window are never replayed again, and are reset at their next begin.
+	if (layer->getCaptureEpoch())
+	{
+		CommandBuffer *pCommandBuffer = layer->get<CommandBuffer>(commandBuffer);
+		MPD_ASSERT(pCommandBuffer);
+
+		// The recorded analysis is replayed on every submit until the command buffer is reset.
+		pCommandBuffer->reset();
+	}
+	return layer->getTable()->ResetCommandBuffer(commandBuffer, flags);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL ResetCommandPool(VkDevice device, VkCommandPool commandPool,
+                                                       VkCommandPoolResetFlags flags)
+{
+	void *key = getDispatchKey(device);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	if (layer->getCaptureEpoch())
+	{
+		CommandPool *pCommandPool = layer->get<CommandPool>(commandPool);
+		MPD_ASSERT(pCommandPool);
+		pCommandPool->resetCommandBuffers();
+	}
+	return layer->getTable()->ResetCommandPool(device, commandPool, flags);
+}
+
 static VKAPI_ATTR VkResult VKAPI_CALL CreateEvent(VkDevice device, const VkEventCreateInfo *pCreateInfo,
                                                   const VkAllocationCallbacks *pAllocator, VkEvent *pEvent)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateEvent(device, pCreateInfo, pAllocator, pEvent);
 	if (res == VK_SUCCESS)
@@ -345,7 +437,8 @@ static VKAPI_ATTR VkResult ResetEvent(VkDevice device, VkEvent event)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 
 	auto *ev = layer->get<Event>(event);
 	MPD_ASSERT(ev);
@@ -358,7 +451,8 @@ static VKAPI_ATTR VkResult SetEvent(VkDevice device, VkEvent event)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 
 	auto *ev = layer->get<Event>(event);
 	MPD_ASSERT(ev);
@@ -368,67 +462,83 @@ static VKAPI_ATTR VkResult SetEvent(VkDevice device, VkEvent event)
 }
 static VKAPI_ATTR void CmdResetEvent(VkCommandBuffer commandBuffer, VkEvent event, VkPipelineStageFlags stageMask)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	auto *cmd = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmd)
+	{
+		layer->getTable()->CmdResetEvent(commandBuffer, event, stageMask);
+		return;
+	}
 
 	auto *ev = layer->get<Event>(event);
 	MPD_ASSERT(ev);
 
-	auto *cmd = layer->get<CommandBuffer>(commandBuffer);
-	cmd->enqueueDeferredFunction([=](Queue &queue) { ev->reset(); });
+	cmd->enqueueResetEvent(ev);
 
 	layer->getTable()->CmdResetEvent(commandBuffer, event, stageMask);
 }
 
 static VKAPI_ATTR void CmdSetEvent(VkCommandBuffer commandBuffer, VkEvent event, VkPipelineStageFlags stageMask)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	auto *cmd = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmd)
+	{
+		layer->getTable()->CmdSetEvent(commandBuffer, event, stageMask);
+		return;
+	}
 
 	auto *ev = layer->get<Event>(event);
 	MPD_ASSERT(ev);
 
-	auto *cmd = layer->get<CommandBuffer>(commandBuffer);
-	cmd->enqueueDeferredFunction([=](Queue &queue) {
-		auto src = stageMask;
-		if (src & VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
-			src |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-		queue.getQueueTracker().signalEvent(*ev, CommandBuffer::vkStagesToTracker(src));
-	});
+	auto src = stageMask;
+	if (src & VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+		src |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	cmd->enqueueSignalEvent(ev, CommandBuffer::vkStagesToTracker(src));
 
 	return layer->getTable()->CmdSetEvent(commandBuffer, event, stageMask);
 }
 
 static VKAPI_ATTR void CmdWaitEvents(VkCommandBuffer commandBuffer, uint32_t eventCount, const VkEvent *pEvents,
-                                     VkPipelineStageFlags, VkPipelineStageFlags dstStageMask, uint32_t,
-                                     const VkMemoryBarrier *, uint32_t, const VkBufferMemoryBarrier *, uint32_t,
-                                     const VkImageMemoryBarrier *)
+                                     VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+                                     uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
+                                     uint32_t bufferMemoryBarrierCount,
+                                     const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+                                     uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmd = layer->get<CommandBuffer>(commandBuffer);
-	for (uint32_t i = 0; i < eventCount; i++)
+	auto *cmd = getCapturedCommandBuffer(layer, commandBuffer);
+	if (cmd)
 	{
-		auto *ev = layer->get<Event>(pEvents[i]);
-		MPD_ASSERT(ev);
-		cmd->enqueueDeferredFunction([=](Queue &queue) {
-			auto dst = dstStageMask;
-			if (dst & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
-				dst |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-			queue.getQueueTracker().waitEvent(*ev, CommandBuffer::vkStagesToTracker(dst));
-		});
+		auto dst = dstStageMask;
+		if (dst & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+			dst |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		for (uint32_t i = 0; i < eventCount; i++)
+		{
+			auto *ev = layer->get<Event>(pEvents[i]);
+			MPD_ASSERT(ev);
+			cmd->enqueueWaitEvent(ev, CommandBuffer::vkStagesToTracker(dst));
+		}
 	}
+
+	layer->getTable()->CmdWaitEvents(commandBuffer, eventCount, pEvents, srcStageMask, dstStageMask,
+	                                 memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
+	                                 pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
 }
 
 static VKAPI_ATTR void VKAPI_CALL DestroyEvent(VkDevice device, VkEvent event, const VkAllocationCallbacks *pAllocator)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 
 	layer->destroy<Event>(event);
 	layer->getTable()->DestroyEvent(device, event, pAllocator);
@@ -439,9 +549,17 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateBuffer(VkDevice device, const VkBuff
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto res = layer->getTable()->CreateBuffer(device, pCreateInfo, pCallbacks, pBuffer);
+	// Index buffers, and the arguments of indirect drawcalls, are copied from for shadow readback.
+	VkBufferCreateInfo createInfo = *pCreateInfo;
+	VkBufferUsageFlags readbackUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	if (layer->getConfig().indirectDrawAnalysisEnable)
+		readbackUsage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	if (layer->getIndexReadback() && (createInfo.usage & readbackUsage))
+		createInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	auto res = layer->getTable()->CreateBuffer(device, &createInfo, pCallbacks, pBuffer);
 	if (res == VK_SUCCESS)
 	{
 		auto *buffer = layer->alloc<Buffer>(*pBuffer);
@@ -462,7 +580,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL BindBufferMemory(VkDevice device, VkBuffer
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto *pBuffer = layer->get<Buffer>(buffer);
 	auto *pMemory = layer->get<DeviceMemory>(memory);
@@ -478,7 +596,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL BindImageMemory(VkDevice device, VkImage i
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto *pImage = layer->get<Image>(image);
 	auto *pMemory = layer->get<DeviceMemory>(memory);
@@ -494,7 +612,25 @@ static VKAPI_ATTR void VKAPI_CALL DestroyBuffer(VkDevice device, VkBuffer buffer
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
+
+	auto *indexScanCache = layer->getIndexScanCache();
+	auto *indexReadback = layer->getIndexReadback();
+	auto *reorderAdvisor = layer->getReorderAdvisor();
+	auto *pBuffer = layer->get<Buffer>(buffer);
+
+	// Our copies are not covered by whatever the application waited for before destroying the buffer.
+	if (pBuffer && indexReadback)
+		indexReadback->waitForBuffer(pBuffer);
+
+	if (pBuffer && (pBuffer->getCreateInfo().usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+	{
+		if (indexScanCache)
+			indexScanCache->removeBuffer(pBuffer);
+		if (reorderAdvisor)
+			reorderAdvisor->removeBuffer(pBuffer);
+	}
 
 	layer->destroy<Buffer>(buffer);
 	layer->getTable()->DestroyBuffer(device, buffer, pCallbacks);
@@ -506,7 +642,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 	MPD_ASSERT(pSwapchain != nullptr);
 
 	auto res = layer->getTable()->CreateSwapchainKHR(device, pCreateInfo, pAllocator, pSwapchain);
@@ -592,7 +728,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroySwapchainKHR(VkDevice device, VkSwapcha
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	if (swapchain != VK_NULL_HANDLE)
 	{
@@ -617,7 +753,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkS
 	// does not cache the swapchain images properly so it will create new unique IDs every time it's called.
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto *chain = layer->get<SwapchainKHR>(swapchain);
 	MPD_ASSERT(chain);
@@ -641,12 +777,57 @@ static VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkS
 	}
 }
 
+// Called with globalLock held, at vkQueuePresentKHR or with frameBoundaryPerSubmit at vkQueueSubmit.
+static void endFrame(Device *layer)
+{
+	// Per-frame scan budgets start over.
+	auto *scheduler = layer->getIndexScanScheduler();
+	if (scheduler && !layer->getConfig().indexBufferScanBudgetPerSubmit)
+		scheduler->nextFrame();
+
+	// Scan the indices copied back by previous submissions, so they are reported within a frame or two.
+	auto *indexReadback = layer->getIndexReadback();
+	if (indexReadback)
+		indexReadback->poll();
+
+	// Frames outside the capture window were not analyzed, so they are not counted either.
+	if (layer->getCaptureEpoch())
+	{
+		auto *reorderAdvisor = layer->getReorderAdvisor();
+		if (reorderAdvisor)
+			reorderAdvisor->nextFrame();
+
+		auto *frameStats = layer->getFrameStats();
+		if (frameStats)
+			frameStats->nextFrame();
+
+		auto *tileBandwidth = layer->getTileBandwidthEstimator();
+		if (tileBandwidth)
+			tileBandwidth->nextFrame();
+	}
+
+	layer->nextCaptureFrame();
+	layer->getInstance()->getLogger().nextFrame();
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
+{
+	lock_guard<mutex> holder{ globalLock };
+	void *key = getDispatchKey(queue);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	// Presenting ends a frame.
+	endFrame(layer);
+
+	return layer->getTable()->QueuePresentKHR(queue, pPresentInfo);
+}
+
 static VKAPI_ATTR VkResult VKAPI_CALL CreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo,
                                                   const VkAllocationCallbacks *pCallbacks, VkImage *pImage)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateImage(device, pCreateInfo, pCallbacks, pImage);
 	if (res == VK_SUCCESS)
@@ -745,7 +926,7 @@ static VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements(VkDevice device, V
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	Buffer *pBuffer = layer->get<Buffer>(buffer);
 	MPD_ASSERT(pBuffer);
@@ -757,7 +938,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMe
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->AllocateMemory(device, pAllocateInfo, pCallbacks, pMemory);
 	if (res == VK_SUCCESS)
@@ -781,11 +962,14 @@ static VKAPI_ATTR VkResult VKAPI_CALL MapMemory(VkDevice device, VkDeviceMemory
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	DeviceMemory *device_memory = layer->get<DeviceMemory>(memory);
 	MPD_ASSERT(device_memory);
 
+	// The application is about to write to the memory.
+	device_memory->signalHostWrite();
+
 	void *mappedMemory = device_memory->getMappedMemory();
 	if (mappedMemory == NULL)
 	{
@@ -800,24 +984,44 @@ static VKAPI_ATTR void VKAPI_CALL UnmapMemory(VkDevice device, VkDeviceMemory me
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	DeviceMemory *device_memory = layer->get<DeviceMemory>(memory);
 	MPD_ASSERT(device_memory);
 
+	// Scans between vkMapMemory and the application's writes might have seen the old contents.
+	device_memory->signalHostWrite();
+
 	if (device_memory->getMappedMemory() == NULL)
 	{
 		layer->getTable()->UnmapMemory(device, memory);
 	}
 }
 
+static VKAPI_ATTR VkResult VKAPI_CALL FlushMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount,
+                                                              const VkMappedMemoryRange *pMemoryRanges)
+{
+	lock_guard<mutex> holder{ globalLock };
+	void *key = getDispatchKey(device);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	for (uint32_t i = 0; i < memoryRangeCount; i++)
+	{
+		DeviceMemory *device_memory = layer->get<DeviceMemory>(pMemoryRanges[i].memory);
+		MPD_ASSERT(device_memory);
+		device_memory->signalHostWrite();
+	}
+
+	return layer->getTable()->FlushMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges);
+}
+
 static VKAPI_ATTR VkResult VKAPI_CALL CreateRenderPass(VkDevice device, const VkRenderPassCreateInfo *pCreateInfo,
                                                        const VkAllocationCallbacks *pAllocator,
                                                        VkRenderPass *pRenderPass)
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateRenderPass(device, pCreateInfo, pAllocator, pRenderPass);
 	if (res == VK_SUCCESS)
@@ -927,7 +1131,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, V
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	const auto &cfg = layer->getConfig();
 	if (cfg.msgNoPipelineCache && pipelineCache == VK_NULL_HANDLE)
@@ -976,7 +1180,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateComputePipelines(VkDevice device, Vk
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	const auto &cfg = layer->getConfig();
 	if (cfg.msgNoPipelineCache && pipelineCache == VK_NULL_HANDLE)
@@ -1022,7 +1226,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyPipeline(VkDevice device, VkPipeline pi
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 	layer->destroy<Pipeline>(pipeline);
 	layer->getTable()->DestroyPipeline(device, pipeline, pAllocator);
 }
@@ -1032,7 +1236,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyRenderPass(VkDevice device, VkRenderPas
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<RenderPass>(renderPass);
 	layer->getTable()->DestroyRenderPass(device, renderPass, pAllocator);
@@ -1044,7 +1248,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateFramebuffer(VkDevice device, const V
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateFramebuffer(device, pCreateInfo, pAllocator, pFramebuffer);
 	if (res == VK_SUCCESS)
@@ -1066,7 +1270,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyFramebuffer(VkDevice device, VkFramebuf
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<Framebuffer>(framebuffer);
 	layer->getTable()->DestroyFramebuffer(device, framebuffer, pAllocator);
@@ -1077,7 +1281,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateImageView(VkDevice device, const VkI
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateImageView(device, pCreateInfo, pAllocator, pImageView);
 	if (res == VK_SUCCESS)
@@ -1099,7 +1303,8 @@ static VKAPI_ATTR void VKAPI_CALL DestroyImageView(VkDevice device, VkImageView
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 
 	layer->destroy<ImageView>(imageView);
 	layer->getTable()->DestroyImageView(device, imageView, pAllocator);
@@ -1110,7 +1315,12 @@ static VKAPI_ATTR void VKAPI_CALL FreeMemory(VkDevice device, VkDeviceMemory mem
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	auto *indexReadback = layer->getIndexReadback();
+	auto *pMemory = layer->get<DeviceMemory>(memory);
+	if (indexReadback && pMemory)
+		indexReadback->waitForMemory(pMemory);
 
 	layer->destroy<DeviceMemory>(memory);
 	layer->getTable()->FreeMemory(device, memory, pCallbacks);
@@ -1120,7 +1330,8 @@ static VKAPI_ATTR void VKAPI_CALL DestroyImage(VkDevice device, VkImage image, c
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->waitForAnalysis();
 
 	layer->destroy<Image>(image);
 	layer->getTable()->DestroyImage(device, image, pCallbacks);
@@ -1131,26 +1342,26 @@ static VKAPI_ATTR void VKAPI_CALL CmdResolveImage(VkCommandBuffer commandBuffer,
                                                   VkImageLayout dstImageLayout, uint32_t regionCount,
                                                   const VkImageResolve *pRegions)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
-	auto *cmd = layer->get<CommandBuffer>(commandBuffer);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	cmd->enqueueDeferredFunction([=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	auto *cmd = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmd)
+	{
+		layer->getTable()->CmdResolveImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+		                                   regionCount, pRegions);
+		return;
+	}
+
+	cmd->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	auto *src = layer->get<Image>(srcImage);
 	auto *dst = layer->get<Image>(dstImage);
 
 	for (uint32_t i = 0; i < regionCount; i++)
 	{
-		// Capture-by-value is vital.
-		auto srcRegion = pRegions[i].srcSubresource;
-		auto dstRegion = pRegions[i].dstSubresource;
-
-		cmd->enqueueDeferredFunction([=](Queue &) {
-			src->signalUsage(srcRegion, Image::Usage::ResourceRead);
-			dst->signalUsage(dstRegion, Image::Usage::ResourceWrite);
-		});
+		cmd->enqueueImageUsage(src, pRegions[i].srcSubresource, Image::Usage::ResourceRead);
+		cmd->enqueueImageUsage(dst, pRegions[i].dstSubresource, Image::Usage::ResourceWrite);
 	}
 
 	const auto &cfg = layer->getConfig();
@@ -1176,7 +1387,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreatePipelineLayout(VkDevice device,
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	VkResult result = layer->getTable()->CreatePipelineLayout(device, pCreateInfo, pAllocator, pLayout);
 	if (result == VK_SUCCESS)
@@ -1199,7 +1410,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyPipelineLayout(VkDevice device, VkPipel
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<PipelineLayout>(layout);
 	layer->getTable()->DestroyPipelineLayout(device, layout, pAllocator);
@@ -1213,7 +1424,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorSetLayout(VkDevice device,
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	VkResult result = layer->getTable()->CreateDescriptorSetLayout(device, pCreateInfo, pAllocator, pSetLayout);
 	if (result == VK_SUCCESS)
@@ -1236,7 +1447,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyDescriptorSetLayout(VkDevice device, Vk
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<DescriptorSetLayout>(layout);
 	layer->getTable()->DestroyDescriptorSetLayout(device, layout, pCallbacks);
@@ -1249,7 +1460,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateDescriptorPool(VkDevice device,
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	VkResult result = layer->getTable()->CreateDescriptorPool(device, pCreateInfo, pAllocator, pDescriptorPool);
 	if (result == VK_SUCCESS)
@@ -1272,7 +1483,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyDescriptorPool(VkDevice device, VkDescr
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<DescriptorPool>(descriptorPool);
 	layer->getTable()->DestroyDescriptorPool(device, descriptorPool, pAllocator);
@@ -1283,7 +1494,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL ResetDescriptorPool(VkDevice device, VkDes
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 	auto *pool = layer->get<DescriptorPool>(descriptorPool);
 	pool->reset();
 
@@ -1296,7 +1507,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL AllocateDescriptorSets(VkDevice device,
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto *pool = layer->get<DescriptorPool>(pAllocateInfo->descriptorPool);
 
@@ -1330,7 +1541,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL FreeDescriptorSets(VkDevice device, VkDesc
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	for (unsigned i = 0; i < descriptorSetCount; ++i)
 	{
@@ -1361,10 +1572,17 @@ CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCre
 static VKAPI_ATTR void VKAPI_CALL DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback,
                                                                 const VkAllocationCallbacks *pAllocator)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(instance);
-	auto *layer = getLayerData(key, instanceData);
+	Instance *layer;
+	{
+		lock_guard<mutex> holder{ globalLock };
+		layer = getLayerData(key, instanceData);
+	}
+
+	// Queued messages are delivered to the callback first, which may call back into the layer.
 	layer->getLogger().unregisterAndDestroyCallback(callback);
+
+	lock_guard<mutex> holder{ globalLock };
 	// Presumably the idea here is that we terminate at the loader in the end.
 	layer->getTable()->DestroyDebugReportCallbackEXT(instance, callback, pAllocator);
 }
@@ -1382,69 +1600,39 @@ static VKAPI_ATTR void VKAPI_CALL DebugReportMessageEXT(VkInstance instance, VkD
 	layer->getTable()->DebugReportMessageEXT(instance, flags, objType, object, location, msgCode, pLayerPrefix, pMsg);
 }
 
-static PFN_vkVoidFunction interceptCoreInstanceCommand(const char *pName)
-{
-	static const struct
-	{
-		const char *name;
-		PFN_vkVoidFunction proc;
-	} coreInstanceCommands[] = {
-		{ "vkCreateInstance", reinterpret_cast<PFN_vkVoidFunction>(CreateInstance) },
-		{ "vkDestroyInstance", reinterpret_cast<PFN_vkVoidFunction>(DestroyInstance) },
-		{ "vkGetInstanceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(vkGetInstanceProcAddr) },
-		{ "vkCreateDevice", reinterpret_cast<PFN_vkVoidFunction>(CreateDevice) },
-	};
-
-	for (auto &cmd : coreInstanceCommands)
-		if (strcmp(cmd.name, pName) == 0)
-			return cmd.proc;
-	return nullptr;
-}
-
-static PFN_vkVoidFunction interceptExtensionInstanceCommand(const char *pName)
-{
-	static const struct
-	{
-		const char *name;
-		PFN_vkVoidFunction proc;
-	} coreInstanceCommands[] = {
-		{ "vkCreateDebugReportCallbackEXT", reinterpret_cast<PFN_vkVoidFunction>(CreateDebugReportCallbackEXT) },
-		{ "vkDestroyDebugReportCallbackEXT", reinterpret_cast<PFN_vkVoidFunction>(DestroyDebugReportCallbackEXT) },
-		{ "vkDebugReportMessageEXT", reinterpret_cast<PFN_vkVoidFunction>(DebugReportMessageEXT) },
-	};
-
-	for (auto &cmd : coreInstanceCommands)
-		if (strcmp(cmd.name, pName) == 0)
-			return cmd.proc;
-	return nullptr;
-}
-
 static VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator)
 {
 	lock_guard<mutex> holder{ globalLock };
 
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+	layer->releaseIndexReadback();
 	layer->getTable()->DestroyDevice(device, pAllocator);
+	deviceLookup.remove(key);
 	destroyLayerData(key, deviceData);
 }
 
 static VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
                                                      const VkCommandBuffer *pCommandBuffers)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+		return;
+	}
 
 	for (uint32_t i = 0; i < commandBufferCount; i++)
 	{
 		CommandBuffer *cb = layer->get<CommandBuffer>(pCommandBuffers[i]);
 		MPD_ASSERT(cb);
-		cmdBuffer->executeCommandBuffer(cb);
+
+		// Secondary command buffers recorded before the capture window opened were not tracked.
+		if (cb->getCaptureEpoch() == cmdBuffer->getCaptureEpoch())
+			cmdBuffer->executeCommandBuffer(cb);
 	}
 
 	layer->getTable()->CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
@@ -1453,13 +1641,15 @@ static VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(VkCommandBuffer commandBuff
 static VKAPI_ATTR void VKAPI_CALL CmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer,
                                                      VkDeviceSize offset, VkIndexType indexType)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+		return;
+	}
 
 	Buffer *index_buffer = layer->get<Buffer>(buffer);
 	MPD_ASSERT(index_buffer);
@@ -1471,213 +1661,45 @@ static VKAPI_ATTR void VKAPI_CALL CmdBindIndexBuffer(VkCommandBuffer commandBuff
 static VKAPI_ATTR void VKAPI_CALL CmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint,
                                                   VkPipeline pipeline)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+		return;
+	}
 
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::PIPELINE_BINDS);
+
+	scope.pause();
 	layer->getTable()->CmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+	scope.resume();
 	cmdBuffer->bindPipeline(pipelineBindPoint, pipeline);
 }
 
-uint32_t getBPP(VkFormat format)
-{
-	switch (format)
-	{
-	case VK_FORMAT_R4G4_UNORM_PACK8:
-	case VK_FORMAT_R8_UNORM:
-	case VK_FORMAT_R8_SNORM:
-	case VK_FORMAT_R8_USCALED:
-	case VK_FORMAT_R8_SSCALED:
-	case VK_FORMAT_R8_UINT:
-	case VK_FORMAT_R8_SINT:
-	case VK_FORMAT_R8_SRGB:
-		return 8;
-	case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
-	case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
-	case VK_FORMAT_R5G6B5_UNORM_PACK16:
-	case VK_FORMAT_B5G6R5_UNORM_PACK16:
-	case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
-	case VK_FORMAT_B5G5R5A1_UNORM_PACK16:
-	case VK_FORMAT_A1R5G5B5_UNORM_PACK16:
-	case VK_FORMAT_R8G8_UNORM:
-	case VK_FORMAT_R8G8_SNORM:
-	case VK_FORMAT_R8G8_USCALED:
-	case VK_FORMAT_R8G8_SSCALED:
-	case VK_FORMAT_R8G8_UINT:
-	case VK_FORMAT_R8G8_SINT:
-	case VK_FORMAT_R8G8_SRGB:
-	case VK_FORMAT_R16_UNORM:
-	case VK_FORMAT_R16_SNORM:
-	case VK_FORMAT_R16_USCALED:
-	case VK_FORMAT_R16_SSCALED:
-	case VK_FORMAT_R16_UINT:
-	case VK_FORMAT_R16_SINT:
-	case VK_FORMAT_R16_SFLOAT:
-	case VK_FORMAT_D16_UNORM:
-		return 16;
-	case VK_FORMAT_R8G8B8_UNORM:
-	case VK_FORMAT_R8G8B8_SNORM:
-	case VK_FORMAT_R8G8B8_USCALED:
-	case VK_FORMAT_R8G8B8_SSCALED:
-	case VK_FORMAT_R8G8B8_UINT:
-	case VK_FORMAT_R8G8B8_SINT:
-	case VK_FORMAT_R8G8B8_SRGB:
-	case VK_FORMAT_B8G8R8_UNORM:
-	case VK_FORMAT_B8G8R8_SNORM:
-	case VK_FORMAT_B8G8R8_USCALED:
-	case VK_FORMAT_B8G8R8_SSCALED:
-	case VK_FORMAT_B8G8R8_UINT:
-	case VK_FORMAT_B8G8R8_SINT:
-	case VK_FORMAT_B8G8R8_SRGB:
-		return 24;
-	case VK_FORMAT_R8G8B8A8_UNORM:
-	case VK_FORMAT_R8G8B8A8_SNORM:
-	case VK_FORMAT_R8G8B8A8_USCALED:
-	case VK_FORMAT_R8G8B8A8_SSCALED:
-	case VK_FORMAT_R8G8B8A8_UINT:
-	case VK_FORMAT_R8G8B8A8_SINT:
-	case VK_FORMAT_R8G8B8A8_SRGB:
-	case VK_FORMAT_B8G8R8A8_UNORM:
-	case VK_FORMAT_B8G8R8A8_SNORM:
-	case VK_FORMAT_B8G8R8A8_USCALED:
-	case VK_FORMAT_B8G8R8A8_SSCALED:
-	case VK_FORMAT_B8G8R8A8_UINT:
-	case VK_FORMAT_B8G8R8A8_SINT:
-	case VK_FORMAT_B8G8R8A8_SRGB:
-	case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
-	case VK_FORMAT_A8B8G8R8_SNORM_PACK32:
-	case VK_FORMAT_A8B8G8R8_USCALED_PACK32:
-	case VK_FORMAT_A8B8G8R8_SSCALED_PACK32:
-	case VK_FORMAT_A8B8G8R8_UINT_PACK32:
-	case VK_FORMAT_A8B8G8R8_SINT_PACK32:
-	case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
-	case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
-	case VK_FORMAT_A2R10G10B10_SNORM_PACK32:
-	case VK_FORMAT_A2R10G10B10_USCALED_PACK32:
-	case VK_FORMAT_A2R10G10B10_SSCALED_PACK32:
-	case VK_FORMAT_A2R10G10B10_UINT_PACK32:
-	case VK_FORMAT_A2R10G10B10_SINT_PACK32:
-	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
-	case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
-	case VK_FORMAT_A2B10G10R10_USCALED_PACK32:
-	case VK_FORMAT_A2B10G10R10_SSCALED_PACK32:
-	case VK_FORMAT_A2B10G10R10_UINT_PACK32:
-	case VK_FORMAT_A2B10G10R10_SINT_PACK32:
-	case VK_FORMAT_R16G16_UNORM:
-	case VK_FORMAT_R16G16_SNORM:
-	case VK_FORMAT_R16G16_USCALED:
-	case VK_FORMAT_R16G16_SSCALED:
-	case VK_FORMAT_R16G16_UINT:
-	case VK_FORMAT_R16G16_SINT:
-	case VK_FORMAT_R16G16_SFLOAT:
-	case VK_FORMAT_R32_UINT:
-	case VK_FORMAT_R32_SINT:
-	case VK_FORMAT_R32_SFLOAT:
-	case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
-	case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
-	case VK_FORMAT_X8_D24_UNORM_PACK32:
-	case VK_FORMAT_D32_SFLOAT:
-		return 32;
-	case VK_FORMAT_R16G16B16_UNORM:
-	case VK_FORMAT_R16G16B16_SNORM:
-	case VK_FORMAT_R16G16B16_USCALED:
-	case VK_FORMAT_R16G16B16_SSCALED:
-	case VK_FORMAT_R16G16B16_UINT:
-	case VK_FORMAT_R16G16B16_SINT:
-	case VK_FORMAT_R16G16B16_SFLOAT:
-		return 48;
-	case VK_FORMAT_R16G16B16A16_UNORM:
-	case VK_FORMAT_R16G16B16A16_SNORM:
-	case VK_FORMAT_R16G16B16A16_USCALED:
-	case VK_FORMAT_R16G16B16A16_SSCALED:
-	case VK_FORMAT_R16G16B16A16_UINT:
-	case VK_FORMAT_R16G16B16A16_SINT:
-	case VK_FORMAT_R16G16B16A16_SFLOAT:
-	case VK_FORMAT_R32G32_UINT:
-	case VK_FORMAT_R32G32_SINT:
-	case VK_FORMAT_R32G32_SFLOAT:
-	case VK_FORMAT_R64_UINT:
-	case VK_FORMAT_R64_SINT:
-	case VK_FORMAT_R64_SFLOAT:
-		return 64;
-	case VK_FORMAT_R32G32B32_UINT:
-	case VK_FORMAT_R32G32B32_SINT:
-	case VK_FORMAT_R32G32B32_SFLOAT:
-		return 96;
-	case VK_FORMAT_R32G32B32A32_UINT:
-	case VK_FORMAT_R32G32B32A32_SINT:
-	case VK_FORMAT_R32G32B32A32_SFLOAT:
-	case VK_FORMAT_R64G64_UINT:
-	case VK_FORMAT_R64G64_SINT:
-	case VK_FORMAT_R64G64_SFLOAT:
-		return 128;
-	case VK_FORMAT_R64G64B64_UINT:
-	case VK_FORMAT_R64G64B64_SINT:
-	case VK_FORMAT_R64G64B64_SFLOAT:
-		return 192;
-	case VK_FORMAT_R64G64B64A64_UINT:
-	case VK_FORMAT_R64G64B64A64_SINT:
-	case VK_FORMAT_R64G64B64A64_SFLOAT:
-		return 256;
-	//special cases...
-	case VK_FORMAT_S8_UINT:
-	case VK_FORMAT_D16_UNORM_S8_UINT:
-	case VK_FORMAT_D24_UNORM_S8_UINT:
-	case VK_FORMAT_D32_SFLOAT_S8_UINT:
-	default:
-		return -1;
-	}
-}
-
-uint32_t getNumSamples(VkSampleCountFlagBits samples)
-{
-	if (samples & VK_SAMPLE_COUNT_64_BIT)
-	{
-		return 64;
-	}
-	if (samples & VK_SAMPLE_COUNT_32_BIT)
-	{
-		return 32;
-	}
-	if (samples & VK_SAMPLE_COUNT_16_BIT)
-	{
-		return 16;
-	}
-	if (samples & VK_SAMPLE_COUNT_8_BIT)
-	{
-		return 8;
-	}
-	if (samples & VK_SAMPLE_COUNT_4_BIT)
-	{
-		return 4;
-	}
-	if (samples & VK_SAMPLE_COUNT_2_BIT)
-	{
-		return 2;
-	}
-
-	return 1;
-}
-
 static VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer,
                                                      const VkRenderPassBeginInfo *pRenderPassBegin,
                                                      VkSubpassContents contents)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+		return;
+	}
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::RENDER_PASSES);
 
 	VkFramebuffer lastFB = cmdBuffer->getLastFramebuffer();
 
+	scope.pause();
 	layer->getTable()->CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+	scope.resume();
 	cmdBuffer->beginRenderPass(pRenderPassBegin, contents);
 
 	VkFramebuffer currFB = cmdBuffer->getLastFramebuffer();
@@ -1755,13 +1777,15 @@ static VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuff
 
 static VKAPI_ATTR void VKAPI_CALL CmdNextSubpass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdNextSubpass(commandBuffer, contents);
+		return;
+	}
 
 	layer->getTable()->CmdNextSubpass(commandBuffer, contents);
 	cmdBuffer->nextSubpass(contents);
@@ -1769,13 +1793,15 @@ static VKAPI_ATTR void VKAPI_CALL CmdNextSubpass(VkCommandBuffer commandBuffer,
 
 static VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(VkCommandBuffer commandBuffer)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdEndRenderPass(commandBuffer);
+		return;
+	}
 
 	layer->getTable()->CmdEndRenderPass(commandBuffer);
 	cmdBuffer->endRenderPass();
@@ -1784,15 +1810,18 @@ static VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(VkCommandBuffer commandBuffer
 static VKAPI_ATTR void VKAPI_CALL CmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer,
                                                 uint32_t regionCount, const VkBufferCopy *pRegions)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+		return;
+	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueueBufferWrite(layer->get<Buffer>(dstBuffer));
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
 }
@@ -1802,30 +1831,27 @@ static VKAPI_ATTR void VKAPI_CALL CmdCopyImage(VkCommandBuffer commandBuffer, Vk
                                                VkImageLayout dstImageLayout, uint32_t regionCount,
                                                const VkImageCopy *pRegions)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdCopyImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount,
+		                                pRegions);
+		return;
+	}
 
 	auto *src = layer->get<Image>(srcImage);
 	auto *dst = layer->get<Image>(dstImage);
 
 	for (uint32_t i = 0; i < regionCount; i++)
 	{
-		// Capture-by-value is vital.
-		auto srcRegion = pRegions[i].srcSubresource;
-		auto dstRegion = pRegions[i].dstSubresource;
-
-		cmdBuffer->enqueueDeferredFunction([=](Queue &) {
-			src->signalUsage(srcRegion, Image::Usage::ResourceRead);
-			dst->signalUsage(dstRegion, Image::Usage::ResourceWrite);
-		});
+		cmdBuffer->enqueueImageUsage(src, pRegions[i].srcSubresource, Image::Usage::ResourceRead);
+		cmdBuffer->enqueueImageUsage(dst, pRegions[i].dstSubresource, Image::Usage::ResourceWrite);
 	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdCopyImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount,
 	                                pRegions);
@@ -1835,25 +1861,25 @@ static VKAPI_ATTR void VKAPI_CALL CmdCopyBufferToImage(VkCommandBuffer commandBu
                                                        VkImage dstImage, VkImageLayout dstImageLayout,
                                                        uint32_t regionCount, const VkBufferImageCopy *pRegions)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount,
+		                                        pRegions);
+		return;
+	}
 
 	auto *dst = layer->get<Image>(dstImage);
 
 	for (uint32_t i = 0; i < regionCount; i++)
 	{
-		// Capture-by-value is vital.
-		auto dstRegion = pRegions[i].imageSubresource;
-
-		cmdBuffer->enqueueDeferredFunction([=](Queue &) { dst->signalUsage(dstRegion, Image::Usage::ResourceWrite); });
+		cmdBuffer->enqueueImageUsage(dst, pRegions[i].imageSubresource, Image::Usage::ResourceWrite);
 	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
 }
@@ -1862,25 +1888,26 @@ static VKAPI_ATTR void VKAPI_CALL CmdCopyImageToBuffer(VkCommandBuffer commandBu
                                                        VkImageLayout srcImageLayout, VkBuffer dstBuffer,
                                                        uint32_t regionCount, const VkBufferImageCopy *pRegions)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount,
+		                                        pRegions);
+		return;
+	}
 
 	auto *src = layer->get<Image>(srcImage);
 
 	for (uint32_t i = 0; i < regionCount; i++)
 	{
-		// Capture-by-value is vital.
-		auto dstRegion = pRegions[i].imageSubresource;
-
-		cmdBuffer->enqueueDeferredFunction([=](Queue &) { src->signalUsage(dstRegion, Image::Usage::ResourceRead); });
+		cmdBuffer->enqueueImageUsage(src, pRegions[i].imageSubresource, Image::Usage::ResourceRead);
 	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueueBufferWrite(layer->get<Buffer>(dstBuffer));
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount, pRegions);
 }
@@ -1890,30 +1917,27 @@ static VKAPI_ATTR void VKAPI_CALL CmdBlitImage(VkCommandBuffer commandBuffer, Vk
                                                VkImageLayout dstImageLayout, uint32_t regionCount,
                                                const VkImageBlit *pRegions, VkFilter filter)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount,
+		                                pRegions, filter);
+		return;
+	}
 
 	auto *src = layer->get<Image>(srcImage);
 	auto *dst = layer->get<Image>(dstImage);
 
 	for (uint32_t i = 0; i < regionCount; i++)
 	{
-		// Capture-by-value is vital.
-		auto srcRegion = pRegions[i].srcSubresource;
-		auto dstRegion = pRegions[i].dstSubresource;
-
-		cmdBuffer->enqueueDeferredFunction([=](Queue &) {
-			src->signalUsage(srcRegion, Image::Usage::ResourceRead);
-			dst->signalUsage(dstRegion, Image::Usage::ResourceWrite);
-		});
+		cmdBuffer->enqueueImageUsage(src, pRegions[i].srcSubresource, Image::Usage::ResourceRead);
+		cmdBuffer->enqueueImageUsage(dst, pRegions[i].dstSubresource, Image::Usage::ResourceWrite);
 	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout, regionCount,
 	                                pRegions, filter);
@@ -1922,15 +1946,18 @@ static VKAPI_ATTR void VKAPI_CALL CmdBlitImage(VkCommandBuffer commandBuffer, Vk
 static VKAPI_ATTR void VKAPI_CALL CmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer,
                                                 VkDeviceSize dstOffset, VkDeviceSize size, uint32_t data)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdFillBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
+		return;
+	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueueBufferWrite(layer->get<Buffer>(dstBuffer));
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdFillBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
 }
@@ -1938,15 +1965,18 @@ static VKAPI_ATTR void VKAPI_CALL CmdFillBuffer(VkCommandBuffer commandBuffer, V
 static VKAPI_ATTR void VKAPI_CALL CmdUpdateBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer,
                                                   VkDeviceSize dstOffset, VkDeviceSize size, const void *data)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdUpdateBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
+		return;
+	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueueBufferWrite(layer->get<Buffer>(dstBuffer));
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdUpdateBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
 }
@@ -1956,15 +1986,18 @@ static VKAPI_ATTR void VKAPI_CALL CmdCopyQueryPoolResults(VkCommandBuffer comman
                                                           VkDeviceSize dstOffset, VkDeviceSize stride,
                                                           VkQueryResultFlags flags)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdCopyQueryPoolResults(commandBuffer, queryPool, firstQuery, queryCount, dstBuffer,
+		                                           dstOffset, stride, flags);
+		return;
+	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	const auto &cfg = layer->getConfig();
 
@@ -1982,12 +2015,15 @@ static VKAPI_ATTR void VKAPI_CALL CmdCopyQueryPoolResults(VkCommandBuffer comman
 static VKAPI_ATTR void VKAPI_CALL CmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool,
                                                       uint32_t firstQuery, uint32_t queryCount)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdResetQueryPool(commandBuffer, queryPool, firstQuery, queryCount);
+		return;
+	}
 
 	const auto &cfg = layer->getConfig();
 
@@ -2007,15 +2043,33 @@ static VKAPI_ATTR void VKAPI_CALL UpdateDescriptorSets(VkDevice device, uint32_t
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	// Descriptor sets are tracked even outside the capture window, they are bound by command buffers recorded in it.
+	if (!layer->getCaptureEpoch())
+	{
+		for (uint32_t i = 0; i < descriptorWriteCount; i++)
+			DescriptorSet::writeDescriptors(layer, pDescriptorWrites[i]);
+		for (uint32_t i = 0; i < descriptorCopyCount; i++)
+			DescriptorSet::copyDescriptors(layer, pDescriptorCopies[i]);
+
+		layer->getTable()->UpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites, descriptorCopyCount,
+		                                        pDescriptorCopies);
+		return;
+	}
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DESCRIPTOR_UPDATES,
+	                        descriptorWriteCount + descriptorCopyCount);
 
 	for (uint32_t i = 0; i < descriptorWriteCount; i++)
 		DescriptorSet::writeDescriptors(layer, pDescriptorWrites[i]);
 	for (uint32_t i = 0; i < descriptorCopyCount; i++)
 		DescriptorSet::copyDescriptors(layer, pDescriptorCopies[i]);
 
+	scope.pause();
 	layer->getTable()->UpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites, descriptorCopyCount,
 	                                        pDescriptorCopies);
+	scope.resume();
 
 	for (uint32_t i = 0; i < descriptorWriteCount; ++i)
 	{
@@ -2215,12 +2269,16 @@ static VKAPI_ATTR void VKAPI_CALL CmdBindDescriptorSets(VkCommandBuffer commandB
                                                         const VkDescriptorSet *pDescriptorSets,
                                                         uint32_t dynamicOffsetCount, const uint32_t *pDynamicOffsets)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount,
+		                                         pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+		return;
+	}
 
 	cmdBuffer->bindDescriptorSets(pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets,
 	                              dynamicOffsetCount, pDynamicOffsets);
@@ -2231,16 +2289,22 @@ static VKAPI_ATTR void VKAPI_CALL CmdBindDescriptorSets(VkCommandBuffer commandB
 
 static VKAPI_ATTR void VKAPI_CALL CmdDispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdDispatch(commandBuffer, x, y, z);
+		return;
+	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_COMPUTE); });
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DISPATCHES);
+
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_COMPUTE);
+	scope.pause();
 	layer->getTable()->CmdDispatch(commandBuffer, x, y, z);
+	scope.resume();
 	cmdBuffer->enqueueComputeDescriptorSetUsage();
 
 	const auto &cfg = layer->getConfig();
@@ -2256,16 +2320,22 @@ static VKAPI_ATTR void VKAPI_CALL CmdDispatch(VkCommandBuffer commandBuffer, uin
 static VKAPI_ATTR void VKAPI_CALL CmdDispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer,
                                                       VkDeviceSize offset)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdDispatchIndirect(commandBuffer, buffer, offset);
+		return;
+	}
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DISPATCHES);
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_COMPUTE); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_COMPUTE);
+	scope.pause();
 	layer->getTable()->CmdDispatchIndirect(commandBuffer, buffer, offset);
+	scope.resume();
 	cmdBuffer->enqueueComputeDescriptorSetUsage();
 }
 
@@ -2273,24 +2343,24 @@ static VKAPI_ATTR void VKAPI_CALL CmdClearColorImage(VkCommandBuffer commandBuff
                                                      VkImageLayout imageLayout, const VkClearColorValue *pColor,
                                                      uint32_t rangeCount, const VkImageSubresourceRange *pRanges)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdClearColorImage(commandBuffer, image, imageLayout, pColor, rangeCount, pRanges);
+		return;
+	}
 
 	auto *dst = layer->get<Image>(image);
 	MPD_ASSERT(dst);
 	for (uint32_t i = 0; i < rangeCount; i++)
 	{
-		// Copy-by-value is important.
-		auto dstRange = pRanges[i];
-		cmdBuffer->enqueueDeferredFunction([=](Queue &) { dst->signalUsage(dstRange, Image::Usage::Cleared); });
+		cmdBuffer->enqueueImageUsage(dst, pRanges[i], Image::Usage::Cleared);
 	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdClearColorImage(commandBuffer, image, imageLayout, pColor, rangeCount, pRanges);
 }
@@ -2300,24 +2370,25 @@ static VKAPI_ATTR void VKAPI_CALL CmdClearDepthStencilImage(VkCommandBuffer comm
                                                             const VkClearDepthStencilValue *pDepthStencil,
                                                             uint32_t rangeCount, const VkImageSubresourceRange *pRanges)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdClearDepthStencilImage(commandBuffer, image, imageLayout, pDepthStencil, rangeCount,
+		                                             pRanges);
+		return;
+	}
 
 	auto *dst = layer->get<Image>(image);
 	MPD_ASSERT(dst);
 	for (uint32_t i = 0; i < rangeCount; i++)
 	{
-		// Copy-by-value is important.
-		auto dstRange = pRanges[i];
-		cmdBuffer->enqueueDeferredFunction([=](Queue &) { dst->signalUsage(dstRange, Image::Usage::Cleared); });
+		cmdBuffer->enqueueImageUsage(dst, pRanges[i], Image::Usage::Cleared);
 	}
 
-	cmdBuffer->enqueueDeferredFunction(
-	    [=](Queue &queue) { queue.getQueueTracker().pushWork(QueueTracker::STAGE_TRANSFER); });
+	cmdBuffer->enqueuePushWork(QueueTracker::STAGE_TRANSFER);
 
 	layer->getTable()->CmdClearDepthStencilImage(commandBuffer, image, imageLayout, pDepthStencil, rangeCount, pRanges);
 }
@@ -2326,12 +2397,15 @@ static VKAPI_ATTR void VKAPI_CALL CmdClearAttachments(VkCommandBuffer commandBuf
                                                       const VkClearAttachment *pAttachments, uint32_t rectCount,
                                                       const VkClearRect *pRects)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdClearAttachments(commandBuffer, attachmentCount, pAttachments, rectCount, pRects);
+		return;
+	}
 
 	Framebuffer *fb = layer->get<Framebuffer>(cmdBuffer->getLastFramebuffer());
 
@@ -2364,34 +2438,49 @@ static VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier(
     uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier *pBufferMemoryBarriers,
     uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	auto *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	auto *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+		                                      memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
+		                                      pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+		return;
+	}
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::BARRIERS);
 
 	cmdBuffer->pipelineBarrier(srcStageMask, dstStageMask, dependencyFlags, memoryBarrierCount, pMemoryBarriers,
 	                           bufferMemoryBarrierCount, pBufferMemoryBarriers, imageMemoryBarrierCount,
 	                           pImageMemoryBarriers);
 
+	scope.pause();
 	layer->getTable()->CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
 	                                      memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
 	                                      pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+	scope.resume();
 }
 
 static VKAPI_ATTR void VKAPI_CALL CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount,
                                           uint32_t firstVertex, uint32_t firstInstance)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		return;
+	}
 
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DRAWS);
+
+	scope.pause();
 	layer->getTable()->CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	scope.resume();
 	cmdBuffer->draw(vertexCount, instanceCount, firstVertex, firstInstance);
 	cmdBuffer->enqueueGraphicsDescriptorSetUsage();
 
@@ -2407,15 +2496,22 @@ static VKAPI_ATTR void VKAPI_CALL CmdDraw(VkCommandBuffer commandBuffer, uint32_
 static VKAPI_ATTR void VKAPI_CALL CmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
                                                   uint32_t drawCount, uint32_t stride)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+		return;
+	}
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DRAWS, drawCount);
 
+	scope.pause();
 	layer->getTable()->CmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+	scope.resume();
+	cmdBuffer->drawIndirect(layer->get<Buffer>(buffer), offset, drawCount, stride, false);
 	cmdBuffer->enqueueGraphicsDescriptorSetUsage();
 }
 
@@ -2423,16 +2519,23 @@ static VKAPI_ATTR void VKAPI_CALL CmdDrawIndexed(VkCommandBuffer commandBuffer,
                                                  uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
                                                  uint32_t firstInstance)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset,
+		                                  firstInstance);
+		return;
+	}
 
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DRAWS);
+
+	scope.pause();
 	layer->getTable()->CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset,
 	                                  firstInstance);
+	scope.resume();
 	cmdBuffer->drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 	cmdBuffer->enqueueGraphicsDescriptorSetUsage();
 }
@@ -2440,15 +2543,22 @@ static VKAPI_ATTR void VKAPI_CALL CmdDrawIndexed(VkCommandBuffer commandBuffer,
 static VKAPI_ATTR void VKAPI_CALL CmdDrawIndexedIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer,
                                                          VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
 {
-	lock_guard<mutex> holder{ globalLock };
-
 	void *key = getDispatchKey(commandBuffer);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
-	CommandBuffer *cmdBuffer = layer->get<CommandBuffer>(commandBuffer);
-	MPD_ASSERT(cmdBuffer);
+	CommandBuffer *cmdBuffer = getCapturedCommandBuffer(layer, commandBuffer);
+	if (!cmdBuffer)
+	{
+		layer->getTable()->CmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+		return;
+	}
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::DRAWS, drawCount);
 
+	scope.pause();
 	layer->getTable()->CmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+	scope.resume();
+	cmdBuffer->drawIndirect(layer->get<Buffer>(buffer), offset, drawCount, stride, true);
 	cmdBuffer->enqueueGraphicsDescriptorSetUsage();
 }
 
@@ -2457,7 +2567,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateSampler(VkDevice device, const VkSam
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateSampler(device, pCreateInfo, pCallbacks, pSampler);
 	if (res == VK_SUCCESS)
@@ -2479,7 +2589,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroySampler(VkDevice device, VkSampler samp
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<Sampler>(sampler);
 	layer->getTable()->DestroySampler(device, sampler, pCallbacks);
@@ -2491,7 +2601,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL CreateShaderModule(VkDevice device, const
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	auto res = layer->getTable()->CreateShaderModule(device, pCreateInfo, pCallbacks, pShaderModule);
 	if (res == VK_SUCCESS)
@@ -2513,7 +2623,7 @@ static VKAPI_ATTR void VKAPI_CALL DestroyShaderModule(VkDevice device, VkShaderM
 {
 	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(device);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
 
 	layer->destroy<ShaderModule>(shaderModule);
 	layer->getTable()->DestroyShaderModule(device, shaderModule, pCallbacks);
@@ -2522,12 +2632,41 @@ static VKAPI_ATTR void VKAPI_CALL DestroyShaderModule(VkDevice device, VkShaderM
 static VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits,
                                                   VkFence fence)
 {
-	lock_guard<mutex> holder{ globalLock };
 	void *key = getDispatchKey(queue);
-	auto *layer = getLayerData(key, deviceData);
+	auto *layer = getLayerData(key, deviceLookup);
+
+	// Outside the capture window, none of the command buffers were recorded for analysis,
+	// so there is nothing to lock for either.
+	uint32_t epoch = layer->getCaptureEpoch();
+	if (!epoch)
+	{
+		auto res = layer->getTable()->QueueSubmit(queue, submitCount, pSubmits, fence);
+		if (layer->getConfig().frameBoundaryPerSubmit)
+		{
+			lock_guard<mutex> holder{ globalLock };
+			endFrame(layer);
+		}
+		return res;
+	}
+
+	lock_guard<mutex> holder{ globalLock };
+
+	FrameStats::Scope scope(layer->getFrameStats(), FrameStats::SUBMITS, submitCount);
 	auto *pQueue = layer->get<Queue>(queue);
 	MPD_ASSERT(pQueue);
 
+	auto *scheduler = layer->getIndexScanScheduler();
+	if (scheduler && layer->getConfig().indexBufferScanBudgetPerSubmit)
+		scheduler->nextFrame();
+
+	auto *indexReadback = layer->getIndexReadback();
+	if (indexReadback)
+		indexReadback->poll();
+
+	// With asynchronous analysis, only capture what the checks need here and let the worker run them.
+	auto *worker = layer->getAnalysisWorker();
+	AnalysisJob *job = worker ? &worker->beginJob(*pQueue) : nullptr;
+
 	for (uint32_t submit = 0; submit < submitCount; submit++)
 	{
 		MPD_ASSERT(pSubmits != nullptr);
@@ -2536,164 +2675,222 @@ static VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submit
 		{
 			CommandBuffer *commandBuffer = layer->get<CommandBuffer>(submissions.pCommandBuffers[i]);
 			MPD_ASSERT(commandBuffer != nullptr);
+			if (commandBuffer->getCaptureEpoch() != epoch)
+				continue;
 
-			commandBuffer->callDeferredFunctions(*pQueue);
+			if (job)
+				commandBuffer->snapshotDeferredCommands(*job);
+			else
+				commandBuffer->replayDeferredCommands(*pQueue);
 		}
 	}
 
-	return layer->getTable()->QueueSubmit(queue, submitCount, pSubmits, fence);
-}
-
-static PFN_vkVoidFunction interceptCoreDeviceCommand(const char *pName)
-{
-	static const struct
+	// Only invalidate cached index scans once this submission has been looked at,
+	// its transfers execute after the indices were read.
+	for (uint32_t submit = 0; submit < submitCount; submit++)
 	{
-		const char *name;
-		PFN_vkVoidFunction proc;
-	} coreDeviceCommands[] = {
-		{ "vkGetDeviceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(vkGetDeviceProcAddr) },
-		{ "vkDestroyDevice", reinterpret_cast<PFN_vkVoidFunction>(DestroyDevice) },
-
-		{ "vkCreateCommandPool", reinterpret_cast<PFN_vkVoidFunction>(CreateCommandPool) },
-		{ "vkDestroyCommandPool", reinterpret_cast<PFN_vkVoidFunction>(DestroyCommandPool) },
-
-		{ "vkAllocateCommandBuffers", reinterpret_cast<PFN_vkVoidFunction>(AllocateCommandBuffers) },
-		{ "vkFreeCommandBuffers", reinterpret_cast<PFN_vkVoidFunction>(FreeCommandBuffers) },
-		{ "vkBeginCommandBuffer", reinterpret_cast<PFN_vkVoidFunction>(BeginCommandBuffer) },
-
-		{ "vkGetDeviceQueue", reinterpret_cast<PFN_vkVoidFunction>(GetDeviceQueue) },
-		{ "vkQueueSubmit", reinterpret_cast<PFN_vkVoidFunction>(QueueSubmit) },
-
-		{ "vkCreateBuffer", reinterpret_cast<PFN_vkVoidFunction>(CreateBuffer) },
-		{ "vkDestroyBuffer", reinterpret_cast<PFN_vkVoidFunction>(DestroyBuffer) },
-
-		{ "vkCreateImage", reinterpret_cast<PFN_vkVoidFunction>(CreateImage) },
-		{ "vkDestroyImage", reinterpret_cast<PFN_vkVoidFunction>(DestroyImage) },
-
-		{ "vkCmdExecuteCommands", reinterpret_cast<PFN_vkVoidFunction>(CmdExecuteCommands) },
-		{ "vkCmdBindIndexBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdBindIndexBuffer) },
-		{ "vkCmdDraw", reinterpret_cast<PFN_vkVoidFunction>(CmdDraw) },
-		{ "vkCmdDrawIndirect", reinterpret_cast<PFN_vkVoidFunction>(CmdDrawIndirect) },
-		{ "vkCmdDrawIndexed", reinterpret_cast<PFN_vkVoidFunction>(CmdDrawIndexed) },
-		{ "vkCmdDrawIndexedIndirect", reinterpret_cast<PFN_vkVoidFunction>(CmdDrawIndexedIndirect) },
-
-		{ "vkCmdBindPipeline", reinterpret_cast<PFN_vkVoidFunction>(CmdBindPipeline) },
-		{ "vkCmdBeginRenderPass", reinterpret_cast<PFN_vkVoidFunction>(CmdBeginRenderPass) },
-		{ "vkCmdNextSubpass", reinterpret_cast<PFN_vkVoidFunction>(CmdNextSubpass) },
-		{ "vkCmdEndRenderPass", reinterpret_cast<PFN_vkVoidFunction>(CmdEndRenderPass) },
-
-		{ "vkCmdPipelineBarrier", reinterpret_cast<PFN_vkVoidFunction>(CmdPipelineBarrier) },
-		{ "vkCmdClearColorImage", reinterpret_cast<PFN_vkVoidFunction>(CmdClearColorImage) },
-		{ "vkCmdClearDepthStencilImage", reinterpret_cast<PFN_vkVoidFunction>(CmdClearDepthStencilImage) },
-		{ "vkCmdClearAttachments", reinterpret_cast<PFN_vkVoidFunction>(CmdClearAttachments) },
-		{ "vkCmdCopyBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyBuffer) },
-		{ "vkCmdCopyImage", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyImage) },
-		{ "vkCmdCopyBufferToImage", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyBufferToImage) },
-		{ "vkCmdCopyImageToBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyImageToBuffer) },
-		{ "vkCmdBlitImage", reinterpret_cast<PFN_vkVoidFunction>(CmdBlitImage) },
-		{ "vkCmdFillBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdFillBuffer) },
-		{ "vkCmdUpdateBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdUpdateBuffer) },
-		{ "vkCmdResolveImage", reinterpret_cast<PFN_vkVoidFunction>(CmdResolveImage) },
-
-		{ "vkCmdCopyQueryPoolResults", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyQueryPoolResults) },
-		{ "vkCmdResetQueryPool", reinterpret_cast<PFN_vkVoidFunction>(CmdResetQueryPool) },
-
-		{ "vkCmdDispatch", reinterpret_cast<PFN_vkVoidFunction>(CmdDispatch) },
-		{ "vkCmdDispatchIndirect", reinterpret_cast<PFN_vkVoidFunction>(CmdDispatchIndirect) },
-
-		{ "vkCmdBindDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(CmdBindDescriptorSets) },
-		{ "vkUpdateDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(UpdateDescriptorSets) },
+		auto &submissions = pSubmits[submit];
+		for (uint32_t i = 0; i < submissions.commandBufferCount; i++)
+		{
+			CommandBuffer *commandBuffer = layer->get<CommandBuffer>(submissions.pCommandBuffers[i]);
+			if (commandBuffer->getCaptureEpoch() == epoch)
+				commandBuffer->signalBufferWrites();
+		}
+	}
 
-		{ "vkCreateEvent", reinterpret_cast<PFN_vkVoidFunction>(CreateEvent) },
-		{ "vkDestroyEvent", reinterpret_cast<PFN_vkVoidFunction>(DestroyEvent) },
-		{ "vkSetEvent", reinterpret_cast<PFN_vkVoidFunction>(SetEvent) },
-		{ "vkResetEvent", reinterpret_cast<PFN_vkVoidFunction>(ResetEvent) },
-		{ "vkCmdSetEvent", reinterpret_cast<PFN_vkVoidFunction>(CmdSetEvent) },
-		{ "vkCmdResetEvent", reinterpret_cast<PFN_vkVoidFunction>(CmdResetEvent) },
-		{ "vkCmdWaitEvents", reinterpret_cast<PFN_vkVoidFunction>(CmdWaitEvents) },
+	if (worker)
+		worker->endJob();
 
-		{ "vkCreateDescriptorSetLayout", reinterpret_cast<PFN_vkVoidFunction>(CreateDescriptorSetLayout) },
-		{ "vkDestroyDescriptorSetLayout", reinterpret_cast<PFN_vkVoidFunction>(DestroyDescriptorSetLayout) },
-		{ "vkCreatePipelineLayout", reinterpret_cast<PFN_vkVoidFunction>(CreatePipelineLayout) },
-		{ "vkDestroyPipelineLayout", reinterpret_cast<PFN_vkVoidFunction>(DestroyPipelineLayout) },
+	scope.pause();
+	auto res = layer->getTable()->QueueSubmit(queue, submitCount, pSubmits, fence);
+	scope.resume();
 
-		{ "vkCreateDescriptorPool", reinterpret_cast<PFN_vkVoidFunction>(CreateDescriptorPool) },
-		{ "vkDestroyDescriptorPool", reinterpret_cast<PFN_vkVoidFunction>(DestroyDescriptorPool) },
-		{ "vkResetDescriptorPool", reinterpret_cast<PFN_vkVoidFunction>(ResetDescriptorPool) },
+	// Indices which are not host visible are copied back right after the drawcalls which use them.
+	if (indexReadback)
+		indexReadback->flush(*pQueue);
 
-		{ "vkAllocateDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(AllocateDescriptorSets) },
-		{ "vkFreeDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(FreeDescriptorSets) },
+	if (layer->getConfig().frameBoundaryPerSubmit)
+	{
+		scope.pause();
+		endFrame(layer);
+	}
 
-		{ "vkAllocateMemory", reinterpret_cast<PFN_vkVoidFunction>(AllocateMemory) },
-		{ "vkFreeMemory", reinterpret_cast<PFN_vkVoidFunction>(FreeMemory) },
-		{ "vkGetBufferMemoryRequirements", reinterpret_cast<PFN_vkVoidFunction>(GetBufferMemoryRequirements) },
-		{ "vkMapMemory", reinterpret_cast<PFN_vkVoidFunction>(MapMemory) },
-		{ "vkUnmapMemory", reinterpret_cast<PFN_vkVoidFunction>(UnmapMemory) },
-		{ "vkBindBufferMemory", reinterpret_cast<PFN_vkVoidFunction>(BindBufferMemory) },
-		{ "vkBindImageMemory", reinterpret_cast<PFN_vkVoidFunction>(BindImageMemory) },
+	return res;
+}
 
-		{ "vkCreateRenderPass", reinterpret_cast<PFN_vkVoidFunction>(CreateRenderPass) },
-		{ "vkDestroyRenderPass", reinterpret_cast<PFN_vkVoidFunction>(DestroyRenderPass) },
+// The groups of Device::InterceptBits. Instance commands are in none of them, so vkGetDeviceProcAddr never
+// returns them.
+enum ProcGroup : uint32_t
+{
+	INSTANCE_PROCS = 0,
+	OBJECT_PROCS = Device::INTERCEPT_OBJECTS_BIT,
+	COMMAND_BUFFER_PROCS = Device::INTERCEPT_COMMAND_BUFFERS_BIT,
+	DESCRIPTOR_UPDATE_PROCS = Device::INTERCEPT_DESCRIPTOR_UPDATES_BIT
+};
 
-		{ "vkCreateFramebuffer", reinterpret_cast<PFN_vkVoidFunction>(CreateFramebuffer) },
-		{ "vkDestroyFramebuffer", reinterpret_cast<PFN_vkVoidFunction>(DestroyFramebuffer) },
+static const ProcTable::Entry procEntries[] = {
+	{ "vkCreateInstance", reinterpret_cast<PFN_vkVoidFunction>(CreateInstance), INSTANCE_PROCS },
+	{ "vkDestroyInstance", reinterpret_cast<PFN_vkVoidFunction>(DestroyInstance), INSTANCE_PROCS },
+	{ "vkGetInstanceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(vkGetInstanceProcAddr), INSTANCE_PROCS },
+	{ "vkCreateDevice", reinterpret_cast<PFN_vkVoidFunction>(CreateDevice), INSTANCE_PROCS },
+
+	{ "vkCreateDebugReportCallbackEXT", reinterpret_cast<PFN_vkVoidFunction>(CreateDebugReportCallbackEXT),
+	  INSTANCE_PROCS },
+	{ "vkDestroyDebugReportCallbackEXT", reinterpret_cast<PFN_vkVoidFunction>(DestroyDebugReportCallbackEXT),
+	  INSTANCE_PROCS },
+	{ "vkDebugReportMessageEXT", reinterpret_cast<PFN_vkVoidFunction>(DebugReportMessageEXT), INSTANCE_PROCS },
+
+	{ "vkGetDeviceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(vkGetDeviceProcAddr), OBJECT_PROCS },
+	{ "vkDestroyDevice", reinterpret_cast<PFN_vkVoidFunction>(DestroyDevice), OBJECT_PROCS },
+
+	{ "vkCreateCommandPool", reinterpret_cast<PFN_vkVoidFunction>(CreateCommandPool), OBJECT_PROCS },
+	{ "vkDestroyCommandPool", reinterpret_cast<PFN_vkVoidFunction>(DestroyCommandPool), OBJECT_PROCS },
+
+	{ "vkAllocateCommandBuffers", reinterpret_cast<PFN_vkVoidFunction>(AllocateCommandBuffers), OBJECT_PROCS },
+	{ "vkFreeCommandBuffers", reinterpret_cast<PFN_vkVoidFunction>(FreeCommandBuffers), OBJECT_PROCS },
+
+	{ "vkGetDeviceQueue", reinterpret_cast<PFN_vkVoidFunction>(GetDeviceQueue), OBJECT_PROCS },
+
+	{ "vkCreateBuffer", reinterpret_cast<PFN_vkVoidFunction>(CreateBuffer), OBJECT_PROCS },
+	{ "vkDestroyBuffer", reinterpret_cast<PFN_vkVoidFunction>(DestroyBuffer), OBJECT_PROCS },
+
+	{ "vkCreateImage", reinterpret_cast<PFN_vkVoidFunction>(CreateImage), OBJECT_PROCS },
+	{ "vkDestroyImage", reinterpret_cast<PFN_vkVoidFunction>(DestroyImage), OBJECT_PROCS },
+
+	{ "vkCreateEvent", reinterpret_cast<PFN_vkVoidFunction>(CreateEvent), OBJECT_PROCS },
+	{ "vkDestroyEvent", reinterpret_cast<PFN_vkVoidFunction>(DestroyEvent), OBJECT_PROCS },
+	{ "vkSetEvent", reinterpret_cast<PFN_vkVoidFunction>(SetEvent), OBJECT_PROCS },
+	{ "vkResetEvent", reinterpret_cast<PFN_vkVoidFunction>(ResetEvent), OBJECT_PROCS },
+
+	{ "vkCreateDescriptorSetLayout", reinterpret_cast<PFN_vkVoidFunction>(CreateDescriptorSetLayout), OBJECT_PROCS },
+	{ "vkDestroyDescriptorSetLayout", reinterpret_cast<PFN_vkVoidFunction>(DestroyDescriptorSetLayout), OBJECT_PROCS },
+	{ "vkCreatePipelineLayout", reinterpret_cast<PFN_vkVoidFunction>(CreatePipelineLayout), OBJECT_PROCS },
+	{ "vkDestroyPipelineLayout", reinterpret_cast<PFN_vkVoidFunction>(DestroyPipelineLayout), OBJECT_PROCS },
+
+	{ "vkCreateDescriptorPool", reinterpret_cast<PFN_vkVoidFunction>(CreateDescriptorPool), OBJECT_PROCS },
+	{ "vkDestroyDescriptorPool", reinterpret_cast<PFN_vkVoidFunction>(DestroyDescriptorPool), OBJECT_PROCS },
+	{ "vkResetDescriptorPool", reinterpret_cast<PFN_vkVoidFunction>(ResetDescriptorPool), OBJECT_PROCS },
+
+	{ "vkAllocateDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(AllocateDescriptorSets), OBJECT_PROCS },
+	{ "vkFreeDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(FreeDescriptorSets), OBJECT_PROCS },
+
+	{ "vkAllocateMemory", reinterpret_cast<PFN_vkVoidFunction>(AllocateMemory), OBJECT_PROCS },
+	{ "vkFreeMemory", reinterpret_cast<PFN_vkVoidFunction>(FreeMemory), OBJECT_PROCS },
+	{ "vkGetBufferMemoryRequirements", reinterpret_cast<PFN_vkVoidFunction>(GetBufferMemoryRequirements),
+	  OBJECT_PROCS },
+	{ "vkMapMemory", reinterpret_cast<PFN_vkVoidFunction>(MapMemory), OBJECT_PROCS },
+	{ "vkUnmapMemory", reinterpret_cast<PFN_vkVoidFunction>(UnmapMemory), OBJECT_PROCS },
+	{ "vkFlushMappedMemoryRanges", reinterpret_cast<PFN_vkVoidFunction>(FlushMappedMemoryRanges), OBJECT_PROCS },
+	{ "vkBindBufferMemory", reinterpret_cast<PFN_vkVoidFunction>(BindBufferMemory), OBJECT_PROCS },
+	{ "vkBindImageMemory", reinterpret_cast<PFN_vkVoidFunction>(BindImageMemory), OBJECT_PROCS },
+
+	{ "vkCreateRenderPass", reinterpret_cast<PFN_vkVoidFunction>(CreateRenderPass), OBJECT_PROCS },
+	{ "vkDestroyRenderPass", reinterpret_cast<PFN_vkVoidFunction>(DestroyRenderPass), OBJECT_PROCS },
+
+	{ "vkCreateFramebuffer", reinterpret_cast<PFN_vkVoidFunction>(CreateFramebuffer), OBJECT_PROCS },
+	{ "vkDestroyFramebuffer", reinterpret_cast<PFN_vkVoidFunction>(DestroyFramebuffer), OBJECT_PROCS },
+
+	{ "vkCreateImageView", reinterpret_cast<PFN_vkVoidFunction>(CreateImageView), OBJECT_PROCS },
+	{ "vkDestroyImageView", reinterpret_cast<PFN_vkVoidFunction>(DestroyImageView), OBJECT_PROCS },
+
+	{ "vkCreateGraphicsPipelines", reinterpret_cast<PFN_vkVoidFunction>(CreateGraphicsPipelines), OBJECT_PROCS },
+	{ "vkCreateComputePipelines", reinterpret_cast<PFN_vkVoidFunction>(CreateComputePipelines), OBJECT_PROCS },
+	{ "vkDestroyPipeline", reinterpret_cast<PFN_vkVoidFunction>(DestroyPipeline), OBJECT_PROCS },
+
+	{ "vkCreateSampler", reinterpret_cast<PFN_vkVoidFunction>(CreateSampler), OBJECT_PROCS },
+	{ "vkDestroySampler", reinterpret_cast<PFN_vkVoidFunction>(DestroySampler), OBJECT_PROCS },
+
+	{ "vkCreateShaderModule", reinterpret_cast<PFN_vkVoidFunction>(CreateShaderModule), OBJECT_PROCS },
+	{ "vkDestroyShaderModule", reinterpret_cast<PFN_vkVoidFunction>(DestroyShaderModule), OBJECT_PROCS },
+
+	{ "vkCreateSwapchainKHR", reinterpret_cast<PFN_vkVoidFunction>(CreateSwapchainKHR), OBJECT_PROCS },
+	{ "vkDestroySwapchainKHR", reinterpret_cast<PFN_vkVoidFunction>(DestroySwapchainKHR), OBJECT_PROCS },
+	{ "vkGetSwapchainImagesKHR", reinterpret_cast<PFN_vkVoidFunction>(GetSwapchainImagesKHR), OBJECT_PROCS },
+	{ "vkQueuePresentKHR", reinterpret_cast<PFN_vkVoidFunction>(QueuePresentKHR), OBJECT_PROCS },
+
+	{ "vkBeginCommandBuffer", reinterpret_cast<PFN_vkVoidFunction>(BeginCommandBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkEndCommandBuffer", reinterpret_cast<PFN_vkVoidFunction>(EndCommandBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkResetCommandBuffer", reinterpret_cast<PFN_vkVoidFunction>(ResetCommandBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkResetCommandPool", reinterpret_cast<PFN_vkVoidFunction>(ResetCommandPool), COMMAND_BUFFER_PROCS },
+
+	{ "vkQueueSubmit", reinterpret_cast<PFN_vkVoidFunction>(QueueSubmit), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdExecuteCommands", reinterpret_cast<PFN_vkVoidFunction>(CmdExecuteCommands), COMMAND_BUFFER_PROCS },
+	{ "vkCmdBindIndexBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdBindIndexBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkCmdDraw", reinterpret_cast<PFN_vkVoidFunction>(CmdDraw), COMMAND_BUFFER_PROCS },
+	{ "vkCmdDrawIndirect", reinterpret_cast<PFN_vkVoidFunction>(CmdDrawIndirect), COMMAND_BUFFER_PROCS },
+	{ "vkCmdDrawIndexed", reinterpret_cast<PFN_vkVoidFunction>(CmdDrawIndexed), COMMAND_BUFFER_PROCS },
+	{ "vkCmdDrawIndexedIndirect", reinterpret_cast<PFN_vkVoidFunction>(CmdDrawIndexedIndirect), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdBindPipeline", reinterpret_cast<PFN_vkVoidFunction>(CmdBindPipeline), COMMAND_BUFFER_PROCS },
+	{ "vkCmdBeginRenderPass", reinterpret_cast<PFN_vkVoidFunction>(CmdBeginRenderPass), COMMAND_BUFFER_PROCS },
+	{ "vkCmdNextSubpass", reinterpret_cast<PFN_vkVoidFunction>(CmdNextSubpass), COMMAND_BUFFER_PROCS },
+	{ "vkCmdEndRenderPass", reinterpret_cast<PFN_vkVoidFunction>(CmdEndRenderPass), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdPipelineBarrier", reinterpret_cast<PFN_vkVoidFunction>(CmdPipelineBarrier), COMMAND_BUFFER_PROCS },
+	{ "vkCmdClearColorImage", reinterpret_cast<PFN_vkVoidFunction>(CmdClearColorImage), COMMAND_BUFFER_PROCS },
+	{ "vkCmdClearDepthStencilImage", reinterpret_cast<PFN_vkVoidFunction>(CmdClearDepthStencilImage),
+	  COMMAND_BUFFER_PROCS },
+	{ "vkCmdClearAttachments", reinterpret_cast<PFN_vkVoidFunction>(CmdClearAttachments), COMMAND_BUFFER_PROCS },
+	{ "vkCmdCopyBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkCmdCopyImage", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyImage), COMMAND_BUFFER_PROCS },
+	{ "vkCmdCopyBufferToImage", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyBufferToImage), COMMAND_BUFFER_PROCS },
+	{ "vkCmdCopyImageToBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyImageToBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkCmdBlitImage", reinterpret_cast<PFN_vkVoidFunction>(CmdBlitImage), COMMAND_BUFFER_PROCS },
+	{ "vkCmdFillBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdFillBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkCmdUpdateBuffer", reinterpret_cast<PFN_vkVoidFunction>(CmdUpdateBuffer), COMMAND_BUFFER_PROCS },
+	{ "vkCmdResolveImage", reinterpret_cast<PFN_vkVoidFunction>(CmdResolveImage), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdCopyQueryPoolResults", reinterpret_cast<PFN_vkVoidFunction>(CmdCopyQueryPoolResults),
+	  COMMAND_BUFFER_PROCS },
+	{ "vkCmdResetQueryPool", reinterpret_cast<PFN_vkVoidFunction>(CmdResetQueryPool), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdDispatch", reinterpret_cast<PFN_vkVoidFunction>(CmdDispatch), COMMAND_BUFFER_PROCS },
+	{ "vkCmdDispatchIndirect", reinterpret_cast<PFN_vkVoidFunction>(CmdDispatchIndirect), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdBindDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(CmdBindDescriptorSets), COMMAND_BUFFER_PROCS },
+
+	{ "vkCmdSetEvent", reinterpret_cast<PFN_vkVoidFunction>(CmdSetEvent), COMMAND_BUFFER_PROCS },
+	{ "vkCmdResetEvent", reinterpret_cast<PFN_vkVoidFunction>(CmdResetEvent), COMMAND_BUFFER_PROCS },
+	{ "vkCmdWaitEvents", reinterpret_cast<PFN_vkVoidFunction>(CmdWaitEvents), COMMAND_BUFFER_PROCS },
+
+	{ "vkUpdateDescriptorSets", reinterpret_cast<PFN_vkVoidFunction>(UpdateDescriptorSets), DESCRIPTOR_UPDATE_PROCS },
+};
 
-		{ "vkCreateImageView", reinterpret_cast<PFN_vkVoidFunction>(CreateImageView) },
-		{ "vkDestroyImageView", reinterpret_cast<PFN_vkVoidFunction>(DestroyImageView) },
+// Built when the layer is loaded, before the loader can query any entry point.
+static const ProcTable procTable(procEntries);
 
-		{ "vkCreateGraphicsPipelines", reinterpret_cast<PFN_vkVoidFunction>(CreateGraphicsPipelines) },
-		{ "vkCreateComputePipelines", reinterpret_cast<PFN_vkVoidFunction>(CreateComputePipelines) },
-		{ "vkDestroyPipeline", reinterpret_cast<PFN_vkVoidFunction>(DestroyPipeline) },
-
-		{ "vkCreateSampler", reinterpret_cast<PFN_vkVoidFunction>(CreateSampler) },
-		{ "vkDestroySampler", reinterpret_cast<PFN_vkVoidFunction>(DestroySampler) },
-
-		{ "vkCreateShaderModule", reinterpret_cast<PFN_vkVoidFunction>(CreateShaderModule) },
-		{ "vkDestroyShaderModule", reinterpret_cast<PFN_vkVoidFunction>(DestroyShaderModule) },
-
-		{ "vkCreateSwapchainKHR", reinterpret_cast<PFN_vkVoidFunction>(CreateSwapchainKHR) },
-		{ "vkDestroySwapchainKHR", reinterpret_cast<PFN_vkVoidFunction>(DestroySwapchainKHR) },
-		{ "vkGetSwapchainImagesKHR", reinterpret_cast<PFN_vkVoidFunction>(GetSwapchainImagesKHR) },
-	};
-
-	for (auto &cmd : coreDeviceCommands)
-		if (strcmp(cmd.name, pName) == 0)
-			return cmd.proc;
-	return nullptr;
+/// Returns the layer's function for pName if it is in one of the groups of interceptMask, see Device::InterceptBits.
+static PFN_vkVoidFunction interceptDeviceCommand(const char *pName, uint32_t interceptMask)
+{
+	auto *entry = procTable.find(pName);
+	return entry && (entry->group & interceptMask) ? entry->proc : nullptr;
 }
 } // namespace MPD
 
 using namespace MPD;
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char *pName)
 {
-	lock_guard<mutex> holder{ globalLock };
+	// Both the device lookup and the entry point table are lock-free.
+	auto *layer = getLayerData(getDispatchKey(device), deviceLookup);
+	MPD_ASSERT(layer);
 
-	auto proc = interceptCoreDeviceCommand(pName);
+	// Entry points which no enabled check needs are not intercepted at all.
+	auto proc = interceptDeviceCommand(pName, layer->getInterceptMask());
 	if (proc)
 		return proc;
 
-	auto *layer = getLayerData(getDispatchKey(device), deviceData);
-	MPD_ASSERT(layer);
-
 	return layer->getTable()->GetDeviceProcAddr(device, pName);
 }
 
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char *pName)
 {
-	lock_guard<mutex> holder{ globalLock };
-
-	auto proc = interceptCoreInstanceCommand(pName);
-	if (proc)
-		return proc;
-
-	proc = interceptExtensionInstanceCommand(pName);
-	if (proc)
-		return proc;
-
-	proc = interceptCoreDeviceCommand(pName);
-	if (proc)
-		return proc;
+	// The device is not known here, so every entry point the layer implements is returned.
+	auto *entry = procTable.find(pName);
+	if (entry)
+		return entry->proc;
 
+	lock_guard<mutex> holder{ globalLock };
 	auto *layer = getLayerData(getDispatchKey(instance), instanceData);
 	MPD_ASSERT(layer);
 
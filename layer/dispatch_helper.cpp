@@ -30,54 +30,33 @@ void layerInitDeviceDispatchTable(VkDevice device, VkLayerDispatchTable *table,
 	table->DestroyDevice = (PFN_vkDestroyDevice)gpa(device, "vkDestroyDevice");
 	table->GetDeviceQueue = (PFN_vkGetDeviceQueue)gpa(device, "vkGetDeviceQueue");
 	table->QueueSubmit = (PFN_vkQueueSubmit)gpa(device, "vkQueueSubmit");
-	table->QueueWaitIdle = (PFN_vkQueueWaitIdle)gpa(device, "vkQueueWaitIdle");
-	table->DeviceWaitIdle = (PFN_vkDeviceWaitIdle)gpa(device, "vkDeviceWaitIdle");
 	table->AllocateMemory = (PFN_vkAllocateMemory)gpa(device, "vkAllocateMemory");
 	table->FreeMemory = (PFN_vkFreeMemory)gpa(device, "vkFreeMemory");
 	table->MapMemory = (PFN_vkMapMemory)gpa(device, "vkMapMemory");
 	table->UnmapMemory = (PFN_vkUnmapMemory)gpa(device, "vkUnmapMemory");
 	table->FlushMappedMemoryRanges = (PFN_vkFlushMappedMemoryRanges)gpa(device, "vkFlushMappedMemoryRanges");
-	table->InvalidateMappedMemoryRanges =
-	    (PFN_vkInvalidateMappedMemoryRanges)gpa(device, "vkInvalidateMappedMemoryRanges");
-	table->GetDeviceMemoryCommitment = (PFN_vkGetDeviceMemoryCommitment)gpa(device, "vkGetDeviceMemoryCommitment");
 	table->BindBufferMemory = (PFN_vkBindBufferMemory)gpa(device, "vkBindBufferMemory");
 	table->BindImageMemory = (PFN_vkBindImageMemory)gpa(device, "vkBindImageMemory");
 	table->GetBufferMemoryRequirements =
 	    (PFN_vkGetBufferMemoryRequirements)gpa(device, "vkGetBufferMemoryRequirements");
 	table->GetImageMemoryRequirements = (PFN_vkGetImageMemoryRequirements)gpa(device, "vkGetImageMemoryRequirements");
-	table->GetImageSparseMemoryRequirements =
-	    (PFN_vkGetImageSparseMemoryRequirements)gpa(device, "vkGetImageSparseMemoryRequirements");
-	table->QueueBindSparse = (PFN_vkQueueBindSparse)gpa(device, "vkQueueBindSparse");
 	table->CreateFence = (PFN_vkCreateFence)gpa(device, "vkCreateFence");
 	table->DestroyFence = (PFN_vkDestroyFence)gpa(device, "vkDestroyFence");
 	table->ResetFences = (PFN_vkResetFences)gpa(device, "vkResetFences");
 	table->GetFenceStatus = (PFN_vkGetFenceStatus)gpa(device, "vkGetFenceStatus");
 	table->WaitForFences = (PFN_vkWaitForFences)gpa(device, "vkWaitForFences");
-	table->CreateSemaphore = (PFN_vkCreateSemaphore)gpa(device, "vkCreateSemaphore");
-	table->DestroySemaphore = (PFN_vkDestroySemaphore)gpa(device, "vkDestroySemaphore");
 	table->CreateEvent = (PFN_vkCreateEvent)gpa(device, "vkCreateEvent");
 	table->DestroyEvent = (PFN_vkDestroyEvent)gpa(device, "vkDestroyEvent");
-	table->GetEventStatus = (PFN_vkGetEventStatus)gpa(device, "vkGetEventStatus");
 	table->SetEvent = (PFN_vkSetEvent)gpa(device, "vkSetEvent");
 	table->ResetEvent = (PFN_vkResetEvent)gpa(device, "vkResetEvent");
-	table->CreateQueryPool = (PFN_vkCreateQueryPool)gpa(device, "vkCreateQueryPool");
-	table->DestroyQueryPool = (PFN_vkDestroyQueryPool)gpa(device, "vkDestroyQueryPool");
-	table->GetQueryPoolResults = (PFN_vkGetQueryPoolResults)gpa(device, "vkGetQueryPoolResults");
 	table->CreateBuffer = (PFN_vkCreateBuffer)gpa(device, "vkCreateBuffer");
 	table->DestroyBuffer = (PFN_vkDestroyBuffer)gpa(device, "vkDestroyBuffer");
-	table->CreateBufferView = (PFN_vkCreateBufferView)gpa(device, "vkCreateBufferView");
-	table->DestroyBufferView = (PFN_vkDestroyBufferView)gpa(device, "vkDestroyBufferView");
 	table->CreateImage = (PFN_vkCreateImage)gpa(device, "vkCreateImage");
 	table->DestroyImage = (PFN_vkDestroyImage)gpa(device, "vkDestroyImage");
-	table->GetImageSubresourceLayout = (PFN_vkGetImageSubresourceLayout)gpa(device, "vkGetImageSubresourceLayout");
 	table->CreateImageView = (PFN_vkCreateImageView)gpa(device, "vkCreateImageView");
 	table->DestroyImageView = (PFN_vkDestroyImageView)gpa(device, "vkDestroyImageView");
 	table->CreateShaderModule = (PFN_vkCreateShaderModule)gpa(device, "vkCreateShaderModule");
 	table->DestroyShaderModule = (PFN_vkDestroyShaderModule)gpa(device, "vkDestroyShaderModule");
-	table->CreatePipelineCache = (PFN_vkCreatePipelineCache)gpa(device, "vkCreatePipelineCache");
-	table->DestroyPipelineCache = (PFN_vkDestroyPipelineCache)gpa(device, "vkDestroyPipelineCache");
-	table->GetPipelineCacheData = (PFN_vkGetPipelineCacheData)gpa(device, "vkGetPipelineCacheData");
-	table->MergePipelineCaches = (PFN_vkMergePipelineCaches)gpa(device, "vkMergePipelineCaches");
 	table->CreateGraphicsPipelines = (PFN_vkCreateGraphicsPipelines)gpa(device, "vkCreateGraphicsPipelines");
 	table->CreateComputePipelines = (PFN_vkCreateComputePipelines)gpa(device, "vkCreateComputePipelines");
 	table->DestroyPipeline = (PFN_vkDestroyPipeline)gpa(device, "vkDestroyPipeline");
@@ -97,7 +76,6 @@ void layerInitDeviceDispatchTable(VkDevice device, VkLayerDispatchTable *table,
 	table->DestroyFramebuffer = (PFN_vkDestroyFramebuffer)gpa(device, "vkDestroyFramebuffer");
 	table->CreateRenderPass = (PFN_vkCreateRenderPass)gpa(device, "vkCreateRenderPass");
 	table->DestroyRenderPass = (PFN_vkDestroyRenderPass)gpa(device, "vkDestroyRenderPass");
-	table->GetRenderAreaGranularity = (PFN_vkGetRenderAreaGranularity)gpa(device, "vkGetRenderAreaGranularity");
 	table->CreateCommandPool = (PFN_vkCreateCommandPool)gpa(device, "vkCreateCommandPool");
 	table->DestroyCommandPool = (PFN_vkDestroyCommandPool)gpa(device, "vkDestroyCommandPool");
 	table->ResetCommandPool = (PFN_vkResetCommandPool)gpa(device, "vkResetCommandPool");
@@ -107,18 +85,8 @@ void layerInitDeviceDispatchTable(VkDevice device, VkLayerDispatchTable *table,
 	table->EndCommandBuffer = (PFN_vkEndCommandBuffer)gpa(device, "vkEndCommandBuffer");
 	table->ResetCommandBuffer = (PFN_vkResetCommandBuffer)gpa(device, "vkResetCommandBuffer");
 	table->CmdBindPipeline = (PFN_vkCmdBindPipeline)gpa(device, "vkCmdBindPipeline");
-	table->CmdSetViewport = (PFN_vkCmdSetViewport)gpa(device, "vkCmdSetViewport");
-	table->CmdSetScissor = (PFN_vkCmdSetScissor)gpa(device, "vkCmdSetScissor");
-	table->CmdSetLineWidth = (PFN_vkCmdSetLineWidth)gpa(device, "vkCmdSetLineWidth");
-	table->CmdSetDepthBias = (PFN_vkCmdSetDepthBias)gpa(device, "vkCmdSetDepthBias");
-	table->CmdSetBlendConstants = (PFN_vkCmdSetBlendConstants)gpa(device, "vkCmdSetBlendConstants");
-	table->CmdSetDepthBounds = (PFN_vkCmdSetDepthBounds)gpa(device, "vkCmdSetDepthBounds");
-	table->CmdSetStencilCompareMask = (PFN_vkCmdSetStencilCompareMask)gpa(device, "vkCmdSetStencilCompareMask");
-	table->CmdSetStencilWriteMask = (PFN_vkCmdSetStencilWriteMask)gpa(device, "vkCmdSetStencilWriteMask");
-	table->CmdSetStencilReference = (PFN_vkCmdSetStencilReference)gpa(device, "vkCmdSetStencilReference");
 	table->CmdBindDescriptorSets = (PFN_vkCmdBindDescriptorSets)gpa(device, "vkCmdBindDescriptorSets");
 	table->CmdBindIndexBuffer = (PFN_vkCmdBindIndexBuffer)gpa(device, "vkCmdBindIndexBuffer");
-	table->CmdBindVertexBuffers = (PFN_vkCmdBindVertexBuffers)gpa(device, "vkCmdBindVertexBuffers");
 	table->CmdDraw = (PFN_vkCmdDraw)gpa(device, "vkCmdDraw");
 	table->CmdDrawIndexed = (PFN_vkCmdDrawIndexed)gpa(device, "vkCmdDrawIndexed");
 	table->CmdDrawIndirect = (PFN_vkCmdDrawIndirect)gpa(device, "vkCmdDrawIndirect");
@@ -140,12 +108,8 @@ void layerInitDeviceDispatchTable(VkDevice device, VkLayerDispatchTable *table,
 	table->CmdResetEvent = (PFN_vkCmdResetEvent)gpa(device, "vkCmdResetEvent");
 	table->CmdWaitEvents = (PFN_vkCmdWaitEvents)gpa(device, "vkCmdWaitEvents");
 	table->CmdPipelineBarrier = (PFN_vkCmdPipelineBarrier)gpa(device, "vkCmdPipelineBarrier");
-	table->CmdBeginQuery = (PFN_vkCmdBeginQuery)gpa(device, "vkCmdBeginQuery");
-	table->CmdEndQuery = (PFN_vkCmdEndQuery)gpa(device, "vkCmdEndQuery");
 	table->CmdResetQueryPool = (PFN_vkCmdResetQueryPool)gpa(device, "vkCmdResetQueryPool");
-	table->CmdWriteTimestamp = (PFN_vkCmdWriteTimestamp)gpa(device, "vkCmdWriteTimestamp");
 	table->CmdCopyQueryPoolResults = (PFN_vkCmdCopyQueryPoolResults)gpa(device, "vkCmdCopyQueryPoolResults");
-	table->CmdPushConstants = (PFN_vkCmdPushConstants)gpa(device, "vkCmdPushConstants");
 	table->CmdBeginRenderPass = (PFN_vkCmdBeginRenderPass)gpa(device, "vkCmdBeginRenderPass");
 	table->CmdNextSubpass = (PFN_vkCmdNextSubpass)gpa(device, "vkCmdNextSubpass");
 	table->CmdEndRenderPass = (PFN_vkCmdEndRenderPass)gpa(device, "vkCmdEndRenderPass");
@@ -153,18 +117,7 @@ void layerInitDeviceDispatchTable(VkDevice device, VkLayerDispatchTable *table,
 	table->CreateSwapchainKHR = (PFN_vkCreateSwapchainKHR)gpa(device, "vkCreateSwapchainKHR");
 	table->DestroySwapchainKHR = (PFN_vkDestroySwapchainKHR)gpa(device, "vkDestroySwapchainKHR");
 	table->GetSwapchainImagesKHR = (PFN_vkGetSwapchainImagesKHR)gpa(device, "vkGetSwapchainImagesKHR");
-	table->AcquireNextImageKHR = (PFN_vkAcquireNextImageKHR)gpa(device, "vkAcquireNextImageKHR");
 	table->QueuePresentKHR = (PFN_vkQueuePresentKHR)gpa(device, "vkQueuePresentKHR");
-	table->CmdDrawIndirectCountAMD = (PFN_vkCmdDrawIndirectCountAMD)gpa(device, "vkCmdDrawIndirectCountAMD");
-	table->CmdDrawIndexedIndirectCountAMD =
-	    (PFN_vkCmdDrawIndexedIndirectCountAMD)gpa(device, "vkCmdDrawIndexedIndirectCountAMD");
-	table->CreateSharedSwapchainsKHR = (PFN_vkCreateSharedSwapchainsKHR)gpa(device, "vkCreateSharedSwapchainsKHR");
-	table->DebugMarkerSetObjectTagEXT = (PFN_vkDebugMarkerSetObjectTagEXT)gpa(device, "vkDebugMarkerSetObjectTagEXT");
-	table->DebugMarkerSetObjectNameEXT =
-	    (PFN_vkDebugMarkerSetObjectNameEXT)gpa(device, "vkDebugMarkerSetObjectNameEXT");
-	table->CmdDebugMarkerBeginEXT = (PFN_vkCmdDebugMarkerBeginEXT)gpa(device, "vkCmdDebugMarkerBeginEXT");
-	table->CmdDebugMarkerEndEXT = (PFN_vkCmdDebugMarkerEndEXT)gpa(device, "vkCmdDebugMarkerEndEXT");
-	table->CmdDebugMarkerInsertEXT = (PFN_vkCmdDebugMarkerInsertEXT)gpa(device, "vkCmdDebugMarkerInsertEXT");
 }
 
 void layerInitInstanceDispatchTable(VkInstance instance, VkLayerInstanceDispatchTable *table,
@@ -172,42 +125,11 @@ void layerInitInstanceDispatchTable(VkInstance instance, VkLayerInstanceDispatch
 {
 	memset(table, 0, sizeof(*table));
 	// Core instance function pointers
-	table->GetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)gpa(instance, "vkGetInstanceProcAddr");
 	table->DestroyInstance = (PFN_vkDestroyInstance)gpa(instance, "vkDestroyInstance");
-	table->EnumeratePhysicalDevices = (PFN_vkEnumeratePhysicalDevices)gpa(instance, "vkEnumeratePhysicalDevices");
-	table->GetPhysicalDeviceFeatures = (PFN_vkGetPhysicalDeviceFeatures)gpa(instance, "vkGetPhysicalDeviceFeatures");
-	table->GetPhysicalDeviceFormatProperties =
-	    (PFN_vkGetPhysicalDeviceFormatProperties)gpa(instance, "vkGetPhysicalDeviceFormatProperties");
-	table->GetPhysicalDeviceImageFormatProperties =
-	    (PFN_vkGetPhysicalDeviceImageFormatProperties)gpa(instance, "vkGetPhysicalDeviceImageFormatProperties");
 	table->GetPhysicalDeviceProperties =
 	    (PFN_vkGetPhysicalDeviceProperties)gpa(instance, "vkGetPhysicalDeviceProperties");
-	table->GetPhysicalDeviceQueueFamilyProperties =
-	    (PFN_vkGetPhysicalDeviceQueueFamilyProperties)gpa(instance, "vkGetPhysicalDeviceQueueFamilyProperties");
 	table->GetPhysicalDeviceMemoryProperties =
 	    (PFN_vkGetPhysicalDeviceMemoryProperties)gpa(instance, "vkGetPhysicalDeviceMemoryProperties");
-	table->EnumerateDeviceExtensionProperties =
-	    (PFN_vkEnumerateDeviceExtensionProperties)gpa(instance, "vkEnumerateDeviceExtensionProperties");
-	table->EnumerateDeviceLayerProperties =
-	    (PFN_vkEnumerateDeviceLayerProperties)gpa(instance, "vkEnumerateDeviceLayerProperties");
-	table->GetPhysicalDeviceSparseImageFormatProperties = (PFN_vkGetPhysicalDeviceSparseImageFormatProperties)gpa(
-	    instance, "vkGetPhysicalDeviceSparseImageFormatProperties");
-	// KHR instance extension function pointers
-	table->DestroySurfaceKHR = (PFN_vkDestroySurfaceKHR)gpa(instance, "vkDestroySurfaceKHR");
-	table->GetPhysicalDeviceSurfaceSupportKHR =
-	    (PFN_vkGetPhysicalDeviceSurfaceSupportKHR)gpa(instance, "vkGetPhysicalDeviceSurfaceSupportKHR");
-	table->GetPhysicalDeviceSurfaceCapabilitiesKHR =
-	    (PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR)gpa(instance, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
-	table->GetPhysicalDeviceSurfaceFormatsKHR =
-	    (PFN_vkGetPhysicalDeviceSurfaceFormatsKHR)gpa(instance, "vkGetPhysicalDeviceSurfaceFormatsKHR");
-	table->GetPhysicalDeviceSurfacePresentModesKHR =
-	    (PFN_vkGetPhysicalDeviceSurfacePresentModesKHR)gpa(instance, "vkGetPhysicalDeviceSurfacePresentModesKHR");
-#ifdef VK_USE_PLATFORM_ANDROID_KHR
-	table->CreateAndroidSurfaceKHR = (PFN_vkCreateAndroidSurfaceKHR)gpa(instance, "vkCreateAndroidSurfaceKHR");
-#endif // VK_USE_PLATFORM_ANDROID_KHR
-	table->GetPhysicalDeviceExternalImageFormatPropertiesNV =
-	    (PFN_vkGetPhysicalDeviceExternalImageFormatPropertiesNV)gpa(
-	        instance, "vkGetPhysicalDeviceExternalImageFormatPropertiesNV");
 	// EXT instance extension function pointers
 	table->CreateDebugReportCallbackEXT =
 	    (PFN_vkCreateDebugReportCallbackEXT)gpa(instance, "vkCreateDebugReportCallbackEXT");
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "perfdoc.hpp"
+#include <atomic>
 #include <memory>
 #include <string.h>
 #include <unordered_map>
@@ -52,6 +53,9 @@ static inline VkLayerDeviceCreateInfo *getChainInfo(const VkDeviceCreateInfo *pC
 	return const_cast<VkLayerDeviceCreateInfo *>(chain_info);
 }
 
+/// Only the functions which the layer calls down the chain are resolved, the other entries are left null.
+/// Every lookup can walk the whole layer chain, and it happens for every vkCreateDevice and vkCreateInstance,
+/// so a function has to be added here before the layer can call it.
 void layerInitDeviceDispatchTable(VkDevice device, VkLayerDispatchTable *table, PFN_vkGetDeviceProcAddr gpa);
 
 void layerInitInstanceDispatchTable(VkInstance instance, VkLayerInstanceDispatchTable *table,
@@ -72,6 +76,107 @@ static inline T *getLayerData(void *key, const std::unordered_map<void *, std::u
 		return nullptr;
 }
 
+/// Lock-free lookup from a loader dispatch key to layer data.
+/// Processes rarely have more than a handful of devices, so the keys are kept in a short array which is
+/// scanned linearly. A lookup of the first device costs two loads, and there is no hashing.
+/// If all slots are taken, another chunk is chained on. Chunks are only freed with the table.
+/// insert() and remove() must be externally synchronized, find() can be called concurrently with both.
+template <typename T>
+class DispatchKeyTable
+{
+public:
+	DispatchKeyTable() = default;
+
+	~DispatchKeyTable()
+	{
+		Chunk *chunk = head.next.load(std::memory_order_relaxed);
+		while (chunk)
+		{
+			Chunk *next = chunk->next.load(std::memory_order_relaxed);
+			delete chunk;
+			chunk = next;
+		}
+	}
+
+	DispatchKeyTable(const DispatchKeyTable &) = delete;
+	void operator=(const DispatchKeyTable &) = delete;
+
+	T *find(void *key) const
+	{
+		for (const Chunk *chunk = &head; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			for (auto &slot : chunk->slots)
+				if (slot.key.load(std::memory_order_acquire) == key)
+					return slot.data.load(std::memory_order_relaxed);
+		}
+		return nullptr;
+	}
+
+	void insert(void *key, T *data)
+	{
+		MPD_ASSERT(key);
+		Chunk *chunk = &head;
+		for (;;)
+		{
+			for (auto &slot : chunk->slots)
+			{
+				if (!slot.key.load(std::memory_order_relaxed))
+				{
+					// Publish the data before the key.
+					slot.data.store(data, std::memory_order_relaxed);
+					slot.key.store(key, std::memory_order_release);
+					return;
+				}
+			}
+
+			Chunk *next = chunk->next.load(std::memory_order_relaxed);
+			if (!next)
+			{
+				next = new Chunk;
+				chunk->next.store(next, std::memory_order_release);
+			}
+			chunk = next;
+		}
+	}
+
+	void remove(void *key)
+	{
+		for (Chunk *chunk = &head; chunk; chunk = chunk->next.load(std::memory_order_relaxed))
+		{
+			for (auto &slot : chunk->slots)
+			{
+				if (slot.key.load(std::memory_order_relaxed) == key)
+				{
+					slot.key.store(nullptr, std::memory_order_release);
+					slot.data.store(nullptr, std::memory_order_relaxed);
+					return;
+				}
+			}
+		}
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<void *> key{ nullptr };
+		std::atomic<T *> data{ nullptr };
+	};
+
+	struct Chunk
+	{
+		Slot slots[8];
+		std::atomic<Chunk *> next{ nullptr };
+	};
+
+	Chunk head;
+};
+
+template <typename T>
+static inline T *getLayerData(void *key, const DispatchKeyTable<T> &table)
+{
+	return table.find(key);
+}
+
 template <typename T, typename... TArgs>
 static inline T *createLayerData(void *key, std::unordered_map<void *, std::unique_ptr<T>> &m, TArgs &&... args)
 {
@@ -0,0 +1,175 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "frame_stats.hpp"
+#include "binary_log_format.hpp"
+#include "device.hpp"
+#include "instance.hpp"
+#include "message_codes.hpp"
+
+using namespace std;
+
+namespace MPD
+{
+static_assert(sizeof(BINARY_LOG_FRAME_COUNTERS) / sizeof(BINARY_LOG_FRAME_COUNTERS[0]) == FrameStats::COUNTER_COUNT,
+              "Binary log frame counters do not match FrameStats::Counter");
+
+static atomic<uint64_t> nextFrameStatsId{ 1 };
+
+FrameStats::FrameStats(Device &device)
+    : device(device)
+    , id(nextFrameStatsId.fetch_add(1, memory_order_relaxed))
+    , lastPresent(chrono::steady_clock::now())
+{
+}
+
+FrameStats::Shard &FrameStats::getShard()
+{
+	struct CachedShard
+	{
+		uint64_t owner;
+		uint64_t generation;
+		Shard *shard;
+	};
+	static thread_local CachedShard cached = { 0, 0, nullptr };
+
+	uint64_t generation = shardGeneration.load(memory_order_acquire);
+	if (cached.owner == id && cached.generation == generation)
+		return *cached.shard;
+
+	lock_guard<mutex> holder{ shardLock };
+	auto thread = this_thread::get_id();
+	auto &shard = shards[thread];
+	if (!shard)
+	{
+		if (freeShards.empty())
+		{
+			shardStorage.emplace_back(new Shard);
+			shard = shardStorage.back().get();
+			for (auto &counter : shard->counters)
+				counter.store(0, memory_order_relaxed);
+		}
+		else
+		{
+			shard = freeShards.back();
+			freeShards.pop_back();
+		}
+		shard->owner = thread;
+	}
+
+	cached.owner = id;
+	cached.generation = generation;
+	cached.shard = shard;
+	return *shard;
+}
+
+FrameStats::Scope::Scope(FrameStats *stats, Counter counter, uint64_t count)
+    : shard(stats ? &stats->getShard() : nullptr)
+{
+	if (shard)
+	{
+		shard->counters[counter].fetch_add(count, memory_order_relaxed);
+		start = chrono::steady_clock::now();
+	}
+}
+
+FrameStats::Scope::~Scope()
+{
+	pause();
+}
+
+void FrameStats::Scope::pause()
+{
+	if (shard && start != chrono::steady_clock::time_point())
+	{
+		auto elapsed = chrono::steady_clock::now() - start;
+		shard->counters[LAYER_CPU_TIME_NS].fetch_add(
+		    uint64_t(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()), memory_order_relaxed);
+		start = chrono::steady_clock::time_point();
+	}
+}
+
+void FrameStats::Scope::resume()
+{
+	if (shard)
+		start = chrono::steady_clock::now();
+}
+
+void FrameStats::restart()
+{
+	lastPresent = chrono::steady_clock::now();
+}
+
+void FrameStats::nextFrame()
+{
+	uint64_t counters[COUNTER_COUNT] = {};
+	{
+		lock_guard<mutex> holder{ shardLock };
+		bool released = false;
+		for (auto &shard : shardStorage)
+		{
+			uint64_t counted = 0;
+			for (uint32_t i = 0; i < COUNTER_COUNT; i++)
+			{
+				uint64_t count = shard->counters[i].exchange(0, memory_order_relaxed);
+				counters[i] += count;
+				counted |= count;
+			}
+
+			// Threads which were idle for a whole frame may be gone, release their shard.
+			auto itr = shards.find(shard->owner);
+			if (!counted && itr != end(shards) && itr->second == shard.get())
+			{
+				shards.erase(itr);
+				freeShards.push_back(shard.get());
+				released = true;
+			}
+		}
+
+		if (released)
+			shardGeneration.fetch_add(1, memory_order_release);
+	}
+
+	auto now = chrono::steady_clock::now();
+	uint64_t frameTimeNs = uint64_t(chrono::duration_cast<chrono::nanoseconds>(now - lastPresent).count());
+	lastPresent = now;
+
+	device.getInstance()->getLogger().writeFrameStats(frameTimeNs, counters, COUNTER_COUNT);
+
+	const auto &cfg = device.getConfig();
+	if (cfg.msgFrameStatistics && cfg.frameStatsLogInterval && frame % cfg.frameStatsLogInterval == 0)
+	{
+		device.log(VK_DEBUG_REPORT_INFORMATION_BIT_EXT, MESSAGE_CODE_FRAME_STATISTICS,
+		           "Frame %llu took %.3f ms: %llu draws, %llu dispatches, %llu render passes, %llu submits, "
+		           "%llu barriers, %llu descriptor updates, %llu pipeline binds, %.3f ms of layer CPU time.",
+		           static_cast<unsigned long long>(frame), double(frameTimeNs) * 1e-6,
+		           static_cast<unsigned long long>(counters[DRAWS]),
+		           static_cast<unsigned long long>(counters[DISPATCHES]),
+		           static_cast<unsigned long long>(counters[RENDER_PASSES]),
+		           static_cast<unsigned long long>(counters[SUBMITS]),
+		           static_cast<unsigned long long>(counters[BARRIERS]),
+		           static_cast<unsigned long long>(counters[DESCRIPTOR_UPDATES]),
+		           static_cast<unsigned long long>(counters[PIPELINE_BINDS]),
+		           double(counters[LAYER_CPU_TIME_NS]) * 1e-6);
+	}
+
+	frame++;
+}
+}
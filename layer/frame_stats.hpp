@@ -0,0 +1,123 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "perfdoc.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace MPD
+{
+class Device;
+
+/// Counts the work the application records and submits in each frame, and the CPU time the layer spends on it.
+///
+/// Frames end at vkQueuePresentKHR. Counters are kept in one shard per thread, so command buffers recorded on
+/// different threads do not contend on the same cache lines, and the shards are merged when the frame ends.
+/// The totals are logged every frameStatsLogInterval frames and written to the binary log every frame.
+///
+/// A shard which counted nothing in a frame is released, so applications which record on short-lived threads do not
+/// accumulate shards. Released shards are reused rather than freed, a thread which still has one cached keeps
+/// counting into memory which is merged every frame.
+class FrameStats
+{
+public:
+	enum Counter
+	{
+		DRAWS,
+		DISPATCHES,
+		RENDER_PASSES,
+		SUBMITS,
+		BARRIERS,
+		DESCRIPTOR_UPDATES,
+		PIPELINE_BINDS,
+		// Time spent in the counted entry points, not including the calls down the chain.
+		LAYER_CPU_TIME_NS,
+		COUNTER_COUNT
+	};
+
+	explicit FrameStats(Device &device);
+
+	FrameStats(const FrameStats &) = delete;
+	void operator=(const FrameStats &) = delete;
+
+	/// Ends the frame, called at vkQueuePresentKHR.
+	void nextFrame();
+
+	/// Times the next frame from now on, for when the frames before it were not counted.
+	void restart();
+
+private:
+	struct Shard;
+
+public:
+	/// Counts a call to an entry point and times the layer's work in it, until the scope is destroyed.
+	/// stats can be null, in which case nothing is counted.
+	class Scope
+	{
+	public:
+		Scope(FrameStats *stats, Counter counter, uint64_t count = 1);
+		~Scope();
+
+		Scope(const Scope &) = delete;
+		void operator=(const Scope &) = delete;
+
+		/// Stops the clock, around calls down the chain.
+		void pause();
+		void resume();
+
+	private:
+		Shard *shard;
+		std::chrono::steady_clock::time_point start;
+	};
+
+private:
+	struct Shard
+	{
+		std::atomic<uint64_t> counters[COUNTER_COUNT];
+		std::thread::id owner;
+		// Keeps the shards of different threads off each other's cache lines.
+		char padding[64];
+	};
+
+	Device &device;
+	// Identifies this object in the per-thread shard cache, addresses can be reused.
+	uint64_t id;
+	uint64_t frame = 0;
+	std::chrono::steady_clock::time_point lastPresent;
+
+	std::mutex shardLock;
+	// Every shard ever allocated, only as many as threads counted in the same frame.
+	std::vector<std::unique_ptr<Shard>> shardStorage;
+	std::unordered_map<std::thread::id, Shard *> shards;
+	std::vector<Shard *> freeShards;
+
+	// Incremented when shards are released, so threads look theirs up again.
+	std::atomic<uint64_t> shardGeneration{ 0 };
+
+	Shard &getShard();
+};
+}
@@ -76,19 +76,30 @@ void DepthPrePassHeuristic::cmdEndRenderPass(VkCommandBuffer)
 	// check current heuristics and report findings (if any)
 	if ((state & (COLOR_ATTACHMENT | DEPTH_ATTACHMENT)) == (COLOR_ATTACHMENT | DEPTH_ATTACHMENT))
 	{
-		if (
-		cfg.msgDepthPrePass &&
-		(numDrawCallsDepthOnly >= device->getConfig().depthPrePassNumDrawCalls) &&
-		    (numDrawCallsDepthEqual >= device->getConfig().depthPrePassNumDrawCalls))
+		// Indirect drawcalls can only be counted once their arguments are known, at submit.
+		if (cfg.msgDepthPrePass && !checkDrawCallCounts(*commandBuffer, numDrawCallsDepthOnly, numDrawCallsDepthEqual) &&
+		    (state & INDIRECT_DRAWS))
 		{
-			this->commandBuffer->log(
-			    VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_DEPTH_PRE_PASS,
-			    "Detected possible rendering pattern using depth pre-pass. "
-			    "This is not recommended on PowerVR due to extra geometry pressure and CPU overhead. ");
+			commandBuffer->enqueueDepthPrePassCheck(numDrawCallsDepthOnly, numDrawCallsDepthEqual);
 		}
 	}
 }
 
+bool DepthPrePassHeuristic::checkDrawCallCounts(CommandBuffer &commandBuffer, uint32_t numDrawCallsDepthOnly,
+                                                uint32_t numDrawCallsDepthEqual)
+{
+	const auto &cfg = commandBuffer.getDevice()->getConfig();
+	if ((numDrawCallsDepthOnly >= cfg.depthPrePassNumDrawCalls) &&
+	    (numDrawCallsDepthEqual >= cfg.depthPrePassNumDrawCalls))
+	{
+		commandBuffer.log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_DEPTH_PRE_PASS,
+		                  "Detected possible rendering pattern using depth pre-pass. "
+		                  "This is not recommended on PowerVR due to extra geometry pressure and CPU overhead. ");
+		return true;
+	}
+	return false;
+}
+
 void DepthPrePassHeuristic::cmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
 {
 	if (pipelineBindPoint != VK_PIPELINE_BIND_POINT_GRAPHICS)
@@ -100,13 +111,24 @@ void DepthPrePassHeuristic::cmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint
 	Pipeline *graphicsPipeline = device->get<Pipeline>(pipeline);
 	MPD_ASSERT(graphicsPipeline);
 
-	const VkGraphicsPipelineCreateInfo &pipelineCreateInfo = graphicsPipeline->getGraphicsCreateInfo();
+	bool depthOnly, depthEqualTest;
+	classifyPipeline(graphicsPipeline->getGraphicsCreateInfo(), depthOnly, depthEqualTest);
+
+	state &= ~(DEPTH_ONLY | DEPTH_EQUAL_TEST);
+	if (depthOnly)
+		state |= DEPTH_ONLY;
+	if (depthEqualTest)
+		state |= DEPTH_EQUAL_TEST;
+}
 
+void DepthPrePassHeuristic::classifyPipeline(const VkGraphicsPipelineCreateInfo &pipelineCreateInfo, bool &depthOnly,
+                                             bool &depthEqualTest)
+{
 	const VkPipelineDepthStencilStateCreateInfo *depthStencilState = pipelineCreateInfo.pDepthStencilState;
 	const VkPipelineColorBlendStateCreateInfo *blendState = pipelineCreateInfo.pColorBlendState;
 
 	// check if color writes are enabled
-	state |= DEPTH_ONLY;
+	depthOnly = true;
 
 	if (blendState)
 	{
@@ -114,14 +136,14 @@ void DepthPrePassHeuristic::cmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint
 		{
 			if (blendState->pAttachments[i].colorWriteMask != 0)
 			{
-				state &= ~DEPTH_ONLY;
+				depthOnly = false;
 				break;
 			}
 		}
 	}
 
 	// check if depth equal test is enabled
-	state &= ~DEPTH_EQUAL_TEST;
+	depthEqualTest = false;
 	if (depthStencilState->depthTestEnable)
 	{
 		switch (depthStencilState->depthCompareOp)
@@ -129,7 +151,7 @@ void DepthPrePassHeuristic::cmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint
 		case VK_COMPARE_OP_EQUAL:
 		case VK_COMPARE_OP_LESS_OR_EQUAL:
 		case VK_COMPARE_OP_GREATER_OR_EQUAL:
-			state |= DEPTH_EQUAL_TEST;
+			depthEqualTest = true;
 			break;
 
 		default:
@@ -173,6 +195,12 @@ void DepthPrePassHeuristic::cmdDrawIndexed(VkCommandBuffer, uint32_t indexCount,
 	}
 }
 
+void DepthPrePassHeuristic::cmdDrawIndirect(VkCommandBuffer, bool)
+{
+	if (state & (DEPTH_ONLY | DEPTH_EQUAL_TEST))
+		state |= INDIRECT_DRAWS;
+}
+
 TileReadbackHeuristic::TileReadbackHeuristic(CommandBuffer *commandBuffer, Device *device)
     : Heuristic(device)
     , commandBuffer(commandBuffer)
@@ -252,6 +280,11 @@ void ClearAttachmentsHeuristic::cmdDrawIndexed(VkCommandBuffer, uint32_t, uint32
 	hasSeenDrawCall = true;
 }
 
+void ClearAttachmentsHeuristic::cmdDrawIndirect(VkCommandBuffer, bool)
+{
+	hasSeenDrawCall = true;
+}
+
 void ClearAttachmentsHeuristic::cmdBeginRenderPass(VkCommandBuffer, const VkRenderPassBeginInfo *pBeginInfo,
                                                    VkSubpassContents)
 {
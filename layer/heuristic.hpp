@@ -74,6 +74,11 @@ public:
 	{
 	}
 
+	/// The draws of indirect drawcalls are only known at submit, see DeferredDrawIndirect.
+	virtual void cmdDrawIndirect(VkCommandBuffer, bool)
+	{
+	}
+
 	virtual void submit()
 	{
 	}
@@ -105,6 +110,16 @@ public:
 	void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
 	                    int32_t vertexOffset, uint32_t firstInstance) override;
 
+	void cmdDrawIndirect(VkCommandBuffer commandBuffer, bool indexed) override;
+
+	/// Finds out whether drawcalls with this pipeline look like a depth pre-pass, or like the pass which follows it.
+	static void classifyPipeline(const VkGraphicsPipelineCreateInfo &createInfo, bool &depthOnly,
+	                             bool &depthEqualTest);
+
+	/// Reports a depth pre-pass if there were enough of both kinds of drawcalls. Returns true if it did.
+	static bool checkDrawCallCounts(CommandBuffer &commandBuffer, uint32_t numDrawCallsDepthOnly,
+	                                uint32_t numDrawCallsDepthEqual);
+
 private:
 	void reset() override;
 
@@ -113,6 +128,7 @@ private:
 	static const uint32_t DEPTH_ONLY = 0x4;
 	static const uint32_t DEPTH_EQUAL_TEST = 0x8;
 	static const uint32_t INSIDE_RENDERPASS = 0x10;
+	static const uint32_t INDIRECT_DRAWS = 0x20;
 
 	CommandBuffer *commandBuffer;
 
@@ -149,6 +165,8 @@ public:
 	void cmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
 	                    int32_t vertexOffset, uint32_t firstInstance) override;
 
+	void cmdDrawIndirect(VkCommandBuffer commandBuffer, bool indexed) override;
+
 	void reset() override;
 
 private:
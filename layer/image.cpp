@@ -81,6 +81,13 @@ uint32_t Image::getUsageFlags(uint32_t arrayLayer, uint32_t mipLevel) const
 	return resource.usageFlags;
 }
 
+void Image::resetLastUsage()
+{
+	for (auto &layer : arrayLayers)
+		for (auto &level : layer.mipLevels)
+			level.lastUsage = Usage::Undefined;
+}
+
 void Image::signalUsage(const VkImageSubresourceRange &range, Usage usage)
 {
 	uint32_t maxLayers = createInfo.arrayLayers - range.baseArrayLayer;
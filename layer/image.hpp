@@ -77,6 +77,10 @@ public:
 	Usage getLastUsage(uint32_t arrayLayer, uint32_t mipLevel) const;
 	uint32_t getUsageFlags(uint32_t arrayLayer, uint32_t mipLevel) const;
 
+	/// Forgets the last usage of every subresource, for when the uses since then were not tracked.
+	/// The usage flags are kept, they only ever accumulate.
+	void resetLastUsage();
+
 private:
 	VkImage image = VK_NULL_HANDLE;
 	DeviceMemory *memory = nullptr;
@@ -0,0 +1,423 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "index_readback.hpp"
+#include "buffer.hpp"
+#include "commandbuffer.hpp"
+#include "device.hpp"
+#include "device_memory.hpp"
+#include "queue.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace MPD
+{
+// Keeps copies aligned for the vectorized scan.
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+static uint32_t findStagingMemoryType(const VkPhysicalDeviceMemoryProperties &memoryProperties, uint32_t typeBits)
+{
+	static const VkMemoryPropertyFlags required =
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	// Cached memory is much faster to read from on the CPU.
+	uint32_t fallback = ~0u;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if (!(typeBits & (1u << i)))
+			continue;
+
+		auto flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if ((flags & required) != required)
+			continue;
+
+		if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+			return i;
+		if (fallback == ~0u)
+			fallback = i;
+	}
+	return fallback;
+}
+
+IndexReadback::IndexReadback(Device &device, VkDeviceSize ringSize)
+    : device(device)
+    , ringSize(ringSize)
+{
+}
+
+IndexReadback::~IndexReadback()
+{
+	auto *table = device.getTable();
+	VkDevice vkDevice = device.getDevice();
+
+	// The copies can't be scanned anymore, but they must complete before their buffers are freed.
+	while (!inFlight.empty())
+	{
+		table->WaitForFences(vkDevice, 1, &inFlight.front()->fence, VK_TRUE, UINT64_MAX);
+		retireFront(false);
+	}
+
+	for (auto &batch : freeBatches)
+	{
+		table->FreeCommandBuffers(vkDevice, commandPools[batch->queueFamily], 1, &batch->commandBuffer);
+		table->DestroyFence(vkDevice, batch->fence, nullptr);
+	}
+
+	for (auto &pool : commandPools)
+		table->DestroyCommandPool(vkDevice, pool.second, nullptr);
+
+	if (stagingData)
+		table->UnmapMemory(vkDevice, stagingMemory);
+	table->DestroyBuffer(vkDevice, stagingBuffer, nullptr);
+	table->FreeMemory(vkDevice, stagingMemory, nullptr);
+}
+
+VkResult IndexReadback::init()
+{
+	auto *table = device.getTable();
+	VkDevice vkDevice = device.getDevice();
+
+	VkBufferCreateInfo bufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.size = ringSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	auto res = table->CreateBuffer(vkDevice, &bufferInfo, nullptr, &stagingBuffer);
+	if (res != VK_SUCCESS)
+		return res;
+
+	VkMemoryRequirements memoryRequirements;
+	table->GetBufferMemoryRequirements(vkDevice, stagingBuffer, &memoryRequirements);
+
+	VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocateInfo.allocationSize = memoryRequirements.size;
+	allocateInfo.memoryTypeIndex =
+	    findStagingMemoryType(device.getMemoryProperties(), memoryRequirements.memoryTypeBits);
+	if (allocateInfo.memoryTypeIndex == ~0u)
+		return VK_ERROR_FEATURE_NOT_PRESENT;
+
+	res = table->AllocateMemory(vkDevice, &allocateInfo, nullptr, &stagingMemory);
+	if (res != VK_SUCCESS)
+		return res;
+
+	res = table->BindBufferMemory(vkDevice, stagingBuffer, stagingMemory, 0);
+	if (res != VK_SUCCESS)
+		return res;
+
+	void *mapped = nullptr;
+	res = table->MapMemory(vkDevice, stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+	if (res != VK_SUCCESS)
+		return res;
+
+	stagingData = static_cast<const uint8_t *>(mapped);
+	return VK_SUCCESS;
+}
+
+bool IndexReadback::allocate(VkDeviceSize size, VkDeviceSize &offset)
+{
+	size = (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+	if (size > ringSize)
+		return false;
+
+	// Copies are contiguous, so skip the end of the ring if the copy would wrap around.
+	VkDeviceSize position = head;
+	if (position % ringSize + size > ringSize)
+		position += ringSize - position % ringSize;
+
+	if (position + size - tail > ringSize)
+		return false;
+
+	offset = position % ringSize;
+	head = position + size;
+	return true;
+}
+
+bool IndexReadback::enqueue(const IndexScanKey &key, uint64_t writeGeneration)
+{
+	uint32_t stride = key.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	VkDeviceSize stagingOffset;
+	if (!allocate(VkDeviceSize(stride) * key.indexCount, stagingOffset))
+		return false;
+
+	PendingScan scan;
+	scan.key = key;
+	scan.writeGeneration = writeGeneration;
+	scan.stagingOffset = stagingOffset;
+	queued.push_back(scan);
+	return true;
+}
+
+bool IndexReadback::enqueueIndirect(const DeferredDrawIndirect &draw, uint32_t drawCount, VkDeviceSize size)
+{
+	VkDeviceSize stagingOffset;
+	if (!allocate(size, stagingOffset))
+		return false;
+
+	PendingIndirect indirect;
+	indirect.draw = draw;
+	indirect.drawCount = drawCount;
+	indirect.size = size;
+	indirect.stagingOffset = stagingOffset;
+	queuedIndirect.push_back(indirect);
+	return true;
+}
+
+IndexReadback::Batch *IndexReadback::acquireBatch(uint32_t queueFamily)
+{
+	auto *table = device.getTable();
+	VkDevice vkDevice = device.getDevice();
+
+	auto itr = find_if(freeBatches.begin(), freeBatches.end(),
+	                   [queueFamily](const unique_ptr<Batch> &batch) { return batch->queueFamily == queueFamily; });
+	if (itr != freeBatches.end())
+	{
+		inFlight.push_back(move(*itr));
+		freeBatches.erase(itr);
+
+		auto *batch = inFlight.back().get();
+		if (table->ResetFences(vkDevice, 1, &batch->fence) != VK_SUCCESS)
+		{
+			freeBatches.push_back(move(inFlight.back()));
+			inFlight.pop_back();
+			return nullptr;
+		}
+		return batch;
+	}
+
+	auto &pool = commandPools[queueFamily];
+	if (pool == VK_NULL_HANDLE)
+	{
+		VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = queueFamily;
+		if (table->CreateCommandPool(vkDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			commandPools.erase(queueFamily);
+			return nullptr;
+		}
+	}
+
+	unique_ptr<Batch> batch(new Batch);
+	batch->queueFamily = queueFamily;
+
+	VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	allocateInfo.commandPool = pool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+	if (table->AllocateCommandBuffers(vkDevice, &allocateInfo, &batch->commandBuffer) != VK_SUCCESS)
+		return nullptr;
+
+	// Command buffers are dispatchable, and we allocated this one below the loader.
+	*reinterpret_cast<void **>(batch->commandBuffer) = *reinterpret_cast<void **>(vkDevice);
+
+	VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	if (table->CreateFence(vkDevice, &fenceInfo, nullptr, &batch->fence) != VK_SUCCESS)
+	{
+		table->FreeCommandBuffers(vkDevice, pool, 1, &batch->commandBuffer);
+		return nullptr;
+	}
+
+	inFlight.push_back(move(batch));
+	return inFlight.back().get();
+}
+
+void IndexReadback::flush(Queue &queue)
+{
+	// Copies from destroyed buffers may have been dropped, give their staging space back.
+	if (queued.empty() && queuedIndirect.empty())
+	{
+		head = inFlight.empty() ? tail : inFlight.back()->ringEnd;
+		return;
+	}
+
+	auto *table = device.getTable();
+	auto *batch = acquireBatch(queue.getFamilyIndex());
+	if (!batch)
+	{
+		// Give the staging space back, the indices won't be scanned this time.
+		head = inFlight.empty() ? tail : inFlight.back()->ringEnd;
+		queued.clear();
+		queuedIndirect.clear();
+		return;
+	}
+
+	batch->ringEnd = head;
+	batch->scans.swap(queued);
+	batch->indirectScans.swap(queuedIndirect);
+	queued.clear();
+	queuedIndirect.clear();
+
+	VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	table->BeginCommandBuffer(batch->commandBuffer, &beginInfo);
+
+	// The indices may have been written by the submission we follow.
+	VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	table->CmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+	                          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Drawcalls tend to share a few index buffers, copy from each of them once.
+	auto &scans = batch->scans;
+	stable_sort(scans.begin(), scans.end(), [](const PendingScan &a, const PendingScan &b) {
+		return a.key.buffer < b.key.buffer;
+	});
+
+	vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < scans.size();)
+	{
+		Buffer *buffer = scans[i].key.buffer;
+		regions.clear();
+		for (; i < scans.size() && scans[i].key.buffer == buffer; i++)
+		{
+			auto &key = scans[i].key;
+			VkDeviceSize stride = key.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+			VkBufferCopy region;
+			region.srcOffset = key.indexOffset + stride * key.firstIndex;
+			region.dstOffset = scans[i].stagingOffset;
+			region.size = stride * key.indexCount;
+			regions.push_back(region);
+		}
+		table->CmdCopyBuffer(batch->commandBuffer, buffer->getBuffer(), stagingBuffer, uint32_t(regions.size()),
+		                     regions.data());
+	}
+
+	for (auto &indirect : batch->indirectScans)
+	{
+		VkBufferCopy region;
+		region.srcOffset = indirect.draw.offset;
+		region.dstOffset = indirect.stagingOffset;
+		region.size = indirect.size;
+		table->CmdCopyBuffer(batch->commandBuffer, indirect.draw.buffer->getBuffer(), stagingBuffer, 1, &region);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	table->CmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+	                          &barrier, 0, nullptr, 0, nullptr);
+
+	VkResult res = table->EndCommandBuffer(batch->commandBuffer);
+	if (res == VK_SUCCESS)
+	{
+		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch->commandBuffer;
+		res = table->QueueSubmit(queue.getQueue(), 1, &submitInfo, batch->fence);
+	}
+
+	if (res != VK_SUCCESS)
+	{
+		// Nothing will signal the fence, so drop the batch right away.
+		MPD_ASSERT(inFlight.back().get() == batch);
+		head = batch->ringEnd = inFlight.size() > 1 ? inFlight[inFlight.size() - 2]->ringEnd : tail;
+		batch->scans.clear();
+		batch->indirectScans.clear();
+		freeBatches.push_back(move(inFlight.back()));
+		inFlight.pop_back();
+	}
+}
+
+void IndexReadback::retireFront(bool scan)
+{
+	MPD_ASSERT(!inFlight.empty());
+	auto batch = move(inFlight.front());
+	inFlight.pop_front();
+
+	if (scan)
+	{
+		// The copies are neither the application's memory nor will they change, so they are not live data.
+		for (auto &pending : batch->scans)
+		{
+			CommandBuffer::scanIndices(device, vertexCache, pending.key, stagingData + pending.stagingOffset,
+			                           pending.writeGeneration, false);
+		}
+
+		// Copies of indices queued from here are allocated past the end of this batch, which is still reserved.
+		for (auto &pending : batch->indirectScans)
+		{
+			CommandBuffer::scanIndirectIndices(device, vertexCache, pending.draw,
+			                                   stagingData + pending.stagingOffset, pending.drawCount);
+		}
+	}
+
+	tail = batch->ringEnd;
+	batch->scans.clear();
+	batch->indirectScans.clear();
+	freeBatches.push_back(move(batch));
+}
+
+void IndexReadback::poll()
+{
+	auto *table = device.getTable();
+	while (!inFlight.empty() && table->GetFenceStatus(device.getDevice(), inFlight.front()->fence) == VK_SUCCESS)
+		retireFront(true);
+}
+
+void IndexReadback::waitUntil(size_t batchIndex)
+{
+	auto *table = device.getTable();
+	for (size_t i = 0; i <= batchIndex; i++)
+	{
+		table->WaitForFences(device.getDevice(), 1, &inFlight.front()->fence, VK_TRUE, UINT64_MAX);
+		retireFront(true);
+	}
+}
+
+template <typename Func>
+void IndexReadback::waitForSource(const Func &readsFrom)
+{
+	auto readsIndirect = [&](const PendingIndirect &indirect) {
+		return readsFrom(indirect.draw.buffer) || readsFrom(indirect.draw.indexState.buffer);
+	};
+
+	for (size_t i = inFlight.size(); i; i--)
+	{
+		auto &batch = *inFlight[i - 1];
+		if (any_of(batch.scans.begin(), batch.scans.end(),
+		           [&](const PendingScan &scan) { return readsFrom(scan.key.buffer); }) ||
+		    any_of(batch.indirectScans.begin(), batch.indirectScans.end(), readsIndirect))
+		{
+			waitUntil(i - 1);
+			break;
+		}
+	}
+
+	// Copies which were not submitted yet are dropped, including those queued by the scans above.
+	queued.erase(remove_if(queued.begin(), queued.end(),
+	                       [&](const PendingScan &scan) { return readsFrom(scan.key.buffer); }),
+	             queued.end());
+	queuedIndirect.erase(remove_if(queuedIndirect.begin(), queuedIndirect.end(), readsIndirect),
+	                     queuedIndirect.end());
+}
+
+void IndexReadback::waitForBuffer(const Buffer *buffer)
+{
+	waitForSource([buffer](const Buffer *source) { return source == buffer; });
+}
+
+void IndexReadback::waitForMemory(const DeviceMemory *memory)
+{
+	waitForSource([memory](const Buffer *source) { return source && source->getDeviceMemory() == memory; });
+}
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "command_stream.hpp"
+#include "index_scan.hpp"
+#include "perfdoc.hpp"
+#include "vertex_cache.hpp"
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace MPD
+{
+class Device;
+class DeviceMemory;
+class Queue;
+
+/// Scans indices which the host cannot read, so index buffers can stay in the memory the application picked.
+///
+/// At vkQueueSubmit, the index ranges of the drawcalls are copied on the GPU into a layer owned, host visible
+/// staging ring, in a submission of our own following the application's. Once its fence has signalled, the copies
+/// are scanned like mapped index data. Nothing ever waits for the GPU, unless the application destroys a buffer
+/// or memory which a pending copy still reads.
+///
+/// The arguments of indexed indirect drawcalls are copied the same way, so arguments written by the GPU are seen
+/// as it executed them. Once they are back, the indices of their draws are scanned, or copied back in turn.
+/// Not thread-safe, used with the global lock held.
+class IndexReadback
+{
+public:
+	IndexReadback(Device &device, VkDeviceSize ringSize);
+
+	/// Waits for pending copies without scanning them, and frees everything. Must happen before vkDestroyDevice.
+	~IndexReadback();
+
+	IndexReadback(const IndexReadback &) = delete;
+	void operator=(const IndexReadback &) = delete;
+
+	VkResult init();
+
+	/// Queues a copy of the indices of a drawcall. Returns false if the staging ring is full.
+	bool enqueue(const IndexScanKey &key, uint64_t writeGeneration);
+
+	/// Queues a copy of the first size bytes of arguments of an indexed indirect drawcall with drawCount draws.
+	/// Returns false if the staging ring is full.
+	bool enqueueIndirect(const DeferredDrawIndirect &draw, uint32_t drawCount, VkDeviceSize size);
+
+	/// Submits the queued copies to the queue the drawcalls were submitted to.
+	void flush(Queue &queue);
+
+	/// Scans the copies which have completed, without blocking.
+	void poll();
+
+	/// Waits for copies reading from the buffer or memory, which the application is about to destroy.
+	void waitForBuffer(const Buffer *buffer);
+	void waitForMemory(const DeviceMemory *memory);
+
+private:
+	struct PendingScan
+	{
+		IndexScanKey key;
+		uint64_t writeGeneration;
+		VkDeviceSize stagingOffset;
+	};
+
+	struct PendingIndirect
+	{
+		DeferredDrawIndirect draw;
+		uint32_t drawCount;
+		VkDeviceSize size;
+		VkDeviceSize stagingOffset;
+	};
+
+	struct Batch
+	{
+		uint32_t queueFamily;
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		VkDeviceSize ringEnd;
+		std::vector<PendingScan> scans;
+		std::vector<PendingIndirect> indirectScans;
+	};
+
+	Device &device;
+	VkDeviceSize ringSize;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+	const uint8_t *stagingData = nullptr;
+
+	// Positions in the staging ring, which only ever grow. Copies are allocated at head,
+	// and batches are retired in submission order, which moves tail to their end.
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+
+	std::vector<PendingScan> queued;
+	std::vector<PendingIndirect> queuedIndirect;
+	std::deque<std::unique_ptr<Batch>> inFlight;
+	std::vector<std::unique_ptr<Batch>> freeBatches;
+	std::unordered_map<uint32_t, VkCommandPool> commandPools;
+
+	// Post-transform cache model for the scans.
+	VertexCache vertexCache;
+
+	bool allocate(VkDeviceSize size, VkDeviceSize &offset);
+	Batch *acquireBatch(uint32_t queueFamily);
+	void retireFront(bool scan);
+	void waitUntil(size_t batchIndex);
+
+	template <typename Func>
+	void waitForSource(const Func &readsFrom);
+};
+}
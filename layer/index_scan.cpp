@@ -0,0 +1,686 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "index_scan.hpp"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define MPD_INDEX_SCAN_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+#define MPD_INDEX_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(MPD_INDEX_SCAN_X86)
+#include <intrin.h>
+#endif
+
+// GCC and Clang only allow intrinsics for instruction sets enabled for the function,
+// so the kernels are compiled for their own target without raising the baseline of the whole layer.
+#if defined(__GNUC__) || defined(__clang__)
+#define MPD_TARGET(x) __attribute__((target(x)))
+#else
+#define MPD_TARGET(x)
+#endif
+
+using namespace std;
+
+namespace MPD
+{
+using IndexBoundsFunc = IndexBounds (*)(const uint8_t *, uint32_t, bool);
+
+template <typename T>
+static inline T loadIndex(const uint8_t *ptr)
+{
+	T value;
+	memcpy(&value, ptr, sizeof(T));
+	return value;
+}
+
+template <typename T>
+static IndexBounds scanBoundsScalar(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart,
+                                    IndexBounds bounds)
+{
+	const T primitiveRestartValue = T(~T(0));
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		T value = loadIndex<T>(indexData + i * sizeof(T));
+		if (!primitiveRestart || value != primitiveRestartValue)
+		{
+			bounds.minValue = std::min<uint32_t>(bounds.minValue, value);
+			bounds.maxValue = std::max<uint32_t>(bounds.maxValue, value);
+		}
+	}
+	return bounds;
+}
+
+template <typename T>
+static IndexBounds scanBoundsScalar(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	return scanBoundsScalar<T>(indexData, indexCount, primitiveRestart, IndexBounds{ ~0u, 0u });
+}
+
+// The vector kernels don't mask primitive restarts out of the minimum. The restart value is the largest
+// representable index, so it can only be the minimum if every index was a restart, which is fixed up here.
+template <typename T>
+static IndexBounds finishBounds(IndexBounds bounds, bool primitiveRestart)
+{
+	if (primitiveRestart && bounds.minValue >= uint32_t(T(~T(0))))
+		return IndexBounds{ ~0u, 0u };
+	return bounds;
+}
+
+#ifdef MPD_INDEX_SCAN_X86
+MPD_TARGET("sse4.1")
+static IndexBounds scanBounds16SSE41(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	const uint32_t count = indexCount & ~7u;
+	if (!count)
+		return scanBoundsScalar<uint16_t>(indexData, indexCount, primitiveRestart);
+
+	const __m128i restart = _mm_set1_epi16(-1);
+	__m128i vmin = _mm_set1_epi16(-1);
+	__m128i vmax = _mm_setzero_si128();
+
+	for (uint32_t i = 0; i < count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indexData + i * sizeof(uint16_t)));
+		vmin = _mm_min_epu16(vmin, v);
+		if (primitiveRestart)
+			v = _mm_andnot_si128(_mm_cmpeq_epi16(v, restart), v);
+		vmax = _mm_max_epu16(vmax, v);
+	}
+
+	// PHMINPOSUW finds the horizontal minimum, the maximum is the inverted minimum of the inverted values.
+	IndexBounds bounds;
+	bounds.minValue = uint32_t(_mm_extract_epi16(_mm_minpos_epu16(vmin), 0));
+	bounds.maxValue = 0xffffu - uint32_t(_mm_extract_epi16(_mm_minpos_epu16(_mm_xor_si128(vmax, restart)), 0));
+
+	bounds = scanBoundsScalar<uint16_t>(indexData + count * sizeof(uint16_t), indexCount - count, primitiveRestart,
+	                                    bounds);
+	return finishBounds<uint16_t>(bounds, primitiveRestart);
+}
+
+MPD_TARGET("sse4.1")
+static inline uint32_t horizontalMin32(__m128i v)
+{
+	v = _mm_min_epu32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_min_epu32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return uint32_t(_mm_cvtsi128_si32(v));
+}
+
+MPD_TARGET("sse4.1")
+static inline uint32_t horizontalMax32(__m128i v)
+{
+	v = _mm_max_epu32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_max_epu32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return uint32_t(_mm_cvtsi128_si32(v));
+}
+
+MPD_TARGET("sse4.1")
+static IndexBounds scanBounds32SSE41(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	const uint32_t count = indexCount & ~3u;
+	if (!count)
+		return scanBoundsScalar<uint32_t>(indexData, indexCount, primitiveRestart);
+
+	const __m128i restart = _mm_set1_epi32(-1);
+	__m128i vmin = _mm_set1_epi32(-1);
+	__m128i vmax = _mm_setzero_si128();
+
+	for (uint32_t i = 0; i < count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indexData + i * sizeof(uint32_t)));
+		vmin = _mm_min_epu32(vmin, v);
+		if (primitiveRestart)
+			v = _mm_andnot_si128(_mm_cmpeq_epi32(v, restart), v);
+		vmax = _mm_max_epu32(vmax, v);
+	}
+
+	IndexBounds bounds = { horizontalMin32(vmin), horizontalMax32(vmax) };
+	bounds = scanBoundsScalar<uint32_t>(indexData + count * sizeof(uint32_t), indexCount - count, primitiveRestart,
+	                                    bounds);
+	return finishBounds<uint32_t>(bounds, primitiveRestart);
+}
+
+MPD_TARGET("avx2")
+static IndexBounds scanBounds16AVX2(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	const uint32_t count = indexCount & ~15u;
+	if (!count)
+		return scanBounds16SSE41(indexData, indexCount, primitiveRestart);
+
+	const __m256i restart = _mm256_set1_epi16(-1);
+	__m256i vmin = _mm256_set1_epi16(-1);
+	__m256i vmax = _mm256_setzero_si256();
+
+	for (uint32_t i = 0; i < count; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indexData + i * sizeof(uint16_t)));
+		vmin = _mm256_min_epu16(vmin, v);
+		if (primitiveRestart)
+			v = _mm256_andnot_si256(_mm256_cmpeq_epi16(v, restart), v);
+		vmax = _mm256_max_epu16(vmax, v);
+	}
+
+	__m128i min128 = _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+	__m128i max128 = _mm_max_epu16(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+
+	IndexBounds bounds;
+	bounds.minValue = uint32_t(_mm_extract_epi16(_mm_minpos_epu16(min128), 0));
+	bounds.maxValue =
+	    0xffffu - uint32_t(_mm_extract_epi16(_mm_minpos_epu16(_mm_xor_si128(max128, _mm_set1_epi16(-1))), 0));
+
+	bounds = scanBoundsScalar<uint16_t>(indexData + count * sizeof(uint16_t), indexCount - count, primitiveRestart,
+	                                    bounds);
+	return finishBounds<uint16_t>(bounds, primitiveRestart);
+}
+
+MPD_TARGET("avx2")
+static IndexBounds scanBounds32AVX2(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	const uint32_t count = indexCount & ~7u;
+	if (!count)
+		return scanBounds32SSE41(indexData, indexCount, primitiveRestart);
+
+	const __m256i restart = _mm256_set1_epi32(-1);
+	__m256i vmin = _mm256_set1_epi32(-1);
+	__m256i vmax = _mm256_setzero_si256();
+
+	for (uint32_t i = 0; i < count; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indexData + i * sizeof(uint32_t)));
+		vmin = _mm256_min_epu32(vmin, v);
+		if (primitiveRestart)
+			v = _mm256_andnot_si256(_mm256_cmpeq_epi32(v, restart), v);
+		vmax = _mm256_max_epu32(vmax, v);
+	}
+
+	IndexBounds bounds;
+	bounds.minValue =
+	    horizontalMin32(_mm_min_epu32(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1)));
+	bounds.maxValue =
+	    horizontalMax32(_mm_max_epu32(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1)));
+
+	bounds = scanBoundsScalar<uint32_t>(indexData + count * sizeof(uint32_t), indexCount - count, primitiveRestart,
+	                                    bounds);
+	return finishBounds<uint32_t>(bounds, primitiveRestart);
+}
+
+static bool cpuSupportsSSE41()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.1") != 0;
+#endif
+}
+
+static bool cpuSupportsAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The OS must also save the YMM registers.
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+#ifdef MPD_INDEX_SCAN_NEON
+static inline uint16_t horizontalMin16(uint16x8_t v)
+{
+#ifdef __aarch64__
+	return vminvq_u16(v);
+#else
+	uint16x4_t r = vpmin_u16(vget_low_u16(v), vget_high_u16(v));
+	r = vpmin_u16(r, r);
+	r = vpmin_u16(r, r);
+	return vget_lane_u16(r, 0);
+#endif
+}
+
+static inline uint16_t horizontalMax16(uint16x8_t v)
+{
+#ifdef __aarch64__
+	return vmaxvq_u16(v);
+#else
+	uint16x4_t r = vpmax_u16(vget_low_u16(v), vget_high_u16(v));
+	r = vpmax_u16(r, r);
+	r = vpmax_u16(r, r);
+	return vget_lane_u16(r, 0);
+#endif
+}
+
+static inline uint32_t horizontalMin32(uint32x4_t v)
+{
+#ifdef __aarch64__
+	return vminvq_u32(v);
+#else
+	uint32x2_t r = vpmin_u32(vget_low_u32(v), vget_high_u32(v));
+	r = vpmin_u32(r, r);
+	return vget_lane_u32(r, 0);
+#endif
+}
+
+static inline uint32_t horizontalMax32(uint32x4_t v)
+{
+#ifdef __aarch64__
+	return vmaxvq_u32(v);
+#else
+	uint32x2_t r = vpmax_u32(vget_low_u32(v), vget_high_u32(v));
+	r = vpmax_u32(r, r);
+	return vget_lane_u32(r, 0);
+#endif
+}
+
+static IndexBounds scanBounds16NEON(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	const uint32_t count = indexCount & ~7u;
+	if (!count)
+		return scanBoundsScalar<uint16_t>(indexData, indexCount, primitiveRestart);
+
+	const uint16x8_t restart = vdupq_n_u16(0xffff);
+	uint16x8_t vmin = vdupq_n_u16(0xffff);
+	uint16x8_t vmax = vdupq_n_u16(0);
+
+	for (uint32_t i = 0; i < count; i += 8)
+	{
+		// vld1q_u8 has no alignment requirement beyond a byte.
+		uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(indexData + i * sizeof(uint16_t)));
+		vmin = vminq_u16(vmin, v);
+		if (primitiveRestart)
+			v = vbicq_u16(v, vceqq_u16(v, restart));
+		vmax = vmaxq_u16(vmax, v);
+	}
+
+	IndexBounds bounds = { horizontalMin16(vmin), horizontalMax16(vmax) };
+	bounds = scanBoundsScalar<uint16_t>(indexData + count * sizeof(uint16_t), indexCount - count, primitiveRestart,
+	                                    bounds);
+	return finishBounds<uint16_t>(bounds, primitiveRestart);
+}
+
+static IndexBounds scanBounds32NEON(const uint8_t *indexData, uint32_t indexCount, bool primitiveRestart)
+{
+	const uint32_t count = indexCount & ~3u;
+	if (!count)
+		return scanBoundsScalar<uint32_t>(indexData, indexCount, primitiveRestart);
+
+	const uint32x4_t restart = vdupq_n_u32(0xffffffffu);
+	uint32x4_t vmin = vdupq_n_u32(0xffffffffu);
+	uint32x4_t vmax = vdupq_n_u32(0);
+
+	for (uint32_t i = 0; i < count; i += 4)
+	{
+		uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(indexData + i * sizeof(uint32_t)));
+		vmin = vminq_u32(vmin, v);
+		if (primitiveRestart)
+			v = vbicq_u32(v, vceqq_u32(v, restart));
+		vmax = vmaxq_u32(vmax, v);
+	}
+
+	IndexBounds bounds = { horizontalMin32(vmin), horizontalMax32(vmax) };
+	bounds = scanBoundsScalar<uint32_t>(indexData + count * sizeof(uint32_t), indexCount - count, primitiveRestart,
+	                                    bounds);
+	return finishBounds<uint32_t>(bounds, primitiveRestart);
+}
+#endif
+
+struct IndexScanKernels
+{
+	IndexBoundsFunc bounds16;
+	IndexBoundsFunc bounds32;
+};
+
+static IndexScanKernels selectKernels()
+{
+	IndexScanKernels kernels = { scanBoundsScalar<uint16_t>, scanBoundsScalar<uint32_t> };
+
+#if defined(MPD_INDEX_SCAN_X86)
+	if (cpuSupportsAVX2())
+	{
+		kernels.bounds16 = scanBounds16AVX2;
+		kernels.bounds32 = scanBounds32AVX2;
+	}
+	else if (cpuSupportsSSE41())
+	{
+		kernels.bounds16 = scanBounds16SSE41;
+		kernels.bounds32 = scanBounds32SSE41;
+	}
+#elif defined(MPD_INDEX_SCAN_NEON)
+	// NEON is part of the target ABI when the compiler enables it, no runtime check needed.
+	kernels.bounds16 = scanBounds16NEON;
+	kernels.bounds32 = scanBounds32NEON;
+#endif
+
+	return kernels;
+}
+
+IndexBounds scanIndexBounds(const uint8_t *indexData, VkIndexType indexType, uint32_t indexCount,
+                            bool primitiveRestart)
+{
+	// Selected once, thread-safe as a function local static.
+	static const IndexScanKernels kernels = selectKernels();
+
+	if (indexType == VK_INDEX_TYPE_UINT16)
+		return kernels.bounds16(indexData, indexCount, primitiveRestart);
+	else
+		return kernels.bounds32(indexData, indexCount, primitiveRestart);
+}
+
+static inline uint32_t popcount64(uint64_t bits)
+{
+#ifdef _MSC_VER
+	return uint32_t(__popcnt(uint32_t(bits))) + uint32_t(__popcnt(uint32_t(bits >> 32)));
+#else
+	return uint32_t(__builtin_popcountll(bits));
+#endif
+}
+
+// Returns true if any bit in [begin, end) is set.
+static bool anyBitSet(const uint64_t *bits, uint64_t begin, uint64_t end)
+{
+	while (begin < end)
+	{
+		uint64_t word = bits[begin / 64];
+		uint64_t bit = begin & 63;
+		uint64_t count = std::min<uint64_t>(64 - bit, end - begin);
+		uint64_t mask = count == 64 ? ~0ull : (((1ull << count) - 1) << bit);
+		if (word & mask)
+			return true;
+		begin += count;
+	}
+	return false;
+}
+
+IndexBitmap &IndexBitmap::get()
+{
+	static thread_local IndexBitmap bitmap;
+	return bitmap;
+}
+
+void IndexBitmap::reset(uint32_t firstValue)
+{
+	// Only clear what the previous scan could have set.
+	if (paged)
+	{
+		for (uint32_t block : usedBlocks)
+		{
+			uint64_t *page = &pages[(pageTable[block] - 1) * size_t(PAGE_WORDS)];
+			std::fill(page, page + PAGE_WORDS, 0ull);
+			pageTable[block] = 0;
+		}
+		usedBlocks.clear();
+	}
+	else if (minValue <= maxValue)
+	{
+		auto first = flat.begin() + ((minValue - flatBase) >> 6);
+		auto last = flat.begin() + ((maxValue - flatBase) >> 6) + 1;
+		std::fill(first, last, 0ull);
+	}
+
+	if (flat.empty())
+		flat.resize(FLAT_BITS / 64);
+
+	minValue = ~0u;
+	maxValue = 0;
+	paged = false;
+	overflow = false;
+
+	// Leave room below the first value, as later indices are just as likely to be smaller.
+	flatBase = firstValue - std::min(firstValue, FLAT_BITS / 4);
+	flatBase = std::min(flatBase, uint32_t(0u - FLAT_BITS));
+}
+
+void IndexBitmap::setSlow(uint32_t value)
+{
+	if (!paged)
+	{
+		// Move what the flat window has so far over to pages.
+		paged = true;
+		if (pageTable.empty())
+			pageTable.resize(size_t(1) << (32 - PAGE_SHIFT));
+
+		for (uint32_t i = 0; i < FLAT_BITS / 64; i++)
+		{
+			uint64_t word = flat[i];
+			flat[i] = 0;
+			while (word)
+			{
+				uint32_t bit = popcount64((word & (0 - word)) - 1);
+				setPaged(flatBase + i * 64 + bit);
+				word &= word - 1;
+			}
+		}
+	}
+
+	setPaged(value);
+}
+
+void IndexBitmap::setPaged(uint32_t value)
+{
+	if (overflow)
+		return;
+
+	uint32_t block = value >> PAGE_SHIFT;
+	uint32_t page = pageTable[block];
+	if (!page)
+	{
+		if (usedBlocks.size() == MAX_PAGES)
+		{
+			overflow = true;
+			return;
+		}
+
+		usedBlocks.push_back(block);
+		page = uint32_t(usedBlocks.size());
+		pageTable[block] = uint16_t(page);
+		if (pages.size() < page * size_t(PAGE_WORDS))
+			pages.resize(page * size_t(PAGE_WORDS));
+	}
+
+	uint32_t bit = value & ((1u << PAGE_SHIFT) - 1);
+	pages[(page - 1) * size_t(PAGE_WORDS) + (bit >> 6)] |= 1ull << (bit & 63);
+}
+
+uint32_t IndexBitmap::count() const
+{
+	uint32_t total = 0;
+	if (paged)
+	{
+		for (size_t i = 0; i < usedBlocks.size() * PAGE_WORDS; i++)
+			total += popcount64(pages[i]);
+	}
+	else if (minValue <= maxValue)
+	{
+		for (uint32_t i = (minValue - flatBase) >> 6; i <= (maxValue - flatBase) >> 6; i++)
+			total += popcount64(flat[i]);
+	}
+	return total;
+}
+
+bool IndexBitmap::anySet(uint64_t begin, uint64_t end) const
+{
+	begin = std::max<uint64_t>(begin, minValue);
+	end = std::min<uint64_t>(end, uint64_t(maxValue) + 1);
+	if (begin >= end)
+		return false;
+
+	if (!paged)
+		return anyBitSet(flat.data(), begin - flatBase, end - flatBase);
+
+	while (begin < end)
+	{
+		uint64_t block = begin >> PAGE_SHIFT;
+		uint64_t blockBegin = block << PAGE_SHIFT;
+		uint64_t blockEnd = std::min(end, blockBegin + (1u << PAGE_SHIFT));
+		uint32_t page = pageTable[block];
+		if (page && anyBitSet(&pages[(page - 1) * size_t(PAGE_WORDS)], begin - blockBegin, blockEnd - blockBegin))
+			return true;
+		begin = blockEnd;
+	}
+	return false;
+}
+
+size_t IndexScanKeyHasher::operator()(const IndexScanKey &key) const
+{
+	// FNV-1a over the fields, the struct itself has padding.
+	uint64_t h = 0xcbf29ce484222325ull;
+	auto mix = [&](uint64_t value) {
+		h ^= value;
+		h *= 0x100000001b3ull;
+	};
+
+	mix(uint64_t(reinterpret_cast<uintptr_t>(key.buffer)));
+	mix(key.indexOffset);
+	mix(key.firstIndex);
+	mix(key.indexCount);
+	mix((uint64_t(key.indexType) << 1) | uint64_t(key.primitiveRestart));
+	mix(key.topology);
+	return size_t(h ^ (h >> 32));
+}
+
+IndexScanCache::IndexScanCache(size_t maxEntries)
+    : maxEntries(maxEntries)
+{
+}
+
+bool IndexScanCache::find(const IndexScanKey &key, uint64_t writeGeneration, IndexScanResult *result) const
+{
+	if (writeGeneration == UNKNOWN_GENERATION)
+		return false;
+
+	lock_guard<mutex> holder{ lock };
+	auto itr = entries.find(key);
+	if (itr == end(entries) || itr->second.writeGeneration != writeGeneration)
+		return false;
+
+	if (result)
+		*result = itr->second.result;
+	return true;
+}
+
+void IndexScanCache::insert(const IndexScanKey &key, uint64_t writeGeneration, const IndexScanResult &result)
+{
+	if (writeGeneration == UNKNOWN_GENERATION)
+		return;
+
+	lock_guard<mutex> holder{ lock };
+
+	// Streamed geometry keeps adding ranges which are never drawn again.
+	// Rather than tracking how recently entries were used, start over when the cache is full.
+	if (entries.size() >= maxEntries && entries.find(key) == end(entries))
+		entries.clear();
+
+	auto &entry = entries[key];
+	entry.writeGeneration = writeGeneration;
+	entry.result = result;
+}
+
+void IndexScanCache::removeBuffer(const Buffer *buffer)
+{
+	lock_guard<mutex> holder{ lock };
+	for (auto itr = begin(entries); itr != end(entries);)
+	{
+		if (itr->first.buffer == buffer)
+			itr = entries.erase(itr);
+		else
+			++itr;
+	}
+}
+
+void IndexScanCache::clear()
+{
+	lock_guard<mutex> holder{ lock };
+	entries.clear();
+}
+
+IndexScanScheduler::IndexScanScheduler(uint64_t byteBudget, uint64_t timeBudgetNanoseconds, size_t maxEntries)
+    : maxEntries(maxEntries)
+    , byteBudget(byteBudget)
+    , timeBudget(timeBudgetNanoseconds)
+{
+}
+
+IndexScanScheduler::Entry &IndexScanScheduler::getEntry(const IndexScanKey &key)
+{
+	// Forgetting draws only means they are treated as new.
+	if (entries.size() >= maxEntries && entries.find(key) == end(entries))
+		entries.clear();
+	return entries[key];
+}
+
+bool IndexScanScheduler::admit(const IndexScanKey &key)
+{
+	lock_guard<mutex> holder{ lock };
+
+	auto itr = entries.find(key);
+	bool scannedBefore = itr != end(entries) && !itr->second.owed;
+
+	if (!hasBudget())
+	{
+		exhausted = true;
+		getEntry(key).owed = true;
+		return false;
+	}
+
+	// Let draws which were turned away catch up before rescanning anything.
+	if (scannedBefore && exhaustedLastFrame)
+		return false;
+
+	uint32_t stride = key.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	bytesUsed += uint64_t(stride) * key.indexCount;
+	getEntry(key).owed = false;
+	return true;
+}
+
+void IndexScanScheduler::chargeTime(uint64_t nanoseconds)
+{
+	lock_guard<mutex> holder{ lock };
+	timeUsed += nanoseconds;
+}
+
+void IndexScanScheduler::nextFrame()
+{
+	lock_guard<mutex> holder{ lock };
+	exhaustedLastFrame = exhausted;
+	exhausted = false;
+	bytesUsed = 0;
+	timeUsed = 0;
+}
+}
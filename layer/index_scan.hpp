@@ -0,0 +1,225 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include <algorithm>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace MPD
+{
+class Buffer;
+
+struct IndexBounds
+{
+	// If no index was used (every index was a primitive restart), minValue is ~0u and maxValue is 0.
+	uint32_t minValue;
+	uint32_t maxValue;
+};
+
+/// Finds the smallest and largest index used, skipping the primitive restart value if primitiveRestart is set.
+/// Uses AVX2, SSE4.1 or NEON when the CPU supports it, the result is identical to the scalar loop.
+/// indexData does not need to be aligned.
+IndexBounds scanIndexBounds(const uint8_t *indexData, VkIndexType indexType, uint32_t indexCount,
+                            bool primitiveRestart);
+
+/// The set of index values used by a drawcall. Memory is kept from scan to scan, so scanning does not allocate.
+///
+/// The indices of a drawcall are usually close to each other, so values are stored in a flat window placed around
+/// the first value. The first value outside the window switches the bitmap to pages, which are only allocated where
+/// values fall. Values too scattered to fit in MAX_PAGES pages overflow the bitmap, and are no longer counted.
+class IndexBitmap
+{
+public:
+	/// Returns the bitmap of the calling thread.
+	static IndexBitmap &get();
+
+	/// Clears the values of the previous scan, and places the flat window for the next one.
+	/// Must be called before the first value of every scan.
+	void reset(uint32_t firstValue);
+
+	void set(uint32_t value)
+	{
+		minValue = std::min(minValue, value);
+		maxValue = std::max(maxValue, value);
+
+		uint32_t offset = value - flatBase;
+		if (!paged && offset < FLAT_BITS)
+			flat[offset >> 6] |= 1ull << (offset & 63);
+		else
+			setSlow(value);
+	}
+
+	/// If set, count() and anySet() do not know about every value.
+	bool overflowed() const
+	{
+		return overflow;
+	}
+
+	/// Number of distinct values.
+	uint32_t count() const;
+
+	/// Returns true if any value in [begin, end) is set.
+	bool anySet(uint64_t begin, uint64_t end) const;
+
+private:
+	static const uint32_t FLAT_BITS = 1u << 16;
+	static const uint32_t PAGE_SHIFT = 16;
+	static const uint32_t PAGE_WORDS = (1u << PAGE_SHIFT) / 64;
+	static const uint32_t MAX_PAGES = 64;
+
+	std::vector<uint64_t> flat;
+	uint32_t flatBase = 0;
+
+	// Page number + 1 of every aligned block of 2^PAGE_SHIFT values, 0 if it has no page.
+	std::vector<uint16_t> pageTable;
+	std::vector<uint64_t> pages;
+	std::vector<uint32_t> usedBlocks;
+
+	uint32_t minValue = ~0u;
+	uint32_t maxValue = 0;
+	bool paged = false;
+	bool overflow = false;
+
+	void setSlow(uint32_t value);
+	void setPaged(uint32_t value);
+};
+
+/// Identifies the indices read by an indexed drawcall.
+struct IndexScanKey
+{
+	Buffer *buffer;
+	VkDeviceSize indexOffset;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	VkIndexType indexType;
+	VkPrimitiveTopology topology;
+	bool primitiveRestart;
+
+	bool operator==(const IndexScanKey &other) const
+	{
+		return buffer == other.buffer && indexOffset == other.indexOffset && firstIndex == other.firstIndex &&
+		       indexCount == other.indexCount && indexType == other.indexType && topology == other.topology &&
+		       primitiveRestart == other.primitiveRestart;
+	}
+};
+
+struct IndexScanKeyHasher
+{
+	size_t operator()(const IndexScanKey &key) const;
+};
+
+struct IndexScanResult
+{
+	uint32_t minValue;
+	uint32_t maxValue;
+	float utilization;
+	float cacheHitRate;
+};
+
+/// Remembers which index ranges have been scanned, so static meshes are only scanned (and reported) once.
+/// Each result is tagged with the write generation of the DeviceMemory the indices were read from,
+/// and only matches as long as the memory has not been written to since.
+/// Thread-safe, indices can be scanned while recording, at submit or on the analysis worker.
+class IndexScanCache
+{
+public:
+	/// Write generation of indices which may have changed while they were read. Never matches and is never stored.
+	static const uint64_t UNKNOWN_GENERATION = ~0ull;
+
+	explicit IndexScanCache(size_t maxEntries);
+
+	/// Returns true if the range was scanned at this write generation.
+	/// If result is non-null, it receives the result of that scan.
+	bool find(const IndexScanKey &key, uint64_t writeGeneration, IndexScanResult *result = nullptr) const;
+	void insert(const IndexScanKey &key, uint64_t writeGeneration, const IndexScanResult &result);
+
+	/// Drops every result for the buffer, so a new buffer at the same address does not match them.
+	void removeBuffer(const Buffer *buffer);
+
+	/// Drops every result, for when writes to index buffers may have been missed.
+	void clear();
+
+private:
+	struct Entry
+	{
+		uint64_t writeGeneration;
+		IndexScanResult result;
+	};
+
+	mutable std::mutex lock;
+	std::unordered_map<IndexScanKey, Entry, IndexScanKeyHasher> entries;
+	size_t maxEntries;
+};
+
+/// Limits how much index data is scanned per frame, for when scanning every draw is too expensive.
+///
+/// Draws are offered in submission order, and only draws which actually need a scan are offered.
+/// Draws which have never been scanned are always admitted while there is budget left.
+/// A draw turned away for lack of budget is owed a scan and is admitted first thing next time.
+/// Draws which have been scanned before (and need a rescan) wait for a frame which had budget to spare,
+/// so a budget which is too small for the whole frame rotates through the draws instead of rescanning the first ones.
+/// Thread-safe.
+class IndexScanScheduler
+{
+public:
+	/// A budget of 0 is unlimited.
+	IndexScanScheduler(uint64_t byteBudget, uint64_t timeBudgetNanoseconds, size_t maxEntries);
+
+	/// Returns true if the draw should be scanned now, and charges its indices against the budget.
+	bool admit(const IndexScanKey &key);
+
+	/// Charges the time spent scanning against the budget.
+	void chargeTime(uint64_t nanoseconds);
+
+	/// Starts a new budget period.
+	void nextFrame();
+
+private:
+	struct Entry
+	{
+		bool owed;
+	};
+
+	std::mutex lock;
+	std::unordered_map<IndexScanKey, Entry, IndexScanKeyHasher> entries;
+	size_t maxEntries;
+
+	uint64_t byteBudget;
+	uint64_t timeBudget;
+	uint64_t bytesUsed = 0;
+	uint64_t timeUsed = 0;
+
+	// Whether a draw was turned away for lack of budget, this frame and last frame.
+	bool exhausted = false;
+	bool exhaustedLastFrame = false;
+
+	Entry &getEntry(const IndexScanKey &key);
+
+	bool hasBudget() const
+	{
+		return (!byteBudget || bytesUsed < byteBudget) && (!timeBudget || timeUsed < timeBudget);
+	}
+};
+}
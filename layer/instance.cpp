@@ -157,6 +157,20 @@ bool Instance::init(VkInstance instance_, VkLayerInstanceDispatchTable *pTable_,
 		cfg.loggingFilename = logFilename;
 #endif
 
+	if (cfg.loggingAsyncEnable)
+		logger.enableAsync(size_t(cfg.loggingAsyncQueueSize), cfg.loggingAsyncBlockWhenFull);
+
+	if (cfg.messageFilterEnable)
+	{
+		MessageFilter::Options options;
+		options.repeatLimit = uint32_t(cfg.messageFilterRepeatLimit);
+		options.ratePerSecond = cfg.messageFilterRatePerSecond;
+		options.burst = uint32_t(cfg.messageFilterBurst);
+		options.summarySeconds = uint32_t(cfg.messageFilterSummarySeconds);
+		options.maxEntries = size_t(cfg.messageFilterTableSize);
+		logger.enableFilter(options);
+	}
+
 	// Setup custom logging callbacks.
 	if (!cfg.loggingFilename.empty())
 	{
@@ -193,6 +207,11 @@ bool Instance::init(VkInstance instance_, VkLayerInstanceDispatchTable *pTable_,
 			logger.createAndRegisterCallback(VK_NULL_HANDLE, ci);
 		}
 #endif
+		else if (cfg.loggingBinary)
+		{
+			// Records are decoded offline, so there is no callback to register.
+			logger.openBinaryLog(path.c_str());
+		}
 		else
 		{
 			// This is a regular file.
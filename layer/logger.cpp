@@ -19,6 +19,11 @@
  */
 
 #include "logger.hpp"
+#include "binary_log.hpp"
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
 
 using namespace std;
 
@@ -31,6 +36,17 @@ Logger::Logger()
 
 Logger::~Logger()
 {
+	if (thread.joinable())
+	{
+		{
+			lock_guard<mutex> holder{ sleepLock };
+			stopping = true;
+		}
+		sleepCond.notify_one();
+
+		// The writer delivers all queued messages before it exits.
+		thread.join();
+	}
 }
 
 struct LoggerCallback
@@ -53,18 +69,24 @@ LoggerCallback *Logger::createAndRegisterCallback(VkDebugReportCallbackEXT callb
 	pCallback->pUserData = createInfo.pUserData;
 
 	auto *ret = pCallback.get();
+	lock_guard<RWSpinLock> holder{ callbackLock };
 	debugCallbacks[callback] = move(pCallback);
 	return ret;
 }
 
 void Logger::unregisterAndDestroyCallback(VkDebugReportCallbackEXT callback)
 {
+	// The callback should still see what was logged before it was destroyed.
+	flush();
+
+	lock_guard<RWSpinLock> holder{ callbackLock };
 	auto itr = debugCallbacks.find(callback);
 	debugCallbacks.erase(itr);
 }
 
-void Logger::write(const LoggerMessageInfo &inf, const char *msg)
+void Logger::deliver(const LoggerMessageInfo &inf, const char *msg)
 {
+	ReadLockGuard holder{ callbackLock };
 	for (const auto &callback : debugCallbacks)
 	{
 		auto &cb = callback.second;
@@ -77,4 +99,255 @@ void Logger::write(const LoggerMessageInfo &inf, const char *msg)
 		}
 	}
 }
+
+void Logger::enableAsync(size_t queueSize, bool blockWhenFull)
+{
+	MPD_ASSERT(!records);
+
+	capacity = 1;
+	while (capacity < queueSize)
+		capacity <<= 1;
+	this->blockWhenFull = blockWhenFull;
+
+	records.reset(new Record[capacity]);
+	for (uint64_t i = 0; i < capacity; i++)
+		records[i].sequence.store(i, memory_order_relaxed);
+
+	thread = std::thread(&Logger::run, this);
+}
+
+Logger::Record *Logger::claim(uint64_t &pos)
+{
+	pos = enqueuePos.load(memory_order_relaxed);
+	for (;;)
+	{
+		auto &record = records[pos & (capacity - 1)];
+		uint64_t sequence = record.sequence.load(memory_order_acquire);
+		int64_t diff = int64_t(sequence - pos);
+
+		if (diff == 0)
+		{
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				return &record;
+		}
+		else if (diff < 0)
+		{
+			// The writer has not delivered the message a lap ago yet.
+			// A callback which calls back into the layer runs on the writer thread, which would wait for itself.
+			if (!blockWhenFull || this_thread::get_id() == thread.get_id())
+			{
+				dropped.fetch_add(1, memory_order_relaxed);
+				return nullptr;
+			}
+			this_thread::yield();
+			pos = enqueuePos.load(memory_order_relaxed);
+		}
+		else
+			pos = enqueuePos.load(memory_order_relaxed);
+	}
+}
+
+void Logger::publish(Record &record, uint64_t pos)
+{
+	record.sequence.store(pos + 1, memory_order_seq_cst);
+
+	// Only take the lock if the writer might be waiting for us.
+	if (sleeping.load(memory_order_seq_cst))
+	{
+		lock_guard<mutex> holder{ sleepLock };
+		sleepCond.notify_one();
+	}
+}
+
+void Logger::write(const LoggerMessageInfo &inf, const char *msg)
+{
+	if (binaryLog)
+	{
+		binaryLog->writeText(inf, msg);
+		if (!hasCallbacks())
+			return;
+	}
+
+	if (!records)
+	{
+		deliver(inf, msg);
+		return;
+	}
+
+	uint64_t pos;
+	auto *record = claim(pos);
+	if (!record)
+		return;
+
+	record->info = inf;
+	size_t len = strlen(msg);
+	if (len < INLINE_TEXT_SIZE)
+		memcpy(record->text, msg, len + 1);
+	else
+	{
+		record->longText.reset(new char[len + 1]);
+		memcpy(record->longText.get(), msg, len + 1);
+	}
+	publish(*record, pos);
+}
+
+bool Logger::openBinaryLog(const char *path)
+{
+	binaryLog.reset(new BinaryLog);
+	if (!binaryLog->init(path))
+	{
+		binaryLog.reset();
+		return false;
+	}
+	return true;
+}
+
+void Logger::nextFrame()
+{
+	if (binaryLog)
+		binaryLog->nextFrame();
+
+	// Messages which were suppressed right before the application stopped logging are still summarized on time.
+	if (filter)
+		writeFilterSummary(false);
+}
+
+void Logger::writeFrameStats(uint64_t frameTimeNs, const uint64_t *counters, uint32_t counterCount)
+{
+	if (binaryLog)
+		binaryLog->writeFrame(frameTimeNs, counters, counterCount);
+}
+
+bool Logger::hasCallbacks()
+{
+	ReadLockGuard holder{ callbackLock };
+	return !debugCallbacks.empty();
+}
+
+void Logger::enableFilter(const MessageFilter::Options &options)
+{
+	filter.reset(new MessageFilter(options));
+}
+
+void Logger::writeFilterSummary(bool force)
+{
+	string summary;
+	if (!filter->takeSummary(summary, force))
+		return;
+
+	LoggerMessageInfo info;
+	info.flags = VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT;
+	info.messageCode = 0;
+	info.object = 0;
+	info.objectType = VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT;
+	write(info, summary.c_str());
+}
+
+void Logger::writeFormatted(const LoggerMessageInfo &inf, const char *fmt, va_list args)
+{
+	if (filter)
+	{
+		writeFilterSummary(false);
+		if (!filter->admit(inf.messageCode, inf.object, fmt))
+			return;
+	}
+
+	if (binaryLog)
+	{
+		va_list binaryArgs;
+		va_copy(binaryArgs, args);
+		binaryLog->write(inf, fmt, binaryArgs);
+		va_end(binaryArgs);
+
+		// Only format the message if someone is going to read it.
+		if (!hasCallbacks())
+			return;
+	}
+
+	if (!records)
+	{
+		char buffer[1024 * 10];
+		vsnprintf(buffer, sizeof(buffer), fmt, args);
+		deliver(inf, buffer);
+		return;
+	}
+
+	uint64_t pos;
+	auto *record = claim(pos);
+	if (!record)
+		return;
+
+	// Format straight into the record, and only go to the heap if the message is too long for it.
+	va_list retry;
+	va_copy(retry, args);
+	record->info = inf;
+	int len = vsnprintf(record->text, INLINE_TEXT_SIZE, fmt, args);
+	if (len >= int(INLINE_TEXT_SIZE))
+	{
+		record->longText.reset(new char[size_t(len) + 1]);
+		vsnprintf(record->longText.get(), size_t(len) + 1, fmt, retry);
+	}
+	va_end(retry);
+	publish(*record, pos);
+}
+
+void Logger::flush()
+{
+	if (filter)
+		writeFilterSummary(true);
+
+	if (!records || this_thread::get_id() == thread.get_id())
+		return;
+
+	uint64_t pos = enqueuePos.load(memory_order_acquire);
+	while (delivered.load(memory_order_acquire) < pos)
+		this_thread::yield();
+}
+
+void Logger::run()
+{
+	for (;;)
+	{
+		uint64_t pos = delivered.load(memory_order_relaxed);
+		auto &record = records[pos & (capacity - 1)];
+
+		if (record.sequence.load(memory_order_acquire) != pos + 1)
+		{
+			// Report drops once the burst which caused them has been delivered.
+			uint64_t droppedCount = dropped.exchange(0, memory_order_relaxed);
+			if (droppedCount)
+			{
+				char msg[128];
+				snprintf(msg, sizeof(msg), "%llu messages were dropped, the logging queue was full.",
+				         static_cast<unsigned long long>(droppedCount));
+
+				LoggerMessageInfo info;
+				info.flags = VK_DEBUG_REPORT_WARNING_BIT_EXT;
+				info.messageCode = 0;
+				info.object = 0;
+				info.objectType = VK_DEBUG_REPORT_OBJECT_TYPE_UNKNOWN_EXT;
+				deliver(info, msg);
+			}
+
+			sleeping.store(true, memory_order_seq_cst);
+			if (record.sequence.load(memory_order_seq_cst) != pos + 1)
+			{
+				unique_lock<mutex> holder{ sleepLock };
+				sleepCond.wait(holder,
+				               [&] { return stopping || record.sequence.load(memory_order_acquire) == pos + 1; });
+				if (record.sequence.load(memory_order_acquire) != pos + 1)
+				{
+					sleeping.store(false, memory_order_relaxed);
+					return;
+				}
+			}
+			sleeping.store(false, memory_order_relaxed);
+		}
+
+		deliver(record.info, record.longText ? record.longText.get() : record.text);
+		record.longText.reset();
+		record.sequence.store(pos + capacity, memory_order_release);
+		delivered.store(pos + 1, memory_order_release);
+	}
+}
 }
@@ -19,9 +19,16 @@
  */
 
 #pragma once
+#include "message_filter.hpp"
 #include "perfdoc.hpp"
+#include "rw_spinlock.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
@@ -31,6 +38,7 @@ namespace MPD
 
 // Opaque, only used internally.
 struct LoggerCallback;
+class BinaryLog;
 
 struct LoggerMessageInfo
 {
@@ -41,6 +49,10 @@ struct LoggerMessageInfo
 };
 
 /// The main logger.
+///
+/// By default messages are delivered to the callbacks by the thread which logs them.
+/// Once enableAsync() is called, messages are formatted straight into a bounded ring of records instead,
+/// which any number of threads can fill without taking a lock, and a writer thread delivers them in order.
 class Logger
 {
 public:
@@ -53,12 +65,83 @@ public:
 	LoggerCallback *createAndRegisterCallback(VkDebugReportCallbackEXT callback,
 	                                          const VkDebugReportCallbackCreateInfoEXT &createInfo);
 
+	/// Delivers the messages written so far first, see flush().
 	void unregisterAndDestroyCallback(VkDebugReportCallbackEXT callback);
 
+	/// Starts the writer thread. queueSize is rounded up to a power of two.
+	/// If blockWhenFull is false, messages which do not fit in the queue are dropped and counted.
+	/// Messages logged by a callback on the writer thread are always dropped when the queue is full.
+	/// Must be called before any message is written.
+	void enableAsync(size_t queueSize, bool blockWhenFull);
+
+	/// Drops repeated messages before they are formatted, see MessageFilter.
+	/// Must be called before any message is written.
+	void enableFilter(const MessageFilter::Options &options);
+
+	/// Records every message in a binary log at path, see BinaryLog. Messages are still formatted and delivered
+	/// to the callbacks if there are any. Must be called before any message is written.
+	bool openBinaryLog(const char *path);
+
+	/// Called at every vkQueuePresentKHR, messages are tagged with the frame in the binary log.
+	/// Also writes the summary of suppressed messages if one is due.
+	void nextFrame();
+
+	/// Records per-frame counters in the binary log, if there is one.
+	void writeFrameStats(uint64_t frameTimeNs, const uint64_t *counters, uint32_t counterCount);
+
+	/// Waits until every message written so far has been delivered, including a summary of suppressed messages.
+	/// Must not be called with the global lock held, the writer thread would wait on it if a callback calls
+	/// back into the layer. Does not wait when called from a callback on the writer thread.
+	void flush();
+
 	/// Send a formated message.
+	/// Can be called from any thread, e.g. while command buffers are recorded concurrently.
 	void write(const LoggerMessageInfo &inf, const char *msg);
 
+	/// Formats and sends a message, the va_list is consumed.
+	/// The format string identifies the call site for the message filter.
+	void writeFormatted(const LoggerMessageInfo &inf, const char *fmt, va_list args);
+
 private:
 	std::unordered_map<VkDebugReportCallbackEXT, std::unique_ptr<LoggerCallback>> debugCallbacks;
+	RWSpinLock callbackLock;
+	std::unique_ptr<MessageFilter> filter;
+	std::unique_ptr<BinaryLog> binaryLog;
+
+	// Messages which do not fit are kept on the heap.
+	static const size_t INLINE_TEXT_SIZE = 1024;
+
+	struct Record
+	{
+		// Sequencing of Vyukov's bounded queue: the record is free for the message at position p when
+		// sequence == p, and holds that message once sequence == p + 1.
+		std::atomic<uint64_t> sequence;
+		LoggerMessageInfo info;
+		std::unique_ptr<char[]> longText;
+		char text[INLINE_TEXT_SIZE];
+	};
+
+	std::unique_ptr<Record[]> records;
+	uint64_t capacity = 0;
+	bool blockWhenFull = false;
+
+	std::atomic<uint64_t> enqueuePos{ 0 };
+	// Only written by the writer thread.
+	std::atomic<uint64_t> delivered{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+
+	// Only used to put the writer to sleep when there is nothing to do.
+	std::mutex sleepLock;
+	std::condition_variable sleepCond;
+	std::atomic<bool> sleeping{ false };
+	bool stopping = false;
+	std::thread thread;
+
+	void deliver(const LoggerMessageInfo &inf, const char *msg);
+	bool hasCallbacks();
+	void writeFilterSummary(bool force);
+	Record *claim(uint64_t &pos);
+	void publish(Record &record, uint64_t pos);
+	void run();
 };
 }
@@ -81,6 +81,11 @@ enum MessageCodes
 	MESSAGE_CODE_SUBPASS_STENCIL_SELF_DEPENDENCY = 50,
 	MESSAGE_CODE_INEFFICIENT_DEPTH_STENCIL_OPS = 51,
 	MESSAGE_CODE_QUERY_BUNDLE_TOO_SMALL = 52,
+	MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE = 53,
+	MESSAGE_CODE_FRAME_STATISTICS = 54,
+	MESSAGE_CODE_TILE_BANDWIDTH_BUDGET = 55,
+	MESSAGE_CODE_TILE_BANDWIDTH_RANKING = 56,
+	MESSAGE_CODE_CAPTURE_WINDOW = 57,
 
 	MESSAGE_CODE_COUNT
 };
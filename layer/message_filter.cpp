@@ -0,0 +1,178 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "message_filter.hpp"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace std;
+
+namespace MPD
+{
+size_t MessageFilter::KeyHasher::operator()(const Key &key) const
+{
+	// FNV-1a over the fields, the struct itself has padding.
+	uint64_t h = 0xcbf29ce484222325ull;
+	auto mix = [&](uint64_t value) {
+		h ^= value;
+		h *= 0x100000001b3ull;
+	};
+
+	mix(uint64_t(uint32_t(key.messageCode)));
+	mix(key.object);
+	mix(uint64_t(reinterpret_cast<uintptr_t>(key.callSite)));
+	return size_t(h ^ (h >> 32));
+}
+
+MessageFilter::MessageFilter(const Options &options)
+    : options(options)
+    , maxEntriesPerShard(options.maxEntries / SHARD_COUNT + 1)
+    , lastSummary(chrono::steady_clock::now())
+{
+	for (auto &bucket : buckets)
+	{
+		bucket.tokens = double(options.burst);
+		bucket.lastRefill = lastSummary;
+	}
+
+	for (auto &count : suppressed)
+		count.store(0, memory_order_relaxed);
+
+	auto interval = chrono::duration_cast<chrono::steady_clock::duration>(chrono::seconds(options.summarySeconds));
+	nextSummary.store(int64_t((lastSummary + interval).time_since_epoch().count()), memory_order_relaxed);
+}
+
+uint32_t MessageFilter::getBucket(int32_t messageCode)
+{
+	if (messageCode > 0 && messageCode < MESSAGE_CODE_COUNT)
+		return uint32_t(messageCode);
+	else
+		return BUCKET_COUNT - 1;
+}
+
+bool MessageFilter::takeToken(uint32_t bucketIndex)
+{
+	auto now = chrono::steady_clock::now();
+	lock_guard<mutex> holder{ bucketLock };
+
+	auto &bucket = buckets[bucketIndex];
+	double elapsed = chrono::duration<double>(now - bucket.lastRefill).count();
+	bucket.lastRefill = now;
+	bucket.tokens = std::min(bucket.tokens + elapsed * options.ratePerSecond, double(std::max(options.burst, 1u)));
+
+	if (bucket.tokens < 1.0)
+		return false;
+
+	bucket.tokens -= 1.0;
+	return true;
+}
+
+bool MessageFilter::admit(int32_t messageCode, uint64_t object, const void *callSite)
+{
+	Key key = { messageCode, object, callSite };
+	size_t hash = KeyHasher()(key);
+	auto &shard = shards[(hash >> 8) % SHARD_COUNT];
+
+	uint64_t count;
+	{
+		lock_guard<mutex> holder{ shard.lock };
+
+		// Objects come and go, so rather than tracking which entries are stale, start over once the shard is full.
+		// Messages which were suppressed get reported again up to repeatLimit times.
+		auto itr = shard.counts.find(key);
+		if (itr == end(shard.counts))
+		{
+			if (shard.counts.size() >= maxEntriesPerShard)
+				shard.counts.clear();
+			itr = shard.counts.insert(make_pair(key, uint64_t(0))).first;
+		}
+		count = ++itr->second;
+	}
+
+	uint32_t bucket = getBucket(messageCode);
+	if ((options.repeatLimit && count > options.repeatLimit) ||
+	    (options.ratePerSecond > 0.0 && !takeToken(bucket)))
+	{
+		suppressed[bucket].fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+// Groups thousands, e.g. 12,431.
+static string formatCount(uint64_t count)
+{
+	string digits = to_string(count);
+	string formatted;
+	for (size_t i = 0; i < digits.size(); i++)
+	{
+		if (i && (digits.size() - i) % 3 == 0)
+			formatted += ',';
+		formatted += digits[i];
+	}
+	return formatted;
+}
+
+bool MessageFilter::takeSummary(string &summary, bool force)
+{
+	if (!force && !options.summarySeconds)
+		return false;
+
+	auto now = chrono::steady_clock::now();
+	if (!force && int64_t(now.time_since_epoch().count()) < nextSummary.load(memory_order_relaxed))
+		return false;
+
+	double seconds;
+	{
+		lock_guard<mutex> holder{ summaryLock };
+		auto interval = chrono::duration_cast<chrono::steady_clock::duration>(chrono::seconds(options.summarySeconds));
+		if (!force && now - lastSummary < interval)
+			return false;
+
+		seconds = chrono::duration<double>(now - lastSummary).count();
+		lastSummary = now;
+		nextSummary.store(int64_t((now + interval).time_since_epoch().count()), memory_order_relaxed);
+	}
+
+	uint64_t total = 0;
+	string codes;
+	for (uint32_t i = 0; i < BUCKET_COUNT; i++)
+	{
+		uint64_t count = suppressed[i].exchange(0, memory_order_relaxed);
+		if (!count)
+			continue;
+
+		total += count;
+		if (!codes.empty())
+			codes += ", ";
+		codes += (i == BUCKET_COUNT - 1 ? string("other") : to_string(i)) + ": " + formatCount(count);
+	}
+
+	if (!total)
+		return false;
+
+	char header[128];
+	snprintf(header, sizeof(header), "in the last %.0f seconds", seconds);
+	summary = "Suppressed " + formatCount(total) + " occurrences of repeated messages " + header +
+	          " (message code: occurrences): " + codes + ".";
+	return true;
+}
+}
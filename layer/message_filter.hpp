@@ -0,0 +1,114 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "message_codes.hpp"
+#include "perfdoc.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+namespace MPD
+{
+/// Decides whether a message is worth formatting, so repeated findings cost a table lookup.
+///
+/// A message is identified by its message code, the object it is about and its call site (the format string).
+/// Each one is reported the first repeatLimit times and only counted afterwards.
+/// On top of that, each message code gets a token bucket which limits how fast it can be reported.
+/// Suppressed messages are summarized periodically, when a message is logged or a frame ends. Thread-safe.
+class MessageFilter
+{
+public:
+	struct Options
+	{
+		uint32_t repeatLimit;
+		double ratePerSecond;
+		uint32_t burst;
+		uint32_t summarySeconds;
+		size_t maxEntries;
+	};
+
+	explicit MessageFilter(const Options &options);
+
+	MessageFilter(const MessageFilter &) = delete;
+	void operator=(const MessageFilter &) = delete;
+
+	/// Returns true if the message should be formatted and delivered.
+	bool admit(int32_t messageCode, uint64_t object, const void *callSite);
+
+	/// Returns true and describes the suppressed messages if the summary interval has passed since the last
+	/// summary, or if force is set, and anything was suppressed.
+	bool takeSummary(std::string &summary, bool force);
+
+private:
+	static const uint32_t SHARD_COUNT = 16;
+	// Message codes outside of the enum share the last bucket.
+	static const uint32_t BUCKET_COUNT = MESSAGE_CODE_COUNT + 1;
+	struct Key
+	{
+		int32_t messageCode;
+		uint64_t object;
+		const void *callSite;
+
+		bool operator==(const Key &other) const
+		{
+			return messageCode == other.messageCode && object == other.object && callSite == other.callSite;
+		}
+	};
+
+	struct KeyHasher
+	{
+		size_t operator()(const Key &key) const;
+	};
+
+	struct Shard
+	{
+		std::mutex lock;
+		std::unordered_map<Key, uint64_t, KeyHasher> counts;
+	};
+
+	struct Bucket
+	{
+		double tokens;
+		std::chrono::steady_clock::time_point lastRefill;
+	};
+
+	Options options;
+	size_t maxEntriesPerShard;
+	Shard shards[SHARD_COUNT];
+
+	std::mutex bucketLock;
+	Bucket buckets[BUCKET_COUNT];
+
+	std::atomic<uint64_t> suppressed[BUCKET_COUNT];
+
+	// When the next summary is due, in steady_clock ticks, so most calls to takeSummary() don't take the lock.
+	std::atomic<int64_t> nextSummary;
+
+	std::mutex summaryLock;
+	std::chrono::steady_clock::time_point lastSummary;
+
+	static uint32_t getBucket(int32_t messageCode);
+	bool takeToken(uint32_t bucket);
+};
+}
@@ -0,0 +1,118 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "object_registry.hpp"
+
+using namespace std;
+
+namespace MPD
+{
+namespace
+{
+struct alignas(64) ReaderSlot
+{
+	// The epoch the lookup in flight announced, IDLE_EPOCH if there is none.
+	atomic<uint64_t> epoch;
+	atomic<bool> owned;
+};
+
+const uint64_t IDLE_EPOCH = 0;
+
+// Zero-initialized before any constructor runs, so lookups during static initialization are fine.
+ReaderSlot readerSlots[RegistryReaders::MAX_SLOTS];
+atomic<uint64_t> currentEpoch{ 1 };
+atomic<uint32_t> overflowReaders{ 0 };
+
+// Gives the slot back when the thread exits.
+struct ThreadSlot
+{
+	ReaderSlot *slot = nullptr;
+	bool acquired = false;
+
+	~ThreadSlot()
+	{
+		if (slot)
+			slot->owned.store(false, memory_order_release);
+	}
+};
+
+ReaderSlot *getThreadSlot()
+{
+	static thread_local ThreadSlot threadSlot;
+	if (!threadSlot.acquired)
+	{
+		threadSlot.acquired = true;
+		for (auto &slot : readerSlots)
+		{
+			if (!slot.owned.load(memory_order_relaxed) && !slot.owned.exchange(true, memory_order_acquire))
+			{
+				threadSlot.slot = &slot;
+				break;
+			}
+		}
+	}
+	return threadSlot.slot;
+}
+}
+
+atomic<uint64_t> *RegistryReaders::enter()
+{
+	auto *slot = getThreadSlot();
+	if (!slot)
+	{
+		overflowReaders.fetch_add(1, memory_order_seq_cst);
+		return nullptr;
+	}
+
+	// Seeing an epoch started by retire() means seeing the table published before it.
+	// The store must be ordered before the caller loads the table, which seq_cst does for a store followed by a load.
+	slot->epoch.store(currentEpoch.load(memory_order_acquire), memory_order_seq_cst);
+	return &slot->epoch;
+}
+
+void RegistryReaders::leave(atomic<uint64_t> *slot)
+{
+	if (slot)
+		slot->store(IDLE_EPOCH, memory_order_release);
+	else
+		overflowReaders.fetch_sub(1, memory_order_release);
+}
+
+uint64_t RegistryReaders::retire()
+{
+	return currentEpoch.fetch_add(1, memory_order_seq_cst);
+}
+
+uint64_t RegistryReaders::getOldestReader()
+{
+	if (overflowReaders.load(memory_order_seq_cst))
+		return IDLE_EPOCH;
+
+	// A reader which is idle here announces itself after the new table was published, and will load it.
+	uint64_t oldest = UINT64_MAX;
+	for (auto &slot : readerSlots)
+	{
+		uint64_t epoch = slot.epoch.load(memory_order_seq_cst);
+		if (epoch != IDLE_EPOCH && epoch < oldest)
+			oldest = epoch;
+	}
+	return oldest;
+}
+}
@@ -0,0 +1,428 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#include "perfdoc.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace MPD
+{
+/// Process wide announcements of ObjectRegistry lookups, so retired tables can be freed without a reader count
+/// which every lookup would write to.
+///
+/// Every thread which looks up objects owns a slot on its own cache line. A lookup stores the current epoch in its
+/// slot before it loads a table, and clears the slot when it is done. Rebuilding a table starts a new epoch after
+/// publishing the new table, so lookups which announce a later epoch cannot see the old table, and it can be freed
+/// once every slot is idle or has moved past the epoch it was retired in.
+/// Threads beyond MAX_SLOTS share a counter instead, and hold back every retired table while they read.
+class RegistryReaders
+{
+public:
+	enum : size_t
+	{
+		MAX_SLOTS = 256
+	};
+
+	/// Announces a lookup on the calling thread. The result must be passed to leave().
+	static std::atomic<uint64_t> *enter();
+	static void leave(std::atomic<uint64_t> *slot);
+
+	/// Starts a new epoch, called after a new table was published. Returns the epoch the old table is retired in.
+	static uint64_t retire();
+
+	/// Returns the oldest epoch a lookup in flight might have announced. Tables retired in earlier epochs are no
+	/// longer in use.
+	static uint64_t getOldestReader();
+};
+
+/// Concurrent handle -> object registry for one Vulkan object type.
+///
+/// Lookups are lock-free: the table is open-addressed with linear probing and every slot is a pair of atomics,
+/// so find() can run on any number of threads while another thread inserts or erases.
+/// Insertions and erasures are serialized by a per-registry mutex.
+/// Objects are constructed in place in slabs of SLAB_SIZE objects, and freed slots are recycled.
+///
+/// Erased slots are left as tombstones which later insertions can reuse. Tombstones at the end of a probe chain
+/// are cleared right away, the others are dropped when the table is rebuilt.
+/// Rebuilt tables are published atomically. The old table is retired rather than freed, because a lock-free
+/// reader might still be probing it. Readers announce themselves in RegistryReaders, which only writes to memory of
+/// the calling thread, and retired tables are freed by the next insertion or erasure once the readers have moved
+/// on, so applications which create and destroy objects every frame do not accumulate tables.
+///
+/// Inserting a handle which is already registered replaces the old object, like the std::unordered_map this
+/// replaced did. Drivers may reuse non-dispatchable handles, and we do not see the destruction of every object.
+template <typename VkType, typename T>
+class ObjectRegistry
+{
+public:
+	ObjectRegistry()
+	    : currentTable(new Table(MIN_TABLE_SIZE))
+	{
+		table.store(currentTable.get(), std::memory_order_relaxed);
+	}
+
+	~ObjectRegistry()
+	{
+		Table *t = table.load(std::memory_order_relaxed);
+		for (size_t i = 0; i <= t->mask; i++)
+		{
+			T *object = t->entries[i].object.load(std::memory_order_relaxed);
+			if (object)
+				object->~T();
+		}
+	}
+
+	ObjectRegistry(const ObjectRegistry &) = delete;
+	void operator=(const ObjectRegistry &) = delete;
+
+	/// Lock-free lookup. Returns nullptr if the handle is not registered.
+	T *find(VkType handle) const
+	{
+		uint64_t key = toKey(handle);
+		if (key == EMPTY_KEY || key == TOMBSTONE_KEY)
+			return nullptr;
+
+		// Announce the reader before loading the table, see RegistryReaders.
+		auto *slot = RegistryReaders::enter();
+		const Table *t = table.load(std::memory_order_seq_cst);
+
+		T *object = nullptr;
+		for (size_t i = hashKey(key) & t->mask;; i = (i + 1) & t->mask)
+		{
+			uint64_t k = t->entries[i].key.load(std::memory_order_acquire);
+			if (k == key)
+			{
+				object = t->entries[i].object.load(std::memory_order_acquire);
+				break;
+			}
+			else if (k == EMPTY_KEY)
+				break;
+		}
+
+		RegistryReaders::leave(slot);
+		return object;
+	}
+
+	template <typename... TArgs>
+	T *emplace(VkType handle, TArgs &&... args)
+	{
+		uint64_t key = toKey(handle);
+		MPD_ASSERT(key != EMPTY_KEY && key != TOMBSTONE_KEY);
+
+		T *object;
+		T *replaced = nullptr;
+
+		{
+			std::lock_guard<std::mutex> holder{ writeLock };
+			object = new (allocateSlot()) T(std::forward<TArgs>(args)...);
+
+			Table *t = table.load(std::memory_order_relaxed);
+			size_t insertIndex = SIZE_MAX;
+			for (size_t i = hashKey(key) & t->mask;; i = (i + 1) & t->mask)
+			{
+				auto &entry = t->entries[i];
+				uint64_t k = entry.key.load(std::memory_order_relaxed);
+				if (k == key)
+				{
+					// The handle was reused, readers now see the new object.
+					replaced = entry.object.load(std::memory_order_relaxed);
+					entry.object.store(object, std::memory_order_release);
+					break;
+				}
+				else if (k == TOMBSTONE_KEY && insertIndex == SIZE_MAX)
+					insertIndex = i;
+				else if (k == EMPTY_KEY)
+				{
+					if (insertIndex == SIZE_MAX)
+						insertIndex = i;
+					break;
+				}
+			}
+
+			if (!replaced)
+			{
+				bool emptySlot = t->entries[insertIndex].key.load(std::memory_order_relaxed) == EMPTY_KEY;
+				if (emptySlot && 2 * (t->used + 1) > t->mask + 1)
+				{
+					t = rebuild();
+					insertIndex = hashKey(key) & t->mask;
+					while (t->entries[insertIndex].key.load(std::memory_order_relaxed) != EMPTY_KEY)
+						insertIndex = (insertIndex + 1) & t->mask;
+				}
+
+				if (t->entries[insertIndex].key.load(std::memory_order_relaxed) == EMPTY_KEY)
+					t->used++;
+
+				// Publish the object before the key, readers which observe the key must observe the object.
+				auto &entry = t->entries[insertIndex];
+				entry.object.store(object, std::memory_order_relaxed);
+				entry.key.store(key, std::memory_order_release);
+				t->live++;
+			}
+
+			reclaimRetiredTables();
+		}
+
+		if (replaced)
+			destroyObject(replaced);
+		return object;
+	}
+
+	void erase(VkType handle)
+	{
+		uint64_t key = toKey(handle);
+		T *object = nullptr;
+
+		{
+			std::lock_guard<std::mutex> holder{ writeLock };
+			Table *t = table.load(std::memory_order_relaxed);
+			for (size_t i = hashKey(key) & t->mask;; i = (i + 1) & t->mask)
+			{
+				auto &entry = t->entries[i];
+				uint64_t k = entry.key.load(std::memory_order_relaxed);
+				if (k == key)
+				{
+					object = entry.object.load(std::memory_order_relaxed);
+					entry.key.store(TOMBSTONE_KEY, std::memory_order_release);
+					entry.object.store(nullptr, std::memory_order_relaxed);
+					t->live--;
+					clearTombstones(*t, i);
+					break;
+				}
+				else if (k == EMPTY_KEY)
+					break;
+			}
+
+			reclaimRetiredTables();
+		}
+
+		MPD_ASSERT(object);
+		if (object)
+			destroyObject(object);
+	}
+
+	/// Erases every object for which pred(object) returns true.
+	template <typename Pred>
+	void eraseIf(const Pred &pred)
+	{
+		std::vector<T *> erased;
+
+		{
+			std::lock_guard<std::mutex> holder{ writeLock };
+			Table *t = table.load(std::memory_order_relaxed);
+			for (size_t i = 0; i <= t->mask; i++)
+			{
+				auto &entry = t->entries[i];
+				T *object = entry.object.load(std::memory_order_relaxed);
+				if (object && pred(*object))
+				{
+					entry.key.store(TOMBSTONE_KEY, std::memory_order_release);
+					entry.object.store(nullptr, std::memory_order_relaxed);
+					t->live--;
+					erased.push_back(object);
+				}
+			}
+
+			// Walk backwards so each probe chain is cleared from its end.
+			for (size_t i = t->mask + 1; i; i--)
+				clearTombstones(*t, i - 1);
+			reclaimRetiredTables();
+		}
+
+		// Destructors may call back into other registries, so run them without holding our lock.
+		for (auto *object : erased)
+			destroyObject(object);
+	}
+
+	/// Calls func(object) for every object. Insertions and erasures wait until it returns.
+	template <typename Func>
+	void forEach(const Func &func)
+	{
+		std::lock_guard<std::mutex> holder{ writeLock };
+		Table *t = table.load(std::memory_order_relaxed);
+		for (size_t i = 0; i <= t->mask; i++)
+		{
+			T *object = t->entries[i].object.load(std::memory_order_relaxed);
+			if (object)
+				func(*object);
+		}
+	}
+
+private:
+	enum : size_t
+	{
+		MIN_TABLE_SIZE = 64,
+		SLAB_SIZE = 64
+	};
+
+	static const uint64_t EMPTY_KEY = 0;
+	static const uint64_t TOMBSTONE_KEY = ~uint64_t(0);
+
+	struct Entry
+	{
+		std::atomic<uint64_t> key;
+		std::atomic<T *> object;
+	};
+
+	struct Table
+	{
+		explicit Table(size_t size)
+		    : mask(size - 1)
+		    , entries(new Entry[size])
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				entries[i].key.store(EMPTY_KEY, std::memory_order_relaxed);
+				entries[i].object.store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		size_t mask;
+		std::unique_ptr<Entry[]> entries;
+
+		// Slots which are not EMPTY_KEY (live objects and tombstones) and live objects only.
+		size_t used = 0;
+		size_t live = 0;
+	};
+
+	struct Slab
+	{
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type objects[SLAB_SIZE];
+	};
+
+	std::atomic<Table *> table;
+	std::unique_ptr<Table> currentTable;
+
+	// With the epoch they were retired in, oldest first.
+	std::vector<std::pair<uint64_t, std::unique_ptr<Table>>> retiredTables;
+
+	std::vector<std::unique_ptr<Slab>> slabs;
+	std::vector<void *> freeSlots;
+	std::mutex writeLock;
+
+	template <typename U>
+	static uint64_t toKey(U *handle)
+	{
+		return uint64_t(reinterpret_cast<uintptr_t>(handle));
+	}
+
+	static uint64_t toKey(uint64_t handle)
+	{
+		return handle;
+	}
+
+	static size_t hashKey(uint64_t key)
+	{
+		// Handles are mostly pointers, mix in the high bits so aligned addresses spread over the table.
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		return size_t(key);
+	}
+
+	void *allocateSlot()
+	{
+		if (freeSlots.empty())
+		{
+			slabs.emplace_back(new Slab);
+			auto &slab = *slabs.back();
+			for (size_t i = SLAB_SIZE; i; i--)
+				freeSlots.push_back(&slab.objects[i - 1]);
+		}
+
+		void *slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	void destroyObject(T *object)
+	{
+		object->~T();
+		std::lock_guard<std::mutex> holder{ writeLock };
+		freeSlots.push_back(object);
+	}
+
+	// Called with writeLock held. A tombstone followed by an empty slot ends every probe chain which reaches it,
+	// so it can become empty itself without hiding any key from a concurrent find().
+	static void clearTombstones(Table &t, size_t index)
+	{
+		while (t.entries[index].key.load(std::memory_order_relaxed) == TOMBSTONE_KEY &&
+		       t.entries[(index + 1) & t.mask].key.load(std::memory_order_relaxed) == EMPTY_KEY)
+		{
+			t.entries[index].key.store(EMPTY_KEY, std::memory_order_release);
+			t.used--;
+			index = (index - 1) & t.mask;
+		}
+	}
+
+	// Called with writeLock held.
+	void reclaimRetiredTables()
+	{
+		if (retiredTables.empty())
+			return;
+
+		uint64_t oldestReader = RegistryReaders::getOldestReader();
+		size_t count = 0;
+		while (count < retiredTables.size() && retiredTables[count].first < oldestReader)
+			count++;
+		retiredTables.erase(retiredTables.begin(), retiredTables.begin() + count);
+	}
+
+	// Called with writeLock held. Builds a new table with only the live entries and publishes it.
+	Table *rebuild()
+	{
+		Table *oldTable = table.load(std::memory_order_relaxed);
+
+		size_t size = oldTable->mask + 1;
+		while (4 * (oldTable->live + 1) > size)
+			size *= 2;
+
+		std::unique_ptr<Table> newTable(new Table(size));
+		for (size_t i = 0; i <= oldTable->mask; i++)
+		{
+			auto &entry = oldTable->entries[i];
+			uint64_t key = entry.key.load(std::memory_order_relaxed);
+			if (key == EMPTY_KEY || key == TOMBSTONE_KEY)
+				continue;
+
+			size_t j = hashKey(key) & newTable->mask;
+			while (newTable->entries[j].key.load(std::memory_order_relaxed) != EMPTY_KEY)
+				j = (j + 1) & newTable->mask;
+
+			newTable->entries[j].object.store(entry.object.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			newTable->entries[j].key.store(key, std::memory_order_relaxed);
+		}
+
+		newTable->used = oldTable->live;
+		newTable->live = oldTable->live;
+
+		Table *t = newTable.get();
+		table.store(t, std::memory_order_seq_cst);
+		retiredTables.emplace_back(RegistryReaders::retire(), std::move(currentTable));
+		currentTable = std::move(newTable);
+		return t;
+	}
+};
+}
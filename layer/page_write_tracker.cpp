@@ -0,0 +1,303 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "page_write_tracker.hpp"
+#include "perfdoc.hpp"
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace MPD
+{
+#ifdef __linux__
+/// Process wide list of trackers which the SIGSEGV handler searches.
+/// The handler can run at any time on any thread, so the list is a fixed array of atomics.
+struct PageWriteTrackerRegistry
+{
+	static const size_t MAX_TRACKERS = 256;
+
+	atomic<PageWriteTracker *> trackers[MAX_TRACKERS];
+
+	// Number of handlers running, so a tracker is not freed while a handler is looking at it.
+	// remove() clears the slot, then reads the count, a handler increments the count, then reads the slots.
+	// Both pairs are a store followed by a load, which only seq_cst keeps in order.
+	atomic<uint32_t> handlersInFlight;
+
+	// Serializes registration and handler installation, never taken by the handler.
+	mutex registrationLock;
+	bool handlerInstalled = false;
+	struct sigaction previousAction;
+
+	static PageWriteTrackerRegistry &get()
+	{
+		static PageWriteTrackerRegistry registry;
+		return registry;
+	}
+
+	PageWriteTrackerRegistry()
+	{
+		for (auto &tracker : trackers)
+			tracker.store(nullptr, memory_order_relaxed);
+		handlersInFlight.store(0, memory_order_relaxed);
+	}
+
+	bool add(PageWriteTracker *tracker)
+	{
+		lock_guard<mutex> holder{ registrationLock };
+		if (!handlerInstalled)
+		{
+			struct sigaction action = {};
+			action.sa_sigaction = onSignal;
+			action.sa_flags = SA_SIGINFO | SA_RESTART;
+			sigemptyset(&action.sa_mask);
+			if (sigaction(SIGSEGV, &action, &previousAction) != 0)
+				return false;
+			handlerInstalled = true;
+		}
+
+		for (auto &slot : trackers)
+		{
+			if (!slot.load(memory_order_relaxed))
+			{
+				slot.store(tracker, memory_order_release);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void remove(PageWriteTracker *tracker)
+	{
+		lock_guard<mutex> holder{ registrationLock };
+		for (auto &slot : trackers)
+		{
+			if (slot.load(memory_order_relaxed) == tracker)
+			{
+				slot.store(nullptr, memory_order_seq_cst);
+				break;
+			}
+		}
+
+		while (handlersInFlight.load(memory_order_seq_cst))
+			this_thread::yield();
+	}
+
+	static void onSignal(int signal, siginfo_t *info, void *context)
+	{
+		auto &registry = get();
+		auto *address = static_cast<uint8_t *>(info->si_addr);
+
+		// The handler interrupts arbitrary code of the application, which must not see mprotect() change errno.
+		int savedErrno = errno;
+
+		registry.handlersInFlight.fetch_add(1, memory_order_seq_cst);
+		bool handled = false;
+		for (auto &slot : registry.trackers)
+		{
+			auto *tracker = slot.load(memory_order_seq_cst);
+			if (tracker && tracker->onWriteFault(address))
+			{
+				handled = true;
+				break;
+			}
+		}
+		registry.handlersInFlight.fetch_sub(1, memory_order_release);
+		errno = savedErrno;
+
+		if (handled)
+			return;
+
+		// Not one of ours, behave as if we were never installed.
+		auto &previous = registry.previousAction;
+		if (previous.sa_flags & SA_SIGINFO)
+			previous.sa_sigaction(signal, info, context);
+		else if (previous.sa_handler == SIG_DFL || previous.sa_handler == SIG_IGN)
+		{
+			// Returning re-executes the faulting instruction, which then crashes as usual.
+			struct sigaction action = {};
+			action.sa_handler = SIG_DFL;
+			sigemptyset(&action.sa_mask);
+			sigaction(SIGSEGV, &action, nullptr);
+		}
+		else
+			previous.sa_handler(signal);
+	}
+};
+
+std::unique_ptr<PageWriteTracker> PageWriteTracker::create(void *mapping, size_t size)
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+	if (pageSize <= 0 || (pageSize & (pageSize - 1)) != 0 || size == 0)
+		return nullptr;
+
+	// The protection applies to whole pages, so don't touch mappings which might share pages with other memory.
+	if (reinterpret_cast<uintptr_t>(mapping) & uintptr_t(pageSize - 1))
+		return nullptr;
+
+	std::unique_ptr<PageWriteTracker> tracker(new PageWriteTracker);
+	while ((size_t(1) << tracker->pageShift) < size_t(pageSize))
+		tracker->pageShift++;
+
+	// The last page might only partially belong to the mapping, leave it alone.
+	size_t pageCount = size >> tracker->pageShift;
+	if (!pageCount)
+		return nullptr;
+
+	tracker->pageCount = pageCount;
+	tracker->begin = static_cast<uint8_t *>(mapping);
+	tracker->end = tracker->begin + (pageCount << tracker->pageShift);
+	tracker->pages.reset(new Page[pageCount]);
+	for (size_t i = 0; i < pageCount; i++)
+	{
+		tracker->pages[i].writes.store(0, memory_order_relaxed);
+		tracker->pages[i].armed.store(0, memory_order_relaxed);
+	}
+
+	if (!PageWriteTrackerRegistry::get().add(tracker.get()))
+		return nullptr;
+
+	return tracker;
+}
+
+PageWriteTracker::~PageWriteTracker()
+{
+	{
+		lock_guard<RWSpinLock> holder{ lock };
+		mprotect(begin, size_t(end - begin), PROT_READ | PROT_WRITE);
+	}
+	PageWriteTrackerRegistry::get().remove(this);
+}
+
+bool PageWriteTracker::canTrack(size_t offset, size_t size, size_t boundOffset, size_t boundSize) const
+{
+	if (!size)
+		return false;
+
+	size_t firstPage = offset >> pageShift;
+	size_t lastPage = (offset + size + (size_t(1) << pageShift) - 1) >> pageShift;
+	return lastPage <= pageCount && (firstPage << pageShift) >= boundOffset &&
+	       (lastPage << pageShift) <= boundOffset + boundSize;
+}
+
+uint64_t PageWriteTracker::arm(size_t offset, size_t size)
+{
+	size_t firstPage = offset >> pageShift;
+	size_t lastPage = (offset + size + (size_t(1) << pageShift) - 1) >> pageShift;
+	MPD_ASSERT(lastPage <= pageCount);
+
+	// In steady state everything is still armed, so don't contend with the fault handler for the lock.
+	if (!isArmed(offset, size))
+	{
+		lock_guard<RWSpinLock> holder{ lock };
+
+		// Protect runs of unarmed pages with one call each.
+		size_t page = firstPage;
+		while (page < lastPage)
+		{
+			if (pages[page].armed.load(memory_order_relaxed))
+			{
+				page++;
+				continue;
+			}
+
+			size_t runEnd = page;
+			while (runEnd < lastPage && !pages[runEnd].armed.load(memory_order_relaxed))
+				runEnd++;
+
+			// Only mark pages armed once they are protected, isArmed() doesn't take the lock.
+			// If this fails, they stay unarmed and isArmed() reports the range as unknown.
+			if (mprotect(begin + (page << pageShift), (runEnd - page) << pageShift, PROT_READ) == 0)
+			{
+				for (size_t i = page; i < runEnd; i++)
+					pages[i].armed.store(1, memory_order_release);
+			}
+			page = runEnd;
+		}
+	}
+
+	uint64_t writes = 0;
+	for (size_t page = firstPage; page < lastPage; page++)
+		writes += pages[page].writes.load(memory_order_acquire);
+	return writes;
+}
+
+bool PageWriteTracker::isArmed(size_t offset, size_t size) const
+{
+	size_t firstPage = offset >> pageShift;
+	size_t lastPage = (offset + size + (size_t(1) << pageShift) - 1) >> pageShift;
+	for (size_t page = firstPage; page < lastPage; page++)
+		if (!pages[page].armed.load(memory_order_acquire))
+			return false;
+	return true;
+}
+
+bool PageWriteTracker::onWriteFault(uint8_t *address)
+{
+	if (address < begin || address >= end)
+		return false;
+
+	size_t page = size_t(address - begin) >> pageShift;
+	lock_guard<RWSpinLock> holder{ lock };
+
+	// Count the write before it can happen, so a reader either sees the new count or the page as unarmed.
+	pages[page].writes.fetch_add(1, memory_order_acq_rel);
+	pages[page].armed.store(0, memory_order_release);
+	mprotect(begin + (page << pageShift), size_t(1) << pageShift, PROT_READ | PROT_WRITE);
+	return true;
+}
+#else
+std::unique_ptr<PageWriteTracker> PageWriteTracker::create(void *, size_t)
+{
+	return nullptr;
+}
+
+PageWriteTracker::~PageWriteTracker()
+{
+}
+
+bool PageWriteTracker::canTrack(size_t, size_t, size_t, size_t) const
+{
+	return false;
+}
+
+uint64_t PageWriteTracker::arm(size_t, size_t)
+{
+	return 0;
+}
+
+bool PageWriteTracker::isArmed(size_t, size_t) const
+{
+	return false;
+}
+
+bool PageWriteTracker::onWriteFault(uint8_t *)
+{
+	return false;
+}
+#endif
+}
@@ -0,0 +1,86 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "rw_spinlock.hpp"
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace MPD
+{
+/// Finds out which pages of a host mapping the application writes to.
+///
+/// Armed pages are write-protected. The first write to an armed page faults, the fault handler counts the write
+/// and lifts the protection, so later writes to the page run at full speed until it is armed again.
+/// Only the memory's own mapping is touched, the layer never writes to it. Linux only.
+///
+/// Only whole pages are tracked, a partial page at the end of the mapping may be shared with another mapping.
+/// Callers must also keep to pages which lie entirely within their resource, see canTrack().
+/// Protected pages make system calls which write to them fail with EFAULT rather than fault, and the SIGSEGV
+/// handler is process wide, which is why write tracking is off by default.
+class PageWriteTracker
+{
+public:
+	/// Returns nullptr if the mapping cannot be tracked, for example if it is not page aligned,
+	/// or on platforms without support.
+	static std::unique_ptr<PageWriteTracker> create(void *mapping, size_t size);
+
+	~PageWriteTracker();
+
+	PageWriteTracker(const PageWriteTracker &) = delete;
+	void operator=(const PageWriteTracker &) = delete;
+
+	/// Returns true if every page the range touches is tracked and lies within [boundOffset, boundOffset + boundSize).
+	bool canTrack(size_t offset, size_t size, size_t boundOffset, size_t boundSize) const;
+
+	/// Write-protects the pages of the range, and returns a counter which changes if any of them is written to after
+	/// this call. The range must pass canTrack().
+	uint64_t arm(size_t offset, size_t size);
+
+	/// Returns true if none of the pages of the range were written to since they were armed.
+	/// Contents read between arm() and a successful isArmed() are known to be current as of the counter.
+	bool isArmed(size_t offset, size_t size) const;
+
+private:
+	PageWriteTracker() = default;
+
+	struct Page
+	{
+		std::atomic<uint32_t> writes;
+		std::atomic<uint32_t> armed;
+	};
+
+	uint8_t *begin = nullptr;
+	uint8_t *end = nullptr;
+	size_t pageShift = 0;
+	size_t pageCount = 0;
+	std::unique_ptr<Page[]> pages;
+
+	// Serializes protection changes between arm() and the fault handler.
+	// Otherwise the handler could lift the protection right after arm() put it back.
+	RWSpinLock lock;
+
+	bool onWriteFault(uint8_t *address);
+
+	friend struct PageWriteTrackerRegistry;
+};
+}
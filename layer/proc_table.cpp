@@ -0,0 +1,77 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "proc_table.hpp"
+#include <string.h>
+
+namespace MPD
+{
+ProcTable::ProcTable(const Entry *entries, size_t count)
+    : entries(entries)
+    , count(count)
+{
+	MPD_ASSERT(count < 0xffff);
+
+	// With 16 slots per name, a seed without collisions turns up after a few tries.
+	// If it takes longer than expected, the table grows instead.
+	size_t size = 16;
+	while (size < count * 16)
+		size *= 2;
+
+	for (uint32_t attempt = 0;; attempt++)
+	{
+		if (attempt != 0 && attempt % 64 == 0)
+			size *= 2;
+
+		slots.assign(size, 0);
+		mask = uint32_t(size - 1);
+		if (tryBuild(attempt))
+			break;
+	}
+}
+
+bool ProcTable::tryBuild(uint32_t seed)
+{
+	this->seed = seed;
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &slot = slots[hashName(entries[i].name, seed) & mask];
+		if (slot)
+		{
+			// A repeated name keeps its first entry, it would never hash apart.
+			if (strcmp(entries[slot - 1].name, entries[i].name) == 0)
+				continue;
+			return false;
+		}
+		slot = uint16_t(i + 1);
+	}
+	return true;
+}
+
+const ProcTable::Entry *ProcTable::find(const char *pName) const
+{
+	uint16_t slot = slots[hashName(pName, seed) & mask];
+	if (!slot)
+		return nullptr;
+
+	const Entry *entry = &entries[slot - 1];
+	return strcmp(entry->name, pName) == 0 ? entry : nullptr;
+}
+}
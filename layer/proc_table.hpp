@@ -0,0 +1,79 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "perfdoc.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace MPD
+{
+/// Maps the names of the entry points the layer implements to its functions, for vkGet*ProcAddr.
+///
+/// The names are hashed with a seed which is picked when the table is built, so that no two names land in the same
+/// slot. A lookup is then one hash and one string compare, whatever the number of entry points.
+/// The table is immutable once built, so lookups do not take any lock.
+class ProcTable
+{
+public:
+	struct Entry
+	{
+		const char *name;
+		PFN_vkVoidFunction proc;
+		// Which group of entry points this is, see Device::InterceptBits.
+		uint32_t group;
+	};
+
+	template <size_t N>
+	explicit ProcTable(const Entry (&entries)[N])
+	    : ProcTable(entries, N)
+	{
+	}
+
+	ProcTable(const Entry *entries, size_t count);
+
+	/// Returns the entry called pName, or nullptr if the layer does not implement it.
+	const Entry *find(const char *pName) const;
+
+	/// FNV-1a, with the seed mixed into the offset basis.
+	static constexpr uint32_t hashName(const char *name, uint32_t seed)
+	{
+		return hashNameStep(name, 2166136261u ^ seed);
+	}
+
+private:
+	static constexpr uint32_t hashNameStep(const char *name, uint32_t hash)
+	{
+		return *name ? hashNameStep(name + 1, (hash ^ uint8_t(*name)) * 16777619u) : hash;
+	}
+
+	bool tryBuild(uint32_t seed);
+
+	const Entry *entries;
+	size_t count;
+	uint32_t seed = 0;
+	uint32_t mask = 0;
+
+	// Index of the entry in each slot plus one, 0 for an empty slot.
+	std::vector<uint16_t> slots;
+};
+}
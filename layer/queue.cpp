@@ -22,9 +22,10 @@
 
 namespace MPD
 {
-VkResult Queue::init(VkQueue queue)
+VkResult Queue::init(VkQueue queue, uint32_t familyIndex)
 {
 	this->queue = queue;
+	this->familyIndex = familyIndex;
 	return VK_SUCCESS;
 }
 }
\ No newline at end of file
@@ -38,13 +38,18 @@ public:
 	{
 	}
 
-	VkResult init(VkQueue queue);
+	VkResult init(VkQueue queue, uint32_t familyIndex);
 
 	VkQueue getQueue() const
 	{
 		return queue;
 	}
 
+	uint32_t getFamilyIndex() const
+	{
+		return familyIndex;
+	}
+
 	QueueTracker &getQueueTracker()
 	{
 		return queueTracker;
@@ -52,6 +57,7 @@ public:
 
 private:
 	VkQueue queue;
+	uint32_t familyIndex;
 	QueueTracker queueTracker;
 };
 }
@@ -34,15 +34,27 @@ QueueTracker::QueueTracker(Queue &queue)
 {
 }
 
-void QueueTracker::pushWork(Stage dstStage)
+void QueueTracker::reportBubble(unsigned dstStage, unsigned srcStage)
 {
 	static const char *stageNames[STAGE_COUNT] = {
 		"COMPUTE", "GEOMETRY", "FRAGMENT", "TRANSFER",
 	};
 
-	
-	const auto &cfg = queue.getDevice()->getConfig();
+	if (!queue.getDevice()->getConfig().msgPipelineBubble)
+		return;
 
+	queue.log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_PIPELINE_BUBBLE,
+	          "Pipeline bubble detected in stage %s. Work in stage %s will block execution in stage %s.",
+	          stageNames[dstStage], stageNames[srcStage], stageNames[dstStage]);
+}
+
+void QueueTracker::pushWork(Stage dstStage)
+{
+	pushWork(dstStage, nullptr);
+}
+
+void QueueTracker::pushWork(Stage dstStage, Recording *recording)
+{
 	for (unsigned i = 0; i < STAGE_COUNT; i++)
 	{
 		if (dstStage == i)
@@ -74,14 +86,12 @@ void QueueTracker::pushWork(Stage dstStage)
 		// TRANSFER work,
 		// TRANSFER -> FRAGMENT,
 		// is a bubble.
-		if (
-		cfg.msgPipelineBubble && 
-		stages[i].waitList[dstStage] == stages[dstStage].index &&
+		if (stages[i].waitList[dstStage] == stages[dstStage].index &&
 		    stages[i].index != stages[i].lastDstStageIndex[dstStage])
 		{
-			queue.log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_PIPELINE_BUBBLE,
-			          "Pipeline bubble detected in stage %s. Work in stage %s will block execution in stage %s.",
-			          stageNames[dstStage], stageNames[i], stageNames[dstStage]);
+			if (recording)
+				recording->bubbles.push_back(uint8_t(dstStage * STAGE_COUNT + i));
+			reportBubble(dstStage, i);
 		}
 	}
 
@@ -89,17 +99,22 @@ void QueueTracker::pushWork(Stage dstStage)
 }
 
 void QueueTracker::pipelineBarrier(StageFlags srcStages, StageFlags dstStages)
+{
+	pipelineBarrier(srcStages, dstStages, nullptr);
+}
+
+void QueueTracker::pipelineBarrier(StageFlags srcStages, StageFlags dstStages, Recording *recording)
 {
 	for (unsigned i = 0; i < STAGE_COUNT; i++)
 	{
 		if (!(dstStages & (1u << i)))
 			continue;
 
-		barrier(srcStages, static_cast<Stage>(i));
+		barrier(srcStages, static_cast<Stage>(i), recording);
 	}
 }
 
-void QueueTracker::barrier(StageFlags srcStages, Stage dstStage)
+void QueueTracker::barrier(StageFlags srcStages, Stage dstStage, Recording *recording)
 {
 	if (srcStages == 0)
 		return;
@@ -115,6 +130,12 @@ void QueueTracker::barrier(StageFlags srcStages, Stage dstStage)
 		{
 			stages[dstStage].waitList[srcStage] = stages[srcStage].index;
 			stages[dstStage].lastDstStageIndex[srcStage] = stages[dstStage].index;
+
+			if (recording)
+			{
+				recording->origins[dstStage].localWaitMask |= 1u << srcStage;
+				recording->origins[dstStage].localLastDstMask |= 1u << srcStage;
+			}
 		}
 
 		// Inherit dependencies from our srcStages.
@@ -126,6 +147,16 @@ void QueueTracker::barrier(StageFlags srcStages, Stage dstStage)
 			{
 				stages[dstStage].waitList[stage] = stages[srcStage].waitList[stage];
 				stages[dstStage].lastDstStageIndex[stage] = stages[dstStage].index;
+
+				if (recording)
+				{
+					auto &src = recording->origins[srcStage];
+					auto &dst = recording->origins[dstStage];
+					dst.waitSource[stage] = src.waitSource[stage];
+					dst.localWaitMask =
+					    (dst.localWaitMask & ~(1u << stage)) | (src.localWaitMask & (1u << stage));
+					dst.localLastDstMask |= 1u << stage;
+				}
 			}
 		}
 	}
@@ -183,4 +214,290 @@ void QueueTracker::waitEvent(const Event &event, StageFlags dstStages)
 		}
 	}
 }
-}
\ No newline at end of file
+
+bool QueueTracker::computeSignature(uint64_t signature[2]) const
+{
+	// Every decision taken while evaluating a segment compares wait indices for the same stage against each other,
+	// against the current index of that stage, or checks whether an index or lastDstStageIndex is still at its
+	// initial value. Ranking the wait indices for each stage captures all of it.
+	signature[0] = 0;
+	signature[1] = 0;
+
+	for (unsigned stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		uint64_t values[STAGE_COUNT + 1];
+		for (unsigned i = 0; i < STAGE_COUNT; i++)
+		{
+			values[i] = stages[i].waitList[stage];
+
+			// Only possible through events. Relative order is no longer enough to predict the segment,
+			// so fall back to evaluating it.
+			if (values[i] > stages[stage].index)
+				return false;
+		}
+		values[STAGE_COUNT] = stages[stage].index;
+
+		for (unsigned i = 0; i <= STAGE_COUNT; i++)
+		{
+			// Dense rank, the number of distinct values below this one.
+			uint64_t rank = 0;
+			for (unsigned j = 0; j <= STAGE_COUNT; j++)
+			{
+				if (values[j] >= values[i])
+					continue;
+
+				bool first = true;
+				for (unsigned k = 0; k < j; k++)
+					if (values[k] == values[j])
+						first = false;
+
+				if (first)
+					rank++;
+			}
+
+			signature[0] |= rank << (3 * (stage * (STAGE_COUNT + 1) + i));
+		}
+
+		if (!stages[stage].index)
+			signature[1] |= 1ull << stage;
+
+		for (unsigned i = 0; i < STAGE_COUNT; i++)
+			if (stages[stage].lastDstStageIndex[i] == stages[stage].index)
+				signature[1] |= 1ull << (STAGE_COUNT + stage * STAGE_COUNT + i);
+	}
+
+	return true;
+}
+
+void QueueTracker::evaluateSegment(const QueueTrackerSummary &summary, size_t segmentIndex, Recording *recording)
+{
+	auto &segment = summary.segments[segmentIndex];
+	for (size_t i = 0; i < segment.opCount; i++)
+	{
+		auto &op = summary.ops[segment.firstOp + i];
+		if (op.type == QueueTrackerSummary::OpType::PushWork)
+		{
+			for (uint32_t j = 0; j < op.count; j++)
+				pushWork(op.stage, recording);
+		}
+		else
+			pipelineBarrier(op.srcStages, op.dstStages, recording);
+	}
+}
+
+void QueueTracker::applySegment(QueueTrackerSummary &summary, size_t segmentIndex)
+{
+	auto &segment = summary.segments[segmentIndex];
+	if (!segment.opCount)
+		return;
+
+	uint64_t signature[2];
+	if (!computeSignature(signature))
+	{
+		evaluateSegment(summary, segmentIndex, nullptr);
+		return;
+	}
+
+	StageStatus initial[STAGE_COUNT];
+	memcpy(initial, stages, sizeof(stages));
+
+	for (auto &transfer : segment.transfers)
+	{
+		if (transfer.signature[0] != signature[0] || transfer.signature[1] != signature[1])
+			continue;
+
+		for (unsigned dst = 0; dst < STAGE_COUNT; dst++)
+		{
+			auto &origin = transfer.origins[dst];
+			stages[dst].index = initial[dst].index + transfer.indexDelta[dst];
+
+			for (unsigned stage = 0; stage < STAGE_COUNT; stage++)
+			{
+				if (origin.localWaitMask & (1u << stage))
+					stages[dst].waitList[stage] = initial[stage].index + transfer.waitOffset[dst][stage];
+				else
+					stages[dst].waitList[stage] = initial[origin.waitSource[stage]].waitList[stage];
+
+				if (origin.localLastDstMask & (1u << stage))
+					stages[dst].lastDstStageIndex[stage] = initial[dst].index + transfer.lastDstOffset[dst][stage];
+			}
+		}
+
+		for (auto bubble : transfer.bubbles)
+			reportBubble(bubble / STAGE_COUNT, bubble % STAGE_COUNT);
+		return;
+	}
+
+	if (segment.transfers.size() >= QueueTrackerSummary::MAX_TRANSFERS_PER_SEGMENT)
+	{
+		evaluateSegment(summary, segmentIndex, nullptr);
+		return;
+	}
+
+	Recording recording;
+	for (unsigned dst = 0; dst < STAGE_COUNT; dst++)
+	{
+		for (unsigned stage = 0; stage < STAGE_COUNT; stage++)
+			recording.origins[dst].waitSource[stage] = uint8_t(dst);
+		recording.origins[dst].localWaitMask = 0;
+		recording.origins[dst].localLastDstMask = 0;
+	}
+
+	evaluateSegment(summary, segmentIndex, &recording);
+
+	segment.transfers.emplace_back();
+	auto &transfer = segment.transfers.back();
+	memcpy(transfer.signature, signature, sizeof(signature));
+	memcpy(transfer.origins, recording.origins, sizeof(recording.origins));
+	transfer.bubbles = move(recording.bubbles);
+
+	for (unsigned dst = 0; dst < STAGE_COUNT; dst++)
+	{
+		transfer.indexDelta[dst] = stages[dst].index - initial[dst].index;
+		for (unsigned stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			// Local values can never fall below the index they were derived from.
+			transfer.waitOffset[dst][stage] = stages[dst].waitList[stage] - initial[stage].index;
+			transfer.lastDstOffset[dst][stage] = stages[dst].lastDstStageIndex[stage] - initial[dst].index;
+		}
+	}
+}
+
+void QueueTracker::apply(QueueTrackerSummary &summary)
+{
+	if (!summary.compiled)
+		summary.compile();
+
+	for (size_t i = 0; i < summary.segments.size(); i++)
+	{
+		applySegment(summary, i);
+
+		// Every segment but the last is terminated by an event command.
+		auto &segment = summary.segments[i];
+		size_t eventOp = segment.firstOp + segment.opCount;
+		if (eventOp >= summary.ops.size())
+			continue;
+
+		auto &op = summary.ops[eventOp];
+		switch (op.type)
+		{
+		case QueueTrackerSummary::OpType::SignalEvent:
+			signalEvent(*op.event, op.srcStages);
+			break;
+
+		case QueueTrackerSummary::OpType::WaitEvent:
+			waitEvent(*op.event, op.dstStages);
+			break;
+
+		case QueueTrackerSummary::OpType::ResetEvent:
+			op.event->reset();
+			break;
+
+		default:
+			MPD_ASSERT(0 && "Segment is not terminated by an event command.");
+			break;
+		}
+	}
+}
+
+void QueueTrackerSummary::appendOp(const Op &op)
+{
+	compiled = false;
+
+	if (op.type == OpType::PushWork && !ops.empty())
+	{
+		auto &last = ops.back();
+		if (last.type == OpType::PushWork && last.stage == op.stage)
+		{
+			last.count += op.count;
+			return;
+		}
+	}
+
+	ops.push_back(op);
+}
+
+void QueueTrackerSummary::pushWork(QueueTracker::Stage stage)
+{
+	Op op = {};
+	op.type = OpType::PushWork;
+	op.stage = stage;
+	op.count = 1;
+	appendOp(op);
+}
+
+void QueueTrackerSummary::pipelineBarrier(QueueTracker::StageFlags srcStages, QueueTracker::StageFlags dstStages)
+{
+	// Empty barriers don't affect the tracker.
+	if (!srcStages || !dstStages)
+		return;
+
+	Op op = {};
+	op.type = OpType::PipelineBarrier;
+	op.srcStages = srcStages;
+	op.dstStages = dstStages;
+	appendOp(op);
+}
+
+void QueueTrackerSummary::signalEvent(Event *event, QueueTracker::StageFlags srcStages)
+{
+	Op op = {};
+	op.type = OpType::SignalEvent;
+	op.event = event;
+	op.srcStages = srcStages;
+	appendOp(op);
+}
+
+void QueueTrackerSummary::waitEvent(Event *event, QueueTracker::StageFlags dstStages)
+{
+	Op op = {};
+	op.type = OpType::WaitEvent;
+	op.event = event;
+	op.dstStages = dstStages;
+	appendOp(op);
+}
+
+void QueueTrackerSummary::resetEvent(Event *event)
+{
+	Op op = {};
+	op.type = OpType::ResetEvent;
+	op.event = event;
+	appendOp(op);
+}
+
+void QueueTrackerSummary::append(const QueueTrackerSummary &other)
+{
+	for (auto &op : other.ops)
+		appendOp(op);
+}
+
+void QueueTrackerSummary::compile()
+{
+	segments.clear();
+
+	Segment segment = {};
+	for (size_t i = 0; i < ops.size(); i++)
+	{
+		if (ops[i].type == OpType::PushWork || ops[i].type == OpType::PipelineBarrier)
+		{
+			segment.opCount++;
+		}
+		else
+		{
+			segments.push_back(move(segment));
+			segment = {};
+			segment.firstOp = i + 1;
+		}
+	}
+	segments.push_back(move(segment));
+
+	compiled = true;
+}
+
+void QueueTrackerSummary::clear()
+{
+	ops.clear();
+	segments.clear();
+	compiled = false;
+}
+}
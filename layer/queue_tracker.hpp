@@ -22,11 +22,14 @@
 #include "base_object.hpp"
 #include "dispatch_helper.hpp"
 #include "perfdoc.hpp"
+#include <vector>
 
 namespace MPD
 {
 class Queue;
 class Event;
+class QueueTrackerSummary;
+
 class QueueTracker
 {
 public:
@@ -56,12 +59,18 @@ public:
 	void waitEvent(const Event &event, StageFlags dstStages);
 	void signalEvent(Event &event, StageFlags srcStages);
 
+	/// Applies everything a command buffer recorded for this tracker.
+	/// Segments between event commands are applied with a cached transfer function when possible,
+	/// so the cost does not depend on the number of commands recorded.
+	void apply(QueueTrackerSummary &summary);
+
 	Queue &getQueue()
 	{
 		return queue;
 	}
 
 private:
+	friend class QueueTrackerSummary;
 	Queue &queue;
 
 	struct StageStatus
@@ -77,6 +86,106 @@ private:
 	};
 	StageStatus stages[STAGE_COUNT];
 
-	void barrier(StageFlags srcStages, Stage dstStage);
+	// Where the values of a StageStatus came from while a summary segment is evaluated.
+	// waitList[i] is either derived from an index reached inside the segment (bit i of localWaitMask),
+	// or it is the waitList[i] of stage waitSource[i] before the segment started.
+	// lastDstStageIndex[i] is either set inside the segment (bit i of localLastDstMask) or left untouched.
+	struct StageOrigin
+	{
+		uint8_t waitSource[STAGE_COUNT];
+		uint32_t localWaitMask;
+		uint32_t localLastDstMask;
+	};
+
+	struct Recording
+	{
+		StageOrigin origins[STAGE_COUNT];
+		std::vector<uint8_t> bubbles;
+	};
+
+	void pushWork(Stage dstStage, Recording *recording);
+	void pipelineBarrier(StageFlags srcStages, StageFlags dstStages, Recording *recording);
+	void barrier(StageFlags srcStages, Stage dstStage, Recording *recording);
+	void reportBubble(unsigned dstStage, unsigned srcStage);
+
+	bool computeSignature(uint64_t signature[2]) const;
+	void applySegment(QueueTrackerSummary &summary, size_t segmentIndex);
+	void evaluateSegment(const QueueTrackerSummary &summary, size_t segmentIndex, Recording *recording);
+};
+
+/// The QueueTracker commands recorded by a command buffer, in recording order.
+///
+/// A segment is a run of pushWork() and pipelineBarrier() which is not interrupted by event commands.
+/// The effect of a segment on the QueueTracker state only depends on how the incoming wait indices compare to
+/// each other, not on their absolute values. The first time a segment is applied to a state with a new
+/// signature, its effect is recorded as a transfer function: index deltas, where each wait index comes from
+/// and which bubbles were found. Later submissions which start from a state with the same signature
+/// apply the transfer function in O(STAGE_COUNT^2).
+class QueueTrackerSummary
+{
+public:
+	void pushWork(QueueTracker::Stage stage);
+	void pipelineBarrier(QueueTracker::StageFlags srcStages, QueueTracker::StageFlags dstStages);
+	void signalEvent(Event *event, QueueTracker::StageFlags srcStages);
+	void waitEvent(Event *event, QueueTracker::StageFlags dstStages);
+	void resetEvent(Event *event);
+
+	/// Appends the commands of an executed secondary command buffer.
+	void append(const QueueTrackerSummary &other);
+
+	/// Splits the commands into segments. Called at vkEndCommandBuffer.
+	void compile();
+
+	void clear();
+
+private:
+	friend class QueueTracker;
+
+	enum class OpType : uint8_t
+	{
+		PushWork,
+		PipelineBarrier,
+		SignalEvent,
+		WaitEvent,
+		ResetEvent
+	};
+
+	struct Op
+	{
+		OpType type;
+		QueueTracker::Stage stage;
+		QueueTracker::StageFlags srcStages;
+		QueueTracker::StageFlags dstStages;
+		// Consecutive pushWork() to the same stage are merged.
+		uint32_t count;
+		Event *event;
+	};
+
+	struct Transfer
+	{
+		uint64_t signature[2];
+		uint64_t indexDelta[QueueTracker::STAGE_COUNT];
+		QueueTracker::StageOrigin origins[QueueTracker::STAGE_COUNT];
+		uint64_t waitOffset[QueueTracker::STAGE_COUNT][QueueTracker::STAGE_COUNT];
+		uint64_t lastDstOffset[QueueTracker::STAGE_COUNT][QueueTracker::STAGE_COUNT];
+		std::vector<uint8_t> bubbles;
+	};
+
+	struct Segment
+	{
+		size_t firstOp;
+		size_t opCount;
+		std::vector<Transfer> transfers;
+	};
+
+	// Command buffers are normally submitted from a handful of different states.
+	// If a segment keeps seeing new ones, stop recording and just evaluate it.
+	static const size_t MAX_TRANSFERS_PER_SEGMENT = 4;
+
+	std::vector<Op> ops;
+	std::vector<Segment> segments;
+	bool compiled = false;
+
+	void appendOp(const Op &op);
 };
 }
\ No newline at end of file
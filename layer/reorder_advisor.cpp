@@ -0,0 +1,401 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "reorder_advisor.hpp"
+#include "buffer.hpp"
+#include "device.hpp"
+#include "message_codes.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+namespace MPD
+{
+ReorderAdvisor::ReorderAdvisor(Device &device, size_t maxEntries)
+    : device(device)
+    , maxEntries(maxEntries)
+{
+	thread = std::thread(&ReorderAdvisor::run, this);
+}
+
+ReorderAdvisor::~ReorderAdvisor()
+{
+	{
+		lock_guard<mutex> holder{ lock };
+		stopping = true;
+	}
+	cond.notify_one();
+
+	// Queued jobs are dropped, only the one in progress is finished.
+	thread.join();
+}
+
+void ReorderAdvisor::countDraw(const IndexScanKey &key)
+{
+	lock_guard<mutex> holder{ lock };
+	auto itr = entries.find(key);
+	if (itr != end(entries))
+		itr->second.drawCount++;
+}
+
+void ReorderAdvisor::analyze(const IndexScanKey &key, const uint8_t *indexData, uint64_t writeGeneration)
+{
+	if (key.topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || key.primitiveRestart || key.indexCount < 3)
+		return;
+
+	{
+		lock_guard<mutex> holder{ lock };
+		auto itr = entries.find(key);
+		if (itr != end(entries) && itr->second.writeGeneration == writeGeneration)
+			return;
+		if (jobs.size() >= MAX_PENDING_JOBS)
+			return;
+	}
+
+	Job job;
+	job.key = key;
+	job.indices.resize(key.indexCount);
+	if (key.indexType == VK_INDEX_TYPE_UINT16)
+	{
+		auto *indices = reinterpret_cast<const uint16_t *>(indexData);
+		copy(indices, indices + key.indexCount, begin(job.indices));
+	}
+	else
+	{
+		auto *indices = reinterpret_cast<const uint32_t *>(indexData);
+		copy(indices, indices + key.indexCount, begin(job.indices));
+	}
+
+	{
+		lock_guard<mutex> holder{ lock };
+		job.id = nextJobId++;
+
+		bool newEntry = entries.find(key) == end(entries);
+		if (newEntry && entries.size() >= maxEntries)
+			evictEntries();
+
+		// Keep the draw count of an entry which is analyzed again.
+		// countDraw() did not know about a new one yet, so count the drawcall which scanned it here.
+		auto &entry = entries[key];
+		if (newEntry)
+			entry.drawCount = 1;
+		entry.writeGeneration = writeGeneration;
+		entry.pendingJob = job.id;
+		entry.bufferHandle = key.buffer->getHandle();
+		entry.analyzed = false;
+		jobs.push_back(move(job));
+	}
+	cond.notify_one();
+}
+
+void ReorderAdvisor::evictEntries()
+{
+	// Streamed geometry keeps adding ranges which are never drawn again. Drop the ranges which were not drawn
+	// since the last ranking, and start over if every range was.
+	for (auto itr = begin(entries); itr != end(entries);)
+	{
+		if (!itr->second.drawCount)
+			itr = entries.erase(itr);
+		else
+			++itr;
+	}
+
+	if (entries.size() >= maxEntries)
+		entries.clear();
+}
+
+void ReorderAdvisor::removeBuffer(const Buffer *buffer)
+{
+	lock_guard<mutex> holder{ lock };
+
+	for (auto itr = begin(entries); itr != end(entries);)
+	{
+		if (itr->first.buffer == buffer)
+			itr = entries.erase(itr);
+		else
+			++itr;
+	}
+
+	jobs.erase(remove_if(begin(jobs), end(jobs), [&](const Job &job) { return job.key.buffer == buffer; }),
+	           end(jobs));
+}
+
+void ReorderAdvisor::run()
+{
+	unique_lock<mutex> holder{ lock };
+	for (;;)
+	{
+		cond.wait(holder, [&] { return stopping || !jobs.empty(); });
+		if (stopping)
+			return;
+
+		Job job = move(jobs.front());
+		jobs.pop_front();
+
+		holder.unlock();
+		Result result = optimize(job.indices);
+		holder.lock();
+
+		// The buffer might have been destroyed, or the indices queued again, while we were busy.
+		auto itr = entries.find(job.key);
+		if (itr == end(entries) || itr->second.pendingJob != job.id)
+			continue;
+
+		auto &entry = itr->second;
+		entry.analyzed = true;
+		entry.triangleCount = result.triangleCount;
+		entry.uniqueVertices = result.uniqueVertices;
+		entry.currentShaded = result.currentShaded;
+		entry.optimizedShaded = result.optimizedShaded;
+
+		Entry reported = entry;
+		holder.unlock();
+		report(job.key, reported);
+		holder.lock();
+	}
+}
+
+uint32_t ReorderAdvisor::countShadedVertices(const vector<uint32_t> &indices)
+{
+	const auto &cfg = device.getConfig();
+	vertexCache.reset(cfg.indexBufferVertexPostTransformCache, cfg.indexBufferVertexPostTransformCacheFIFO ?
+	                                                               VertexCache::Policy::FIFO :
+	                                                               VertexCache::Policy::LRU);
+
+	uint32_t shaded = 0;
+	for (auto index : indices)
+		if (!vertexCache.access(index))
+			shaded++;
+	return shaded;
+}
+
+ReorderAdvisor::Result ReorderAdvisor::optimize(vector<uint32_t> &indices)
+{
+	static const uint32_t NONE = ~0u;
+
+	Result result = {};
+	uint32_t triangleCount = uint32_t(indices.size() / 3);
+	indices.resize(size_t(triangleCount) * 3);
+	result.triangleCount = triangleCount;
+	result.currentShaded = countShadedVertices(indices);
+
+	// Renumber the vertices densely, so they can index the per-vertex arrays below.
+	vector<uint32_t> vertices = indices;
+	sort(begin(vertices), end(vertices));
+	vertices.erase(unique(begin(vertices), end(vertices)), end(vertices));
+	for (auto &index : indices)
+		index = uint32_t(lower_bound(begin(vertices), end(vertices), index) - begin(vertices));
+
+	uint32_t vertexCount = uint32_t(vertices.size());
+	result.uniqueVertices = vertexCount;
+
+	// Triangles using each vertex.
+	vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (auto index : indices)
+		adjacencyOffsets[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	vector<uint32_t> adjacency(indices.size());
+	vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t i = 0; i < indices.size(); i++)
+	{
+		uint32_t v = indices[i];
+		adjacency[adjacencyOffsets[v] + liveTriangles[v]++] = i / 3;
+	}
+
+	// Tipsify: emit every remaining triangle around a fanning vertex, then move on to a vertex those triangles
+	// brought into the cache, which will still be there once its own triangles are emitted.
+	uint32_t cacheSize = uint32_t(std::max(device.getConfig().indexBufferVertexPostTransformCache, uint64_t(1)));
+	vector<uint32_t> cacheTime(vertexCount, 0);
+	vector<bool> emitted(triangleCount, false);
+	vector<uint32_t> deadEnds;
+	vector<uint32_t> candidates;
+	vector<uint32_t> reordered;
+	reordered.reserve(indices.size());
+
+	uint32_t timeStamp = cacheSize + 1;
+	uint32_t cursor = 0;
+	uint32_t fanning = 0;
+
+	while (fanning != NONE)
+	{
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+		{
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t v = indices[3 * triangle + corner];
+				reordered.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (timeStamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timeStamp++;
+			}
+		}
+
+		// Prefer the candidate which has been in the cache longest.
+		uint32_t next = NONE;
+		uint32_t bestPriority = 0;
+		for (auto v : candidates)
+		{
+			if (!liveTriangles[v])
+				continue;
+
+			uint32_t priority = 0;
+			if (timeStamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = timeStamp - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		// Otherwise go back to the most recent vertex which still has triangles left,
+		// and once there are none, to the next vertex in order.
+		while (next == NONE && !deadEnds.empty())
+		{
+			uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v])
+				next = v;
+		}
+
+		while (next == NONE && cursor < vertexCount)
+		{
+			uint32_t v = cursor++;
+			if (liveTriangles[v])
+				next = v;
+		}
+
+		fanning = next;
+	}
+
+	MPD_ASSERT(reordered.size() == indices.size());
+	result.optimizedShaded = countShadedVertices(reordered);
+	return result;
+}
+
+void ReorderAdvisor::report(const IndexScanKey &key, const Entry &entry)
+{
+	const auto &cfg = device.getConfig();
+	if (!cfg.msgIndexBufferReorderAdvice || entry.optimizedShaded >= entry.currentShaded)
+		return;
+
+	uint32_t saved = entry.currentShaded - entry.optimizedShaded;
+	float savings = float(saved) / float(entry.currentShaded);
+	if (savings < cfg.indexBufferReorderAdvisorMinSavings)
+		return;
+
+	device.log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE,
+	           "Indices used by drawcall (VkBuffer 0x%llx, offset %llu, first index %u, %u indices) could be "
+	           "reordered for the post-transform vertex cache, saving %u of %u vertex shader invocations (%.0f%%).\n"
+	           "ACMR is estimated to %.3f, and could be %.3f. ATVR is estimated to %.3f, and could be %.3f.",
+	           static_cast<unsigned long long>(entry.bufferHandle), static_cast<unsigned long long>(key.indexOffset),
+	           key.firstIndex, key.indexCount, saved, entry.currentShaded, savings * 100.0f,
+	           float(entry.currentShaded) / float(entry.triangleCount),
+	           float(entry.optimizedShaded) / float(entry.triangleCount),
+	           float(entry.currentShaded) / float(entry.uniqueVertices),
+	           float(entry.optimizedShaded) / float(entry.uniqueVertices));
+}
+
+void ReorderAdvisor::nextFrame()
+{
+	const auto &cfg = device.getConfig();
+	if (!cfg.indexBufferReorderAdvisorReportFrames)
+		return;
+
+	struct Ranked
+	{
+		const IndexScanKey *key;
+		const Entry *entry;
+		double savedPerFrame;
+	};
+
+	string message;
+	{
+		lock_guard<mutex> holder{ lock };
+		if (++frame < cfg.indexBufferReorderAdvisorReportFrames)
+			return;
+		frame = 0;
+
+		vector<Ranked> ranking;
+		for (auto &it : entries)
+		{
+			const auto &entry = it.second;
+			if (entry.analyzed && entry.drawCount && entry.optimizedShaded < entry.currentShaded)
+			{
+				double saved = double(entry.currentShaded - entry.optimizedShaded) * entry.drawCount;
+				ranking.push_back({ &it.first, &entry, saved / cfg.indexBufferReorderAdvisorReportFrames });
+			}
+		}
+
+		size_t count = std::min(ranking.size(), size_t(cfg.indexBufferReorderAdvisorReportCount));
+		partial_sort(begin(ranking), begin(ranking) + count, end(ranking),
+		             [](const Ranked &a, const Ranked &b) { return a.savedPerFrame > b.savedPerFrame; });
+
+		double total = 0.0;
+		for (auto &ranked : ranking)
+			total += ranked.savedPerFrame;
+
+		if (count)
+		{
+			char line[256];
+			snprintf(line, sizeof(line),
+			         "Reordering indices for the post-transform vertex cache could save %.0f vertex shader "
+			         "invocations per frame, instancing not included. Drawcalls with the most to gain:",
+			         total);
+			message = line;
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const auto &key = *ranking[i].key;
+				const auto &entry = *ranking[i].entry;
+				snprintf(line, sizeof(line),
+				         "\n#%u: VkBuffer 0x%llx, offset %llu, first index %u, %u indices: %.0f per frame, "
+				         "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+				         unsigned(i + 1), static_cast<unsigned long long>(entry.bufferHandle),
+				         static_cast<unsigned long long>(key.indexOffset), key.firstIndex, key.indexCount,
+				         ranking[i].savedPerFrame, float(entry.currentShaded) / float(entry.triangleCount),
+				         float(entry.optimizedShaded) / float(entry.triangleCount),
+				         float(entry.currentShaded) / float(entry.uniqueVertices),
+				         float(entry.optimizedShaded) / float(entry.uniqueVertices));
+				message += line;
+			}
+		}
+
+		for (auto &it : entries)
+			it.second.drawCount = 0;
+	}
+
+	if (!message.empty() && cfg.msgIndexBufferReorderAdvice)
+		device.log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE, "%s",
+		           message.c_str());
+}
+}
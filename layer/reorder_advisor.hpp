@@ -0,0 +1,122 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "index_scan.hpp"
+#include "perfdoc.hpp"
+#include "vertex_cache.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace MPD
+{
+class Device;
+
+/// Works out how much better the post-transform cache could do with the indices of scanned triangle lists.
+///
+/// Indices are copied when they are scanned and reordered on a thread of its own with Tipsify
+/// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+/// Both orders go through the cache model of the scan, and drawcalls which would shade noticeably fewer
+/// vertices are reported with their current and achievable ACMR (shaded vertices per triangle) and ATVR
+/// (shaded vertices per unique vertex). Every few frames, the drawcalls with the most to gain per frame are ranked.
+/// At most maxEntries index ranges are remembered, like IndexScanCache.
+/// Thread-safe.
+class ReorderAdvisor
+{
+public:
+	ReorderAdvisor(Device &device, size_t maxEntries);
+	~ReorderAdvisor();
+
+	ReorderAdvisor(const ReorderAdvisor &) = delete;
+	void operator=(const ReorderAdvisor &) = delete;
+
+	/// Counts a drawcall with these indices towards the per-frame savings, whether it is scanned or not.
+	void countDraw(const IndexScanKey &key);
+
+	/// Queues indices which have just been scanned. Only triangle lists without primitive restart are analyzed,
+	/// and indices which were already analyzed at this write generation are skipped.
+	void analyze(const IndexScanKey &key, const uint8_t *indexData, uint64_t writeGeneration);
+
+	/// Called at every frame boundary, ranks the drawcalls every indexBufferReorderAdvisorReportFrames.
+	void nextFrame();
+
+	/// Forgets everything about the buffer, so a new buffer at the same address starts afresh.
+	void removeBuffer(const Buffer *buffer);
+
+private:
+	// Indices are dropped rather than queued beyond this, they are analyzed when they are scanned again.
+	static const size_t MAX_PENDING_JOBS = 64;
+
+	struct Job
+	{
+		uint64_t id;
+		IndexScanKey key;
+		std::vector<uint32_t> indices;
+	};
+
+	struct Entry
+	{
+		uint64_t writeGeneration;
+		// The job which will fill in the results, so results for a buffer which was destroyed are dropped.
+		uint64_t pendingJob;
+		uint64_t bufferHandle;
+		bool analyzed;
+		uint32_t triangleCount;
+		uint32_t uniqueVertices;
+		uint32_t currentShaded;
+		uint32_t optimizedShaded;
+		// Drawcalls since the last ranking.
+		uint32_t drawCount;
+	};
+
+	struct Result
+	{
+		uint32_t triangleCount;
+		uint32_t uniqueVertices;
+		uint32_t currentShaded;
+		uint32_t optimizedShaded;
+	};
+
+	Device &device;
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<Job> jobs;
+	std::unordered_map<IndexScanKey, Entry, IndexScanKeyHasher> entries;
+	size_t maxEntries;
+	uint64_t nextJobId = 0;
+	uint32_t frame = 0;
+	bool stopping = false;
+	std::thread thread;
+
+	// Only used by the worker.
+	VertexCache vertexCache;
+
+	void evictEntries();
+	void run();
+	Result optimize(std::vector<uint32_t> &indices);
+	uint32_t countShadedVertices(const std::vector<uint32_t> &indices);
+	void report(const IndexScanKey &key, const Entry &entry);
+};
+}
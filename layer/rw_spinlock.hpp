@@ -0,0 +1,117 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+namespace MPD
+{
+/// A reader/writer spinlock.
+/// Any number of readers can hold the lock at the same time without serializing on each other,
+/// while writers get exclusive access. Writers are expected to be rare compared to readers.
+class RWSpinLock
+{
+public:
+	RWSpinLock()
+	{
+		counter.store(0);
+	}
+
+	RWSpinLock(const RWSpinLock &) = delete;
+	void operator=(const RWSpinLock &) = delete;
+
+	void lockRead()
+	{
+		for (;;)
+		{
+			uint32_t v = counter.fetch_add(READER, std::memory_order_acquire);
+			if ((v & WRITER) == 0)
+				return;
+
+			// A writer is active or waiting, back off so it can drain the readers.
+			counter.fetch_sub(READER, std::memory_order_relaxed);
+			while ((counter.load(std::memory_order_relaxed) & WRITER) != 0)
+				std::this_thread::yield();
+		}
+	}
+
+	void unlockRead()
+	{
+		counter.fetch_sub(READER, std::memory_order_release);
+	}
+
+	void lockWrite()
+	{
+		// Claim the writer bit first so new readers back off, then wait for existing readers to leave.
+		while ((counter.fetch_or(WRITER, std::memory_order_acquire) & WRITER) != 0)
+			std::this_thread::yield();
+		while (counter.load(std::memory_order_acquire) != WRITER)
+			std::this_thread::yield();
+	}
+
+	void unlockWrite()
+	{
+		counter.fetch_and(~WRITER, std::memory_order_release);
+	}
+
+	// BasicLockable, so std::lock_guard takes the lock for writing.
+	void lock()
+	{
+		lockWrite();
+	}
+
+	void unlock()
+	{
+		unlockWrite();
+	}
+
+private:
+	enum : uint32_t
+	{
+		WRITER = 1,
+		READER = 2
+	};
+	std::atomic<uint32_t> counter;
+};
+
+/// Scoped read lock, the shared counterpart of std::lock_guard<RWSpinLock>.
+class ReadLockGuard
+{
+public:
+	explicit ReadLockGuard(RWSpinLock &lock)
+	    : lock(lock)
+	{
+		lock.lockRead();
+	}
+
+	~ReadLockGuard()
+	{
+		lock.unlockRead();
+	}
+
+	ReadLockGuard(const ReadLockGuard &) = delete;
+	void operator=(const ReadLockGuard &) = delete;
+
+private:
+	RWSpinLock &lock;
+};
+}
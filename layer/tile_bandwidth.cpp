@@ -0,0 +1,265 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "tile_bandwidth.hpp"
+#include "device.hpp"
+#include "format.hpp"
+#include "framebuffer.hpp"
+#include "image.hpp"
+#include "image_view.hpp"
+#include "message_codes.hpp"
+#include "render_pass.hpp"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace std;
+
+namespace MPD
+{
+static double toMiB(uint64_t bytes)
+{
+	return double(bytes) / (1024.0 * 1024.0);
+}
+
+TileBandwidthEstimator::TileBandwidthEstimator(Device &device)
+    : device(device)
+{
+}
+
+static bool isResolveAttachment(const VkRenderPassCreateInfo &info, uint32_t attachment)
+{
+	for (uint32_t subpass = 0; subpass < info.subpassCount; subpass++)
+	{
+		auto &subpassInfo = info.pSubpasses[subpass];
+		if (!subpassInfo.pResolveAttachments)
+			continue;
+
+		for (uint32_t i = 0; i < subpassInfo.colorAttachmentCount; i++)
+			if (subpassInfo.pResolveAttachments[i].attachment == attachment)
+				return true;
+	}
+
+	return false;
+}
+
+TileTraffic TileBandwidthEstimator::estimateRenderPass(Device &device, const VkRenderPassBeginInfo &beginInfo,
+                                                       vector<pair<uint64_t, TileTraffic>> &attachments)
+{
+	TileTraffic total = {};
+
+	auto *rp = device.get<RenderPass>(beginInfo.renderPass);
+	auto *fb = device.get<Framebuffer>(beginInfo.framebuffer);
+	if (!rp || !fb)
+		return total;
+
+	auto &rpInfo = rp->getCreateInfo();
+	auto &fbInfo = fb->getCreateInfo();
+
+	uint64_t texels = uint64_t(beginInfo.renderArea.extent.width) * beginInfo.renderArea.extent.height *
+	                  std::max(fbInfo.layers, 1u);
+
+	for (uint32_t att = 0; att < rpInfo.attachmentCount; att++)
+	{
+		// Attachments which are only read as input attachments are texture reads, not tile traffic.
+		if (!rp->renderPassUsesAttachmentOnTile(att))
+			continue;
+
+		auto &attachment = rpInfo.pAttachments[att];
+
+		uint32_t bits = 0;
+		if (formatIsDepthOnly(attachment.format) || formatIsDepthStencil(attachment.format))
+			bits = formatDepthBits(attachment.format);
+		else if (!formatIsStencilOnly(attachment.format))
+			bits = getBPP(attachment.format);
+		if (bits == uint32_t(-1))
+			bits = 0;
+
+		uint64_t samples = getNumSamples(attachment.samples);
+		uint64_t bytes = texels * samples * bits / 8;
+		uint64_t stencilBytes = texels * samples * formatStencilBits(attachment.format) / 8;
+
+		TileTraffic traffic = {};
+		if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+			traffic.loaded += bytes;
+		if (attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+			traffic.loaded += stencilBytes;
+
+		uint64_t stored = 0;
+		if (attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE)
+			stored += bytes;
+		if (attachment.stencilStoreOp == VK_ATTACHMENT_STORE_OP_STORE)
+			stored += stencilBytes;
+
+		if (isResolveAttachment(rpInfo, att))
+			traffic.resolved = stored;
+		else
+			traffic.stored = stored;
+
+		if (!traffic.total())
+			continue;
+
+		uint64_t imageHandle = 0;
+		auto *view = device.get<ImageView>(fbInfo.pAttachments[att]);
+		if (view)
+		{
+			auto *image = device.get<Image>(view->getCreateInfo().image);
+			if (image)
+				imageHandle = image->getHandle();
+		}
+
+		attachments.push_back({ imageHandle, traffic });
+		total.add(traffic);
+	}
+
+	return total;
+}
+
+void TileBandwidthEstimator::addRenderPass(uint64_t renderPass, uint64_t framebuffer, const TileTraffic &traffic)
+{
+	lock_guard<mutex> holder{ lock };
+	frameTraffic.add(traffic);
+	frameRenderPasses++;
+
+	if (device.getConfig().tileBandwidthReportFrames)
+	{
+		reportTraffic.add(traffic);
+		auto &entry = passes[{ renderPass, framebuffer }];
+		entry.traffic.add(traffic);
+		entry.count++;
+	}
+}
+
+void TileBandwidthEstimator::addImage(uint64_t image, const TileTraffic &traffic)
+{
+	if (!device.getConfig().tileBandwidthReportFrames)
+		return;
+
+	lock_guard<mutex> holder{ lock };
+	images[image].add(traffic);
+}
+
+void TileBandwidthEstimator::nextFrame()
+{
+	const auto &cfg = device.getConfig();
+
+	TileTraffic traffic;
+	uint32_t renderPasses;
+	uint64_t frameIndex;
+	string ranking;
+	{
+		lock_guard<mutex> holder{ lock };
+		traffic = frameTraffic;
+		renderPasses = frameRenderPasses;
+		frameIndex = frame++;
+		frameTraffic = {};
+		frameRenderPasses = 0;
+
+		if (cfg.tileBandwidthReportFrames && ++framesSinceReport >= cfg.tileBandwidthReportFrames)
+		{
+			ranking = rank();
+			passes.clear();
+			images.clear();
+			reportTraffic = {};
+			framesSinceReport = 0;
+		}
+	}
+
+	if (cfg.msgTileBandwidthBudget && cfg.tileBandwidthBudgetBytes && traffic.total() > cfg.tileBandwidthBudgetBytes)
+	{
+		device.log(VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT, MESSAGE_CODE_TILE_BANDWIDTH_BUDGET,
+		           "The render passes of frame %llu move an estimated %.2f MiB between the tile buffer and memory, "
+		           "over the budget of %.2f MiB. %u render passes load %.2f MiB, store %.2f MiB and resolve %.2f "
+		           "MiB. Avoid LOAD_OP_LOAD and STORE_OP_STORE for attachments whose contents are not needed.",
+		           static_cast<unsigned long long>(frameIndex), toMiB(traffic.total()),
+		           toMiB(cfg.tileBandwidthBudgetBytes), renderPasses, toMiB(traffic.loaded), toMiB(traffic.stored),
+		           toMiB(traffic.resolved));
+	}
+
+	if (!ranking.empty() && cfg.msgTileBandwidthRanking)
+		device.log(VK_DEBUG_REPORT_INFORMATION_BIT_EXT, MESSAGE_CODE_TILE_BANDWIDTH_RANKING, "%s", ranking.c_str());
+}
+
+string TileBandwidthEstimator::rank()
+{
+	const auto &cfg = device.getConfig();
+	if (!reportTraffic.total())
+		return string();
+
+	double frames = double(framesSinceReport);
+	size_t maxCount = size_t(cfg.tileBandwidthReportCount);
+
+	vector<pair<const PassKey *, const PassEntry *>> passRanking;
+	for (auto &it : passes)
+		passRanking.push_back({ &it.first, &it.second });
+	size_t passCount = std::min(passRanking.size(), maxCount);
+	partial_sort(begin(passRanking), begin(passRanking) + passCount, end(passRanking),
+	             [](const pair<const PassKey *, const PassEntry *> &a,
+	                const pair<const PassKey *, const PassEntry *> &b) {
+		             return a.second->traffic.total() > b.second->traffic.total();
+	             });
+
+	vector<pair<uint64_t, const TileTraffic *>> imageRanking;
+	for (auto &it : images)
+		imageRanking.push_back({ it.first, &it.second });
+	size_t imageCount = std::min(imageRanking.size(), maxCount);
+	partial_sort(begin(imageRanking), begin(imageRanking) + imageCount, end(imageRanking),
+	             [](const pair<uint64_t, const TileTraffic *> &a, const pair<uint64_t, const TileTraffic *> &b) {
+		             return a.second->total() > b.second->total();
+	             });
+
+	char line[256];
+	snprintf(line, sizeof(line),
+	         "Render passes moved an estimated %.2f MiB per frame between the tile buffer and memory over the last "
+	         "%u frames: %.2f MiB loaded, %.2f MiB stored and %.2f MiB resolved. Render passes which cost the most:",
+	         toMiB(reportTraffic.total()) / frames, framesSinceReport, toMiB(reportTraffic.loaded) / frames,
+	         toMiB(reportTraffic.stored) / frames, toMiB(reportTraffic.resolved) / frames);
+	string message = line;
+
+	for (size_t i = 0; i < passCount; i++)
+	{
+		auto &key = *passRanking[i].first;
+		auto &entry = *passRanking[i].second;
+		snprintf(line, sizeof(line),
+		         "\n#%u: VkRenderPass 0x%llx, VkFramebuffer 0x%llx: %.2f MiB per frame in %.1f instances "
+		         "(%.2f MiB loaded, %.2f MiB stored, %.2f MiB resolved)",
+		         unsigned(i + 1), static_cast<unsigned long long>(key.renderPass),
+		         static_cast<unsigned long long>(key.framebuffer), toMiB(entry.traffic.total()) / frames,
+		         entry.count / frames, toMiB(entry.traffic.loaded) / frames, toMiB(entry.traffic.stored) / frames,
+		         toMiB(entry.traffic.resolved) / frames);
+		message += line;
+	}
+
+	if (imageCount)
+		message += "\nImages which cost the most:";
+
+	for (size_t i = 0; i < imageCount; i++)
+	{
+		auto &traffic = *imageRanking[i].second;
+		snprintf(line, sizeof(line),
+		         "\n#%u: VkImage 0x%llx: %.2f MiB per frame (%.2f MiB loaded, %.2f MiB stored, %.2f MiB resolved)",
+		         unsigned(i + 1), static_cast<unsigned long long>(imageRanking[i].first),
+		         toMiB(traffic.total()) / frames, toMiB(traffic.loaded) / frames, toMiB(traffic.stored) / frames,
+		         toMiB(traffic.resolved) / frames);
+		message += line;
+	}
+
+	return message;
+}
+}
@@ -0,0 +1,128 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "perfdoc.hpp"
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace MPD
+{
+class Device;
+
+/// Bytes moved between the tile buffer and memory.
+struct TileTraffic
+{
+	// Attachments read into the tile buffer by VK_ATTACHMENT_LOAD_OP_LOAD.
+	uint64_t loaded;
+	// Attachments written back by VK_ATTACHMENT_STORE_OP_STORE.
+	uint64_t stored;
+	// Resolve attachments written back at the end of their subpass.
+	uint64_t resolved;
+
+	uint64_t total() const
+	{
+		return loaded + stored + resolved;
+	}
+
+	void add(const TileTraffic &other)
+	{
+		loaded += other.loaded;
+		stored += other.stored;
+		resolved += other.resolved;
+	}
+};
+
+/// Models the memory bandwidth render passes cost on a tile-based GPU.
+///
+/// Everything inside a render pass stays on tile, so the traffic is what the load and store ops of the attachments
+/// move over the render area, for every sample, plane and layer. Render pass instances are estimated when they
+/// are recorded, and counted towards the frame they are submitted in. A warning is raised for frames which move
+/// more than tileBandwidthBudgetBytes, and every few frames, the render passes and images which cost the most
+/// traffic are ranked.
+/// Thread-safe.
+class TileBandwidthEstimator
+{
+public:
+	explicit TileBandwidthEstimator(Device &device);
+
+	TileBandwidthEstimator(const TileBandwidthEstimator &) = delete;
+	void operator=(const TileBandwidthEstimator &) = delete;
+
+	/// Estimates the traffic of a render pass instance. The traffic of each attachment is returned with the handle
+	/// of its image.
+	static TileTraffic estimateRenderPass(Device &device, const VkRenderPassBeginInfo &beginInfo,
+	                                      std::vector<std::pair<uint64_t, TileTraffic>> &attachments);
+
+	/// Called when a render pass instance is submitted.
+	void addRenderPass(uint64_t renderPass, uint64_t framebuffer, const TileTraffic &traffic);
+	/// Called for each attachment of a render pass instance which is submitted.
+	void addImage(uint64_t image, const TileTraffic &traffic);
+
+	/// Called at every frame boundary, checks the budget and ranks the render passes every
+	/// tileBandwidthReportFrames.
+	void nextFrame();
+
+private:
+	struct PassKey
+	{
+		uint64_t renderPass;
+		uint64_t framebuffer;
+
+		bool operator==(const PassKey &other) const
+		{
+			return renderPass == other.renderPass && framebuffer == other.framebuffer;
+		}
+	};
+
+	struct PassKeyHasher
+	{
+		size_t operator()(const PassKey &key) const
+		{
+			return std::hash<uint64_t>()(key.renderPass * 0x9e3779b97f4a7c15ull ^ key.framebuffer);
+		}
+	};
+
+	struct PassEntry
+	{
+		TileTraffic traffic;
+		uint32_t count;
+	};
+
+	Device &device;
+
+	std::mutex lock;
+	TileTraffic frameTraffic = {};
+	uint32_t frameRenderPasses = 0;
+	uint64_t frame = 0;
+
+	// Since the last ranking, only kept if tileBandwidthReportFrames is set.
+	std::unordered_map<PassKey, PassEntry, PassKeyHasher> passes;
+	std::unordered_map<uint64_t, TileTraffic> images;
+	TileTraffic reportTraffic = {};
+	uint32_t framesSinceReport = 0;
+
+	std::string rank();
+};
+}
@@ -0,0 +1,211 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include "perfdoc.hpp"
+#include <stdint.h>
+#include <vector>
+
+namespace MPD
+{
+/// Model of the post-transform vertex cache, used to estimate how many vertices a draw shades.
+///
+/// Lookups go through an open-addressed hash table of cache tags, and the replacement order is kept
+/// in an intrusive list (LRU) or a ring (FIFO), so an access costs the same regardless of the cache size.
+class VertexCache
+{
+public:
+	enum class Policy
+	{
+		LRU,
+		FIFO
+	};
+
+	/// Empties the cache. Memory is kept if the size does not grow.
+	void reset(uint32_t cacheSize, Policy cachePolicy)
+	{
+		size = cacheSize;
+		policy = cachePolicy;
+		used = 0;
+		head = INVALID;
+		tail = INVALID;
+		fifoNext = 0;
+
+		uint32_t tableSize = 1;
+		shift = 32;
+		while (tableSize < 2 * size)
+		{
+			tableSize <<= 1;
+			shift--;
+		}
+		mask = tableSize - 1;
+
+		entries.resize(size);
+		// Copy the constant, assign() takes it by reference.
+		table.assign(tableSize, uint32_t(INVALID));
+	}
+
+	/// Returns true if the vertex was in the cache, otherwise inserts it.
+	bool access(uint32_t vertex)
+	{
+		if (!size)
+			return false;
+
+		uint32_t slot = home(vertex);
+		for (;;)
+		{
+			uint32_t index = table[slot];
+			if (index == INVALID)
+				break;
+
+			if (entries[index].vertex == vertex)
+			{
+				if (policy == Policy::LRU)
+					moveToFront(index);
+				return true;
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		uint32_t index;
+		if (used < size)
+			index = used++;
+		else
+		{
+			// Evict the oldest entry and reuse it.
+			if (policy == Policy::LRU)
+			{
+				index = tail;
+				unlink(index);
+			}
+			else
+			{
+				index = fifoNext;
+				fifoNext = fifoNext + 1 == size ? 0 : fifoNext + 1;
+			}
+
+			erase(entries[index].vertex);
+
+			// The slot we found might have moved into the hole left by erase().
+			slot = home(vertex);
+			while (table[slot] != INVALID)
+				slot = (slot + 1) & mask;
+		}
+
+		entries[index].vertex = vertex;
+		table[slot] = index;
+		if (policy == Policy::LRU)
+			pushFront(index);
+		return false;
+	}
+
+private:
+	static const uint32_t INVALID = ~0u;
+
+	struct Entry
+	{
+		uint32_t vertex;
+		// Only used for LRU.
+		uint32_t prev;
+		uint32_t next;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<uint32_t> table;
+	uint32_t size = 0;
+	uint32_t used = 0;
+	uint32_t mask = 0;
+	uint32_t shift = 32;
+	Policy policy = Policy::LRU;
+
+	// Most and least recently used entries for LRU.
+	uint32_t head = INVALID;
+	uint32_t tail = INVALID;
+
+	// Next entry to replace for FIFO.
+	uint32_t fifoNext = 0;
+
+	uint32_t home(uint32_t vertex) const
+	{
+		// Fibonacci hashing, the top bits are the best mixed.
+		return shift == 32 ? 0 : (vertex * 0x9e3779b1u) >> shift;
+	}
+
+	void erase(uint32_t vertex)
+	{
+		uint32_t slot = home(vertex);
+		while (entries[table[slot]].vertex != vertex)
+			slot = (slot + 1) & mask;
+
+		// Backward shift deletion, so lookups never need tombstones.
+		uint32_t next = slot;
+		for (;;)
+		{
+			next = (next + 1) & mask;
+			if (table[next] == INVALID)
+				break;
+
+			uint32_t target = home(entries[table[next]].vertex);
+			// Move the entry into the hole unless its home lies cyclically in (slot, next].
+			bool inRange = slot <= next ? (slot < target && target <= next) : (slot < target || target <= next);
+			if (!inRange)
+			{
+				table[slot] = table[next];
+				slot = next;
+			}
+		}
+		table[slot] = INVALID;
+	}
+
+	void unlink(uint32_t index)
+	{
+		auto &entry = entries[index];
+		if (entry.prev != INVALID)
+			entries[entry.prev].next = entry.next;
+		else
+			head = entry.next;
+
+		if (entry.next != INVALID)
+			entries[entry.next].prev = entry.prev;
+		else
+			tail = entry.prev;
+	}
+
+	void pushFront(uint32_t index)
+	{
+		auto &entry = entries[index];
+		entry.prev = INVALID;
+		entry.next = head;
+		if (head != INVALID)
+			entries[head].prev = index;
+		head = index;
+		if (tail == INVALID)
+			tail = index;
+	}
+
+	void moveToFront(uint32_t index)
+	{
+		if (head == index)
+			return;
+		unlink(index);
+		pushFront(index);
+	}
+};
+}
@@ -0,0 +1,241 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class AsyncAnalysisTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	shared_ptr<Texture> tex;
+	shared_ptr<Framebuffer> fb;
+	shared_ptr<Pipeline> pplineNoRestart;
+	shared_ptr<Pipeline> pplineRestart;
+
+	shared_ptr<Buffer> idxBuffNoReuse;
+	shared_ptr<Buffer> idxBuffNoReuseSparse;
+	shared_ptr<Buffer> idxBuffThrash;
+	shared_ptr<Buffer> idxBuffNoThrash;
+
+	static const unsigned reuseFactor = 16;
+
+	shared_ptr<CommandBuffer> submitDraw(const Buffer &buffer, unsigned count, bool primitiveRestart)
+	{
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+		                  primitiveRestart ? pplineRestart->pipeline : pplineNoRestart->pipeline);
+		vkCmdBindIndexBuffer(cmdb->commandBuffer, buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(cmdb->commandBuffer, count, 1, 0, 0, 0);
+		vkCmdEndRenderPass(cmdb->commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb->commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		return cmdb;
+	}
+
+	// The analysis of a command buffer finishes before it can be freed, so freeing it waits for the findings.
+	void waitForAnalysis(shared_ptr<CommandBuffer> &cmdb)
+	{
+		vkQueueWaitIdle(queue);
+		cmdb.reset();
+	}
+
+	bool expectCounts(unsigned sparse, unsigned thrashing)
+	{
+		return getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) == sparse &&
+		       getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) == thrashing;
+	}
+
+	// The same draws as commandbuffer-test's testIndexScanning(), with the same findings.
+	bool testOneByOne()
+	{
+		const unsigned count = cfg.indexBufferScanMinIndexCount;
+
+		resetCounts();
+		auto cmdb = submitDraw(*idxBuffNoReuseSparse, count, false);
+		waitForAnalysis(cmdb);
+		if (!expectCounts(1, 0))
+			return false;
+
+		resetCounts();
+		cmdb = submitDraw(*idxBuffNoReuseSparse, count, true);
+		waitForAnalysis(cmdb);
+		if (!expectCounts(0, 0))
+			return false;
+
+		resetCounts();
+		cmdb = submitDraw(*idxBuffNoReuse, count, false);
+		waitForAnalysis(cmdb);
+		if (!expectCounts(0, 0))
+			return false;
+
+		resetCounts();
+		cmdb = submitDraw(*idxBuffThrash, reuseFactor * count, false);
+		waitForAnalysis(cmdb);
+		if (!expectCounts(0, 1))
+			return false;
+
+		resetCounts();
+		cmdb = submitDraw(*idxBuffNoThrash, reuseFactor * count, false);
+		waitForAnalysis(cmdb);
+		if (!expectCounts(0, 0))
+			return false;
+
+		return true;
+	}
+
+	// Submissions queue up for the worker while the application keeps going, and none of them are lost.
+	bool testQueued()
+	{
+		const unsigned count = cfg.indexBufferScanMinIndexCount;
+
+		// Scans are cached, use buffers with the same contents which haven't been scanned yet.
+		vector<uint16_t> indices(count);
+		for (unsigned i = 0; i < count; i++)
+			indices[i] = i;
+		indices.back() = 0xffff;
+
+		resetCounts();
+		vector<shared_ptr<Buffer>> buffers;
+		vector<shared_ptr<CommandBuffer>> cmdbs;
+		for (unsigned i = 0; i < 8; i++)
+		{
+			auto buffer = make_shared<Buffer>(device);
+			buffer->init(sizeof(uint16_t) * count, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+			             HOST_ACCESS_WRITE, indices.data());
+			buffers.push_back(buffer);
+			cmdbs.push_back(submitDraw(*buffer, count, false));
+		}
+
+		for (auto &cmdb : cmdbs)
+			waitForAnalysis(cmdb);
+
+		if (!expectCounts(8, 0))
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.primitiveRestartEnable = false;
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		pplineNoRestart = make_shared<Pipeline>(device);
+		pplineNoRestart->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+		ia.primitiveRestartEnable = true;
+		pplineRestart = make_shared<Pipeline>(device);
+		pplineRestart->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		const unsigned count = cfg.indexBufferScanMinIndexCount;
+		vector<uint16_t> indices(count);
+		for (unsigned i = 0; i < count; i++)
+			indices[i] = i;
+
+		idxBuffNoReuse = make_shared<Buffer>(device);
+		idxBuffNoReuse->init(sizeof(uint16_t) * count, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                     HOST_ACCESS_WRITE, indices.data());
+
+		indices.back() = 0xffff;
+		idxBuffNoReuseSparse = make_shared<Buffer>(device);
+		idxBuffNoReuseSparse->init(sizeof(uint16_t) * count, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                           HOST_ACCESS_WRITE, indices.data());
+
+		// Worst possible reuse.
+		indices.resize(reuseFactor * count);
+		for (unsigned i = 0; i < reuseFactor; i++)
+			for (unsigned j = 0; j < count; j++)
+				indices[j + i * count] = j;
+
+		idxBuffThrash = make_shared<Buffer>(device);
+		idxBuffThrash->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                    HOST_ACCESS_WRITE, indices.data());
+
+		// Best possible reuse.
+		for (unsigned j = 0; j < count; j++)
+			for (unsigned i = 0; i < reuseFactor; i++)
+				indices[j * reuseFactor + i] = j;
+
+		idxBuffNoThrash = make_shared<Buffer>(device);
+		idxBuffNoThrash->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                      HOST_ACCESS_WRITE, indices.data());
+
+		if (!testOneByOne())
+			return false;
+
+		if (!testQueued())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	setLayerConfig("async-analysis-test", "asyncAnalysisEnable on\n");
+	return new AsyncAnalysisTest;
+}
@@ -0,0 +1,132 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <thread>
+
+using namespace MPD;
+using namespace std;
+
+static const char *TRIGGER_FILE = "capture-window-test.trigger";
+
+class CaptureWindowTest : public VulkanTestHelper
+{
+	// Records and submits one frame, and returns whether the command buffer was analyzed.
+	bool runFrame(CommandBuffer &cmdb)
+	{
+		resetCounts();
+
+		// Resets outside the window are skipped by the layer, inside they discard the recorded analysis.
+		MPD_ASSERT_RESULT(vkResetCommandBuffer(cmdb.commandBuffer, 0));
+
+		// The simultaneous use warning is reported at vkBeginCommandBuffer, but only in the capture window.
+		VkCommandBufferBeginInfo cbbi = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		cbbi.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb.commandBuffer, &cbbi));
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb.commandBuffer));
+		bool analyzed = getCount(MESSAGE_CODE_COMMAND_BUFFER_SIMULTANEOUS_USE) == 1;
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb.commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+
+		return analyzed;
+	}
+
+	bool testFrameRange(CommandBuffer &cmdb)
+	{
+		// The window covers frames 2 and 3, every submit ends a frame.
+		for (uint32_t frame = 0; frame < 6; frame++)
+		{
+			bool analyzed = runFrame(cmdb);
+			if (analyzed != (frame == 2 || frame == 3))
+				return false;
+
+			// The window opens when frame 1 ends and closes when frame 3 ends.
+			unsigned expected = (frame == 1 || frame == 3) ? 1 : 0;
+			if (getCount(MESSAGE_CODE_CAPTURE_WINDOW) != expected)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool testTriggerFile(CommandBuffer &cmdb)
+	{
+		FILE *file = fopen(TRIGGER_FILE, "w");
+		if (!file)
+			return false;
+		fclose(file);
+
+		// The file is only looked for once the poll interval is over.
+		this_thread::sleep_for(chrono::milliseconds(100));
+		runFrame(cmdb);
+		if (getCount(MESSAGE_CODE_CAPTURE_WINDOW) != 1)
+			return false;
+
+		if (!runFrame(cmdb))
+			return false;
+
+		remove(TRIGGER_FILE);
+		this_thread::sleep_for(chrono::milliseconds(100));
+		if (!runFrame(cmdb))
+			return false;
+		if (getCount(MESSAGE_CODE_CAPTURE_WINDOW) != 1)
+			return false;
+
+		if (runFrame(cmdb))
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		if (!testFrameRange(*cmdb))
+			return false;
+
+		if (!testTriggerFile(*cmdb))
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	remove(TRIGGER_FILE);
+	setLayerConfig("capture-window-test", "captureWindowEnable on\n"
+	                                      "captureWindowFirstFrame 2\n"
+	                                      "captureWindowFrameCount 2\n"
+	                                      "captureTriggerFile capture-window-test.trigger\n"
+	                                      "captureTriggerPollMilliseconds 50\n"
+	                                      "frameBoundaryPerSubmit on\n");
+	return new CaptureWindowTest;
+}
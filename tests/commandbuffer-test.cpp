@@ -42,6 +42,12 @@ class CommandBufferTest : public VulkanTestHelper
 		if (!testIndexScanning())
 			return false;
 
+		if (!testIndirectDrawcalls())
+			return false;
+
+		if (!testIndexScanCache())
+			return false;
+
 		return true;
 	}
 
@@ -286,7 +292,19 @@ class CommandBufferTest : public VulkanTestHelper
 		idxBuffNoThrash->init(sizeof(uint16_t) * reuseFactor * cfg.indexBufferScanMinIndexCount,
 		                      VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties, HOST_ACCESS_WRITE, indices.data());
 
-		const auto buildRenderPass = [&](const Buffer &buffer, unsigned count, bool primitiveRestart) {
+		// Indices spread over more than 64 pages of 65536 values, more than the scan can count distinct values for.
+		// The range is no larger than the index count, so the indices are not sparse either.
+		const uint32_t scatteredCount = 65 * 65536;
+		vector<uint32_t> scatteredIndices(scatteredCount);
+		for (uint32_t i = 0; i < scatteredCount; i++)
+			scatteredIndices[i] = i;
+
+		auto idxBuffScattered = make_shared<Buffer>(device);
+		idxBuffScattered->init(sizeof(uint32_t) * scatteredCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                       HOST_ACCESS_WRITE, scatteredIndices.data());
+
+		const auto buildRenderPass = [&](const Buffer &buffer, unsigned count, bool primitiveRestart,
+		                                 VkIndexType indexType) {
 			// Create command buffer
 			auto cmdb = make_shared<CommandBuffer>(device);
 			cmdb->initPrimary();
@@ -318,7 +336,7 @@ class CommandBufferTest : public VulkanTestHelper
 			vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
 			vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			                  primitiveRestart ? pplineRestart->pipeline : pplineNoRestart->pipeline);
-			vkCmdBindIndexBuffer(cmdb->commandBuffer, buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdBindIndexBuffer(cmdb->commandBuffer, buffer.buffer, 0, indexType);
 			vkCmdDrawIndexed(cmdb->commandBuffer, count, 1, 0, 0, 0);
 			vkCmdEndRenderPass(cmdb->commandBuffer);
 
@@ -333,7 +351,7 @@ class CommandBufferTest : public VulkanTestHelper
 
 		// One index is way off (primitive restart, but we aren't using primitive restart).
 		resetCounts();
-		buildRenderPass(*idxBuffNoReuseSparse, cfg.indexBufferScanMinIndexCount, false);
+		buildRenderPass(*idxBuffNoReuseSparse, cfg.indexBufferScanMinIndexCount, false, VK_INDEX_TYPE_UINT16);
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
 			return false;
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) != 0)
@@ -341,7 +359,7 @@ class CommandBufferTest : public VulkanTestHelper
 
 		// One index is way off, but it's primitive restart, so it's okay.
 		resetCounts();
-		buildRenderPass(*idxBuffNoReuseSparse, cfg.indexBufferScanMinIndexCount, true);
+		buildRenderPass(*idxBuffNoReuseSparse, cfg.indexBufferScanMinIndexCount, true, VK_INDEX_TYPE_UINT16);
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
 			return false;
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) != 0)
@@ -349,7 +367,7 @@ class CommandBufferTest : public VulkanTestHelper
 
 		// No reuse no sparse-ness.
 		resetCounts();
-		buildRenderPass(*idxBuffNoReuse, cfg.indexBufferScanMinIndexCount, false);
+		buildRenderPass(*idxBuffNoReuse, cfg.indexBufferScanMinIndexCount, false, VK_INDEX_TYPE_UINT16);
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
 			return false;
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) != 0)
@@ -357,7 +375,7 @@ class CommandBufferTest : public VulkanTestHelper
 
 		// Thrash test.
 		resetCounts();
-		buildRenderPass(*idxBuffThrash, reuseFactor * cfg.indexBufferScanMinIndexCount, false);
+		buildRenderPass(*idxBuffThrash, reuseFactor * cfg.indexBufferScanMinIndexCount, false, VK_INDEX_TYPE_UINT16);
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
 			return false;
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) != 1)
@@ -365,7 +383,15 @@ class CommandBufferTest : public VulkanTestHelper
 
 		// No-thrash test.
 		resetCounts();
-		buildRenderPass(*idxBuffNoThrash, reuseFactor * cfg.indexBufferScanMinIndexCount, false);
+		buildRenderPass(*idxBuffNoThrash, reuseFactor * cfg.indexBufferScanMinIndexCount, false, VK_INDEX_TYPE_UINT16);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
+			return false;
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) != 0)
+			return false;
+
+		// Every vertex is shaded once, but the hit rate can't be estimated, so thrashing must not be reported.
+		resetCounts();
+		buildRenderPass(*idxBuffScattered, scatteredCount, false, VK_INDEX_TYPE_UINT32);
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
 			return false;
 		if (getCount(MESSAGE_CODE_INDEX_BUFFER_CACHE_THRASHING) != 0)
@@ -458,6 +484,249 @@ class CommandBufferTest : public VulkanTestHelper
 
 		return true;
 	}
+
+	bool testIndirectDrawcalls()
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+		const uint32_t WIDTH = 64, HEIGHT = 64;
+
+		// Create render target
+		auto tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		// Create FB
+		auto fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		// Create shaders
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		// Crete pipeline
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+		auto ppline = make_shared<Pipeline>(device);
+		ppline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		// One index is way off, so scanning all of them reports a sparse index buffer.
+		vector<uint16_t> indices(cfg.indexBufferScanMinIndexCount);
+		for (unsigned i = 0; i < cfg.indexBufferScanMinIndexCount; i++)
+			indices[i] = i;
+		indices.back() = 0xffff;
+
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		              HOST_ACCESS_WRITE, indices.data());
+
+		const auto submitIndirect = [&](vector<VkDrawIndexedIndirectCommand> args) {
+			auto argBuff = make_shared<Buffer>(device);
+			argBuff->init(sizeof(VkDrawIndexedIndirectCommand) * args.size(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			              memoryProperties, HOST_ACCESS_WRITE, args.data());
+
+			auto cmdb = make_shared<CommandBuffer>(device);
+			cmdb->initPrimary();
+
+			VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+				                                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+			MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+			VkClearValue clearValues[3];
+			memset(clearValues, 0, sizeof(clearValues));
+
+			VkRenderPassBeginInfo rbi = {};
+			rbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			rbi.renderPass = fb->renderPass;
+			rbi.framebuffer = fb->framebuffer;
+			rbi.clearValueCount = 3;
+			rbi.pClearValues = clearValues;
+
+			VkViewport s;
+			s.x = 0;
+			s.y = 0;
+			s.width = WIDTH;
+			s.height = HEIGHT;
+			s.minDepth = 0.0;
+			s.maxDepth = 1.0;
+
+			vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+			vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ppline->pipeline);
+			vkCmdBindIndexBuffer(cmdb->commandBuffer, idxBuff->buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdDrawIndexedIndirect(cmdb->commandBuffer, argBuff->buffer, 0, uint32_t(args.size()),
+			                         sizeof(VkDrawIndexedIndirectCommand));
+			vkCmdEndRenderPass(cmdb->commandBuffer);
+
+			MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+			VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit.commandBufferCount = 1;
+			submit.pCommandBuffers = &cmdb->commandBuffer;
+			vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE);
+			vkQueueWaitIdle(queue);
+		};
+
+		// The arguments are read at submit, where every draw counts like a direct drawcall.
+		resetCounts();
+		VkDrawIndexedIndirectCommand smallDraw = { 3, 1, 0, 0, 0 };
+		submitIndirect(vector<VkDrawIndexedIndirectCommand>(cfg.maxSmallIndexedDrawcalls, smallDraw));
+		if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != 1)
+			return false;
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
+			return false;
+
+		// Draws culled on the GPU have no instances, and are not counted.
+		resetCounts();
+		VkDrawIndexedIndirectCommand culledDraw = { 3, 0, 0, 0, 0 };
+		submitIndirect(vector<VkDrawIndexedIndirectCommand>(cfg.maxSmallIndexedDrawcalls, culledDraw));
+		if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != 0)
+			return false;
+
+		// The indices of each draw are scanned.
+		resetCounts();
+		VkDrawIndexedIndirectCommand sparseDraw = { uint32_t(indices.size()), 1, 0, 0, 0 };
+		submitIndirect(vector<VkDrawIndexedIndirectCommand>(1, sparseDraw));
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+		if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != 0)
+			return false;
+
+		return true;
+	}
+
+	bool testIndexScanCache()
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+		const uint32_t WIDTH = 64, HEIGHT = 64;
+
+		// Create render target
+		auto tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		// Create FB
+		auto fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		// Create shaders
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		// Crete pipeline
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+		auto ppline = make_shared<Pipeline>(device);
+		ppline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		// One index is way off, so scanning the indices reports a sparse index buffer.
+		vector<uint16_t> indices(cfg.indexBufferScanMinIndexCount);
+		for (unsigned i = 0; i < cfg.indexBufferScanMinIndexCount; i++)
+			indices[i] = i;
+		indices.back() = 0xffff;
+
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(sizeof(uint16_t) * indices.size(),
+		              VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties,
+		              HOST_ACCESS_WRITE, indices.data());
+
+		const auto submit = [&](VkCommandBuffer commandBuffer) {
+			VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+			vkQueueWaitIdle(queue);
+		};
+
+		// Recorded once and submitted as often as needed.
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL, 0, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValues[3];
+		memset(clearValues, 0, sizeof(clearValues));
+
+		VkRenderPassBeginInfo rbi = {};
+		rbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 3;
+		rbi.pClearValues = clearValues;
+
+		VkViewport s;
+		s.x = 0;
+		s.y = 0;
+		s.width = WIDTH;
+		s.height = HEIGHT;
+		s.minDepth = 0.0;
+		s.maxDepth = 1.0;
+
+		vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ppline->pipeline);
+		vkCmdBindIndexBuffer(cmdb->commandBuffer, idxBuff->buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(cmdb->commandBuffer, uint32_t(indices.size()), 1, 0, 0, 0);
+		vkCmdEndRenderPass(cmdb->commandBuffer);
+
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		// The first submission scans the indices.
+		resetCounts();
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		// The indices haven't changed since, so the draw isn't scanned or reported again.
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		// Mapping the memory means the application may have written new indices.
+		void *ptr;
+		MPD_ASSERT_RESULT(vkMapMemory(device, idxBuff->memory, 0, VK_WHOLE_SIZE, 0, &ptr));
+		vkUnmapMemory(device, idxBuff->memory);
+
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 2)
+			return false;
+
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 2)
+			return false;
+
+		// So may transfers on the GPU.
+		auto updateCmdb = make_shared<CommandBuffer>(device);
+		updateCmdb->initPrimary();
+
+		VkCommandBufferBeginInfo updateBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(updateCmdb->commandBuffer, &updateBeginInfo));
+		vkCmdUpdateBuffer(updateCmdb->commandBuffer, idxBuff->buffer, 0, sizeof(uint16_t) * indices.size(),
+		                  indices.data());
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(updateCmdb->commandBuffer));
+		submit(updateCmdb->commandBuffer);
+
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 3)
+			return false;
+
+		return true;
+	}
 };
 
 VulkanTestHelper *MPD::createTest()
@@ -0,0 +1,113 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <thread>
+
+using namespace MPD;
+using namespace std;
+
+class FrameStatsTest : public VulkanTestHelper
+{
+	// Every submit ends a frame, and every other frame is reported.
+	static const uint32_t LOG_INTERVAL = 2;
+
+	void recordBarrier(CommandBuffer &cmdb)
+	{
+		VkCommandBufferBeginInfo cbbi = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		cbbi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb.commandBuffer, &cbbi));
+		vkCmdPipelineBarrier(cmdb.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+		                     nullptr, 0, nullptr, 0, nullptr);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb.commandBuffer));
+	}
+
+	void submit(CommandBuffer &cmdb)
+	{
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb.commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+	}
+
+	bool testFrameStatistics()
+	{
+		resetCounts();
+
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		for (uint32_t frame = 0; frame < 2 * LOG_INTERVAL; frame++)
+		{
+			recordBarrier(*cmdb);
+			submit(*cmdb);
+		}
+
+		if (getCount(MESSAGE_CODE_FRAME_STATISTICS) != 2)
+			return false;
+
+		return true;
+	}
+
+	bool testShortLivedThreads()
+	{
+		resetCounts();
+
+		// Each frame is recorded on a new thread, whose counters must still make it into the frame.
+		for (uint32_t frame = 0; frame < 2 * LOG_INTERVAL; frame++)
+		{
+			auto cmdb = make_shared<CommandBuffer>(device);
+			thread recorder([&]() {
+				cmdb->initPrimary();
+				recordBarrier(*cmdb);
+			});
+			recorder.join();
+			submit(*cmdb);
+		}
+
+		if (getCount(MESSAGE_CODE_FRAME_STATISTICS) != 2)
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		if (!testFrameStatistics())
+			return false;
+
+		if (!testShortLivedThreads())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	setLayerConfig("frame-stats-test", "frameStatsEnable on\n"
+	                                    "frameStatsLogInterval 2\n"
+	                                    "frameBoundaryPerSubmit on\n");
+	return new FrameStatsTest;
+}
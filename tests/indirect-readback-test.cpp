@@ -0,0 +1,142 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class IndirectReadbackTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	void submit(VkCommandBuffer commandBuffer)
+	{
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = commandBuffer != VK_NULL_HANDLE ? 1 : 0;
+		submit.pCommandBuffers = &commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		auto tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		auto fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		auto pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		// One index is way off, so scanning all of them reports a sparse index buffer.
+		vector<uint16_t> indices(cfg.indexBufferScanMinIndexCount);
+		for (unsigned i = 0; i < cfg.indexBufferScanMinIndexCount; i++)
+			indices[i] = i;
+		indices.back() = 0xffff;
+
+		// Both the indices and the arguments are written on the GPU, like a GPU-driven renderer would.
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(sizeof(uint16_t) * indices.size(),
+		              VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties);
+
+		auto argBuff = make_shared<Buffer>(device);
+		argBuff->init(sizeof(VkDrawIndexedIndirectCommand),
+		              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties);
+
+		VkDrawIndexedIndirectCommand args = { uint32_t(indices.size()), 1, 0, 0, 0 };
+
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		vkCmdUpdateBuffer(cmdb->commandBuffer, idxBuff->buffer, 0, sizeof(uint16_t) * indices.size(),
+		                  indices.data());
+		vkCmdUpdateBuffer(cmdb->commandBuffer, argBuff->buffer, 0, sizeof(args), &args);
+
+		VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(cmdb->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier,
+		                     0, nullptr, 0, nullptr);
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		vkCmdBindIndexBuffer(cmdb->commandBuffer, idxBuff->buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexedIndirect(cmdb->commandBuffer, argBuff->buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+		vkCmdEndRenderPass(cmdb->commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		// Nothing is known about the draw before the GPU has written its arguments.
+		resetCounts();
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
+			return false;
+
+		// The copies are picked up by later submissions, the indices may need one more round trip.
+		for (unsigned i = 0; i < 4 && getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) == 0; i++)
+			submit(VK_NULL_HANDLE);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	setLayerConfig("indirect-readback-test", "indexBufferShadowReadback on\n");
+	return new IndirectReadbackTest;
+}
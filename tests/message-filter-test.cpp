@@ -0,0 +1,183 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class MessageFilterTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	// The summary of suppressed messages is not about any check, and has no message code of its own.
+	static const MessageCodes SUMMARY = MessageCodes(0);
+
+	shared_ptr<Texture> tex;
+	shared_ptr<Framebuffer> fb;
+	shared_ptr<Pipeline> pipeline;
+	shared_ptr<Buffer> idxBuff;
+	shared_ptr<CommandBuffer> repeatCmdb;
+
+	// Reports MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS for the command buffer.
+	void recordSmallDrawcalls(VkCommandBuffer commandBuffer)
+	{
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		vkCmdBindIndexBuffer(commandBuffer, idxBuff->buffer, 0, VK_INDEX_TYPE_UINT32);
+		for (unsigned i = 0; i < cfg.maxSmallIndexedDrawcalls; i++)
+			vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, 0);
+		vkCmdEndRenderPass(commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	bool testRepeatLimit()
+	{
+		resetCounts();
+
+		repeatCmdb = make_shared<CommandBuffer>(device);
+		repeatCmdb->initPrimary();
+
+		// Recording the same command buffer again repeats the message for the same object.
+		for (unsigned i = 1; i <= 5; i++)
+		{
+			MPD_ASSERT_RESULT(vkResetCommandBuffer(repeatCmdb->commandBuffer, 0));
+			recordSmallDrawcalls(repeatCmdb->commandBuffer);
+			if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != min(i, 2u))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool testRateLimit()
+	{
+		resetCounts();
+
+		// Every command buffer is a different object, so these are not repeats. Only the burst limits them, and
+		// testRepeatLimit() already took two of the three messages it allows.
+		for (unsigned i = 0; i < 4; i++)
+		{
+			auto cmdb = make_shared<CommandBuffer>(device);
+			cmdb->initPrimary();
+			recordSmallDrawcalls(cmdb->commandBuffer);
+		}
+
+		if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != 1)
+			return false;
+
+		return true;
+	}
+
+	bool testSummary()
+	{
+		resetCounts();
+
+		// Suppressed, the command buffer is past its repeat limit.
+		MPD_ASSERT_RESULT(vkResetCommandBuffer(repeatCmdb->commandBuffer, 0));
+		recordSmallDrawcalls(repeatCmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != 0)
+			return false;
+
+		// Once the interval has passed, the end of a frame writes the summary even though nothing else is logged.
+		unsigned summaries = getCount(SUMMARY);
+		this_thread::sleep_for(chrono::milliseconds(1100));
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+
+		if (getCount(SUMMARY) != summaries + 1)
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		pplineInf.renderPass = fb->renderPass;
+
+		pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(sizeof(uint32_t) * 3, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties);
+
+		if (!testRepeatLimit())
+			return false;
+
+		if (!testRateLimit())
+			return false;
+
+		if (!testSummary())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	// The rate is low enough for the bucket not to refill while the test runs.
+	setLayerConfig("message-filter-test", "messageFilterEnable on\n"
+	                                      "messageFilterRepeatLimit 2\n"
+	                                      "messageFilterRatePerSecond 0.001\n"
+	                                      "messageFilterBurst 3\n"
+	                                      "messageFilterSummarySeconds 1\n"
+	                                      "frameBoundaryPerSubmit on\n");
+	return new MessageFilterTest;
+}
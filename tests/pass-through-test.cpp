@@ -0,0 +1,220 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class PassThroughTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	shared_ptr<Texture> tex;
+	shared_ptr<Framebuffer> fb;
+	shared_ptr<Pipeline> pipeline;
+
+	void recordDraws(VkCommandBuffer commandBuffer, const Buffer &buffer, uint32_t indexCount, unsigned drawCount)
+	{
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		vkCmdBindIndexBuffer(commandBuffer, buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		for (unsigned i = 0; i < drawCount; i++)
+			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	bool testObjects()
+	{
+		resetCounts();
+
+		// Object creation is always intercepted.
+		auto buffer = make_shared<Buffer>(device);
+		buffer->init(256, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, memoryProperties);
+		if (getCount(MESSAGE_CODE_SMALL_ALLOCATION) != 1)
+			return false;
+
+		return true;
+	}
+
+	bool testCommandBuffers()
+	{
+		resetCounts();
+
+		vector<uint16_t> indices(cfg.indexBufferScanMinIndexCount);
+		for (unsigned i = 0; i < cfg.indexBufferScanMinIndexCount; i++)
+			indices[i] = i;
+		indices.back() = 0xffff;
+
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		              HOST_ACCESS_WRITE, indices.data());
+
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		// The check is disabled, the command buffer is still recorded for the others.
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                     VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+		if (getCount(MESSAGE_CODE_COMMAND_BUFFER_SIMULTANEOUS_USE) != 0)
+			return false;
+
+		// Checked while recording.
+		recordDraws(cmdb->commandBuffer, *idxBuff, 3, unsigned(cfg.maxSmallIndexedDrawcalls));
+		if (getCount(MESSAGE_CODE_MANY_SMALL_INDEXED_DRAWCALLS) != 1)
+			return false;
+
+		// Checked at vkQueueSubmit.
+		recordDraws(cmdb->commandBuffer, *idxBuff, uint32_t(indices.size()), 1);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb->commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		if (!testObjects())
+			return false;
+
+		if (!testCommandBuffers())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	// Every check is disabled except for one of each kind, so nothing else keeps the entry points they need
+	// intercepted.
+	static const char *const disabled[] = {
+		"msgCommandBufferReset",
+		"msgCommandBufferSimultaneousUse",
+		"msgSmallDedicatedAllocation",
+		"msgTooLargeSampleCount",
+		"msgNonLazyMultisampledImage",
+		"msgNonLazyTransientImage",
+		"msgMultisampledImageRequiresMemory",
+		"msgResolveImage",
+		"msgFramebufferAttachmentShouldBeTransient",
+		"msgFramebufferAttachmentShouldNotBeTransient",
+		"msgIndexBufferCacheThrashing",
+		"msgTooManyInstancedVertexBuffers",
+		"msgDissimilarWrapping",
+		"msgNoPipelineCache",
+		"msgDescriptorSetAllocationChecks",
+		"msgComputeNoThreadGroupAlignment",
+		"msgComputeLargeWorkGroup",
+		"msgComputePoorSpatialLocality",
+		"msgPotentialPushConstant",
+		"msgDepthPrePass",
+		"msgPipelineBubble",
+		"msgNotFullThroughputBlending",
+		"msgSamplerLodClamping",
+		"msgSamplerLodBias",
+		"msgSamplerBorderClampColor",
+		"msgSamplerUnnormalizedCoords",
+		"msgSamplerAnisotropy",
+		"msgTileReadback",
+		"msgClearAttachmentsAfterLoad",
+		"msgClearAttachmentsNoDrawCall",
+		"msgRedundantRenderpassStore",
+		"msgRedundantImageClear",
+		"msgInefficientClear",
+		"msgLazyTransientImageNotSupported",
+		"msgUncompressedTextureUsed",
+		"msgNonMipmappedTextureUsed",
+		"msgNonIndexedDrawCall",
+		"msgSuboptimalTextureFormat",
+		"msgTextureLinearTiling",
+		"msgNoFBCDC",
+		"msgRobustBufferAccessEnabled",
+		"msgSuboptimalSubpassDependencyFlag",
+		"msgPartialClear",
+		"msgPipelineOptimisationDisabled",
+		"msgWorkgroupSizeDivisor",
+		"msgPotentialSubpass",
+		"msgSubpassStencilSelfDependency",
+		"msgInefficientDepthStencilOps",
+		"msgQueryBundleTooSmall",
+		"msgIndexBufferReorderAdvice",
+		"msgFrameStatistics",
+		"msgTileBandwidthBudget",
+		"msgTileBandwidthRanking",
+		"msgCaptureWindow",
+	};
+
+	string options = "dispatchPassThroughEnable on\n";
+	for (auto *name : disabled)
+		options += string(name) + " off\n";
+
+	setLayerConfig("pass-through-test", options.c_str());
+	return new PassThroughTest;
+}
@@ -33,6 +33,9 @@ class QueueTest : public VulkanTestHelper
 		if (!testBarriers())
 			return false;
 
+		if (!testDependencyChains())
+			return false;
+
 		return true;
 	}
 
@@ -206,6 +209,159 @@ class QueueTest : public VulkanTestHelper
 
 		return true;
 	}
+
+	// Chains which mix pipeline barriers and events, in one submission or across several.
+	// Command buffers are applied to the queue as precompiled summaries, and resubmitted ones reuse what
+	// was recorded for them, so every case here must find the same bubbles as applying the commands one by one.
+	// The queue keeps its state from testBarriers(), which the expected counts depend on.
+	bool testDependencyChains()
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+		const uint32_t WIDTH = 64, HEIGHT = 64;
+
+		auto tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		auto fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		VkClearValue clearValues[3];
+		memset(clearValues, 0, sizeof(clearValues));
+
+		VkRenderPassBeginInfo rbi = {};
+		rbi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 3;
+		rbi.pClearValues = clearValues;
+
+		const auto clearImage = [&](VkCommandBuffer cmd) {
+			VkClearColorValue color = {};
+			VkImageSubresourceRange range = {};
+			range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			range.layerCount = 1;
+			range.levelCount = 1;
+			vkCmdClearColorImage(cmd, tex->image, VK_IMAGE_LAYOUT_GENERAL, &color, 1, &range);
+		};
+
+		const auto record = [&](const std::function<void(VkCommandBuffer)> &work) {
+			auto cmdb = make_shared<CommandBuffer>(device);
+			cmdb->initPrimary();
+
+			// Not one-time submit, some of these are submitted again.
+			VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+			work(cmdb->commandBuffer);
+			MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+			return cmdb;
+		};
+
+		// Returns the number of bubbles found by the submission.
+		const auto submit = [&](const shared_ptr<CommandBuffer> &cmdb) {
+			resetCounts();
+			VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit.commandBufferCount = 1;
+			submit.pCommandBuffers = &cmdb->commandBuffer;
+			vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE);
+			vkQueueWaitIdle(queue);
+			return getCount(MESSAGE_CODE_PIPELINE_BUBBLE);
+		};
+
+		VkEventCreateInfo eventInfo = { VK_STRUCTURE_TYPE_EVENT_CREATE_INFO };
+		VkEvent events[5];
+		for (auto &event : events)
+			vkCreateEvent(device, &eventInfo, nullptr, &event);
+
+		bool success = [&]() {
+			// An event signalled after fragment work in one submission, and waited for by geometry in the next.
+			if (submit(record([&](VkCommandBuffer cmd) {
+				    vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+				    vkCmdEndRenderPass(cmd);
+				    vkCmdSetEvent(cmd, events[0], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			    })) != 0)
+				return false;
+
+			if (submit(record([&](VkCommandBuffer cmd) {
+				    vkCmdWaitEvents(cmd, 1, &events[0], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				                    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, nullptr, 0, nullptr, 0, nullptr);
+				    vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+				    vkCmdEndRenderPass(cmd);
+			    })) != 2)
+				return false;
+
+			// FRAGMENT -> TRANSFER through an event, transfer work, then TRANSFER -> FRAGMENT through a barrier.
+			// Every resubmission waits for more of the work queued before it, and finds one more bubble.
+			auto eventThenBarrier = record([&](VkCommandBuffer cmd) {
+				vkCmdResetEvent(cmd, events[1], VK_PIPELINE_STAGE_TRANSFER_BIT);
+				vkCmdSetEvent(cmd, events[1], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+				vkCmdWaitEvents(cmd, 1, &events[1], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				                VK_PIPELINE_STAGE_TRANSFER_BIT, 0, nullptr, 0, nullptr, 0, nullptr);
+				clearImage(cmd);
+				vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+				                     nullptr, 0, nullptr, 0, nullptr);
+				vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdEndRenderPass(cmd);
+			});
+
+			if (submit(eventThenBarrier) != 0)
+				return false;
+			if (submit(eventThenBarrier) != 1)
+				return false;
+			if (submit(eventThenBarrier) != 2)
+				return false;
+
+			// FRAGMENT -> TRANSFER through a barrier, transfer work, then TRANSFER -> FRAGMENT through an event.
+			// Only the first submission follows fragment work which the transfer has to wait for.
+			auto barrierThenEvent = record([&](VkCommandBuffer cmd) {
+				vkCmdResetEvent(cmd, events[2], VK_PIPELINE_STAGE_TRANSFER_BIT);
+				vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+				                     nullptr, 0, nullptr, 0, nullptr);
+				clearImage(cmd);
+				vkCmdSetEvent(cmd, events[2], VK_PIPELINE_STAGE_TRANSFER_BIT);
+				vkCmdWaitEvents(cmd, 1, &events[2], VK_PIPELINE_STAGE_TRANSFER_BIT,
+				                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, nullptr, 0, nullptr, 0, nullptr);
+				vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdEndRenderPass(cmd);
+			});
+
+			if (submit(barrierThenEvent) != 1)
+				return false;
+			if (submit(barrierThenEvent) != 0)
+				return false;
+			if (submit(barrierThenEvent) != 0)
+				return false;
+
+			// The same chains without transfer work are just FRAGMENT -> FRAGMENT dependencies, so no bubble.
+			if (submit(record([&](VkCommandBuffer cmd) {
+				    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				                         0, nullptr, 0, nullptr, 0, nullptr);
+				    vkCmdSetEvent(cmd, events[3], VK_PIPELINE_STAGE_TRANSFER_BIT);
+				    vkCmdWaitEvents(cmd, 1, &events[3], VK_PIPELINE_STAGE_TRANSFER_BIT,
+				                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, nullptr, 0, nullptr, 0, nullptr);
+				    vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+				    vkCmdEndRenderPass(cmd);
+			    })) != 0)
+				return false;
+
+			if (submit(record([&](VkCommandBuffer cmd) {
+				    vkCmdSetEvent(cmd, events[4], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+				    vkCmdWaitEvents(cmd, 1, &events[4], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				                    VK_PIPELINE_STAGE_TRANSFER_BIT, 0, nullptr, 0, nullptr, 0, nullptr);
+				    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				                         0, nullptr, 0, nullptr, 0, nullptr);
+				    vkCmdBeginRenderPass(cmd, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+				    vkCmdEndRenderPass(cmd);
+			    })) != 0)
+				return false;
+
+			return true;
+		}();
+
+		for (auto &event : events)
+			vkDestroyEvent(device, event, nullptr);
+
+		return success;
+	}
 };
 
 VulkanTestHelper *MPD::createTest()
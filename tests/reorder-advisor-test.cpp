@@ -0,0 +1,198 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class ReorderAdvisorTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	shared_ptr<Texture> tex;
+	shared_ptr<Framebuffer> fb;
+	shared_ptr<Pipeline> pipeline;
+
+	void submitDraw(const Buffer &buffer, uint32_t indexCount)
+	{
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		vkCmdBindIndexBuffer(cmdb->commandBuffer, buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(cmdb->commandBuffer, indexCount, 1, 0, 0, 0);
+		vkCmdEndRenderPass(cmdb->commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb->commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+	}
+
+	// Indices are reordered on a thread of the layer, give it time to report.
+	void waitForAdvice(unsigned count)
+	{
+		for (unsigned i = 0; i < 500 && getCount(MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE) < count; i++)
+			this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	bool testWellOrdered()
+	{
+		resetCounts();
+
+		// Each triangle only brings one new vertex, which can't be improved on.
+		vector<uint16_t> indices;
+		for (uint16_t i = 0; i < 256; i++)
+		{
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + 2);
+		}
+
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(indices.size() * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		              HOST_ACCESS_WRITE, indices.data());
+
+		submitDraw(*idxBuff, uint32_t(indices.size()));
+		submitDraw(*idxBuff, uint32_t(indices.size()));
+
+		// Nothing to report, neither for the drawcall nor in the ranking.
+		waitForAdvice(1);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE) != 0)
+			return false;
+
+		return true;
+	}
+
+	bool testShuffled()
+	{
+		resetCounts();
+
+		// A grid whose triangles are drawn in a scrambled order, so hardly any vertex is still in the cache.
+		const uint16_t GRID = 16;
+		vector<uint16_t> indices;
+		for (uint16_t y = 0; y < GRID; y++)
+		{
+			for (uint16_t x = 0; x < GRID; x++)
+			{
+				uint16_t v = y * (GRID + 1) + x;
+				uint16_t quad[] = { v, uint16_t(v + 1), uint16_t(v + GRID + 1),
+					                uint16_t(v + 1), uint16_t(v + GRID + 2), uint16_t(v + GRID + 1) };
+				indices.insert(end(indices), quad, quad + 6);
+			}
+		}
+
+		uint32_t triangleCount = uint32_t(indices.size() / 3);
+		uint32_t seed = 1;
+		for (uint32_t i = triangleCount - 1; i > 0; i--)
+		{
+			seed = seed * 1103515245u + 12345u;
+			uint32_t j = (seed >> 16) % (i + 1);
+			for (uint32_t corner = 0; corner < 3; corner++)
+				swap(indices[3 * i + corner], indices[3 * j + corner]);
+		}
+
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(indices.size() * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		              HOST_ACCESS_WRITE, indices.data());
+
+		// The drawcall is reported once its indices have been reordered.
+		submitDraw(*idxBuff, uint32_t(indices.size()));
+		waitForAdvice(1);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE) != 1)
+			return false;
+
+		// The second frame ends the ranking period, which lists the drawcall.
+		submitDraw(*idxBuff, uint32_t(indices.size()));
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_REORDER_ADVICE) != 2)
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		if (!testWellOrdered())
+			return false;
+
+		if (!testShuffled())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	setLayerConfig("reorder-advisor-test", "indexBufferReorderAdvisorEnable on\n"
+	                                       "indexBufferReorderAdvisorReportFrames 2\n"
+	                                       "frameBoundaryPerSubmit on\n");
+	return new ReorderAdvisorTest;
+}
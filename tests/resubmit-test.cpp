@@ -0,0 +1,217 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class ResubmitTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	shared_ptr<Texture> tex;
+	shared_ptr<Framebuffer> fb;
+	shared_ptr<Pipeline> pipeline;
+	shared_ptr<Buffer> idxBuffSparse;
+	shared_ptr<Buffer> idxBuffDense;
+
+	void submit(VkCommandBuffer commandBuffer)
+	{
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+	}
+
+	void beginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+	{
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+		vkCmdBeginRenderPass(commandBuffer, &rbi, contents);
+	}
+
+	void draw(VkCommandBuffer commandBuffer, const Buffer &buffer)
+	{
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+		vkCmdSetViewport(commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		vkCmdBindIndexBuffer(commandBuffer, buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(commandBuffer, cfg.indexBufferScanMinIndexCount, 1, 0, 0, 0);
+	}
+
+	void recordPrimary(VkCommandBuffer commandBuffer, const Buffer &buffer)
+	{
+		// Not one-time submit, the command buffer is submitted as recorded until it is reset.
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(commandBuffer, &cbBeginInfo));
+		beginRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		draw(commandBuffer, buffer);
+		vkCmdEndRenderPass(commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
+
+	bool testPrimary()
+	{
+		resetCounts();
+
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+		recordPrimary(cmdb->commandBuffer, *idxBuffSparse);
+
+		// Every submission is analyzed, not just the first one after recording.
+		for (unsigned i = 1; i <= 3; i++)
+		{
+			submit(cmdb->commandBuffer);
+			if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != i)
+				return false;
+		}
+
+		// Resetting the command buffer forgets what was recorded before.
+		MPD_ASSERT_RESULT(vkResetCommandBuffer(cmdb->commandBuffer, 0));
+		recordPrimary(cmdb->commandBuffer, *idxBuffDense);
+
+		for (unsigned i = 0; i < 2; i++)
+		{
+			submit(cmdb->commandBuffer);
+			if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 3)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool testSecondary()
+	{
+		resetCounts();
+
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferAllocateInfo cbAllocInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, NULL, cmdb->pool,
+			                                        VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1 };
+		VkCommandBuffer secondary;
+		MPD_ASSERT_RESULT(vkAllocateCommandBuffers(device, &cbAllocInfo, &secondary));
+
+		VkCommandBufferInheritanceInfo inheritance = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+		inheritance.renderPass = fb->renderPass;
+		inheritance.framebuffer = fb->framebuffer;
+
+		VkCommandBufferBeginInfo secondaryBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(secondary, &secondaryBeginInfo));
+		draw(secondary, *idxBuffSparse);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(secondary));
+
+		const auto recordExecute = [&]() {
+			VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+			beginRenderPass(cmdb->commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkCmdExecuteCommands(cmdb->commandBuffer, 1, &secondary);
+			vkCmdEndRenderPass(cmdb->commandBuffer);
+			MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+		};
+
+		// The secondary command buffer is replayed as part of the primary each time.
+		recordExecute();
+		for (unsigned i = 1; i <= 2; i++)
+		{
+			submit(cmdb->commandBuffer);
+			if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != i)
+				return false;
+		}
+
+		// Re-recording the primary doesn't lose the secondary's commands.
+		MPD_ASSERT_RESULT(vkResetCommandBuffer(cmdb->commandBuffer, 0));
+		recordExecute();
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 3)
+			return false;
+
+		vkFreeCommandBuffers(device, cmdb->pool, 1, &secondary);
+		return true;
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		vector<uint16_t> indices(cfg.indexBufferScanMinIndexCount);
+		for (unsigned i = 0; i < cfg.indexBufferScanMinIndexCount; i++)
+			indices[i] = i;
+
+		idxBuffDense = make_shared<Buffer>(device);
+		idxBuffDense->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                   HOST_ACCESS_WRITE, indices.data());
+
+		// One index is way off, without primitive restart.
+		indices.back() = 0xffff;
+		idxBuffSparse = make_shared<Buffer>(device);
+		idxBuffSparse->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		                    HOST_ACCESS_WRITE, indices.data());
+
+		if (!testPrimary())
+			return false;
+
+		if (!testSecondary())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	// Otherwise the indices are only scanned once, however often they are drawn.
+	setLayerConfig("resubmit-test", "indexBufferScanCacheEnable off\n");
+	return new ResubmitTest;
+}
@@ -0,0 +1,138 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class ScanBudgetTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+	static const unsigned DRAW_COUNT = 4;
+
+	bool testBudget()
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		auto tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		auto fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		auto pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		// Every draw is sparse, and has its own index buffer, so each one is reported when it is first scanned.
+		vector<uint16_t> indices(cfg.indexBufferScanMinIndexCount);
+		for (unsigned i = 0; i < cfg.indexBufferScanMinIndexCount; i++)
+			indices[i] = i;
+		indices.back() = 0xffff;
+
+		vector<shared_ptr<Buffer>> idxBuffs;
+		for (unsigned i = 0; i < DRAW_COUNT; i++)
+		{
+			auto idxBuff = make_shared<Buffer>(device);
+			idxBuff->init(sizeof(uint16_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+			              HOST_ACCESS_WRITE, indices.data());
+			idxBuffs.push_back(idxBuff);
+		}
+
+		// The same frame is submitted over and over.
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		for (auto &idxBuff : idxBuffs)
+		{
+			vkCmdBindIndexBuffer(cmdb->commandBuffer, idxBuff->buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdDrawIndexed(cmdb->commandBuffer, uint32_t(indices.size()), 1, 0, 0, 0);
+		}
+		vkCmdEndRenderPass(cmdb->commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb->commandBuffer;
+
+		// The budget only covers the first draw which is offered each frame. The draws turned away are scanned
+		// in later frames, and once all of them were, the cached results leave nothing to scan.
+		resetCounts();
+		for (unsigned frame = 1; frame <= DRAW_COUNT + 2; frame++)
+		{
+			MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+			vkQueueWaitIdle(queue);
+
+			if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != (frame < DRAW_COUNT ? frame : DRAW_COUNT))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		if (!testBudget())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	// Less than a single draw's indices, so each frame scans exactly one draw.
+	setLayerConfig("scan-budget-test", "indexBufferScanBudgetBytes 1\n"
+	                                   "frameBoundaryPerSubmit on\n");
+	return new ScanBudgetTest;
+}
@@ -0,0 +1,140 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+
+using namespace MPD;
+using namespace std;
+
+class TileBandwidthTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	shared_ptr<Texture> tex;
+	shared_ptr<Framebuffer> fbStore;
+	shared_ptr<Framebuffer> fbDontCare;
+
+	// Submits a frame of empty render passes.
+	void submitFrame(const Framebuffer &fb, unsigned renderPassCount)
+	{
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, NULL,
+			                                     VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, NULL };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb.renderPass;
+		rbi.framebuffer = fb.framebuffer;
+		rbi.renderArea.extent.width = WIDTH;
+		rbi.renderArea.extent.height = HEIGHT;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		for (unsigned i = 0; i < renderPassCount; i++)
+		{
+			vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdEndRenderPass(cmdb->commandBuffer);
+		}
+
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &cmdb->commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+	}
+
+	bool testBudget()
+	{
+		resetCounts();
+
+		// Storing the attachment once is 16 KiB, within the budget.
+		submitFrame(*fbStore, 1);
+		if (getCount(MESSAGE_CODE_TILE_BANDWIDTH_BUDGET) != 0)
+			return false;
+		if (getCount(MESSAGE_CODE_TILE_BANDWIDTH_RANKING) != 0)
+			return false;
+
+		// Storing it twice is over it. This frame also ends the ranking period.
+		submitFrame(*fbStore, 2);
+		if (getCount(MESSAGE_CODE_TILE_BANDWIDTH_BUDGET) != 1)
+			return false;
+		if (getCount(MESSAGE_CODE_TILE_BANDWIDTH_RANKING) != 1)
+			return false;
+
+		return true;
+	}
+
+	bool testNoTraffic()
+	{
+		resetCounts();
+
+		// Render passes which neither load nor store their attachments stay on tile, there is nothing to rank.
+		for (unsigned frame = 0; frame < 2; frame++)
+		{
+			submitFrame(*fbDontCare, 4);
+			if (getCount(MESSAGE_CODE_TILE_BANDWIDTH_BUDGET) != 0)
+				return false;
+			if (getCount(MESSAGE_CODE_TILE_BANDWIDTH_RANKING) != 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		fbStore = make_shared<Framebuffer>(device);
+		fbStore->initOnlyColor(tex, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE);
+
+		fbDontCare = make_shared<Framebuffer>(device);
+		fbDontCare->initOnlyColor(tex, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+		if (!testBudget())
+			return false;
+
+		if (!testNoTraffic())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	// A 64x64 RGBA8 attachment is 16 KiB, the budget allows storing it once per frame.
+	setLayerConfig("tile-bandwidth-test", "tileBandwidthEstimatorEnable on\n"
+	                                      "tileBandwidthBudgetBytes 24576\n"
+	                                      "tileBandwidthReportFrames 2\n"
+	                                      "frameBoundaryPerSubmit on\n");
+	return new TileBandwidthTest;
+}
@@ -20,7 +20,9 @@
 
 #include "vulkan_test.hpp"
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 using namespace std;
@@ -30,7 +32,8 @@ namespace MPD
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT, uint64_t, size_t,
                                                     int32_t messageCode, const char *pLayerPrefix, const char * message, void *pUserData)
 {
-	if (flags == VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT && !strcmp(pLayerPrefix, "PowerVRPerfDoc"))
+	if ((flags == VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT || flags == VK_DEBUG_REPORT_INFORMATION_BIT_EXT) &&
+	    !strcmp(pLayerPrefix, "PowerVRPerfDoc"))
 	{
 		MPD_ASSERT(messageCode >= 0 && messageCode < MESSAGE_CODE_COUNT);
 		static_cast<VulkanTestHelper *>(pUserData)->notifyCallback(static_cast<MessageCodes>(messageCode));
@@ -122,7 +125,8 @@ VulkanTestHelper::VulkanTestHelper()
 
 	VULKAN_SYMBOL_WRAPPER_LOAD_INSTANCE_EXTENSION_SYMBOL(instance, vkCreateDebugReportCallbackEXT);
 	VkDebugReportCallbackCreateInfoEXT info = { VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT };
-	info.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT;
+	info.flags = VK_DEBUG_REPORT_ERROR_BIT_EXT | VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT |
+	             VK_DEBUG_REPORT_INFORMATION_BIT_EXT;
 	info.pfnCallback = debugCallback;
 	info.pUserData = this;
 	vkCreateDebugReportCallbackEXT(instance, &info, nullptr, &callback);
@@ -215,6 +219,22 @@ void VulkanTestHelper::notifyCallback(MessageCodes code)
 	warningCount[code]++;
 }
 
+void setLayerConfig(const char *name, const char *options)
+{
+	string path = string(name) + ".cfg";
+	FILE *file = fopen(path.c_str(), "w");
+	if (!file)
+		throw runtime_error("Failed to write layer config.");
+	fputs(options, file);
+	fclose(file);
+
+#ifdef _WIN32
+	_putenv_s("POWERVR_PERFDOC_CONFIG", path.c_str());
+#else
+	setenv("POWERVR_PERFDOC_CONFIG", path.c_str(), 1);
+#endif
+}
+
 VulkanTestHelper::~VulkanTestHelper()
 {
 	if (device != VK_NULL_HANDLE)
@@ -64,4 +64,8 @@ protected:
 
 // Implemented by tests.
 VulkanTestHelper *createTest();
+
+// Writes the options, one "name value" per line, to name.cfg and makes the layer load it.
+// Must be called from createTest(), before the instance is created.
+void setLayerConfig(const char *name, const char *options);
 }
\ No newline at end of file
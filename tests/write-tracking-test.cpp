@@ -0,0 +1,159 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "perfdoc.hpp"
+#include "util.hpp"
+#include "vulkan_test.hpp"
+#include <memory>
+#include <vector>
+
+using namespace MPD;
+using namespace std;
+
+class WriteTrackingTest : public VulkanTestHelper
+{
+	static const uint32_t WIDTH = 64, HEIGHT = 64;
+
+	// 64 KiB of indices, whole pages for any common page size, so all of them can be tracked.
+	static const uint32_t INDEX_COUNT = 32768;
+
+	void submit(VkCommandBuffer commandBuffer)
+	{
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &commandBuffer;
+		MPD_ASSERT_RESULT(vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE));
+		vkQueueWaitIdle(queue);
+	}
+
+	bool testWrites()
+	{
+		const VkFormat FMT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		auto tex = make_shared<Texture>(device);
+		tex->initRenderTarget2D(WIDTH, HEIGHT, FMT);
+
+		auto fb = make_shared<Framebuffer>(device);
+		fb->initOnlyColor(tex);
+
+		static const uint32_t vertCode[] =
+#include "quad_no_attribs.vert.inc"
+		    ;
+
+		static const uint32_t fragCode[] =
+#include "quad.frag.inc"
+		    ;
+
+		VkGraphicsPipelineCreateInfo pplineInf = {};
+		VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+		pplineInf.pInputAssemblyState = &ia;
+		pplineInf.renderPass = fb->renderPass;
+
+		auto pipeline = make_shared<Pipeline>(device);
+		pipeline->initGraphics(vertCode, sizeof(vertCode), fragCode, sizeof(fragCode), &pplineInf);
+
+		// A small range of vertices, every one of them used.
+		vector<uint16_t> indices(INDEX_COUNT);
+		for (uint32_t i = 0; i < INDEX_COUNT; i++)
+			indices[i] = uint16_t(i % 1024);
+
+		auto idxBuff = make_shared<Buffer>(device);
+		idxBuff->init(sizeof(uint16_t) * INDEX_COUNT, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memoryProperties,
+		              HOST_ACCESS_WRITE, indices.data());
+
+		// Recorded once and submitted as often as needed.
+		auto cmdb = make_shared<CommandBuffer>(device);
+		cmdb->initPrimary();
+
+		VkCommandBufferBeginInfo cbBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		MPD_ASSERT_RESULT(vkBeginCommandBuffer(cmdb->commandBuffer, &cbBeginInfo));
+
+		VkClearValue clearValue = {};
+		VkRenderPassBeginInfo rbi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rbi.renderPass = fb->renderPass;
+		rbi.framebuffer = fb->framebuffer;
+		rbi.clearValueCount = 1;
+		rbi.pClearValues = &clearValue;
+
+		VkViewport s = { 0.0f, 0.0f, float(WIDTH), float(HEIGHT), 0.0f, 1.0f };
+
+		vkCmdBeginRenderPass(cmdb->commandBuffer, &rbi, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdb->commandBuffer, 0, 1, &s);
+		vkCmdBindPipeline(cmdb->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+		vkCmdBindIndexBuffer(cmdb->commandBuffer, idxBuff->buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(cmdb->commandBuffer, INDEX_COUNT, 1, 0, 0, 0);
+		vkCmdEndRenderPass(cmdb->commandBuffer);
+		MPD_ASSERT_RESULT(vkEndCommandBuffer(cmdb->commandBuffer));
+
+		resetCounts();
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 0)
+			return false;
+
+		// One index written through the mapping makes the indices sparse, which the next scan must see.
+		void *ptr;
+		MPD_ASSERT_RESULT(vkMapMemory(device, idxBuff->memory, 0, VK_WHOLE_SIZE, 0, &ptr));
+		static_cast<uint16_t *>(ptr)[INDEX_COUNT / 2] = 0xffff;
+		vkUnmapMemory(device, idxBuff->memory);
+
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		// The scan is cached, so the draw is not reported again.
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		// Without tracking, mapping the memory would be taken as a write. With it, only real writes count.
+		MPD_ASSERT_RESULT(vkMapMemory(device, idxBuff->memory, 0, VK_WHOLE_SIZE, 0, &ptr));
+		vkUnmapMemory(device, idxBuff->memory);
+
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 1)
+			return false;
+
+		// A write to any other page of the buffer also causes a rescan, which reports the draw once more.
+		MPD_ASSERT_RESULT(vkMapMemory(device, idxBuff->memory, 0, VK_WHOLE_SIZE, 0, &ptr));
+		static_cast<uint16_t *>(ptr)[0] = 0;
+		vkUnmapMemory(device, idxBuff->memory);
+
+		submit(cmdb->commandBuffer);
+		if (getCount(MESSAGE_CODE_INDEX_BUFFER_SPARSE) != 2)
+			return false;
+
+		return true;
+	}
+
+	bool runTest() override
+	{
+		if (!testWrites())
+			return false;
+
+		return true;
+	}
+};
+
+VulkanTestHelper *MPD::createTest()
+{
+	setLayerConfig("write-tracking-test", "indexBufferWriteTrackingEnable on\n");
+	return new WriteTrackingTest;
+}
@@ -0,0 +1,366 @@
+/* Copyright (c) 2017, ARM Limited and Contributors
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Renders a binary log written by the layer with loggingBinary as text, or as JSON with one object per line.
+
+#include "binary_log_format.hpp"
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace MPD;
+
+static bool readFile(const char *path, vector<uint8_t> &data)
+{
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	uint8_t buffer[64 * 1024];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		data.insert(data.end(), buffer, buffer + count);
+
+	fclose(file);
+	return true;
+}
+
+// Reads the raw arguments of a message in order.
+struct ArgReader
+{
+	const uint8_t *data;
+	size_t size;
+	size_t offset;
+
+	bool readValue(uint64_t &value)
+	{
+		if (offset + sizeof(value) > size)
+			return false;
+		memcpy(&value, data + offset, sizeof(value));
+		offset += sizeof(value);
+		return true;
+	}
+
+	bool readString(string &str)
+	{
+		uint32_t length;
+		if (offset + sizeof(length) > size)
+			return false;
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+		if (offset + length > size)
+			return false;
+		str.assign(reinterpret_cast<const char *>(data + offset), length);
+		offset += length;
+		return true;
+	}
+};
+
+static bool formatArg(const string &spec, BinaryLogArg arg, ArgReader &reader, string &out)
+{
+	char buffer[1024];
+	uint64_t value = 0;
+	string str;
+
+	if (arg == BinaryLogArg::STRING)
+	{
+		if (!reader.readString(str))
+			return false;
+	}
+	else if (!reader.readValue(value))
+		return false;
+
+	double d;
+	memcpy(&d, &value, sizeof(d));
+
+	switch (arg)
+	{
+	case BinaryLogArg::NONE:
+		return true;
+	case BinaryLogArg::INT:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), int(int64_t(value)));
+		break;
+	case BinaryLogArg::UNSIGNED_INT:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), unsigned(value));
+		break;
+	case BinaryLogArg::LONG:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), long(int64_t(value)));
+		break;
+	case BinaryLogArg::UNSIGNED_LONG:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<unsigned long>(value));
+		break;
+	case BinaryLogArg::LONG_LONG:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<long long>(value));
+		break;
+	case BinaryLogArg::UNSIGNED_LONG_LONG:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<unsigned long long>(value));
+		break;
+	case BinaryLogArg::SIZE:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), size_t(value));
+		break;
+	case BinaryLogArg::DOUBLE:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), d);
+		break;
+	case BinaryLogArg::LONG_DOUBLE:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), static_cast<long double>(d));
+		break;
+	case BinaryLogArg::POINTER:
+		snprintf(buffer, sizeof(buffer), spec.c_str(), reinterpret_cast<void *>(uintptr_t(value)));
+		break;
+	case BinaryLogArg::STRING:
+		// Strings can be longer than the buffer.
+		if (spec == "%s")
+		{
+			out += str;
+			return true;
+		}
+		snprintf(buffer, sizeof(buffer), spec.c_str(), str.c_str());
+		break;
+	}
+
+	out += buffer;
+	return true;
+}
+
+static string renderMessage(const string &fmt, ArgReader reader)
+{
+	string out;
+	const char *literal = fmt.c_str();
+	const char *cursor = literal;
+	BinaryLogConversion conversion;
+
+	while (nextBinaryLogConversion(cursor, conversion))
+	{
+		out.append(literal, conversion.begin);
+		literal = cursor;
+
+		if (conversion.arg == BinaryLogArg::NONE)
+		{
+			out += '%';
+			continue;
+		}
+
+		// '*' widths and precisions were recorded as arguments, put them back into the specification.
+		string spec;
+		bool complete = true;
+		for (const char *c = conversion.begin; c != conversion.end; c++)
+		{
+			uint64_t value;
+			if (*c != '*')
+				spec += *c;
+			else if (reader.readValue(value))
+				spec += to_string(int(int64_t(value)));
+			else
+				complete = false;
+		}
+
+		if (!complete || !formatArg(spec, conversion.arg, reader, out))
+			out += "<missing>";
+	}
+
+	// The rest of the format string, including anything after a conversion the log does not support.
+	out += literal;
+	return out;
+}
+
+static string escapeJson(const string &str)
+{
+	string escaped;
+	for (char c : str)
+	{
+		switch (c)
+		{
+		case '"':
+			escaped += "\\\"";
+			break;
+		case '\\':
+			escaped += "\\\\";
+			break;
+		case '\n':
+			escaped += "\\n";
+			break;
+		case '\t':
+			escaped += "\\t";
+			break;
+		default:
+			if (uint8_t(c) < 0x20)
+			{
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", unsigned(uint8_t(c)));
+				escaped += buffer;
+			}
+			else
+				escaped += c;
+			break;
+		}
+	}
+	return escaped;
+}
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	const char *path = nullptr;
+	bool usage = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--json"))
+			json = true;
+		else if (!path)
+			path = argv[i];
+		else
+			usage = true;
+	}
+
+	if (!path || usage)
+	{
+		fprintf(stderr, "Usage: perfdoc-log-decode [--json] <log>\n");
+		return 1;
+	}
+
+	vector<uint8_t> data;
+	if (!readFile(path, data))
+	{
+		fprintf(stderr, "Failed to open %s.\n", path);
+		return 1;
+	}
+
+	BinaryLogFileHeader header;
+	if (data.size() < sizeof(header))
+	{
+		fprintf(stderr, "%s is not a PerfDoc binary log.\n", path);
+		return 1;
+	}
+
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.magic, BINARY_LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != BINARY_LOG_VERSION ||
+	    header.headerSize < sizeof(header) || header.headerSize > data.size())
+	{
+		fprintf(stderr, "%s is not a PerfDoc binary log of version %u.\n", path, BINARY_LOG_VERSION);
+		return 1;
+	}
+
+	unordered_map<uint32_t, string> formats;
+	size_t offset = header.headerSize;
+
+	while (offset + sizeof(BinaryLogRecordHeader) <= data.size())
+	{
+		BinaryLogRecordHeader recordHeader;
+		memcpy(&recordHeader, data.data() + offset, sizeof(recordHeader));
+		if (recordHeader.type == BINARY_LOG_RECORD_END)
+			break;
+
+		if (recordHeader.size < sizeof(recordHeader) || recordHeader.size > data.size() - offset)
+		{
+			fprintf(stderr, "Truncated record at offset %llu.\n", static_cast<unsigned long long>(offset));
+			return 1;
+		}
+
+		const uint8_t *record = data.data() + offset;
+		offset += recordHeader.size;
+
+		if (recordHeader.type == BINARY_LOG_RECORD_FORMAT && recordHeader.size >= sizeof(BinaryLogFormatRecord))
+		{
+			BinaryLogFormatRecord format;
+			memcpy(&format, record, sizeof(format));
+			if (format.length <= recordHeader.size - sizeof(format))
+				formats[format.formatId].assign(reinterpret_cast<const char *>(record + sizeof(format)), format.length);
+		}
+		else if (recordHeader.type == BINARY_LOG_RECORD_MESSAGE &&
+		         recordHeader.size >= sizeof(BinaryLogMessageRecord))
+		{
+			BinaryLogMessageRecord message;
+			memcpy(&message, record, sizeof(message));
+
+			ArgReader reader = { record + sizeof(message), 0, 0 };
+			reader.size = std::min<size_t>(message.argSize, recordHeader.size - sizeof(message));
+
+			string text;
+			auto itr = formats.find(message.formatId);
+			if (itr != formats.end())
+				text = renderMessage(itr->second, reader);
+			else
+				text = "<unknown format " + to_string(message.formatId) + ">";
+
+			if (json)
+			{
+				printf("{\"timestamp_ns\": %llu, \"frame\": %llu, \"thread\": %u, \"flags\": %u, \"object_type\": %u, "
+				       "\"object\": %llu, \"message_code\": %d, \"message\": \"%s\"}\n",
+				       static_cast<unsigned long long>(message.timestampNs),
+				       static_cast<unsigned long long>(message.frame), message.threadIndex, message.flags,
+				       message.objectType, static_cast<unsigned long long>(message.object), message.messageCode,
+				       escapeJson(text).c_str());
+			}
+			else
+			{
+				printf("[%llu.%06llu] frame %llu, thread %u: PowerVRPerfDoc (objectType: %u, object: %llu, "
+				       "messageCode: %d): %s\n",
+				       static_cast<unsigned long long>(message.timestampNs / 1000000000),
+				       static_cast<unsigned long long>((message.timestampNs / 1000) % 1000000),
+				       static_cast<unsigned long long>(message.frame), message.threadIndex, message.objectType,
+				       static_cast<unsigned long long>(message.object), message.messageCode, text.c_str());
+			}
+		}
+		else if (recordHeader.type == BINARY_LOG_RECORD_FRAME && recordHeader.size >= sizeof(BinaryLogFrameRecord))
+		{
+			BinaryLogFrameRecord frame;
+			memcpy(&frame, record, sizeof(frame));
+
+			uint32_t counterCount =
+			    std::min<uint32_t>(frame.counterCount, uint32_t((recordHeader.size - sizeof(frame)) / sizeof(uint64_t)));
+			const size_t knownCounters = sizeof(BINARY_LOG_FRAME_COUNTERS) / sizeof(BINARY_LOG_FRAME_COUNTERS[0]);
+
+			string counters;
+			for (uint32_t i = 0; i < counterCount; i++)
+			{
+				uint64_t value;
+				memcpy(&value, record + sizeof(frame) + i * sizeof(uint64_t), sizeof(value));
+
+				string name = i < knownCounters ? BINARY_LOG_FRAME_COUNTERS[i] : "counter_" + to_string(i);
+				if (json)
+					counters += ", \"" + name + "\": " + to_string(value);
+				else
+					counters += ", " + name + " " + to_string(value);
+			}
+
+			if (json)
+			{
+				printf("{\"timestamp_ns\": %llu, \"frame\": %llu, \"frame_time_ns\": %llu%s}\n",
+				       static_cast<unsigned long long>(frame.timestampNs), static_cast<unsigned long long>(frame.frame),
+				       static_cast<unsigned long long>(frame.frameTimeNs), counters.c_str());
+			}
+			else
+			{
+				printf("[%llu.%06llu] frame %llu ended: frame_time_ns %llu%s\n",
+				       static_cast<unsigned long long>(frame.timestampNs / 1000000000),
+				       static_cast<unsigned long long>((frame.timestampNs / 1000) % 1000000),
+				       static_cast<unsigned long long>(frame.frame), static_cast<unsigned long long>(frame.frameTimeNs),
+				       counters.c_str());
+			}
+		}
+	}
+
+	return 0;
+}